@@ -0,0 +1,925 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_LOCALE_H
+#  include <locale.h>
+#endif
+
+#include <milter/server.h>
+#include <milter/core.h>
+
+#define DEFAULT_MIN_TIME 0.5
+#define MAX_ITERATIONS 1000000000
+#define BODY_CHUNK_SIZE MILTER_CHUNK_SIZE
+#define N_HEADERS 50 /* X-Benchmark-0, ..., X-Benchmark-49 */
+
+typedef gpointer (*BenchmarkSetupFunc)    (GError **error);
+typedef void     (*BenchmarkRunFunc)      (gpointer data);
+typedef void     (*BenchmarkTeardownFunc) (gpointer data);
+
+typedef struct _Benchmark
+{
+    const gchar *name;
+    BenchmarkSetupFunc setup;
+    BenchmarkRunFunc run;
+    BenchmarkTeardownFunc teardown;
+} Benchmark;
+
+typedef struct _BenchmarkResult
+{
+    const gchar *name;
+    gint64 n_iterations;
+    gdouble elapsed;
+    gsize n_allocations;
+    gsize n_allocated_bytes;
+} BenchmarkResult;
+
+static gdouble min_time = DEFAULT_MIN_TIME;
+static gchar *filter = NULL;
+static gchar *packet_directory = NULL;
+static gchar *output_path = NULL;
+static gboolean list = FALSE;
+
+/*
+ * Allocations are counted by overriding malloc() and friends
+ * in this program. GLib ignores g_mem_set_vtable() since
+ * 2.46, so the memory profiler can't be used for this. The
+ * overrides forward to the glibc internal allocator, so they
+ * are only available with glibc. Memory allocated by
+ * posix_memalign() isn't counted.
+ */
+#ifdef __GLIBC__
+#  define COUNT_ALLOCATIONS 1
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t n_members, size_t size);
+extern void *__libc_realloc (void *memory, size_t size);
+
+static volatile gsize n_allocations = 0;
+static volatile gsize n_allocated_bytes = 0;
+
+static void
+count_allocation (size_t size)
+{
+    __sync_fetch_and_add(&n_allocations, 1);
+    __sync_fetch_and_add(&n_allocated_bytes, size);
+}
+
+void *
+malloc (size_t size)
+{
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void *
+calloc (size_t n_members, size_t size)
+{
+    count_allocation(n_members * size);
+    return __libc_calloc(n_members, size);
+}
+
+void *
+realloc (void *memory, size_t size)
+{
+    if (size > 0)
+        count_allocation(size);
+    return __libc_realloc(memory, size);
+}
+#endif
+
+
+typedef struct _EncoderData
+{
+    MilterEncoder *encoder;
+    GHashTable *macros;
+    gchar *body;
+} EncoderData;
+
+static GHashTable *
+create_connect_macros (void)
+{
+    GHashTable *macros;
+
+    macros = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_insert(macros, "j", "mail.example.com");
+    g_hash_table_insert(macros, "{daemon_name}", "mail.example.com");
+    g_hash_table_insert(macros, "v", "Postfix 2.10.0");
+    g_hash_table_insert(macros, "_", "client.example.net [192.0.2.1]");
+    g_hash_table_insert(macros, "{client_addr}", "192.0.2.1");
+    g_hash_table_insert(macros, "{client_name}", "client.example.net");
+    g_hash_table_insert(macros, "{client_ptr}", "client.example.net");
+    g_hash_table_insert(macros, "{if_addr}", "192.0.2.254");
+
+    return macros;
+}
+
+static gpointer
+setup_command_encoder (GError **error)
+{
+    EncoderData *data;
+
+    data = g_new0(EncoderData, 1);
+    data->encoder = milter_command_encoder_new();
+    data->macros = create_connect_macros();
+    data->body = g_malloc(BODY_CHUNK_SIZE);
+    memset(data->body, 'X', BODY_CHUNK_SIZE);
+
+    return data;
+}
+
+static gpointer
+setup_reply_encoder (GError **error)
+{
+    EncoderData *data;
+
+    data = g_new0(EncoderData, 1);
+    data->encoder = milter_reply_encoder_new();
+    data->body = g_malloc(BODY_CHUNK_SIZE);
+    memset(data->body, 'X', BODY_CHUNK_SIZE);
+
+    return data;
+}
+
+static void
+teardown_encoder (gpointer user_data)
+{
+    EncoderData *data = user_data;
+
+    g_object_unref(data->encoder);
+    if (data->macros)
+        g_hash_table_unref(data->macros);
+    g_free(data->body);
+    g_free(data);
+}
+
+static void
+run_command_encoder_define_macro (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_command_encoder_encode_define_macro(
+        MILTER_COMMAND_ENCODER(data->encoder),
+        &packet, &packet_size,
+        MILTER_COMMAND_CONNECT, data->macros);
+}
+
+static void
+run_command_encoder_helo (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_command_encoder_encode_helo(MILTER_COMMAND_ENCODER(data->encoder),
+                                       &packet, &packet_size,
+                                       "client.example.net");
+}
+
+static void
+run_command_encoder_header (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_command_encoder_encode_header(MILTER_COMMAND_ENCODER(data->encoder),
+                                         &packet, &packet_size,
+                                         "Subject",
+                                         "Hello from milter-benchmark");
+}
+
+static void
+run_command_encoder_body (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size, packed_size;
+
+    milter_command_encoder_encode_body(MILTER_COMMAND_ENCODER(data->encoder),
+                                       &packet, &packet_size,
+                                       data->body, BODY_CHUNK_SIZE,
+                                       &packed_size);
+}
+
+static void
+run_reply_encoder_continue (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_reply_encoder_encode_continue(MILTER_REPLY_ENCODER(data->encoder),
+                                         &packet, &packet_size);
+}
+
+static void
+run_reply_encoder_add_header (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_reply_encoder_encode_add_header(MILTER_REPLY_ENCODER(data->encoder),
+                                           &packet, &packet_size,
+                                           "X-Virus-Status", "Clean");
+}
+
+static void
+run_reply_encoder_replace_body (gpointer user_data)
+{
+    EncoderData *data = user_data;
+    const gchar *packet;
+    gsize packet_size, packed_size;
+
+    milter_reply_encoder_encode_replace_body(
+        MILTER_REPLY_ENCODER(data->encoder),
+        &packet, &packet_size,
+        data->body, BODY_CHUNK_SIZE, &packed_size);
+}
+
+
+typedef struct _DecoderData
+{
+    MilterDecoder *decoder;
+    GPtrArray *packets;
+    guint next_packet;
+} DecoderData;
+
+static gint
+parse_hex_digit (gchar character)
+{
+    if (g_ascii_isxdigit(character))
+        return g_ascii_xdigit_value(character);
+    return -1;
+}
+
+/*
+ * Parses a dump line such as
+ * "0000  00 00 00 0d 4f 00 ...   ....O..." and appends
+ * its bytes to packet.
+ */
+static void
+parse_dump_line (const gchar *line, GString *packet)
+{
+    const gchar *bytes;
+    gint i;
+
+    bytes = line + strlen("0000  ");
+    for (i = 0; i < 16; i++) {
+        gint high, low;
+
+        if (strlen(bytes) < 2)
+            break;
+        high = parse_hex_digit(bytes[0]);
+        low = parse_hex_digit(bytes[1]);
+        if (high < 0 || low < 0)
+            break;
+        g_string_append_c(packet, (gchar)((high << 4) | low));
+        if (bytes[2] != ' ')
+            break;
+        bytes += 3;
+    }
+}
+
+static gboolean
+is_dump_line (const gchar *line)
+{
+    gint i;
+
+    for (i = 0; i < 4; i++) {
+        if (parse_hex_digit(line[i]) < 0)
+            return FALSE;
+    }
+
+    return g_str_has_prefix(line + 4, "  ");
+}
+
+/*
+ * data/packet/*.log has MTA to milter packets at the
+ * beginning of lines and milter to MTA packets indented.
+ */
+static void
+load_packet_log (const gchar *content, gboolean reply, GPtrArray *packets)
+{
+    gchar **lines;
+    gint i;
+    GString *packet = NULL;
+
+    lines = g_strsplit(content, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        const gchar *line = lines[i];
+        gboolean indented;
+
+        indented = line[0] == ' ';
+        while (line[0] == ' ')
+            line++;
+
+        if (g_str_has_prefix(line, "Data (")) {
+            if (packet)
+                g_ptr_array_add(packets, packet);
+            packet = NULL;
+            if (indented == reply)
+                packet = g_string_new(NULL);
+        } else if (packet && is_dump_line(line)) {
+            parse_dump_line(line, packet);
+        }
+    }
+    if (packet)
+        g_ptr_array_add(packets, packet);
+    g_strfreev(lines);
+}
+
+static void
+free_packet (gpointer data)
+{
+    g_string_free(data, TRUE);
+}
+
+static gpointer
+setup_decoder (MilterDecoder *decoder, gboolean reply, GError **error)
+{
+    DecoderData *data;
+    GDir *dir;
+    const gchar *name;
+    GPtrArray *packets;
+    guint i;
+
+    if (!packet_directory) {
+        g_set_error(error,
+                    G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                    "packet directory isn't specified: use --packet-directory");
+        g_object_unref(decoder);
+        return NULL;
+    }
+
+    dir = g_dir_open(packet_directory, 0, error);
+    if (!dir) {
+        g_object_unref(decoder);
+        return NULL;
+    }
+
+    packets = g_ptr_array_new_with_free_func(free_packet);
+    while ((name = g_dir_read_name(dir))) {
+        gchar *path, *content;
+
+        if (!g_str_has_suffix(name, ".log"))
+            continue;
+
+        path = g_build_filename(packet_directory, name, NULL);
+        if (g_file_get_contents(path, &content, NULL, NULL)) {
+            load_packet_log(content, reply, packets);
+            g_free(content);
+        }
+        g_free(path);
+    }
+    g_dir_close(dir);
+
+    data = g_new0(DecoderData, 1);
+    data->decoder = decoder;
+    data->packets = g_ptr_array_new_with_free_func(free_packet);
+    data->next_packet = 0;
+
+    /*
+     * Use only complete packets that can be decoded
+     * successfully. A partial packet leaves data in the
+     * decoder buffer and breaks the following packets.
+     */
+    for (i = 0; i < packets->len; i++) {
+        GString *packet = g_ptr_array_index(packets, i);
+        guint32 length;
+        GError *decode_error = NULL;
+
+        if (packet->len <= sizeof(length))
+            continue;
+        memcpy(&length, packet->str, sizeof(length));
+        if (g_ntohl(length) != packet->len - sizeof(length))
+            continue;
+
+        if (milter_decoder_decode(decoder, packet->str, packet->len,
+                                  &decode_error)) {
+            g_ptr_array_add(data->packets,
+                            g_string_new_len(packet->str, packet->len));
+        } else {
+            g_error_free(decode_error);
+        }
+    }
+    g_ptr_array_unref(packets);
+
+    if (data->packets->len == 0) {
+        g_set_error(error,
+                    G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                    "no packet is found in %s", packet_directory);
+        g_object_unref(data->decoder);
+        g_ptr_array_unref(data->packets);
+        g_free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+static gpointer
+setup_command_decoder (GError **error)
+{
+    return setup_decoder(milter_command_decoder_new(), FALSE, error);
+}
+
+static gpointer
+setup_reply_decoder (GError **error)
+{
+    return setup_decoder(milter_reply_decoder_new(), TRUE, error);
+}
+
+static void
+teardown_decoder (gpointer user_data)
+{
+    DecoderData *data = user_data;
+
+    g_object_unref(data->decoder);
+    g_ptr_array_unref(data->packets);
+    g_free(data);
+}
+
+static void
+run_decoder (gpointer user_data)
+{
+    DecoderData *data = user_data;
+    GString *packet;
+
+    packet = g_ptr_array_index(data->packets, data->next_packet);
+    milter_decoder_decode(data->decoder, packet->str, packet->len, NULL);
+    data->next_packet = (data->next_packet + 1) % data->packets->len;
+}
+
+
+static gpointer
+setup_headers (GError **error)
+{
+    MilterHeaders *headers;
+    gint i;
+
+    headers = milter_headers_new();
+    for (i = 0; i < N_HEADERS; i++) {
+        gchar *name, *value;
+
+        name = g_strdup_printf("X-Benchmark-%d", i);
+        value = g_strdup_printf("value %d", i);
+        milter_headers_append_header(headers, name, value);
+        g_free(name);
+        g_free(value);
+    }
+
+    return headers;
+}
+
+static void
+teardown_headers (gpointer data)
+{
+    g_object_unref(data);
+}
+
+static void
+run_headers_append_remove (gpointer data)
+{
+    MilterHeaders *headers = data;
+    MilterHeader *header;
+
+    milter_headers_append_header(headers, "X-Appended", "appended");
+    header = milter_headers_lookup_by_name(headers, "X-Appended");
+    milter_headers_remove(headers, header);
+}
+
+static void
+run_headers_lookup_by_name (gpointer data)
+{
+    MilterHeaders *headers = data;
+
+    /* The last header is the worst case. */
+    milter_headers_lookup_by_name(headers, "X-Benchmark-49");
+}
+
+static void
+run_headers_copy (gpointer data)
+{
+    MilterHeaders *headers = data;
+
+    g_object_unref(milter_headers_copy(headers));
+}
+
+
+static gpointer
+setup_nothing (GError **error)
+{
+    return NULL;
+}
+
+static void
+teardown_nothing (gpointer data)
+{
+}
+
+static void
+run_esmtp_parse_mail_from_argument (gpointer data)
+{
+    gchar *path = NULL;
+    GHashTable *parameters = NULL;
+
+    milter_esmtp_parse_mail_from_argument(
+        "<sender@example.com> SIZE=102400 BODY=8BITMIME",
+        &path, &parameters, NULL);
+    g_free(path);
+    if (parameters)
+        g_hash_table_unref(parameters);
+}
+
+
+typedef struct _ServerContextData
+{
+    MilterEventLoop *loop;
+    MilterServerContext *context;
+    MilterDecoder *decoder;
+    gchar *continue_packet;
+    gsize continue_packet_size;
+} ServerContextData;
+
+static gpointer
+setup_server_context (GError **error)
+{
+    ServerContextData *data;
+    MilterAgent *agent;
+    MilterProtocolAgent *protocol_agent;
+    MilterMacrosRequests *macros_requests;
+    MilterReplyEncoder *encoder;
+    GIOChannel *channel;
+    MilterWriter *writer;
+    const gchar *packet;
+
+    channel = g_io_channel_new_file("/dev/null", "w", error);
+    if (!channel)
+        return NULL;
+    g_io_channel_set_encoding(channel, NULL, NULL);
+    g_io_channel_set_buffered(channel, FALSE);
+
+    data = g_new0(ServerContextData, 1);
+    data->loop = milter_libev_event_loop_new();
+    data->context = milter_server_context_new();
+    agent = MILTER_AGENT(data->context);
+    protocol_agent = MILTER_PROTOCOL_AGENT(data->context);
+    milter_server_context_set_name(data->context, "milter-benchmark");
+    milter_agent_set_event_loop(agent, data->loop);
+
+    writer = milter_writer_io_channel_new(channel);
+    g_io_channel_unref(channel);
+    milter_agent_set_writer(agent, writer);
+    g_object_unref(writer);
+    if (!milter_agent_start(agent, error)) {
+        g_object_unref(data->context);
+        g_object_unref(data->loop);
+        g_free(data);
+        return NULL;
+    }
+
+    milter_protocol_agent_set_macros(protocol_agent, MILTER_COMMAND_HELO,
+                                     "j", "mail.example.com",
+                                     "{daemon_name}", "mail.example.com",
+                                     "v", "Postfix 2.10.0",
+                                     "{tls_version}", "TLSv1.2",
+                                     "{cipher}", "ECDHE-RSA-AES256-GCM-SHA384",
+                                     "{cipher_bits}", "256",
+                                     "{cert_subject}", "CN=client.example.net",
+                                     "{cert_issuer}", "CN=Example CA",
+                                     NULL);
+    macros_requests = milter_macros_requests_new();
+    milter_macros_requests_set_symbols(macros_requests, MILTER_COMMAND_HELO,
+                                       "{tls_version}", "{cipher}",
+                                       "{cert_subject}", NULL);
+    milter_protocol_agent_set_macros_requests(protocol_agent, macros_requests);
+    g_object_unref(macros_requests);
+
+    data->decoder = milter_agent_get_decoder(agent);
+    encoder = MILTER_REPLY_ENCODER(milter_reply_encoder_new());
+    milter_reply_encoder_encode_continue(encoder, &packet,
+                                         &data->continue_packet_size);
+    data->continue_packet = g_memdup(packet, data->continue_packet_size);
+    g_object_unref(encoder);
+
+    return data;
+}
+
+static void
+teardown_server_context (gpointer user_data)
+{
+    ServerContextData *data = user_data;
+
+    milter_agent_shutdown(MILTER_AGENT(data->context));
+    while (milter_event_loop_iterate(data->loop, FALSE))
+        ;
+    g_object_unref(data->context);
+    g_object_unref(data->loop);
+    g_free(data->continue_packet);
+    g_free(data);
+}
+
+/*
+ * Sends HELO with filtered macros, flushes it to
+ * /dev/null and receives "continue" for it.
+ */
+static void
+run_server_context_helo (gpointer user_data)
+{
+    ServerContextData *data = user_data;
+
+    milter_server_context_helo(data->context, "client.example.net");
+    while (milter_event_loop_iterate(data->loop, FALSE))
+        ;
+    milter_decoder_decode(data->decoder,
+                          data->continue_packet, data->continue_packet_size,
+                          NULL);
+}
+
+
+static Benchmark benchmarks[] = {
+    {"command-encoder/define-macro",
+     setup_command_encoder, run_command_encoder_define_macro, teardown_encoder},
+    {"command-encoder/helo",
+     setup_command_encoder, run_command_encoder_helo, teardown_encoder},
+    {"command-encoder/header",
+     setup_command_encoder, run_command_encoder_header, teardown_encoder},
+    {"command-encoder/body",
+     setup_command_encoder, run_command_encoder_body, teardown_encoder},
+    {"reply-encoder/continue",
+     setup_reply_encoder, run_reply_encoder_continue, teardown_encoder},
+    {"reply-encoder/add-header",
+     setup_reply_encoder, run_reply_encoder_add_header, teardown_encoder},
+    {"reply-encoder/replace-body",
+     setup_reply_encoder, run_reply_encoder_replace_body, teardown_encoder},
+    {"command-decoder/packet",
+     setup_command_decoder, run_decoder, teardown_decoder},
+    {"reply-decoder/packet",
+     setup_reply_decoder, run_decoder, teardown_decoder},
+    {"headers/append-remove",
+     setup_headers, run_headers_append_remove, teardown_headers},
+    {"headers/lookup-by-name",
+     setup_headers, run_headers_lookup_by_name, teardown_headers},
+    {"headers/copy",
+     setup_headers, run_headers_copy, teardown_headers},
+    {"esmtp/parse-mail-from-argument",
+     setup_nothing, run_esmtp_parse_mail_from_argument, teardown_nothing},
+    {"server-context/helo-with-filtered-macros",
+     setup_server_context, run_server_context_helo, teardown_server_context},
+    {NULL}
+};
+
+static void
+measure (Benchmark *benchmark, gpointer data, gint64 n_iterations,
+         BenchmarkResult *result)
+{
+    GTimer *timer;
+    gsize n_allocations_before = 0, n_allocations_after = 0;
+    gsize n_bytes_before = 0, n_bytes_after = 0;
+    gint64 i;
+
+    timer = g_timer_new();
+#ifdef COUNT_ALLOCATIONS
+    n_allocations_before = n_allocations;
+    n_bytes_before = n_allocated_bytes;
+#endif
+    g_timer_start(timer);
+    for (i = 0; i < n_iterations; i++) {
+        benchmark->run(data);
+    }
+    g_timer_stop(timer);
+#ifdef COUNT_ALLOCATIONS
+    n_allocations_after = n_allocations;
+    n_bytes_after = n_allocated_bytes;
+#endif
+
+    result->name = benchmark->name;
+    result->n_iterations = n_iterations;
+    result->elapsed = g_timer_elapsed(timer, NULL);
+    result->n_allocations = n_allocations_after - n_allocations_before;
+    result->n_allocated_bytes = n_bytes_after - n_bytes_before;
+    g_timer_destroy(timer);
+}
+
+static gboolean
+run_benchmark (Benchmark *benchmark, BenchmarkResult *result, GError **error)
+{
+    gpointer data;
+    gint64 n_iterations = 1;
+
+    data = benchmark->setup(error);
+    if (error && *error)
+        return FALSE;
+
+    /* Warm up caches, lazily initialized buffers and so on. */
+    benchmark->run(data);
+
+    while (TRUE) {
+        gint64 next_n_iterations;
+
+        measure(benchmark, data, n_iterations, result);
+        if (result->elapsed >= min_time || n_iterations >= MAX_ITERATIONS)
+            break;
+
+        if (result->elapsed <= 0.0) {
+            next_n_iterations = n_iterations * 100;
+        } else {
+            next_n_iterations = min_time / result->elapsed * n_iterations * 1.2;
+            next_n_iterations = MIN(next_n_iterations, n_iterations * 100);
+        }
+        n_iterations = CLAMP(next_n_iterations,
+                             n_iterations + 1,
+                             MAX_ITERATIONS);
+    }
+
+    benchmark->teardown(data);
+
+    return TRUE;
+}
+
+static void
+append_result_json (GString *json, BenchmarkResult *result)
+{
+    gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf(json, "    {\"name\": \"%s\", ", result->name);
+    g_string_append_printf(json, "\"iterations\": %" G_GINT64_FORMAT ", ",
+                           result->n_iterations);
+    g_string_append_printf(json, "\"ns_per_op\": %s, ",
+                           g_ascii_formatd(buffer, sizeof(buffer), "%.2f",
+                                           result->elapsed * 1e9 /
+                                           result->n_iterations));
+#ifdef COUNT_ALLOCATIONS
+    g_string_append_printf(json, "\"allocs_per_op\": %s, ",
+                           g_ascii_formatd(buffer, sizeof(buffer), "%.2f",
+                                           (gdouble)result->n_allocations /
+                                           result->n_iterations));
+    g_string_append_printf(json, "\"bytes_per_op\": %s}",
+                           g_ascii_formatd(buffer, sizeof(buffer), "%.2f",
+                                           (gdouble)result->n_allocated_bytes /
+                                           result->n_iterations));
+#else
+    g_string_append(json, "\"allocs_per_op\": null, \"bytes_per_op\": null}");
+#endif
+}
+
+static gboolean
+print_version (const gchar *option_name,
+               const gchar *value,
+               gpointer data,
+               GError **error)
+{
+    g_print("%s %s\n", PACKAGE, VERSION);
+    exit(EXIT_SUCCESS);
+    return TRUE;
+}
+
+static const GOptionEntry option_entries[] =
+{
+    {"min-time", 't', 0, G_OPTION_ARG_DOUBLE, &min_time,
+     N_("Run each benchmark at least SECONDS seconds. "
+        "(" G_STRINGIFY(DEFAULT_MIN_TIME) ")"),
+     "SECONDS"},
+    {"filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+     N_("Run only benchmarks whose name matches PATTERN. "
+        "'*' and '?' wildcards are available."),
+     "PATTERN"},
+    {"packet-directory", 0, 0, G_OPTION_ARG_FILENAME, &packet_directory,
+     N_("Read packets for decoder benchmarks from *.log in DIRECTORY"),
+     "DIRECTORY"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+     N_("Write JSON result to PATH instead of standard output"), "PATH"},
+    {"list", 'l', 0, G_OPTION_ARG_NONE, &list,
+     N_("List available benchmarks"), NULL},
+    {"version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, print_version,
+     N_("Show version"), NULL},
+    {NULL}
+};
+
+static void
+free_option_values (void)
+{
+    g_free(filter);
+    g_free(packet_directory);
+    g_free(output_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+    gboolean success = TRUE;
+    GError *error = NULL;
+    GOptionContext *option_context;
+    GPatternSpec *pattern = NULL;
+    GString *json;
+    gboolean first = TRUE;
+    gint i;
+
+#ifdef HAVE_LOCALE_H
+    setlocale(LC_ALL, "");
+#endif
+
+    milter_init();
+    milter_server_init();
+
+    option_context = g_option_context_new(NULL);
+    g_option_context_set_summary(
+        option_context,
+        _("Run microbenchmarks for milter-core primitives."));
+    g_option_context_add_main_entries(option_context, option_entries, NULL);
+    if (!g_option_context_parse(option_context, &argc, &argv, &error)) {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(option_context);
+        free_option_values();
+        exit(EXIT_FAILURE);
+    }
+    g_option_context_free(option_context);
+
+    if (list) {
+        for (i = 0; benchmarks[i].name; i++) {
+            g_print("%s\n", benchmarks[i].name);
+        }
+        free_option_values();
+        exit(EXIT_SUCCESS);
+    }
+
+    if (filter)
+        pattern = g_pattern_spec_new(filter);
+
+    json = g_string_new("{\n");
+    g_string_append(json, "  \"benchmarks\": [\n");
+    for (i = 0; benchmarks[i].name; i++) {
+        Benchmark *benchmark = &(benchmarks[i]);
+        BenchmarkResult result;
+
+        if (pattern && !g_pattern_match_string(pattern, benchmark->name))
+            continue;
+
+        if (!run_benchmark(benchmark, &result, &error)) {
+            g_printerr("%s: %s\n", benchmark->name, error->message);
+            g_clear_error(&error);
+            success = FALSE;
+            continue;
+        }
+
+        if (!first)
+            g_string_append(json, ",\n");
+        first = FALSE;
+        append_result_json(json, &result);
+    }
+    g_string_append(json, "\n  ]\n}\n");
+
+    if (pattern)
+        g_pattern_spec_free(pattern);
+
+    if (output_path) {
+        if (!g_file_set_contents(output_path, json->str, json->len, &error)) {
+            g_print("%s\n", error->message);
+            g_error_free(error);
+            success = FALSE;
+        }
+    } else {
+        g_print("%s", json->str);
+    }
+    g_string_free(json, TRUE);
+
+    free_option_values();
+
+    milter_server_quit();
+    milter_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
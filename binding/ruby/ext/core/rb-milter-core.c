@@ -49,6 +49,10 @@ Init_milter_core (void)
     rb_define_const(rb_mMilter, "VERSION", version);
 
     rb_define_const(rb_mMilter, "CHUNK_SIZE", UINT2NUM(MILTER_CHUNK_SIZE));
+    rb_define_const(rb_mMilter, "MAX_DATA_SIZE_256K",
+                    UINT2NUM(MILTER_MAX_DATA_SIZE_256K));
+    rb_define_const(rb_mMilter, "MAX_DATA_SIZE_1M",
+                    UINT2NUM(MILTER_MAX_DATA_SIZE_1M));
 
     milter_init();
 
@@ -39,6 +39,30 @@ merge (VALUE self, VALUE other)
     return self;
 }
 
+static VALUE
+add_rule (VALUE self, VALUE rule)
+{
+    milter_manager_applicable_condition_add_rule(
+	SELF(self), MILTER_MANAGER_CONDITION_RULE(RVAL2GOBJ(rule)));
+    return self;
+}
+
+static VALUE
+get_rules (VALUE self)
+{
+    const GList *rules;
+
+    rules = milter_manager_applicable_condition_get_rules(SELF(self));
+    return GLIST2ARY((GList *)rules);
+}
+
+static VALUE
+clear_rules (VALUE self)
+{
+    milter_manager_applicable_condition_clear_rules(SELF(self));
+    return self;
+}
+
 void
 Init_milter_manager_applicable_condition (void)
 {
@@ -52,6 +76,12 @@ Init_milter_manager_applicable_condition (void)
                      "initialize", initialize, 1);
     rb_define_method(rb_cMilterManagerApplicableCondition,
                      "merge", merge, 1);
+    rb_define_method(rb_cMilterManagerApplicableCondition,
+                     "add_rule", add_rule, 1);
+    rb_define_method(rb_cMilterManagerApplicableCondition,
+                     "rules", get_rules, 0);
+    rb_define_method(rb_cMilterManagerApplicableCondition,
+                     "clear_rules", clear_rules, 0);
 
     G_DEF_SETTERS(rb_cMilterManagerApplicableCondition);
 }
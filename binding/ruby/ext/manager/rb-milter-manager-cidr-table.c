@@ -0,0 +1,73 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "rb-milter-manager-private.h"
+
+#define SELF(self) (MILTER_MANAGER_CIDR_TABLE(RVAL2GOBJ(self)))
+
+static VALUE
+initialize (VALUE self)
+{
+    G_INITIALIZE(self, milter_manager_cidr_table_new());
+    return Qnil;
+}
+
+static VALUE
+add (VALUE self, VALUE network, VALUE action)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_cidr_table_add(SELF(self),
+				       RVAL2CSTR(network),
+				       RVAL2CSTR(action),
+				       &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+get_n_entries (VALUE self)
+{
+    return UINT2NUM(milter_manager_cidr_table_get_n_entries(SELF(self)));
+}
+
+static VALUE
+lookup (VALUE self, VALUE address)
+{
+    return CSTR2RVAL(milter_manager_cidr_table_lookup(SELF(self),
+						      RVAL2CSTR(address)));
+}
+
+void
+Init_milter_manager_cidr_table (void)
+{
+    VALUE rb_cMilterManagerCIDRTable;
+
+    rb_cMilterManagerCIDRTable =
+	G_DEF_CLASS(MILTER_TYPE_MANAGER_CIDR_TABLE,
+		    "CIDRTable", rb_mMilterManager);
+
+    rb_define_method(rb_cMilterManagerCIDRTable,
+		     "initialize", initialize, 0);
+    rb_define_method(rb_cMilterManagerCIDRTable, "add", add, 2);
+    rb_define_method(rb_cMilterManagerCIDRTable,
+		     "n_entries", get_n_entries, 0);
+    rb_define_method(rb_cMilterManagerCIDRTable, "lookup", lookup, 1);
+}
@@ -0,0 +1,99 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "rb-milter-manager-private.h"
+
+#define SELF(self) (MILTER_MANAGER_CONDITION_RULE(RVAL2GOBJ(self)))
+
+static VALUE
+initialize (VALUE self, VALUE stage, VALUE action)
+{
+    G_INITIALIZE(self,
+		 milter_manager_condition_rule_new(
+		     RVAL2GENUM(stage, MILTER_TYPE_MANAGER_CONDITION_STAGE),
+		     RVAL2GENUM(action, MILTER_TYPE_MANAGER_CONDITION_ACTION)));
+    return Qnil;
+}
+
+static VALUE
+add_address (VALUE self, VALUE network)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_condition_rule_add_address(SELF(self),
+						   RVAL2CSTR(network),
+						   &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+add_domain (VALUE self, VALUE domain)
+{
+    milter_manager_condition_rule_add_domain(SELF(self), RVAL2CSTR(domain));
+    return self;
+}
+
+static VALUE
+add_regex (VALUE self, VALUE pattern)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_condition_rule_add_regex(SELF(self),
+						 RVAL2CSTR(pattern),
+						 &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+add_macro (VALUE self, VALUE name, VALUE value)
+{
+    milter_manager_condition_rule_add_macro(SELF(self),
+					    RVAL2CSTR(name),
+					    RVAL2CSTR(value));
+    return self;
+}
+
+void
+Init_milter_manager_condition_rule (void)
+{
+    VALUE rb_cMilterManagerConditionRule;
+
+    rb_cMilterManagerConditionRule =
+	G_DEF_CLASS(MILTER_TYPE_MANAGER_CONDITION_RULE,
+		    "ConditionRule", rb_mMilterManager);
+    G_DEF_CLASS(MILTER_TYPE_MANAGER_CONDITION_STAGE, "ConditionStage",
+		rb_mMilterManager);
+    G_DEF_CLASS(MILTER_TYPE_MANAGER_CONDITION_ACTION, "ConditionAction",
+		rb_mMilterManager);
+
+    rb_define_method(rb_cMilterManagerConditionRule,
+		     "initialize", initialize, 2);
+    rb_define_method(rb_cMilterManagerConditionRule,
+		     "add_address", add_address, 1);
+    rb_define_method(rb_cMilterManagerConditionRule,
+		     "add_domain", add_domain, 1);
+    rb_define_method(rb_cMilterManagerConditionRule,
+		     "add_regex", add_regex, 1);
+    rb_define_method(rb_cMilterManagerConditionRule,
+		     "add_macro", add_macro, 2);
+}
@@ -0,0 +1,94 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/socket.h>
+
+#include "rb-milter-manager-private.h"
+
+#define SELF(self) (MILTER_MANAGER_CONNECTION_TABLE(RVAL2GOBJ(self)))
+
+static VALUE
+initialize (VALUE self)
+{
+    G_INITIALIZE(self, milter_manager_connection_table_new());
+    return Qnil;
+}
+
+static VALUE
+update (VALUE self)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_connection_table_update(SELF(self), &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+lookup (VALUE self, VALUE foreign_address, VALUE foreign_port)
+{
+    const MilterManagerConnectionInfo *info;
+
+    info = milter_manager_connection_table_lookup(SELF(self),
+						  RVAL2CSTR(foreign_address),
+						  NUM2UINT(foreign_port));
+    if (!info)
+	return Qnil;
+
+    return rb_ary_new3(6,
+		       CSTR2RVAL(info->family == AF_INET6 ? "tcp6" : "tcp4"),
+		       CSTR2RVAL(info->local_address),
+		       UINT2NUM(info->local_port),
+		       CSTR2RVAL(info->foreign_address),
+		       UINT2NUM(info->foreign_port),
+		       CSTR2RVAL(info->state));
+}
+
+static VALUE
+size (VALUE self)
+{
+    return UINT2NUM(milter_manager_connection_table_size(SELF(self)));
+}
+
+static VALUE
+clear (VALUE self)
+{
+    milter_manager_connection_table_clear(SELF(self));
+    return self;
+}
+
+void
+Init_milter_manager_connection_table (void)
+{
+    VALUE rb_cMilterManagerConnectionTable;
+
+    rb_cMilterManagerConnectionTable =
+	G_DEF_CLASS(MILTER_TYPE_MANAGER_CONNECTION_TABLE, "ConnectionTable",
+		    rb_mMilterManager);
+    G_DEF_ERROR2(MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+		 "ConnectionTableError", rb_mMilterManager, rb_eMilterError);
+
+    rb_define_method(rb_cMilterManagerConnectionTable,
+		     "initialize", initialize, 0);
+    rb_define_method(rb_cMilterManagerConnectionTable, "update", update, 0);
+    rb_define_method(rb_cMilterManagerConnectionTable, "lookup", lookup, 2);
+    rb_define_method(rb_cMilterManagerConnectionTable, "size", size, 0);
+    rb_define_method(rb_cMilterManagerConnectionTable, "clear", clear, 0);
+}
@@ -41,6 +41,35 @@ set_connection_spec (VALUE self, VALUE spec)
     return self;
 }
 
+static VALUE
+add_replica_connection_spec (VALUE self, VALUE spec)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_egg_add_replica_connection_spec(SELF(self),
+							RVAL2CSTR(spec),
+							&error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+get_replica_connection_specs (VALUE self)
+{
+    const GList *specs;
+
+    specs = milter_manager_egg_get_replica_connection_specs(SELF(self));
+    return GLIST2ARY_STR((GList *)specs);
+}
+
+static VALUE
+clear_replica_connection_specs (VALUE self)
+{
+    milter_manager_egg_clear_replica_connection_specs(SELF(self));
+    return self;
+}
+
 static VALUE
 merge (VALUE self, VALUE other)
 {
@@ -104,6 +133,10 @@ Init_milter_manager_egg (void)
 
     rb_cMilterManagerEgg =
 	G_DEF_CLASS(MILTER_TYPE_MANAGER_EGG, "Egg", rb_mMilterManager);
+    G_DEF_CLASS(MILTER_TYPE_MANAGER_REPLICA_POLICY, "ReplicaPolicy",
+		rb_mMilterManager);
+    G_DEF_CLASS(MILTER_TYPE_MANAGER_EGG_PRIORITY, "EggPriority",
+		rb_mMilterManager);
 
     G_DEF_SIGNAL_FUNC(rb_cMilterManagerEgg,
                       "to-xml", rb_milter_manager_gstring_handle_to_xml_signal);
@@ -120,6 +153,12 @@ Init_milter_manager_egg (void)
 
     rb_define_method(rb_cMilterManagerEgg, "set_connection_spec",
 		     set_connection_spec, 1);
+    rb_define_method(rb_cMilterManagerEgg, "add_replica_connection_spec",
+		     add_replica_connection_spec, 1);
+    rb_define_method(rb_cMilterManagerEgg, "replica_connection_specs",
+		     get_replica_connection_specs, 0);
+    rb_define_method(rb_cMilterManagerEgg, "clear_replica_connection_specs",
+		     clear_replica_connection_specs, 0);
     rb_define_method(rb_cMilterManagerEgg, "merge", merge, 1);
     rb_define_method(rb_cMilterManagerEgg, "to_xml", to_xml, -1);
 
@@ -27,11 +27,15 @@ extern void Init_milter_manager_gstring (void);
 extern void Init_milter_manager_configuration (void);
 extern void Init_milter_manager_child (void);
 extern void Init_milter_manager_applicable_condition (void);
+extern void Init_milter_manager_condition_rule (void);
+extern void Init_milter_manager_regexp_table (void);
+extern void Init_milter_manager_cidr_table (void);
 extern void Init_milter_manager_egg (void);
 extern void Init_milter_manager_children (void);
 extern void Init_milter_manager_control_command_encoder (void);
 extern void Init_milter_manager_control_reply_encoder (void);
 extern void Init_milter_manager_control_decoder (void);
+extern void Init_milter_manager_connection_table (void);
 
 extern VALUE rb_milter_manager_gstring_handle_to_xml_signal (guint num, const GValue *values);
 
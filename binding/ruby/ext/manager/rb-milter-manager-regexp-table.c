@@ -0,0 +1,113 @@
+/* -*- c-file-style: "ruby" -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "rb-milter-manager-private.h"
+
+#define SELF(self) (MILTER_MANAGER_REGEXP_TABLE(RVAL2GOBJ(self)))
+
+static VALUE
+initialize (VALUE self)
+{
+    G_INITIALIZE(self, milter_manager_regexp_table_new());
+    return Qnil;
+}
+
+static VALUE
+push_condition (VALUE self, VALUE pattern, VALUE negative)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_regexp_table_push_condition(SELF(self),
+						    RVAL2CSTR(pattern),
+						    RVAL2CBOOL(negative),
+						    &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+pop_condition (VALUE self)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_regexp_table_pop_condition(SELF(self), &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+add (VALUE self, VALUE pattern, VALUE negative, VALUE action)
+{
+    GError *error = NULL;
+
+    if (!milter_manager_regexp_table_add(SELF(self),
+					 RVAL2CSTR(pattern),
+					 RVAL2CBOOL(negative),
+					 RVAL2CSTR(action),
+					 &error))
+	RAISE_GERROR(error);
+
+    return self;
+}
+
+static VALUE
+get_n_entries (VALUE self)
+{
+    return UINT2NUM(milter_manager_regexp_table_get_n_entries(SELF(self)));
+}
+
+static VALUE
+compile (VALUE self)
+{
+    milter_manager_regexp_table_compile(SELF(self));
+    return self;
+}
+
+static VALUE
+lookup (VALUE self, VALUE text)
+{
+    gchar *action;
+
+    action = milter_manager_regexp_table_lookup(SELF(self), RVAL2CSTR(text));
+    return CSTR2RVAL_FREE(action);
+}
+
+void
+Init_milter_manager_regexp_table (void)
+{
+    VALUE rb_cMilterManagerRegexpTable;
+
+    rb_cMilterManagerRegexpTable =
+	G_DEF_CLASS(MILTER_TYPE_MANAGER_REGEXP_TABLE,
+		    "RegexpTable", rb_mMilterManager);
+
+    rb_define_method(rb_cMilterManagerRegexpTable,
+		     "initialize", initialize, 0);
+    rb_define_method(rb_cMilterManagerRegexpTable,
+		     "push_condition", push_condition, 2);
+    rb_define_method(rb_cMilterManagerRegexpTable,
+		     "pop_condition", pop_condition, 0);
+    rb_define_method(rb_cMilterManagerRegexpTable, "add", add, 3);
+    rb_define_method(rb_cMilterManagerRegexpTable,
+		     "n_entries", get_n_entries, 0);
+    rb_define_method(rb_cMilterManagerRegexpTable, "compile", compile, 0);
+    rb_define_method(rb_cMilterManagerRegexpTable, "lookup", lookup, 1);
+}
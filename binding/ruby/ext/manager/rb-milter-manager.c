@@ -29,9 +29,13 @@ Init_milter_manager (void)
     Init_milter_manager_configuration();
     Init_milter_manager_child();
     Init_milter_manager_applicable_condition();
+    Init_milter_manager_condition_rule();
+    Init_milter_manager_regexp_table();
+    Init_milter_manager_cidr_table();
     Init_milter_manager_egg();
     Init_milter_manager_children();
     Init_milter_manager_control_command_encoder();
     Init_milter_manager_control_reply_encoder();
     Init_milter_manager_control_decoder();
+    Init_milter_manager_connection_table();
 }
@@ -192,6 +192,9 @@ module Milter
         dump_item("manager.suspend_time_on_unacceptable",
                   c.suspend_time_on_unacceptable.inspect)
         dump_item("manager.max_connections", c.max_connections.inspect)
+        dump_item("manager.adaptive_max_connections",
+                  c.adaptive_max_connections?)
+        dump_item("manager.load_shedding", c.load_shedding?)
         dump_item("manager.max_file_descriptors", c.max_file_descriptors.inspect)
         dump_item("manager.custom_configuration_directory",
                   c.custom_configuration_directory.inspect)
@@ -201,6 +204,10 @@ module Milter
         dump_item("manager.event_loop_backend",
                   c.event_loop_backend.nick.dump)
         dump_item("manager.n_workers", c.n_workers)
+        dump_item("manager.reuse_port", c.reuse_port?)
+        dump_item("manager.pin_workers", c.pin_workers?)
+        dump_item("manager.n_io_threads", c.n_io_threads)
+        dump_item("manager.mirror_buffer_size", c.mirror_buffer_size)
         dump_item("manager.packet_buffer_size", c.default_packet_buffer_size)
         dump_item("manager.connection_check_interval",
                   c.connection_check_interval.inspect)
@@ -568,6 +575,18 @@ module Milter
                 if @egg_config.has_key?("evaluation_mode")
                   milter.evaluation_mode = @egg_config["evaluation_mode"]
                 end
+                if @egg_config.has_key?("circuit_breaker_threshold")
+                  threshold = Integer(@egg_config["circuit_breaker_threshold"])
+                  milter.circuit_breaker_threshold = threshold
+                end
+                if @egg_config.has_key?("max_concurrent_sessions")
+                  max_sessions = Integer(@egg_config["max_concurrent_sessions"])
+                  milter.max_concurrent_sessions = max_sessions
+                end
+                if @egg_config.has_key?("verdict_cache_size")
+                  size = Integer(@egg_config["verdict_cache_size"])
+                  milter.verdict_cache_size = size
+                end
               end
               @egg_config = nil
             when "milter_applicable_condition"
@@ -631,7 +650,10 @@ module Milter
               available_locals = ["name", "description",
                                   "enabled", "connection_spec",
                                   "command", "command_options",
-                                  "fallback_status", "evaluation_mode"]
+                                  "fallback_status", "evaluation_mode",
+                                  "circuit_breaker_threshold",
+                                  "max_concurrent_sessions",
+                                  "verdict_cache_size"]
               case local
               when "applicable_conditions"
                 @egg_config["applicable_conditions"] = []
@@ -984,7 +1006,7 @@ module Milter
 
         def chunk_size=(size)
           update_location("chunk_size", size.nil?)
-          size ||= Milter::CHUNK_SIZE
+          size ||= Milter::MAX_DATA_SIZE_1M
           @raw_configuration.chunk_size = size
         end
 
@@ -998,6 +1020,70 @@ module Milter
           @raw_configuration.connection_check_interval = interval
         end
 
+        def session_deadline
+          @raw_configuration.session_deadline
+        end
+
+        def session_deadline=(deadline)
+          update_location("session_deadline", deadline.nil?)
+          deadline ||= 0
+          @raw_configuration.session_deadline = deadline
+        end
+
+        def adaptive_max_connections?
+          @raw_configuration.adaptive_max_connections?
+        end
+
+        def adaptive_max_connections=(boolean)
+          update_location("adaptive_max_connections", boolean.nil?)
+          @raw_configuration.adaptive_max_connections = !!boolean
+        end
+
+        def load_shedding?
+          @raw_configuration.load_shedding?
+        end
+
+        def load_shedding=(boolean)
+          update_location("load_shedding", boolean.nil?)
+          @raw_configuration.load_shedding = !!boolean
+        end
+
+        def reuse_port?
+          @raw_configuration.reuse_port?
+        end
+
+        def reuse_port=(boolean)
+          update_location("reuse_port", boolean.nil?)
+          @raw_configuration.reuse_port = !!boolean
+        end
+
+        def pin_workers?
+          @raw_configuration.pin_workers?
+        end
+
+        def pin_workers=(boolean)
+          update_location("pin_workers", boolean.nil?)
+          @raw_configuration.pin_workers = !!boolean
+        end
+
+        def n_io_threads
+          @raw_configuration.n_io_threads
+        end
+
+        def n_io_threads=(n_io_threads)
+          update_location("n_io_threads", n_io_threads.nil?)
+          @raw_configuration.n_io_threads = n_io_threads || 0
+        end
+
+        def mirror_buffer_size
+          @raw_configuration.mirror_buffer_size
+        end
+
+        def mirror_buffer_size=(size)
+          update_location("mirror_buffer_size", size.nil?)
+          @raw_configuration.mirror_buffer_size = size || 0
+        end
+
         def netstat_connection_checker
           @raw_configuration.netstat_connection_checker
         end
@@ -1177,6 +1263,69 @@ module Milter
           @egg.fallback_status = value
         end
 
+        def connection_specs
+          @egg.replica_connection_specs
+        end
+
+        def connection_specs=(specs)
+          specs = [specs] if specs.is_a?(String)
+          specs ||= []
+          update_location("connection_specs", specs.empty?)
+          @egg.clear_replica_connection_specs
+          specs.each do |spec|
+            @egg.add_replica_connection_spec(spec)
+          end
+        end
+
+        def replica_policy
+          @egg.replica_policy.nick
+        end
+
+        def replica_policy=(policy)
+          available_values = {
+            "round-robin" => ReplicaPolicy::ROUND_ROBIN,
+            "least-outstanding" => ReplicaPolicy::LEAST_OUTSTANDING,
+            "latency" => ReplicaPolicy::LATENCY,
+          }
+          if policy.respond_to?(:nick)
+            normalized_policy = policy.nick
+          else
+            normalized_policy = policy.to_s.downcase.gsub(/_/, '-')
+          end
+          value = available_values[normalized_policy]
+          if value.nil?
+            raise InvalidValue.new("milter.replica_policy",
+                                   available_values.keys,
+                                   policy)
+          end
+          update_location("replica_policy", false)
+          @egg.replica_policy = value
+        end
+
+        def priority
+          @egg.priority.nick
+        end
+
+        def priority=(priority)
+          available_values = {
+            "essential" => EggPriority::ESSENTIAL,
+            "optional" => EggPriority::OPTIONAL,
+          }
+          if priority.respond_to?(:nick)
+            normalized_priority = priority.nick
+          else
+            normalized_priority = priority.to_s.downcase
+          end
+          value = available_values[normalized_priority]
+          if value.nil?
+            raise InvalidValue.new("milter.priority",
+                                   available_values.keys,
+                                   priority)
+          end
+          update_location("priority", false)
+          @egg.priority = value
+        end
+
         def method_missing(name, *args, &block)
           result = @egg.send(name, *args, &block)
           if /=\z/ =~ name.to_s
@@ -1251,6 +1400,14 @@ module Milter
           @end_of_message_stoppers << block
         end
 
+        def define_rule(stage, action)
+          rule = ConditionRule.new(resolve_rule_stage(stage),
+                                   resolve_rule_action(action))
+          yield(ConditionRuleConfigurationLoader.new(rule)) if block_given?
+          @condition.add_rule(rule)
+          rule
+        end
+
         def have_stopper?
           [@connect_stoppers,
            @helo_stoppers,
@@ -1386,11 +1543,80 @@ module Milter
           end
         end
 
+        def resolve_rule_stage(stage)
+          available_values = {
+            "connect" => ConditionStage::CONNECT,
+            "helo" => ConditionStage::HELO,
+            "envelope-from" => ConditionStage::ENVELOPE_FROM,
+            "envelope-recipient" => ConditionStage::ENVELOPE_RECIPIENT,
+          }
+          value = available_values[stage.to_s.downcase.gsub(/_/, '-')]
+          if value.nil?
+            raise InvalidValue.new("condition.define_rule(stage)",
+                                   available_values.keys,
+                                   stage)
+          end
+          value
+        end
+
+        def resolve_rule_action(action)
+          available_values = {
+            "apply" => ConditionAction::APPLY,
+            "stop" => ConditionAction::STOP,
+          }
+          value = available_values[action.to_s.downcase]
+          if value.nil?
+            raise InvalidValue.new("condition.define_rule(action)",
+                                   available_values.keys,
+                                   action)
+          end
+          value
+        end
+
         def update_location(name, reset, deep_level=2)
           full_key = "applicable_condition[#{@condition.name}].#{name}"
           @loader.configuration.update_location(full_key, reset, deep_level)
         end
       end
+
+      class ConditionRuleConfigurationLoader
+        def initialize(rule)
+          @rule = rule
+        end
+
+        def add_address(*networks)
+          networks.flatten.each do |network|
+            @rule.add_address(network.to_s)
+          end
+        end
+
+        def add_domain(*domains)
+          domains.flatten.each do |domain|
+            @rule.add_domain(domain.to_s)
+          end
+        end
+
+        def add_regex(*patterns)
+          patterns.flatten.each do |pattern|
+            @rule.add_regex(regex_pattern(pattern))
+          end
+        end
+
+        def add_macro(name, value)
+          @rule.add_macro(name.to_s, value.to_s)
+        end
+
+        private
+        def regex_pattern(pattern)
+          return pattern unless pattern.is_a?(Regexp)
+          # "^" and "$" match at each line in Ruby.
+          options = "m"
+          options << "i" if (pattern.options & Regexp::IGNORECASE) != 0
+          options << "x" if (pattern.options & Regexp::EXTENDED) != 0
+          options << "s" if (pattern.options & Regexp::MULTILINE) != 0
+          "(?#{options})#{pattern.source}"
+        end
+      end
     end
   end
 end
@@ -32,7 +32,10 @@ module Milter::Manager
       @options = (options || {}).dup
       @database = nil
       @last_update = nil
-      detect_netstat_command
+      @connection_table = nil
+      @netstat_command = nil
+      detect_connection_table
+      detect_netstat_command if @connection_table.nil?
     end
 
     def connected?(context)
@@ -80,7 +83,7 @@ module Milter::Manager
     end
 
     def connection_info(address, options={})
-      return nil if @netstat_command.nil?
+      return nil if @connection_table.nil? and @netstat_command.nil?
       type = nil
       case address
       when Milter::SocketAddress::IPv4
@@ -99,6 +102,10 @@ module Milter::Manager
         return nil
       end
 
+      if @connection_table
+        return lookup_connection_table(address, options)
+      end
+
       tcp_address = "#{address.address}:#{address.port}"
       update_database
       info = @database[type][tcp_address]
@@ -110,15 +117,46 @@ module Milter::Manager
       info
     end
 
+    def lookup_connection_table(address, options)
+      update_connection_table
+      found = @connection_table.lookup(address.address, address.port)
+      if found.nil? and options[:retry]
+        purge_cache
+        update_connection_table
+        found = @connection_table.lookup(address.address, address.port)
+      end
+      return nil if found.nil?
+      protocol, local_ip_address, local_port,
+        foreign_ip_address, foreign_port, state = found
+      ConnectionInfo.new(protocol,
+                         local_ip_address, local_port.to_s,
+                         foreign_ip_address, foreign_port.to_s,
+                         state)
+    end
+
     def purge_cache
       @database = nil
       @last_update = nil
     end
 
+    def update_connection_table
+      return unless need_database_update?
+      begin
+        @connection_table.update
+      rescue Milter::Manager::ConnectionTableError
+        Milter::Logger.error("[connection-table][error] " +
+                             "failed to update: #{$!.message}")
+        @connection_table.clear
+      end
+      @database = @connection_table
+      @last_update = Time.now
+    end
+
     def update_database
       return unless need_database_update?
       @database = {:tcp4 => {}, :tcp6 => {}}
       parse_netstat_result(netstat)
+      @last_update = Time.now
     end
 
     def need_database_update?
@@ -159,6 +197,21 @@ module Milter::Manager
       [ip_address, port]
     end
 
+    def detect_connection_table
+      return unless Milter::Manager.const_defined?(:ConnectionTable)
+      table = Milter::Manager::ConnectionTable.new
+      begin
+        table.update
+      rescue Milter::Manager::ConnectionTableError
+        Milter::Logger.info("[connection-table][not-available] " +
+                            "#{$!.message}")
+        return
+      end
+      table.clear
+      @connection_table = table
+      Milter::Logger.info("[connection-table][detect]")
+    end
+
     def detect_netstat_command
       @netstat_command = nil
       commands = ["env LANG=C netstat -n -W 2>&1",
@@ -24,6 +24,7 @@ module Milter::Manager
 
     def initialize
       @table = []
+      @compiled_table = CIDRTable.new
     end
 
     def parse(io)
@@ -42,6 +43,7 @@ module Milter::Manager
                                         io.path, line_no)
           end
           @table << [ip_address, action]
+          compile(address, action)
         else
           raise InvalidFormatError.new(line, io.path, line_no)
         end
@@ -50,10 +52,25 @@ module Milter::Manager
 
     def find(address)
       address = address.to_ip_address if address.respond_to?(:to_ip_address)
+      if @compiled_table
+        return nil if address.nil?
+        return @compiled_table.lookup(address.to_s)
+      end
       @table.each do |match_address, action|
         return action if match_address === address
       end
       nil
     end
+
+    private
+    def compile(address, action)
+      return if @compiled_table.nil?
+      begin
+        @compiled_table.add(address, action)
+      rescue GLib::Error
+        # IPAddr accepts some addresses that inet_pton() doesn't accept.
+        @compiled_table = nil
+      end
+    end
   end
 end
@@ -24,6 +24,7 @@ module Milter::Manager
 
     def initialize
       @table = []
+      @compiled_table = RegexpTable.new
     end
 
     def parse(io)
@@ -38,8 +39,9 @@ module Milter::Manager
           regexp = create_regexp(pattern, flag, io, line, line_no)
           new_table = []
           current_table << [not_flag == "!", regexp, new_table]
+          tables << current_table
           current_table = new_table
-          tables << new_table
+          compile(:push_condition, regexp, not_flag == "!")
         when /\A\s*(!)?\/(.*)\/([imx]+)?\s+(.+)\s*$/
           not_flag = $1
           pattern = $2
@@ -47,22 +49,65 @@ module Milter::Manager
           action = $4
           regexp = create_regexp(pattern, flag, io, line, line_no)
           current_table << [not_flag == "!", regexp, action]
+          compile(:add, regexp, not_flag == "!", action)
         when /\Aendif\s*$/
+          if tables.empty?
+            raise InvalidFormatError.new(line, io.path, line_no)
+          end
           current_table = tables.pop
+          @compiled_table.pop_condition if @compiled_table
         else
           raise InvalidFormatError.new(line, io.path, io.lineno)
         end
       end
       unless tables.empty?
-        raise InvalidFormatError("endif isn't matched", io.path, io.lineno)
+        raise InvalidFormatError.new("endif isn't matched", io.path, io.lineno)
+      end
+      @compiled_table.compile if @compiled_table
+    ensure
+      if @compiled_table
+        tables.size.times do
+          @compiled_table.pop_condition
+        end
       end
     end
 
     def find(text)
-      find_action(@table, text)
-     end
+      if @compiled_table
+        @compiled_table.lookup(text.to_s)
+      else
+        find_action(@table, text)
+      end
+    end
 
     private
+    def compile(method_name, regexp, *arguments)
+      return if @compiled_table.nil?
+      pattern = compiled_pattern(regexp)
+      if pattern.nil?
+        @compiled_table = nil
+        return
+      end
+      begin
+        @compiled_table.send(method_name, pattern, *arguments)
+      rescue GLib::Error
+        # Ruby accepts some patterns that PCRE doesn't accept.
+        @compiled_table = nil
+      end
+    end
+
+    def compiled_pattern(regexp)
+      source = regexp.source
+      # \h is a hex digit in Ruby but a horizontal space in PCRE.
+      return nil if /\\[hH]/ =~ source
+      # "^" and "$" match at each line in Ruby.
+      options = "m"
+      options << "i" if (regexp.options & Regexp::IGNORECASE) != 0
+      options << "x" if (regexp.options & Regexp::EXTENDED) != 0
+      options << "s" if (regexp.options & Regexp::MULTILINE) != 0
+      "(?#{options})#{source}"
+    end
+
     def create_regexp(pattern, flag, io, line, line_no)
       regexp_flag = Regexp::IGNORECASE
       if flag
@@ -233,16 +233,16 @@ class TestConfigurationLoader < Test::Unit::TestCase
   end
 
   def test_manager_chunk_size
-    assert_equal(65535, @configuration.chunk_size)
+    assert_equal(1048575, @configuration.chunk_size)
     @loader.manager.chunk_size = 4096
     assert_equal(4096, @configuration.chunk_size)
     @loader.manager.chunk_size = nil
-    assert_equal(65535, @configuration.chunk_size)
+    assert_equal(1048575, @configuration.chunk_size)
   end
 
   def test_manager_chunk_size_over
-    @loader.manager.chunk_size = 65536
-    assert_equal(65535, @configuration.chunk_size)
+    @loader.manager.chunk_size = 1048576
+    assert_equal(1048575, @configuration.chunk_size)
   end
 
   def test_manager_max_pending_finished_sessions
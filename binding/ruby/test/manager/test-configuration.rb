@@ -284,6 +284,10 @@ manager.suspend_time_on_unacceptable = 5
 # default
 manager.max_connections = 0
 # default
+manager.adaptive_max_connections = false
+# default
+manager.load_shedding = false
+# default
 manager.max_file_descriptors = 0
 # default
 manager.custom_configuration_directory = nil
@@ -296,11 +300,19 @@ manager.event_loop_backend = "glib"
 # default
 manager.n_workers = 0
 # default
+manager.reuse_port = false
+# default
+manager.pin_workers = false
+# default
+manager.n_io_threads = 0
+# default
+manager.mirror_buffer_size = 0
+# default
 manager.packet_buffer_size = 0
 # default
 manager.connection_check_interval = 0
 # default
-manager.chunk_size = 65535
+manager.chunk_size = 1048575
 # default
 manager.max_pending_finished_sessions = 0
 
@@ -429,6 +441,10 @@ manager.suspend_time_on_unacceptable = 5
 # default
 manager.max_connections = 0
 # default
+manager.adaptive_max_connections = false
+# default
+manager.load_shedding = false
+# default
 manager.max_file_descriptors = 0
 # #{__FILE__}:#{manager_custom_configuration_directory}
 manager.custom_configuration_directory = "/tmp/milter-manager/"
@@ -441,11 +457,19 @@ manager.event_loop_backend = "glib"
 # default
 manager.n_workers = 0
 # default
+manager.reuse_port = false
+# default
+manager.pin_workers = false
+# default
+manager.n_io_threads = 0
+# default
+manager.mirror_buffer_size = 0
+# default
 manager.packet_buffer_size = 0
 # default
 manager.connection_check_interval = 0
 # default
-manager.chunk_size = 65535
+manager.chunk_size = 1048575
 # default
 manager.max_pending_finished_sessions = 0
 
@@ -70,6 +70,35 @@ EOC
     assert_nil(@table.find("owner-outgoing@example.com"))
   end
 
+  def test_after_endif
+    @table.parse(create_input(<<-EOC))
+if /^owner/
+/@example\\.com$/   OK
+endif
+/@example\\.com$/   REJECT
+EOC
+    assert_equal("OK", @table.find("owner@example.com"))
+    assert_equal("REJECT", @table.find("user@example.com"))
+  end
+
+  def test_first_match
+    @table.parse(create_input(<<-EOC))
+/example\\.com$/    REJECT
+/^user@/           OK
+EOC
+    assert_equal("REJECT", @table.find("user@example.com"))
+    assert_equal("OK", @table.find("user@example.net"))
+  end
+
+  def test_unmatched_endif
+    error = invalid_format_error("endif", nil, 1)
+    assert_raise(error) do
+      @table.parse(create_input(<<-EOC))
+endif
+EOC
+    end
+  end
+
   def test_invalid_pattern
     message = nil
     begin
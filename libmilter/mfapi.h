@@ -1479,6 +1479,26 @@ int smfi_version    (unsigned int    *major,
  **/
 #define SMFIP_HDR_LEADSPC     0x00100000L
 
+/**
+ * SMFIP_MDS_256K:
+ *
+ * Indicates that the milter accepts data such as a body
+ * chunk up to 256KB.
+ *
+ * This flag can be got/set to @steps_output of xxfi_negotiate().
+ **/
+#define SMFIP_MDS_256K        0x10000000L
+
+/**
+ * SMFIP_MDS_1M:
+ *
+ * Indicates that the milter accepts data such as a body
+ * chunk up to 1MB.
+ *
+ * This flag can be got/set to @steps_output of xxfi_negotiate().
+ **/
+#define SMFIP_MDS_1M          0x20000000L
+
 /**
  * smfi_getsymval:
  * @context: the context for the current milter session.
@@ -22,6 +22,7 @@
 
 #include <milter/client/milter-client.h>
 #include <milter/client/milter-client-context.h>
+#include <milter/client/milter-client-concurrency-limiter.h>
 #include <milter/client/milter-client-enum-types.h>
 
 G_BEGIN_DECLS
@@ -0,0 +1,252 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <milter/core/milter-logger.h>
+#include <milter/core/milter-utils.h>
+#include "milter-client-concurrency-limiter.h"
+
+#define DECREASE_RATIO 0.9
+#define DECREASE_INTERVAL 1.0
+#define MIN_LIMIT 1.0
+
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(obj)              \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER, \
+                                 MilterClientConcurrencyLimiterPrivate))
+
+typedef struct _MilterClientConcurrencyLimiterPrivate MilterClientConcurrencyLimiterPrivate;
+struct _MilterClientConcurrencyLimiterPrivate
+{
+    GMutex *mutex;
+    gdouble limit;
+    guint max_limit;
+    MilterUtilsLatencyTrend latency_trend;
+    gdouble lag;
+    GTimer *decrease_timer;
+};
+
+G_DEFINE_TYPE(MilterClientConcurrencyLimiter,
+              milter_client_concurrency_limiter,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_client_concurrency_limiter_class_init (MilterClientConcurrencyLimiterClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterClientConcurrencyLimiterPrivate));
+}
+
+static void
+milter_client_concurrency_limiter_init (MilterClientConcurrencyLimiter *limiter)
+{
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter);
+    priv->mutex = g_mutex_new();
+    priv->limit = MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_INITIAL_LIMIT;
+    priv->max_limit = 0;
+    milter_utils_latency_trend_init(&(priv->latency_trend));
+    priv->lag = 0.0;
+    priv->decrease_timer = NULL;
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(object);
+
+    if (priv->mutex) {
+        g_mutex_free(priv->mutex);
+        priv->mutex = NULL;
+    }
+
+    if (priv->decrease_timer) {
+        g_timer_destroy(priv->decrease_timer);
+        priv->decrease_timer = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_client_concurrency_limiter_parent_class)->dispose(object);
+}
+
+MilterClientConcurrencyLimiter *
+milter_client_concurrency_limiter_new (guint max_limit)
+{
+    MilterClientConcurrencyLimiter *limiter;
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    limiter = g_object_new(MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER, NULL);
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter);
+    priv->max_limit = max_limit;
+    if (max_limit > 0)
+        priv->limit = max_limit;
+
+    return limiter;
+}
+
+guint
+milter_client_concurrency_limiter_get_limit (MilterClientConcurrencyLimiter *limiter)
+{
+    return (guint)MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter)->limit;
+}
+
+void
+milter_client_concurrency_limiter_set_max_limit (MilterClientConcurrencyLimiter *limiter,
+                                                 guint max_limit)
+{
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    priv->max_limit = max_limit;
+    if (max_limit > 0 && priv->limit > max_limit)
+        priv->limit = max_limit;
+    g_mutex_unlock(priv->mutex);
+}
+
+guint
+milter_client_concurrency_limiter_get_max_limit (MilterClientConcurrencyLimiter *limiter)
+{
+    return MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter)->max_limit;
+}
+
+gboolean
+milter_client_concurrency_limiter_is_acceptable (MilterClientConcurrencyLimiter *limiter,
+                                                 guint n_processing_sessions)
+{
+    return n_processing_sessions <
+        milter_client_concurrency_limiter_get_limit(limiter);
+}
+
+static void
+decrease (MilterClientConcurrencyLimiterPrivate *priv, const gchar *reason)
+{
+    gdouble limit;
+
+    if (priv->decrease_timer &&
+        g_timer_elapsed(priv->decrease_timer, NULL) < DECREASE_INTERVAL)
+        return;
+
+    limit = MAX(priv->limit * DECREASE_RATIO, MIN_LIMIT);
+    if ((guint)limit != (guint)priv->limit) {
+        milter_statistics("[client][concurrency-limiter][decrease][%s] "
+                          "%u -> %u: latency=%g baseline=%g lag=%g",
+                          reason,
+                          (guint)priv->limit,
+                          (guint)limit,
+                          priv->latency_trend.latency,
+                          priv->latency_trend.baseline_latency,
+                          priv->lag);
+    }
+    priv->limit = limit;
+
+    if (priv->decrease_timer)
+        g_timer_start(priv->decrease_timer);
+    else
+        priv->decrease_timer = g_timer_new();
+}
+
+static void
+increase (MilterClientConcurrencyLimiterPrivate *priv)
+{
+    gdouble limit;
+
+    limit = priv->limit + 1.0 / priv->limit;
+    if (priv->max_limit > 0 && limit > priv->max_limit)
+        limit = priv->max_limit;
+    if ((guint)limit != (guint)priv->limit) {
+        milter_debug("[client][concurrency-limiter][increase] %u -> %u",
+                     (guint)priv->limit,
+                     (guint)limit);
+    }
+    priv->limit = limit;
+}
+
+void
+milter_client_concurrency_limiter_record_latency (MilterClientConcurrencyLimiter *limiter,
+                                                  gdouble latency,
+                                                  guint n_processing_sessions)
+{
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    milter_utils_latency_trend_add(&(priv->latency_trend), latency);
+
+    if (milter_utils_latency_trend_is_warmed_up(&(priv->latency_trend)) &&
+        priv->latency_trend.latency >
+        priv->latency_trend.baseline_latency *
+        MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_LATENCY_TOLERANCE) {
+        decrease(priv, "latency");
+    } else if (n_processing_sessions * 2 >= (guint)priv->limit &&
+               priv->lag <= MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_MAX_LAG) {
+        /* Only grow a limit that is actually used. */
+        increase(priv);
+    }
+    g_mutex_unlock(priv->mutex);
+}
+
+void
+milter_client_concurrency_limiter_record_lag (MilterClientConcurrencyLimiter *limiter,
+                                              gdouble lag)
+{
+    MilterClientConcurrencyLimiterPrivate *priv;
+
+    priv = MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    priv->lag = lag;
+    if (lag > MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_MAX_LAG)
+        decrease(priv, "lag");
+    g_mutex_unlock(priv->mutex);
+}
+
+gdouble
+milter_client_concurrency_limiter_get_latency (MilterClientConcurrencyLimiter *limiter)
+{
+    return MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter)->latency_trend.latency;
+}
+
+gdouble
+milter_client_concurrency_limiter_get_baseline_latency (MilterClientConcurrencyLimiter *limiter)
+{
+    return MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter)->latency_trend.baseline_latency;
+}
+
+gdouble
+milter_client_concurrency_limiter_get_lag (MilterClientConcurrencyLimiter *limiter)
+{
+    return MILTER_CLIENT_CONCURRENCY_LIMITER_GET_PRIVATE(limiter)->lag;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,181 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_CLIENT_CONCURRENCY_LIMITER_H__
+#define __MILTER_CLIENT_CONCURRENCY_LIMITER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_INITIAL_LIMIT:
+ *
+ * The initial limit when there is no max limit.
+ */
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_INITIAL_LIMIT 100
+
+/**
+ * MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_LATENCY_TOLERANCE:
+ *
+ * The default ratio of the recent latency to the baseline
+ * latency that is treated as overload.
+ */
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_LATENCY_TOLERANCE 2.0
+
+/**
+ * MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_MAX_LAG:
+ *
+ * The default event loop lag in seconds that is treated as
+ * overload.
+ */
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_MAX_LAG 0.1
+
+#define MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER            (milter_client_concurrency_limiter_get_type())
+#define MILTER_CLIENT_CONCURRENCY_LIMITER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER, MilterClientConcurrencyLimiter))
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER, MilterClientConcurrencyLimiterClass))
+#define MILTER_IS_CLIENT_CONCURRENCY_LIMITER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER))
+#define MILTER_IS_CLIENT_CONCURRENCY_LIMITER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER))
+#define MILTER_CLIENT_CONCURRENCY_LIMITER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_CLIENT_CONCURRENCY_LIMITER, MilterClientConcurrencyLimiterClass))
+
+typedef struct _MilterClientConcurrencyLimiter         MilterClientConcurrencyLimiter;
+typedef struct _MilterClientConcurrencyLimiterClass    MilterClientConcurrencyLimiterClass;
+
+struct _MilterClientConcurrencyLimiter
+{
+    GObject object;
+};
+
+struct _MilterClientConcurrencyLimiterClass
+{
+    GObjectClass parent_class;
+};
+
+GType milter_client_concurrency_limiter_get_type (void) G_GNUC_CONST;
+
+/**
+ * milter_client_concurrency_limiter_new:
+ * @max_limit: the upper bound of the limit. 0 means 'no
+ *             upper bound'.
+ *
+ * Creates a new AIMD (additive increase, multiplicative
+ * decrease) concurrency limiter. The limit is increased
+ * while sessions finish as fast as usual and is decreased
+ * when the session latency or the event loop lag grows.
+ *
+ * Returns: a new %MilterClientConcurrencyLimiter object.
+ */
+MilterClientConcurrencyLimiter *
+             milter_client_concurrency_limiter_new
+                                        (guint max_limit);
+
+/**
+ * milter_client_concurrency_limiter_get_limit:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ *
+ * Returns: the current limit of concurrent sessions.
+ */
+guint        milter_client_concurrency_limiter_get_limit
+                                        (MilterClientConcurrencyLimiter *limiter);
+
+/**
+ * milter_client_concurrency_limiter_set_max_limit:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ * @max_limit: the upper bound of the limit. 0 means 'no
+ *             upper bound'.
+ *
+ * Sets the upper bound of the limit.
+ */
+void         milter_client_concurrency_limiter_set_max_limit
+                                        (MilterClientConcurrencyLimiter *limiter,
+                                         guint                           max_limit);
+guint        milter_client_concurrency_limiter_get_max_limit
+                                        (MilterClientConcurrencyLimiter *limiter);
+
+/**
+ * milter_client_concurrency_limiter_is_acceptable:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ * @n_processing_sessions: the number of processing sessions.
+ *
+ * Returns: %TRUE if a new session can be accepted.
+ */
+gboolean     milter_client_concurrency_limiter_is_acceptable
+                                        (MilterClientConcurrencyLimiter *limiter,
+                                         guint                           n_processing_sessions);
+
+/**
+ * milter_client_concurrency_limiter_record_latency:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ * @latency: the seconds that a finished session took.
+ * @n_processing_sessions: the number of sessions that were
+ *                         processed with the session.
+ *
+ * Adjusts the limit by a finished session.
+ */
+void         milter_client_concurrency_limiter_record_latency
+                                        (MilterClientConcurrencyLimiter *limiter,
+                                         gdouble                         latency,
+                                         guint                           n_processing_sessions);
+
+/**
+ * milter_client_concurrency_limiter_record_lag:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ * @lag: the seconds that a timer of the event loop was
+ *       delayed.
+ *
+ * Adjusts the limit by the event loop lag.
+ */
+void         milter_client_concurrency_limiter_record_lag
+                                        (MilterClientConcurrencyLimiter *limiter,
+                                         gdouble                         lag);
+
+/**
+ * milter_client_concurrency_limiter_get_latency:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ *
+ * Returns: the recent session latency in seconds.
+ */
+gdouble      milter_client_concurrency_limiter_get_latency
+                                        (MilterClientConcurrencyLimiter *limiter);
+
+/**
+ * milter_client_concurrency_limiter_get_baseline_latency:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ *
+ * Returns: the long term session latency in seconds.
+ */
+gdouble      milter_client_concurrency_limiter_get_baseline_latency
+                                        (MilterClientConcurrencyLimiter *limiter);
+
+/**
+ * milter_client_concurrency_limiter_get_lag:
+ * @limiter: a %MilterClientConcurrencyLimiter.
+ *
+ * Returns: the last event loop lag in seconds.
+ */
+gdouble      milter_client_concurrency_limiter_get_lag
+                                        (MilterClientConcurrencyLimiter *limiter);
+
+G_END_DECLS
+
+#endif /* __MILTER_CLIENT_CONCURRENCY_LIMITER_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
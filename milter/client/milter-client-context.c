@@ -2898,6 +2898,8 @@ negotiate_response (MilterClientContext *context,
                                               &packet, &packet_size,
                                               priv->option, macros_requests);
         write_packet(MILTER_CLIENT_CONTEXT(context), packet, packet_size);
+        milter_encoder_set_max_data_size(
+            encoder, milter_option_get_max_data_size(priv->option));
         break;
     case MILTER_STATUS_REJECT:
         encoder = milter_agent_get_encoder(MILTER_AGENT(context));
@@ -21,12 +21,20 @@
 #  include "../../config.h"
 #endif /* HAVE_CONFIG_H */
 
+#if defined(HAVE_SCHED_SETAFFINITY) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE
+#endif
+
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <pwd.h>
 #include <grp.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#  include <sched.h>
+#endif
 
 #include <errno.h>
 
@@ -37,6 +45,10 @@
 #include "milter-client-private.h"
 #include "../core/milter-glib-compatible.h"
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
 enum
 {
     PROP_0,
@@ -66,6 +78,7 @@ enum
     EVENT_LOOP_CREATED,
     WORKERS_CREATED,
     WORKER_CREATED,
+    IO_THREAD_CREATED,
     LAST_SIGNAL
 };
 
@@ -102,13 +115,23 @@ struct _MilterClientPrivate
     gboolean remove_unix_socket_on_create;
     guint suspend_time_on_unacceptable;
     guint max_connections;
-    gboolean multi_thread_mode;
-    GThreadPool *worker_threads;
+    guint n_io_threads;
+    struct {
+        GPtrArray *threads;
+        GIOChannel *notify_channel;
+        gint notify_fd;
+        guint notify_watch_id;
+        gint n_finished_sessions;
+    } io_threads;
     struct {
         GIOChannel *control;
         guint n_process;
         guint id;
         GArray *pids;
+        GPtrArray *listen_channels;
+        gint *n_accepts;
+        guint n_accepts_length;
+        guint report_id;
     } workers;
     struct sockaddr *address;
     socklen_t address_size;
@@ -133,16 +156,51 @@ struct _MilterClientPrivate
     gboolean daemonized;
 
     guint max_pending_finished_sessions;
+
+    gboolean adaptive_max_connections;
+    MilterClientConcurrencyLimiter *concurrency_limiter;
+    MilterEventLoop *accept_watch_loop;
+    GIOFunc accept_watch_func;
+    gint accept_watch_priority;
+    guint accept_resume_id;
+    guint lag_check_id;
+    GTimer *lag_timer;
+
+    gboolean reuse_port;
+    gboolean pin_workers;
 };
 
+typedef struct _MilterClientIOThread
+{
+    MilterClient *client;
+    guint id;
+    MilterEventLoop *loop;
+    GThread *thread;
+    GAsyncQueue *queue;
+    GIOChannel *wakeup_channel;
+    gint wakeup_fd;
+    guint wakeup_watch_id;
+    GList *processing_data;
+    GPtrArray *finished_data;
+    guint finisher_id;
+    gint n_sessions;
+    gint quitting;
+} MilterClientIOThread;
+
 typedef struct _MilterClientProcessData
 {
     MilterClientPrivate *priv;
     MilterClient *client;
     MilterClientContext *context;
+    MilterClientIOThread *io_thread;
     gulong finished_handler_id;
+    GTimer *timer;
 } MilterClientProcessData;
 
+#define ACCEPT_RESUME_CHECK_INTERVAL 0.1
+#define LAG_CHECK_INTERVAL 0.1
+#define WORKER_ACCEPTS_REPORT_INTERVAL 60
+
 typedef gboolean (*AcceptConnectionFunction) (MilterClient *client, gint fd);
 
 #define _milter_client_get_type milter_client_get_type
@@ -216,6 +274,16 @@ static gboolean run_master (MilterClient *client,
                             GError      **error);
 static gboolean run_worker (MilterClient *client,
                             GError      **error);
+static gboolean start_io_threads
+                           (MilterClient *client,
+                            GError      **error);
+static void     stop_io_threads
+                           (MilterClient *client);
+static void     io_threads_process_client_channel
+                           (MilterClient *client,
+                            GIOChannel   *channel,
+                            MilterGenericSocketAddress *address,
+                            socklen_t     address_size);
 
 static guint        get_max_pending_finished_sessions
                            (MilterClient    *client);
@@ -224,6 +292,26 @@ static void         set_max_pending_finished_sessions
                             guint            n_sessions);
 static GArray      *get_worker_pids
                            (MilterClient    *client);
+static gboolean     is_adaptive_max_connections
+                           (MilterClient    *client);
+static void         set_adaptive_max_connections
+                           (MilterClient    *client,
+                            gboolean         adaptive);
+static gboolean     is_reuse_port
+                           (MilterClient    *client);
+static void         set_reuse_port
+                           (MilterClient    *client,
+                            gboolean         reuse_port);
+static gboolean     is_pin_workers
+                           (MilterClient    *client);
+static void         set_pin_workers
+                           (MilterClient    *client,
+                            gboolean         pin_workers);
+static guint        get_n_io_threads
+                           (MilterClient    *client);
+static void         set_n_io_threads
+                           (MilterClient    *client,
+                            guint            n_io_threads);
 
 static void
 _milter_client_class_init (MilterClientClass *klass)
@@ -264,6 +352,16 @@ _milter_client_class_init (MilterClientClass *klass)
     client_class->set_max_pending_finished_sessions
                                          = set_max_pending_finished_sessions;
     client_class->get_worker_pids        = get_worker_pids;
+    client_class->is_adaptive_max_connections
+                                         = is_adaptive_max_connections;
+    client_class->set_adaptive_max_connections
+                                         = set_adaptive_max_connections;
+    client_class->is_reuse_port          = is_reuse_port;
+    client_class->set_reuse_port         = set_reuse_port;
+    client_class->is_pin_workers         = is_pin_workers;
+    client_class->set_pin_workers        = set_pin_workers;
+    client_class->get_n_io_threads       = get_n_io_threads;
+    client_class->set_n_io_threads       = set_n_io_threads;
 
     spec = g_param_spec_string("connection-spec",
                                "Connection Spec",
@@ -443,11 +541,20 @@ _milter_client_class_init (MilterClientClass *klass)
                      g_cclosure_marshal_VOID__VOID,
                      G_TYPE_NONE, 0);
 
+    signals[IO_THREAD_CREATED] =
+        g_signal_new("io-thread-created",
+                     MILTER_TYPE_CLIENT,
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterClientClass, io_thread_created),
+                     NULL, NULL,
+                     g_cclosure_marshal_VOID__OBJECT,
+                     G_TYPE_NONE, 1, MILTER_TYPE_EVENT_LOOP);
+
     g_type_class_add_private(gobject_class, sizeof(MilterClientPrivate));
 }
 
-MilterEventLoop *
-milter_client_create_event_loop (MilterClient *client, gboolean use_default_context)
+static MilterEventLoop *
+create_event_loop (MilterClient *client, gboolean use_default_context)
 {
     MilterEventLoop *loop = NULL;
 
@@ -473,6 +580,16 @@ milter_client_create_event_loop (MilterClient *client, gboolean use_default_cont
         }
         break;
     }
+
+    return loop;
+}
+
+MilterEventLoop *
+milter_client_create_event_loop (MilterClient *client, gboolean use_default_context)
+{
+    MilterEventLoop *loop;
+
+    loop = create_event_loop(client, use_default_context);
     g_signal_emit(client, signals[EVENT_LOOP_CREATED], 0, loop);
 
     return loop;
@@ -510,12 +627,20 @@ _milter_client_init (MilterClient *client)
     priv->suspend_time_on_unacceptable =
         MILTER_CLIENT_DEFAULT_SUSPEND_TIME_ON_UNACCEPTABLE;
     priv->max_connections = MILTER_CLIENT_DEFAULT_MAX_CONNECTIONS;
-    priv->multi_thread_mode = FALSE;
-    priv->worker_threads = NULL;
+    priv->n_io_threads = 0;
+    priv->io_threads.threads = NULL;
+    priv->io_threads.notify_channel = NULL;
+    priv->io_threads.notify_fd = -1;
+    priv->io_threads.notify_watch_id = 0;
+    priv->io_threads.n_finished_sessions = 0;
     priv->workers.n_process = 0;
     priv->workers.id = 0;
     priv->workers.control = NULL;
     priv->workers.pids = NULL;
+    priv->workers.listen_channels = NULL;
+    priv->workers.n_accepts = NULL;
+    priv->workers.n_accepts_length = 0;
+    priv->workers.report_id = 0;
     priv->address = NULL;
     priv->address_size = 0;
     priv->effective_user = NULL;
@@ -540,6 +665,18 @@ _milter_client_init (MilterClient *client)
     priv->daemonized = FALSE;
 
     priv->max_pending_finished_sessions = 0;
+
+    priv->adaptive_max_connections = FALSE;
+    priv->concurrency_limiter = NULL;
+    priv->accept_watch_loop = NULL;
+    priv->accept_watch_func = NULL;
+    priv->accept_watch_priority = G_PRIORITY_DEFAULT;
+    priv->accept_resume_id = 0;
+    priv->lag_check_id = 0;
+    priv->lag_timer = NULL;
+
+    priv->reuse_port = FALSE;
+    priv->pin_workers = FALSE;
 }
 
 static void
@@ -557,6 +694,8 @@ process_data_free (MilterClientProcessData *data)
 {
     dispose_process_data_finished_handler(data);
     g_object_unref(data->context);
+    if (data->timer)
+        g_timer_destroy(data->timer);
     g_free(data);
 }
 
@@ -579,6 +718,21 @@ dispose_finisher (MilterClientPrivate *priv)
     }
 }
 
+static void
+record_session_latency (MilterClientProcessData *data)
+{
+    MilterClientPrivate *priv;
+
+    priv = data->priv;
+    if (!priv->concurrency_limiter || !data->timer)
+        return;
+
+    milter_client_concurrency_limiter_record_latency(
+        priv->concurrency_limiter,
+        g_timer_elapsed(data->timer, NULL),
+        priv->n_processing_sessions);
+}
+
 static void
 finish_processing (MilterClientProcessData *data)
 {
@@ -668,6 +822,23 @@ milter_client_need_maintain (MilterClient *client, guint n_finished_sessions)
     return n_finished_sessions_in_interval < n_finished_sessions;
 }
 
+static void
+emit_sessions_finished (MilterClient *client, guint n_finished_sessions)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    g_signal_emit(client, signals[SESSIONS_FINISHED], 0, n_finished_sessions);
+
+    milter_statistics("[sessions][finished] %u(+%u) %u",
+                      priv->n_processed_sessions,
+                      n_finished_sessions,
+                      priv->n_processing_sessions);
+    if (milter_client_need_maintain(client, n_finished_sessions)) {
+        g_signal_emit(client, signals[MAINTAIN], 0);
+    }
+}
+
 static void
 dispose_finished_data (MilterClient *client)
 {
@@ -684,15 +855,7 @@ dispose_finished_data (MilterClient *client)
     priv->finished_data = NULL;
     n_finished_sessions =
         priv->n_processed_sessions - n_processed_sessions_before;
-    g_signal_emit(client, signals[SESSIONS_FINISHED], 0, n_finished_sessions);
-
-    milter_statistics("[sessions][finished] %u(+%u) %u",
-                      priv->n_processed_sessions,
-                      n_finished_sessions,
-                      priv->n_processing_sessions);
-    if (milter_client_need_maintain(client, n_finished_sessions)) {
-        g_signal_emit(client, signals[MAINTAIN], 0);
-    }
+    emit_sessions_finished(client, n_finished_sessions);
 }
 
 static void
@@ -702,9 +865,34 @@ watch_worker_process (GPid     pid,
 {
 }
 
+static void
+dispose_concurrency_limiter (MilterClientPrivate *priv)
+{
+    if (priv->lag_check_id > 0) {
+        milter_event_loop_remove(priv->event_loop, priv->lag_check_id);
+        priv->lag_check_id = 0;
+    }
+
+    if (priv->lag_timer) {
+        g_timer_destroy(priv->lag_timer);
+        priv->lag_timer = NULL;
+    }
+
+    if (priv->concurrency_limiter) {
+        g_object_unref(priv->concurrency_limiter);
+        priv->concurrency_limiter = NULL;
+    }
+}
+
 static void
 dispose_accept_watchers (MilterClientPrivate *priv)
 {
+    if (priv->accept_resume_id > 0) {
+        milter_event_loop_remove(priv->accept_watch_loop,
+                                 priv->accept_resume_id);
+        priv->accept_resume_id = 0;
+    }
+
     if (priv->accept_watch_id > 0) {
         if (priv->accept_loop) {
             milter_event_loop_remove(priv->accept_loop, priv->accept_watch_id);
@@ -726,6 +914,33 @@ dispose_accept_watchers (MilterClientPrivate *priv)
     }
 }
 
+static void
+dispose_worker_listen_channels (MilterClientPrivate *priv)
+{
+    if (priv->workers.listen_channels) {
+        g_ptr_array_foreach(priv->workers.listen_channels,
+                            (GFunc)g_io_channel_unref, NULL);
+        g_ptr_array_free(priv->workers.listen_channels, TRUE);
+        priv->workers.listen_channels = NULL;
+    }
+}
+
+static void
+dispose_worker_accepts (MilterClientPrivate *priv)
+{
+    if (priv->workers.report_id > 0) {
+        milter_event_loop_remove(priv->event_loop, priv->workers.report_id);
+        priv->workers.report_id = 0;
+    }
+
+    if (priv->workers.n_accepts) {
+        munmap(priv->workers.n_accepts,
+               sizeof(gint) * priv->workers.n_accepts_length);
+        priv->workers.n_accepts = NULL;
+        priv->workers.n_accepts_length = 0;
+    }
+}
+
 static void
 dispose_syslog_logger (MilterClientPrivate *priv)
 {
@@ -752,12 +967,17 @@ dispose (GObject *object)
         priv->workers.pids = NULL;
     }
 
+    dispose_worker_listen_channels(priv);
+    dispose_worker_accepts(priv);
+    stop_io_threads(MILTER_CLIENT(object));
+
     if (priv->listening_channel) {
         g_io_channel_unref(priv->listening_channel);
         priv->listening_channel = NULL;
     }
 
     dispose_accept_watchers(priv);
+    dispose_concurrency_limiter(priv);
 
     if (priv->accept_loop) {
         g_object_unref(priv->accept_loop);
@@ -800,11 +1020,6 @@ dispose (GObject *object)
         priv->default_unix_socket_group = NULL;
     }
 
-    if (priv->worker_threads) {
-        g_thread_pool_free(priv->worker_threads, TRUE, FALSE);
-        priv->worker_threads = NULL;
-    }
-
     dispose_address(priv);
 
     if (priv->effective_user) {
@@ -1171,6 +1386,7 @@ single_thread_cb_finished (MilterClientContext *context, gpointer _data)
     guint max_pending_finished_sessions;
 
     dispose_process_data_finished_handler(data);
+    record_session_latency(data);
     priv = data->priv;
     if (!priv->finished_data) {
         priv->finished_data = g_ptr_array_new();
@@ -1219,19 +1435,18 @@ milter_client_create_context (MilterClient *client)
 static gboolean
 milter_client_start_context (MilterClient *client,
                              MilterClientContext *context,
+                             MilterEventLoop *loop,
                              GIOChannel *channel,
                              MilterGenericSocketAddress *address,
                              GError **error)
 {
-    MilterClientPrivate *priv;
     MilterAgent *agent;
     MilterWriter *writer;
     MilterReader *reader;
 
     agent = MILTER_AGENT(context);
-    priv = MILTER_CLIENT_GET_PRIVATE(client);
 
-    milter_agent_set_event_loop(agent, priv->event_loop);
+    milter_agent_set_event_loop(agent, loop);
 
     writer = milter_writer_io_channel_new(channel);
     milter_agent_set_writer(agent, writer);
@@ -1274,6 +1489,8 @@ single_thread_client_channel_setup (MilterClient *client,
     data->priv = priv;
     data->client = client;
     data->context = context;
+    data->io_thread = NULL;
+    data->timer = priv->concurrency_limiter ? g_timer_new() : NULL;
 
     milter_debug("[%u] [client][single-thread][start]",
                  milter_agent_get_tag(agent));
@@ -1284,7 +1501,8 @@ single_thread_client_channel_setup (MilterClient *client,
 
     priv->processing_data = g_list_prepend(priv->processing_data, data);
 
-    if (milter_client_start_context(client, context, channel, address, &error)) {
+    if (milter_client_start_context(client, context, priv->event_loop,
+                                    channel, address, &error)) {
         g_signal_emit(client, signals[CONNECTION_ESTABLISHED], 0, context);
     } else {
         milter_error("[%u] [client][single-thread][start][error] %s",
@@ -1319,6 +1537,12 @@ single_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
+    if (priv->io_threads.threads) {
+        io_threads_process_client_channel(client, channel,
+                                          address, address_size);
+        return;
+    }
+
     data = g_new(ClientChannelSetupData, 1);
     data->client = client;
     data->channel = channel;
@@ -1332,6 +1556,69 @@ single_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
                                     NULL);
 }
 
+static gboolean
+cb_resume_accepting (gpointer user_data)
+{
+    MilterClient *client = user_data;
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->listening_channel) {
+        priv->accept_resume_id = 0;
+        return FALSE;
+    }
+    if (!milter_client_concurrency_limiter_is_acceptable(
+            priv->concurrency_limiter, priv->n_processing_sessions))
+        return TRUE;
+
+    milter_debug("[client][accept][resume] "
+                 "processing connection: %u, limit: %u",
+                 priv->n_processing_sessions,
+                 milter_client_concurrency_limiter_get_limit(
+                     priv->concurrency_limiter));
+    priv->accept_resume_id = 0;
+    priv->accept_watch_id =
+        milter_event_loop_watch_io_full(priv->accept_watch_loop,
+                                        priv->accept_watch_priority,
+                                        priv->listening_channel,
+                                        G_IO_IN | G_IO_PRI,
+                                        priv->accept_watch_func,
+                                        client,
+                                        NULL);
+    return FALSE;
+}
+
+/*
+ * Stops watching the listening socket while the limit is
+ * reached. New connections wait in the listen backlog
+ * without blocking the event loop.
+ */
+static void
+pause_accepting (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (priv->accept_resume_id > 0)
+        return;
+
+    milter_debug("[client][accept][pause] "
+                 "too many processing connection: %u, limit: %u",
+                 priv->n_processing_sessions,
+                 milter_client_concurrency_limiter_get_limit(
+                     priv->concurrency_limiter));
+    if (priv->accept_watch_id > 0) {
+        milter_event_loop_remove(priv->accept_watch_loop,
+                                 priv->accept_watch_id);
+        priv->accept_watch_id = 0;
+    }
+    priv->accept_resume_id =
+        milter_event_loop_add_timeout(priv->accept_watch_loop,
+                                      ACCEPT_RESUME_CHECK_INTERVAL,
+                                      cb_resume_accepting,
+                                      client);
+}
+
 static gint
 accept_connection_fd (MilterClient *client, gint server_fd,
                       MilterGenericSocketAddress *address,
@@ -1343,8 +1630,17 @@ accept_connection_fd (MilterClient *client, gint server_fd,
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
+    if (priv->concurrency_limiter && priv->accept_watch_loop &&
+        !milter_client_concurrency_limiter_is_acceptable(
+            priv->concurrency_limiter, priv->n_processing_sessions)) {
+        pause_accepting(client);
+        errno = EAGAIN;
+        return -1;
+    }
+
     suspend_time = milter_client_get_suspend_time_on_unacceptable(client);
-    max_connections = milter_client_get_max_connections(client);
+    max_connections = priv->concurrency_limiter ?
+        0 : milter_client_get_max_connections(client);
     for (n_suspend = 0;
          0 < max_connections && max_connections <= priv->n_processing_sessions;
          n_suspend++) {
@@ -1543,173 +1839,455 @@ single_thread_start_accept (MilterClient *client, GError **error)
     return TRUE;
 }
 
+static gboolean
+create_io_thread_pipe (GIOChannel **read_channel, gint *write_fd,
+                       GError **error)
+{
+    int pipe_fds[2];
+
+    if (pipe(pipe_fds) == -1) {
+        g_set_error(error,
+                    MILTER_CLIENT_ERROR,
+                    MILTER_CLIENT_ERROR_THREAD,
+                    "failed to create a pipe for I/O threads: %s",
+                    g_strerror(errno));
+        milter_error("[client][io-threads][pipe][error] %s",
+                     g_strerror(errno));
+        return FALSE;
+    }
+
+    fcntl(pipe_fds[MILTER_UTILS_WRITE_PIPE], F_SETFL, O_NONBLOCK);
+    *read_channel = setup_client_channel(pipe_fds[MILTER_UTILS_READ_PIPE]);
+    *write_fd = pipe_fds[MILTER_UTILS_WRITE_PIPE];
+
+    return TRUE;
+}
+
+/*
+ * Wakes up the event loop that watches the other end of
+ * @fd. A full pipe already has a pending wake up. So it
+ * doesn't need to block.
+ */
+static void
+wake_up_io_thread_pipe (gint fd)
+{
+    gchar byte = '\0';
+    ssize_t written_size;
+
+    do {
+        written_size = write(fd, &byte, 1);
+    } while (written_size == -1 && errno == EINTR);
+}
+
 static void
-multi_thread_process_client_channel (MilterClient *client, GIOChannel *channel,
-                                     MilterGenericSocketAddress *address,
-                                     socklen_t address_size)
+drain_io_thread_pipe (GIOChannel *channel)
+{
+    gchar buffer[64];
+    gint fd;
+
+    fd = g_io_channel_unix_get_fd(channel);
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+static void
+io_thread_finish_sessions (MilterClientIOThread *thread)
 {
     MilterClientPrivate *priv;
+    guint i, n_finished_sessions;
+
+    if (!thread->finished_data)
+        return;
+
+    n_finished_sessions = thread->finished_data->len;
+    for (i = 0; i < n_finished_sessions; i++) {
+        MilterClientProcessData *data;
+
+        data = g_ptr_array_index(thread->finished_data, i);
+        thread->processing_data = g_list_remove(thread->processing_data, data);
+        process_data_free(data);
+    }
+    g_ptr_array_free(thread->finished_data, TRUE);
+    thread->finished_data = NULL;
+
+    milter_debug("[client][io-thread][finish] <%u>: <%u>",
+                 thread->id, n_finished_sessions);
+
+    priv = MILTER_CLIENT_GET_PRIVATE(thread->client);
+    g_atomic_int_add(&(thread->n_sessions), -(gint)n_finished_sessions);
+    g_atomic_int_add(&(priv->io_threads.n_finished_sessions),
+                     n_finished_sessions);
+    wake_up_io_thread_pipe(priv->io_threads.notify_fd);
+}
+
+static gboolean
+io_thread_finisher (gpointer user_data)
+{
+    MilterClientIOThread *thread = user_data;
+
+    thread->finisher_id = 0;
+    io_thread_finish_sessions(thread);
+
+    return FALSE;
+}
+
+static void
+io_thread_cb_finished (MilterClientContext *context, gpointer user_data)
+{
+    MilterClientProcessData *data = user_data;
+    MilterClientIOThread *thread;
+
+    thread = data->io_thread;
+    dispose_process_data_finished_handler(data);
+    record_session_latency(data);
+    if (!thread->finished_data)
+        thread->finished_data = g_ptr_array_new();
+    g_ptr_array_add(thread->finished_data, data);
+
+    if (thread->finisher_id == 0) {
+        thread->finisher_id =
+            milter_event_loop_add_idle_full(thread->loop,
+                                            G_PRIORITY_DEFAULT,
+                                            io_thread_finisher,
+                                            thread,
+                                            NULL);
+    }
+}
+
+static void
+io_thread_client_channel_setup (MilterClientIOThread *thread,
+                                ClientChannelSetupData *setup_data)
+{
+    MilterClient *client;
+    MilterClientPrivate *priv;
+    MilterAgent *agent;
     MilterClientContext *context;
     MilterClientProcessData *data;
     GError *error = NULL;
 
+    client = thread->client;
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
     context = milter_client_create_context(client);
+    agent = MILTER_AGENT(context);
 
     data = g_new(MilterClientProcessData, 1);
     data->priv = priv;
     data->client = client;
     data->context = context;
-    data->finished_handler_id = 0;
+    data->io_thread = thread;
+    data->timer = priv->concurrency_limiter ? g_timer_new() : NULL;
 
-    priv->processing_data = g_list_prepend(priv->processing_data, data);
-    if (milter_client_start_context(client, context, channel, address, &error)) {
-        g_thread_pool_push(priv->worker_threads, data, &error);
-        if (error) {
-            GError *client_error;
-
-            client_error = g_error_new(MILTER_CLIENT_ERROR,
-                                       MILTER_CLIENT_ERROR_THREAD,
-                                       "failed to push a data to thread pool: %s",
-                                       error->message);
-            g_error_free(error);
-            milter_error("[%u] [client][multi-thread][error] %s",
-                         milter_agent_get_tag(MILTER_AGENT(context)),
-                         client_error->message);
-            milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(client),
-                                        client_error);
-            g_error_free(client_error);
-            milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
-        }
+    milter_debug("[%u] [client][io-thread][start] <%u>",
+                 milter_agent_get_tag(agent), thread->id);
+
+    data->finished_handler_id =
+        g_signal_connect(context, "finished",
+                         G_CALLBACK(io_thread_cb_finished), data);
+
+    thread->processing_data = g_list_prepend(thread->processing_data, data);
+
+    if (milter_client_start_context(client, context, thread->loop,
+                                    setup_data->channel,
+                                    &(setup_data->address),
+                                    &error)) {
+        g_signal_emit(client, signals[CONNECTION_ESTABLISHED], 0, context);
     } else {
-        milter_error("[%u] [client][multi-thread][start][error] %s",
-                     milter_agent_get_tag(MILTER_AGENT(context)),
-                     error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(context), error);
+        milter_error("[%u] [client][io-thread][start][error] <%u>: %s",
+                     milter_agent_get_tag(agent), thread->id, error->message);
+        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(agent), error);
         g_error_free(error);
         milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
     }
-
-    g_io_channel_unref(channel);
 }
 
 static gboolean
-multi_thread_accept_connection (MilterClient *client, gint server_fd)
+io_thread_wakeup_watch_func (GIOChannel *channel, GIOCondition condition,
+                             gpointer user_data)
 {
-    gboolean accepted;
-    GIOChannel *client_channel;
-    MilterGenericSocketAddress address;
-    socklen_t address_size;
+    MilterClientIOThread *thread = user_data;
+    ClientChannelSetupData *setup_data;
 
-    accepted = accept_connection(client, server_fd, &client_channel,
-                                 &address, &address_size);
-    if (accepted) {
-        multi_thread_process_client_channel(client, client_channel,
-                                            &address, address_size);
-        g_io_channel_unref(client_channel);
+    drain_io_thread_pipe(channel);
+    while ((setup_data = g_async_queue_try_pop(thread->queue))) {
+        io_thread_client_channel_setup(thread, setup_data);
+        g_io_channel_unref(setup_data->channel);
+        g_free(setup_data);
+    }
+
+    if (g_atomic_int_get(&(thread->quitting))) {
+        milter_debug("[client][io-thread][loop][quit] <%u>", thread->id);
+        milter_event_loop_quit(thread->loop);
     }
 
     return TRUE;
 }
 
-static gboolean
-multi_thread_accept_watch_func (GIOChannel *channel, GIOCondition condition,
-                                gpointer data)
+static gpointer
+io_thread_run (gpointer user_data)
 {
-    MilterClient *client = data;
-    gboolean keep_callback = TRUE;
-    gint fd;
+    MilterClientIOThread *thread = user_data;
 
-    fd = g_io_channel_unix_get_fd(channel);
-    keep_callback = multi_thread_accept_connection(client, fd);
-    if (!keep_callback)
-        milter_client_shutdown(client);
-    return keep_callback;
+    milter_debug("[client][io-thread][run] <%u>", thread->id);
+    milter_event_loop_run(thread->loop);
+    milter_debug("[client][io-thread][stop] <%u>", thread->id);
+
+    return NULL;
 }
 
 static void
-multi_thread_cb_finished (MilterClientContext *context, gpointer _data)
+io_thread_free (MilterClientIOThread *thread)
 {
-    MilterClientProcessData *data = _data;
+    ClientChannelSetupData *setup_data;
+
+    if (thread->finisher_id > 0)
+        milter_event_loop_remove(thread->loop, thread->finisher_id);
+    if (thread->wakeup_watch_id > 0)
+        milter_event_loop_remove(thread->loop, thread->wakeup_watch_id);
+
+    /* Finished sessions are still in processing_data. */
+    if (thread->finished_data)
+        g_ptr_array_free(thread->finished_data, TRUE);
+    if (thread->processing_data) {
+        g_list_foreach(thread->processing_data, (GFunc)process_data_free, NULL);
+        g_list_free(thread->processing_data);
+    }
+
+    if (thread->queue) {
+        while ((setup_data = g_async_queue_try_pop(thread->queue))) {
+            g_io_channel_unref(setup_data->channel);
+            g_free(setup_data);
+        }
+        g_async_queue_unref(thread->queue);
+    }
+
+    if (thread->wakeup_channel)
+        g_io_channel_unref(thread->wakeup_channel);
+    if (thread->wakeup_fd != -1)
+        close(thread->wakeup_fd);
+    if (thread->loop)
+        g_object_unref(thread->loop);
 
-    finish_processing(data);
+    g_free(thread);
 }
 
-static void
-multi_thread_process_client_channel_thread (gpointer data_, gpointer user_data)
+static gboolean
+io_threads_notify_watch_func (GIOChannel *channel, GIOCondition condition,
+                              gpointer user_data)
 {
-    MilterAgent *agent;
-    MilterClientContext *context;
-    MilterClient *client = data_;
-    MilterClientProcessData *data = user_data;
-    MilterEventLoop *event_loop;
-    GError *error = NULL;
+    MilterClient *client = user_data;
+    MilterClientPrivate *priv;
+    gint i, n_finished_sessions;
 
-    event_loop = milter_client_create_event_loop(client, FALSE);
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
 
-    context = MILTER_CLIENT_CONTEXT(data->context);
-    agent = MILTER_AGENT(context);
-    milter_debug("[%u] [client][multi-thread][start]",
-                 milter_agent_get_tag(agent));
+    drain_io_thread_pipe(channel);
+    do {
+        n_finished_sessions =
+            g_atomic_int_get(&(priv->io_threads.n_finished_sessions));
+    } while (!g_atomic_int_compare_and_exchange(
+                 &(priv->io_threads.n_finished_sessions),
+                 n_finished_sessions,
+                 0));
+    if (n_finished_sessions == 0)
+        return TRUE;
 
-    data->finished_handler_id =
-        g_signal_connect(data->context, "finished",
-                         G_CALLBACK(multi_thread_cb_finished), data);
+    for (i = 0; i < n_finished_sessions; i++) {
+        milter_client_session_finished(client);
+    }
+    emit_sessions_finished(client, n_finished_sessions);
 
-    milter_agent_set_event_loop(agent, event_loop);
-    if (milter_agent_start(agent, &error)) {
-        g_signal_emit(client, signals[CONNECTION_ESTABLISHED], 0, context);
-        milter_event_loop_run(event_loop);
-    } else {
-        milter_error("[%u] [client][multi-thread][start][error] %s",
-                     milter_agent_get_tag(agent), error->message);
-        milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(client),
-                                    error);
-        g_error_free(error);
-        milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(context));
+    if (priv->quitting) {
+        g_mutex_lock(priv->quit_mutex);
+        if (priv->quitting && priv->n_processing_sessions == 0) {
+            milter_debug("[client][io-threads][loop][quit]");
+            milter_event_loop_quit(priv->event_loop);
+        }
+        g_mutex_unlock(priv->quit_mutex);
+    }
+
+    return TRUE;
+}
+
+static MilterClientIOThread *
+io_thread_new (MilterClient *client, guint id, GError **error)
+{
+    MilterClientIOThread *thread;
+
+    thread = g_new0(MilterClientIOThread, 1);
+    thread->client = client;
+    thread->id = id;
+    thread->wakeup_fd = -1;
+
+    if (!create_io_thread_pipe(&(thread->wakeup_channel),
+                               &(thread->wakeup_fd),
+                               error)) {
+        io_thread_free(thread);
+        return NULL;
     }
+    thread->queue = g_async_queue_new();
+    /* Don't emit "event-loop-created". Its handlers may add
+     * sources that must run in the main thread. */
+    thread->loop = create_event_loop(client, FALSE);
+    thread->wakeup_watch_id =
+        milter_event_loop_watch_io(thread->loop,
+                                   thread->wakeup_channel,
+                                   G_IO_IN | G_IO_PRI,
+                                   io_thread_wakeup_watch_func,
+                                   thread);
 
-    g_object_unref(event_loop);
+    return thread;
 }
 
 static gboolean
-multi_thread_start_accept (MilterClient *client, GError **error)
+start_io_threads (MilterClient *client, GError **error)
+{
+    MilterClientPrivate *priv;
+    MilterEventLoop *loop;
+    guint i, n_io_threads;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    n_io_threads = milter_client_get_n_io_threads(client);
+    if (n_io_threads == 0)
+        return TRUE;
+
+    loop = milter_client_get_event_loop(client);
+    if (!create_io_thread_pipe(&(priv->io_threads.notify_channel),
+                               &(priv->io_threads.notify_fd),
+                               error)) {
+        return FALSE;
+    }
+    priv->io_threads.notify_watch_id =
+        milter_event_loop_watch_io(loop,
+                                   priv->io_threads.notify_channel,
+                                   G_IO_IN | G_IO_PRI,
+                                   io_threads_notify_watch_func,
+                                   client);
+
+    priv->io_threads.threads = g_ptr_array_sized_new(n_io_threads);
+    for (i = 0; i < n_io_threads; i++) {
+        MilterClientIOThread *thread;
+        GError *local_error = NULL;
+
+        thread = io_thread_new(client, i + 1, error);
+        if (!thread) {
+            stop_io_threads(client);
+            return FALSE;
+        }
+        g_ptr_array_add(priv->io_threads.threads, thread);
+
+        g_signal_emit(client, signals[IO_THREAD_CREATED], 0, thread->loop);
+
+        thread->thread = g_thread_try_new("milter-io-thread",
+                                          io_thread_run,
+                                          thread,
+                                          &local_error);
+        if (!thread->thread) {
+            milter_error("[client][io-thread][start][error] <%u>: %s",
+                         thread->id, local_error->message);
+            milter_utils_set_error_with_sub_error(
+                error,
+                MILTER_CLIENT_ERROR,
+                MILTER_CLIENT_ERROR_THREAD,
+                local_error,
+                "failed to create an I/O thread: <%u>",
+                thread->id);
+            stop_io_threads(client);
+            return FALSE;
+        }
+    }
+
+    milter_info("[client][io-threads][run] <%u>", n_io_threads);
+    return TRUE;
+}
+
+static void
+stop_io_threads (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+    guint i;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+
+    if (priv->io_threads.threads) {
+        GPtrArray *threads = priv->io_threads.threads;
+
+        for (i = 0; i < threads->len; i++) {
+            MilterClientIOThread *thread = g_ptr_array_index(threads, i);
+
+            if (!thread->thread)
+                continue;
+            /* The thread quits its loop by itself because
+             * quitting a loop that isn't running yet is
+             * ignored. */
+            g_atomic_int_set(&(thread->quitting), TRUE);
+            wake_up_io_thread_pipe(thread->wakeup_fd);
+            g_thread_join(thread->thread);
+            thread->thread = NULL;
+        }
+        g_ptr_array_foreach(threads, (GFunc)io_thread_free, NULL);
+        g_ptr_array_free(threads, TRUE);
+        priv->io_threads.threads = NULL;
+    }
+
+    if (priv->io_threads.notify_watch_id > 0) {
+        milter_event_loop_remove(priv->event_loop,
+                                 priv->io_threads.notify_watch_id);
+        priv->io_threads.notify_watch_id = 0;
+    }
+    if (priv->io_threads.notify_channel) {
+        g_io_channel_unref(priv->io_threads.notify_channel);
+        priv->io_threads.notify_channel = NULL;
+    }
+    if (priv->io_threads.notify_fd != -1) {
+        close(priv->io_threads.notify_fd);
+        priv->io_threads.notify_fd = -1;
+    }
+    priv->io_threads.n_finished_sessions = 0;
+}
+
+/*
+ * Assigns an accepted connection to the I/O thread that
+ * processes the fewest sessions. The thread creates and
+ * starts a context for the connection on its own event loop.
+ */
+static void
+io_threads_process_client_channel (MilterClient *client, GIOChannel *channel,
+                                   MilterGenericSocketAddress *address,
+                                   socklen_t address_size)
 {
     MilterClientPrivate *priv;
-    gint max_threads = 10;
-    GError *local_error = NULL;
+    MilterClientIOThread *thread = NULL;
+    ClientChannelSetupData *data;
+    gint min_n_sessions = G_MAXINT;
+    guint i;
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
-    priv->worker_threads =
-        g_thread_pool_new(multi_thread_process_client_channel_thread,
-                          client,
-                          max_threads,
-                          FALSE,
-                          &local_error);
-    if (!priv->worker_threads) {
-        GError *client_error;
-        client_error = g_error_new(MILTER_CLIENT_ERROR,
-                                   MILTER_CLIENT_ERROR_THREAD,
-                                   "failed to create a thread pool "
-                                   "for processing accepted connection: %s",
-                                   local_error->message);
-        g_error_free(local_error);
-        milter_error("[client][multi-thread][accept][error] %s",
-                     client_error->message);
-        g_propagate_error(error, client_error);
-        return FALSE;
+    for (i = 0; i < priv->io_threads.threads->len; i++) {
+        MilterClientIOThread *candidate;
+        gint n_sessions;
+
+        candidate = g_ptr_array_index(priv->io_threads.threads, i);
+        n_sessions = g_atomic_int_get(&(candidate->n_sessions));
+        if (n_sessions < min_n_sessions) {
+            thread = candidate;
+            min_n_sessions = n_sessions;
+        }
     }
+    g_atomic_int_inc(&(thread->n_sessions));
 
-    milter_event_loop_run(priv->accept_loop);
-
-    g_thread_pool_free(priv->worker_threads, TRUE, TRUE);
-    priv->worker_threads = NULL;
+    data = g_new(ClientChannelSetupData, 1);
+    data->client = client;
+    data->channel = channel;
+    memcpy(&(data->address), address, address_size);
+    g_io_channel_ref(channel);
 
-    return TRUE;
+    milter_debug("[client][io-thread][assign] <%u>: <%d>",
+                 thread->id, min_n_sessions);
+    g_async_queue_push(thread->queue, data);
+    wake_up_io_thread_pipe(thread->wakeup_fd);
 }
 
-
 static GIOChannel *
 milter_client_listen_channel (MilterClient  *client, GError **error)
 {
@@ -1736,11 +2314,84 @@ milter_client_listen_channel (MilterClient  *client, GError **error)
     return channel;
 }
 
+static gboolean
+is_reuse_port_mode (MilterClient *client)
+{
+    const gchar *connection_spec;
+
+    if (milter_client_get_n_workers(client) == 0)
+        return FALSE;
+    if (!milter_client_is_reuse_port(client))
+        return FALSE;
+
+    connection_spec = milter_client_get_connection_spec(client);
+    if (!milter_connection_is_reuse_port_available(connection_spec)) {
+        milter_warning("[client][listen][reuse-port][unavailable] "
+                       "use a shared socket: <%s>",
+                       connection_spec);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * All sockets are created by the master process before
+ * forking workers because sockets in a SO_REUSEPORT group
+ * must be created by the same user. Privileges may be
+ * dropped before workers are forked.
+ */
+static gboolean
+milter_client_listen_reuse_port (MilterClient *client, GError **error)
+{
+    MilterClientPrivate *priv;
+    const gchar *connection_spec;
+    GPtrArray *channels;
+    guint i, n_workers;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+
+    dispose_address(priv);
+    dispose_worker_listen_channels(priv);
+
+    connection_spec = milter_client_get_connection_spec(client);
+    n_workers = milter_client_get_n_workers(client);
+    channels = g_ptr_array_sized_new(n_workers);
+    for (i = 0; i < n_workers; i++) {
+        GIOChannel *channel;
+
+        dispose_address(priv);
+        channel = milter_connection_listen_reuse_port(connection_spec,
+                                                      priv->listen_backlog,
+                                                      &(priv->address),
+                                                      &(priv->address_size),
+                                                      error);
+        if (!channel) {
+            g_ptr_array_foreach(channels, (GFunc)g_io_channel_unref, NULL);
+            g_ptr_array_free(channels, TRUE);
+            return FALSE;
+        }
+        g_ptr_array_add(channels, channel);
+    }
+
+    milter_info("[client][listen][reuse-port] <%s>: <%u>",
+                connection_spec, n_workers);
+    g_signal_emit(client, signals[LISTEN_STARTED], 0,
+                  priv->address, priv->address_size);
+
+    priv->workers.listen_channels = channels;
+    milter_client_set_listen_channel(client, g_ptr_array_index(channels, 0));
+    return TRUE;
+}
+
 gboolean
 milter_client_listen (MilterClient  *client, GError **error)
 {
     GIOChannel *channel;
 
+    if (is_reuse_port_mode(client))
+        return milter_client_listen_reuse_port(client, error);
+
     channel = milter_client_listen_channel(client, error);
     if (!channel)
         return FALSE;
@@ -1991,6 +2642,48 @@ accept_error_watch_func (GIOChannel *channel, GIOCondition condition,
     return FALSE;
 }
 
+static gboolean
+cb_check_event_loop_lag (gpointer user_data)
+{
+    MilterClientPrivate *priv;
+    gdouble lag;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(user_data);
+    lag = g_timer_elapsed(priv->lag_timer, NULL) - LAG_CHECK_INTERVAL;
+    milter_client_concurrency_limiter_record_lag(priv->concurrency_limiter,
+                                                 MAX(lag, 0.0));
+    g_timer_start(priv->lag_timer);
+
+    return TRUE;
+}
+
+static void
+start_concurrency_limiter (MilterClient *client, MilterEventLoop *accept_loop,
+                           GIOFunc accept_func, gint accept_priority)
+{
+    MilterClientPrivate *priv;
+    guint max_connections;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    priv->accept_watch_loop = accept_loop;
+    priv->accept_watch_func = accept_func;
+    priv->accept_watch_priority = accept_priority;
+
+    dispose_concurrency_limiter(priv);
+    if (!milter_client_is_adaptive_max_connections(client))
+        return;
+
+    max_connections = milter_client_get_max_connections(client);
+    priv->concurrency_limiter =
+        milter_client_concurrency_limiter_new(max_connections);
+    priv->lag_timer = g_timer_new();
+    priv->lag_check_id =
+        milter_event_loop_add_timeout(milter_client_get_event_loop(client),
+                                      LAG_CHECK_INTERVAL,
+                                      cb_check_event_loop_lag,
+                                      client);
+}
+
 static gboolean
 milter_client_prepare (MilterClient *client, MilterEventLoop *loop,
                        GIOFunc accept_func, GError **error)
@@ -2027,6 +2720,7 @@ milter_client_prepare (MilterClient *client, MilterEventLoop *loop,
         return FALSE;
     }
 
+    start_concurrency_limiter(client, loop, accept_func, G_PRIORITY_DEFAULT);
     priv->accept_watch_id =
         milter_event_loop_watch_io(loop,
                                    priv->listening_channel,
@@ -2127,6 +2821,95 @@ worker_watch_master (GIOChannel   *source,
     return TRUE;
 }
 
+static void
+setup_worker_accepts (MilterClientPrivate *priv, guint n_workers)
+{
+    gpointer n_accepts;
+
+    /* Anonymous shared memory is inherited by workers. */
+    n_accepts = mmap(NULL, sizeof(gint) * n_workers, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (n_accepts == MAP_FAILED) {
+        milter_warning("[client][workers][accepts][mmap][error] %s",
+                       g_strerror(errno));
+        return;
+    }
+
+    priv->workers.n_accepts = n_accepts;
+    priv->workers.n_accepts_length = n_workers;
+}
+
+static void
+report_worker_accepts (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+    GString *report;
+    guint i;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    report = g_string_new(NULL);
+    for (i = 0; i < priv->workers.n_accepts_length; i++) {
+        g_string_append_printf(report, " <%u>=<%u>",
+                               i + 1,
+                               milter_client_get_worker_n_accepts(client,
+                                                                  i + 1));
+    }
+    milter_statistics("[client][workers][accepts]%s", report->str);
+    g_string_free(report, TRUE);
+}
+
+static gboolean
+cb_report_worker_accepts (gpointer user_data)
+{
+    report_worker_accepts(user_data);
+    return TRUE;
+}
+
+static void
+pin_worker (MilterClient *client)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+    MilterClientPrivate *priv;
+    cpu_set_t available_cpus, cpus;
+    gint cpu, n_available_cpus, nth;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+
+    if (sched_getaffinity(0, sizeof(available_cpus), &available_cpus) == -1) {
+        milter_warning("[client][worker][pin][error] "
+                       "failed to get available CPUs: %s",
+                       g_strerror(errno));
+        return;
+    }
+
+    n_available_cpus = CPU_COUNT(&available_cpus);
+    if (n_available_cpus == 0)
+        return;
+
+    nth = (priv->workers.id - 1) % n_available_cpus;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &available_cpus))
+            continue;
+        if (nth == 0)
+            break;
+        nth--;
+    }
+
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+        milter_warning("[client][worker][pin][error] <%u>: <%d>: %s",
+                       priv->workers.id, cpu, g_strerror(errno));
+        return;
+    }
+
+    milter_info("[client][worker][pin] <%u>: <%d>", priv->workers.id, cpu);
+#else
+    milter_warning("[client][worker][pin][unsupported] "
+                   "sched_setaffinity() isn't available");
+#endif
+}
+
 static gboolean
 client_run_workers (MilterClient *client, guint n_workers, GError **error)
 {
@@ -2158,6 +2941,7 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
     }
 
     priv->workers.pids = g_array_new(TRUE, TRUE, sizeof(GPid));
+    setup_worker_accepts(priv, n_workers);
 
     for (i = 0; i < n_workers; ++i) {
         GPid pid = milter_client_fork(client);
@@ -2166,6 +2950,15 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
             close(pipe_fds[MILTER_UTILS_WRITE_PIPE]);
             priv->workers.control = setup_client_channel(pipe_fds[MILTER_UTILS_READ_PIPE]);
             priv->workers.id = i + 1;
+            if (priv->workers.listen_channels) {
+                GPtrArray *channels = priv->workers.listen_channels;
+                milter_client_set_listen_channel(
+                    client,
+                    g_ptr_array_index(channels, i % channels->len));
+                dispose_worker_listen_channels(priv);
+            }
+            if (milter_client_is_pin_workers(client))
+                pin_worker(client);
             milter_event_loop_watch_io(loop, priv->workers.control,
                                        G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
                                        worker_watch_master, client);
@@ -2191,6 +2984,20 @@ client_run_workers (MilterClient *client, guint n_workers, GError **error)
     close(pipe_fds[MILTER_UTILS_READ_PIPE]);
     priv->workers.control = setup_client_channel(pipe_fds[MILTER_UTILS_WRITE_PIPE]);
 
+    if (priv->workers.listen_channels) {
+        /* Each socket is owned by its worker. */
+        dispose_worker_listen_channels(priv);
+        milter_client_set_listen_channel(client, NULL);
+    }
+
+    if (priv->workers.n_accepts) {
+        priv->workers.report_id =
+            milter_event_loop_add_timeout(loop,
+                                          WORKER_ACCEPTS_REPORT_INTERVAL,
+                                          cb_report_worker_accepts,
+                                          client);
+    }
+
     milter_info("[client][workers][run] <%d>", n_workers);
     return TRUE;
 }
@@ -2207,7 +3014,13 @@ single_thread_single_loop_accept_connection (MilterClient *client,
     accepted = accept_connection(client, server_fd, &client_channel,
                                  &address, &address_size);
     if (accepted) {
-        single_thread_client_channel_setup(client, client_channel, &address);
+        if (MILTER_CLIENT_GET_PRIVATE(client)->io_threads.threads) {
+            io_threads_process_client_channel(client, client_channel,
+                                              &address, address_size);
+        } else {
+            single_thread_client_channel_setup(client, client_channel,
+                                               &address);
+        }
         g_io_channel_unref(client_channel);
     }
 
@@ -2262,15 +3075,6 @@ milter_client_run_loop (MilterClient *client, GError **error)
         }
         g_signal_emit(client, signals[WORKERS_CREATED], 0, n_workers);
         success = run_master(client, error);
-    } else if (priv->multi_thread_mode) {
-        priv->accept_loop = milter_client_create_event_loop(client, FALSE);
-        if (!milter_client_prepare(client,
-                                   priv->accept_loop,
-                                   multi_thread_accept_watch_func,
-                                   error)) {
-            return FALSE;
-        }
-        success = multi_thread_start_accept(client, error);
     } else {
         const gchar *use_accept_loop_env;
         gboolean use_accept_loop = FALSE;
@@ -2284,6 +3088,9 @@ milter_client_run_loop (MilterClient *client, GError **error)
             }
         }
 
+        if (!start_io_threads(client, error))
+            return FALSE;
+
         if (use_accept_loop) {
             milter_debug("[client][single-thread][accept-loop]");
             if (!priv->accept_loop)
@@ -2300,6 +3107,8 @@ milter_client_run_loop (MilterClient *client, GError **error)
             milter_debug("[client][single-thread][single-loop]");
             success = single_thread_single_loop_run(client, error);
         }
+
+        stop_io_threads(client);
     }
 
     return success;
@@ -2429,7 +3238,14 @@ worker_accept_watch_func (GIOChannel *channel, GIOCondition condition,
     if (client_fd == -1) {
         keep_callback = errno == EAGAIN;
     } else {
+        MilterClientPrivate *priv;
         GIOChannel *client_channel;
+
+        priv = MILTER_CLIENT_GET_PRIVATE(client);
+        if (priv->workers.n_accepts &&
+            priv->workers.id <= priv->workers.n_accepts_length) {
+            g_atomic_int_inc(priv->workers.n_accepts + priv->workers.id - 1);
+        }
         client_channel = setup_client_channel(client_fd);
         single_thread_process_client_channel(client, client_channel,
                                              &address, (socklen_t)address_size);
@@ -2476,6 +3292,8 @@ run_worker (MilterClient *client, GError **error)
 
     priv->quitting = FALSE;
     loop = milter_client_get_event_loop(client);
+    start_concurrency_limiter(client, loop, worker_accept_watch_func,
+                              G_PRIORITY_HIGH);
     priv->accept_watch_id =
         milter_event_loop_watch_io_full(loop,
                                         G_PRIORITY_HIGH,
@@ -2492,7 +3310,10 @@ run_worker (MilterClient *client, GError **error)
                                         accept_error_watch_func,
                                         client,
                                         NULL);
+    if (!start_io_threads(client, error))
+        return FALSE;
     milter_event_loop_run(loop);
+    stop_io_threads(client);
 
     return TRUE;
 }
@@ -2515,6 +3336,12 @@ milter_client_shutdown (MilterClient *client)
             g_io_channel_unref(priv->workers.control);
             priv->workers.control = NULL;
         }
+        if (priv->workers.report_id > 0) {
+            report_worker_accepts(client);
+            milter_event_loop_remove(priv->event_loop,
+                                     priv->workers.report_id);
+            priv->workers.report_id = 0;
+        }
         if (priv->listening_channel) {
             g_io_channel_unref(priv->listening_channel);
             priv->listening_channel = NULL;
@@ -2979,13 +3806,9 @@ milter_client_get_event_loop (MilterClient *client)
 
     priv = MILTER_CLIENT_GET_PRIVATE(client);
 
-    if (priv->multi_thread_mode) {
-        return NULL;
-    } else {
-        if (!priv->event_loop)
-            priv->event_loop = milter_client_create_event_loop(client, TRUE);
-        return priv->event_loop;
-    }
+    if (!priv->event_loop)
+        priv->event_loop = milter_client_create_event_loop(client, TRUE);
+    return priv->event_loop;
 }
 
 static MilterClientEventLoopBackend
@@ -3286,6 +4109,192 @@ milter_client_get_worker_pids (MilterClient  *client)
     return klass->get_worker_pids(client);
 }
 
+static gboolean
+is_adaptive_max_connections (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->adaptive_max_connections;
+}
+
+gboolean
+milter_client_is_adaptive_max_connections (MilterClient *client)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    return klass->is_adaptive_max_connections(client);
+}
+
+static void
+set_adaptive_max_connections (MilterClient *client, gboolean adaptive)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->adaptive_max_connections = adaptive;
+}
+
+void
+milter_client_set_adaptive_max_connections (MilterClient *client,
+                                            gboolean      adaptive)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    klass->set_adaptive_max_connections(client, adaptive);
+}
+
+static gboolean
+is_reuse_port (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->reuse_port;
+}
+
+gboolean
+milter_client_is_reuse_port (MilterClient *client)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    return klass->is_reuse_port(client);
+}
+
+static void
+set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->reuse_port = reuse_port;
+}
+
+void
+milter_client_set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    klass->set_reuse_port(client, reuse_port);
+}
+
+static gboolean
+is_pin_workers (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->pin_workers;
+}
+
+gboolean
+milter_client_is_pin_workers (MilterClient *client)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    return klass->is_pin_workers(client);
+}
+
+static void
+set_pin_workers (MilterClient *client, gboolean pin_workers)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->pin_workers = pin_workers;
+}
+
+void
+milter_client_set_pin_workers (MilterClient *client, gboolean pin_workers)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    klass->set_pin_workers(client, pin_workers);
+}
+
+static guint
+get_n_io_threads (MilterClient *client)
+{
+    return MILTER_CLIENT_GET_PRIVATE(client)->n_io_threads;
+}
+
+guint
+milter_client_get_n_io_threads (MilterClient *client)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    return klass->get_n_io_threads(client);
+}
+
+static void
+set_n_io_threads (MilterClient *client, guint n_io_threads)
+{
+    MILTER_CLIENT_GET_PRIVATE(client)->n_io_threads = n_io_threads;
+}
+
+void
+milter_client_set_n_io_threads (MilterClient *client, guint n_io_threads)
+{
+    MilterClientClass *klass;
+
+    klass = MILTER_CLIENT_GET_CLASS(client);
+    klass->set_n_io_threads(client, n_io_threads);
+}
+
+guint
+milter_client_get_io_thread_n_sessions (MilterClient *client,
+                                        guint io_thread_id)
+{
+    MilterClientPrivate *priv;
+    MilterClientIOThread *thread;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->io_threads.threads)
+        return 0;
+    if (io_thread_id == 0 || io_thread_id > priv->io_threads.threads->len)
+        return 0;
+    thread = g_ptr_array_index(priv->io_threads.threads, io_thread_id - 1);
+    return g_atomic_int_get(&(thread->n_sessions));
+}
+
+guint
+milter_client_get_worker_n_accepts (MilterClient *client, guint worker_id)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->workers.n_accepts)
+        return 0;
+    if (worker_id == 0 || worker_id > priv->workers.n_accepts_length)
+        return 0;
+    return g_atomic_int_get(priv->workers.n_accepts + worker_id - 1);
+}
+
+guint
+milter_client_get_connection_limit (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (priv->concurrency_limiter)
+        return milter_client_concurrency_limiter_get_limit(
+            priv->concurrency_limiter);
+    return milter_client_get_max_connections(client);
+}
+
+gdouble
+milter_client_get_session_latency (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->concurrency_limiter)
+        return 0.0;
+    return milter_client_concurrency_limiter_get_latency(
+        priv->concurrency_limiter);
+}
+
+gdouble
+milter_client_get_event_loop_lag (MilterClient *client)
+{
+    MilterClientPrivate *priv;
+
+    priv = MILTER_CLIENT_GET_PRIVATE(client);
+    if (!priv->concurrency_limiter)
+        return 0.0;
+    return milter_client_concurrency_limiter_get_lag(
+        priv->concurrency_limiter);
+}
+
 
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
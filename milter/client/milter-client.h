@@ -64,6 +64,13 @@ G_BEGIN_DECLS
  */
 #define MILTER_CLIENT_MAX_N_WORKERS 1000
 
+/**
+ * MILTER_CLIENT_MAX_N_IO_THREADS:
+ *
+ * The maximum number of I/O threads.
+ */
+#define MILTER_CLIENT_MAX_N_IO_THREADS 256
+
 /**
  * MILTER_CLIENT_ERROR:
  *
@@ -207,6 +214,22 @@ struct _MilterClientClass
                                            guint         n_workers);
     void   (*worker_created)              (MilterClient *client);
     GArray *(*get_worker_pids)            (MilterClient *client);
+    gboolean (*is_adaptive_max_connections)
+                                          (MilterClient *client);
+    void   (*set_adaptive_max_connections)
+                                          (MilterClient *client,
+                                           gboolean      adaptive);
+    gboolean (*is_reuse_port)             (MilterClient *client);
+    void   (*set_reuse_port)              (MilterClient *client,
+                                           gboolean      reuse_port);
+    gboolean (*is_pin_workers)            (MilterClient *client);
+    void   (*set_pin_workers)             (MilterClient *client,
+                                           gboolean      pin_workers);
+    guint  (*get_n_io_threads)            (MilterClient *client);
+    void   (*set_n_io_threads)            (MilterClient *client,
+                                           guint         n_io_threads);
+    void   (*io_thread_created)           (MilterClient *client,
+                                           MilterEventLoop *loop);
 };
 
 GQuark               milter_client_error_quark       (void);
@@ -703,7 +726,8 @@ void                 milter_client_shutdown          (MilterClient  *client);
  * @user_data: user data to pass to the function.
  *
  * Calls a function for each processing
- * %MilterClientContext.
+ * %MilterClientContext. Contexts processed in I/O threads
+ * aren't included. See milter_client_get_n_io_threads().
  */
 void                 milter_client_processing_context_foreach
                                                      (MilterClient  *client,
@@ -1046,6 +1070,197 @@ void                 milter_client_set_max_pending_finished_sessions
 
 GArray              *milter_client_get_worker_pids   (MilterClient  *client);
 
+/**
+ * milter_client_is_adaptive_max_connections:
+ * @client: a %MilterClient.
+ *
+ * Gets whether the limit of connections is adjusted
+ * automatically. If it is %TRUE, the limit is decreased
+ * when the session latency or the event loop lag grows
+ * and increased while sessions finish as fast as usual.
+ * milter_client_get_max_connections() is the upper bound
+ * of the limit. When the limit is reached, new connections
+ * wait in the listen backlog instead of suspending the
+ * process for milter_client_get_suspend_time_on_unacceptable()
+ * seconds.
+ *
+ * Returns: %TRUE if the limit is adjusted automatically.
+ */
+gboolean             milter_client_is_adaptive_max_connections
+                                                     (MilterClient  *client);
+
+/**
+ * milter_client_set_adaptive_max_connections:
+ * @client: a %MilterClient.
+ * @adaptive: whether the limit of connections is adjusted
+ *            automatically.
+ *
+ * Sets whether the limit of connections is adjusted
+ * automatically. See
+ * milter_client_is_adaptive_max_connections() for more
+ * details.
+ */
+void                 milter_client_set_adaptive_max_connections
+                                                     (MilterClient  *client,
+                                                      gboolean       adaptive);
+
+/**
+ * milter_client_get_connection_limit:
+ * @client: a %MilterClient.
+ *
+ * Gets the current limit of connections. It is the
+ * adjusted limit when
+ * milter_client_is_adaptive_max_connections() is %TRUE.
+ *
+ * Returns: the current limit of connections. 0 means 'no
+ * limit'.
+ */
+guint                milter_client_get_connection_limit
+                                                     (MilterClient  *client);
+
+/**
+ * milter_client_get_session_latency:
+ * @client: a %MilterClient.
+ *
+ * Gets the recent session latency used to adjust the limit
+ * of connections.
+ *
+ * Returns: the recent session latency in seconds. 0 when
+ * the limit isn't adjusted automatically.
+ */
+gdouble              milter_client_get_session_latency
+                                                     (MilterClient  *client);
+
+/**
+ * milter_client_get_event_loop_lag:
+ * @client: a %MilterClient.
+ *
+ * Gets the last lag of the event loop used to adjust the
+ * limit of connections.
+ *
+ * Returns: the lag in seconds. 0 when the limit isn't
+ * adjusted automatically.
+ */
+gdouble              milter_client_get_event_loop_lag
+                                                     (MilterClient  *client);
+
+/**
+ * milter_client_is_reuse_port:
+ * @client: a %MilterClient.
+ *
+ * Gets whether each worker process listens its own socket
+ * bound with SO_REUSEPORT. If it is %TRUE, the kernel
+ * distributes new connections to workers instead of waking
+ * up all workers that watch the shared socket. It is used
+ * only when milter_client_get_n_workers() is 1 or more and
+ * the connection spec is inet or inet6. The shared socket
+ * is used otherwise.
+ *
+ * Returns: %TRUE if each worker listens its own socket.
+ */
+gboolean             milter_client_is_reuse_port     (MilterClient  *client);
+
+/**
+ * milter_client_set_reuse_port:
+ * @client: a %MilterClient.
+ * @reuse_port: whether each worker process listens its
+ *              own socket.
+ *
+ * Sets whether each worker process listens its own socket
+ * bound with SO_REUSEPORT. See
+ * milter_client_is_reuse_port() for more details.
+ */
+void                 milter_client_set_reuse_port    (MilterClient  *client,
+                                                      gboolean       reuse_port);
+
+/**
+ * milter_client_is_pin_workers:
+ * @client: a %MilterClient.
+ *
+ * Gets whether each worker process is pinned to a CPU. The
+ * Nth worker is pinned to the Nth CPU that is available for
+ * the master process. It is ignored on systems that don't
+ * support sched_setaffinity().
+ *
+ * Returns: %TRUE if each worker process is pinned to a CPU.
+ */
+gboolean             milter_client_is_pin_workers    (MilterClient  *client);
+
+/**
+ * milter_client_set_pin_workers:
+ * @client: a %MilterClient.
+ * @pin_workers: whether each worker process is pinned to a
+ *               CPU.
+ *
+ * Sets whether each worker process is pinned to a CPU. See
+ * milter_client_is_pin_workers() for more details.
+ */
+void                 milter_client_set_pin_workers   (MilterClient  *client,
+                                                      gboolean       pin_workers);
+
+/**
+ * milter_client_get_worker_n_accepts:
+ * @client: a %MilterClient.
+ * @worker_id: the ID of a worker process. See
+ *             milter_client_get_worker_id().
+ *
+ * Gets the number of connections accepted by the worker
+ * process. The counts are shared between the master
+ * process and worker processes. The master process logs
+ * them as statistics log periodically.
+ *
+ * Returns: the number of accepted connections. 0 when
+ * @worker_id is unknown.
+ */
+guint                milter_client_get_worker_n_accepts
+                                                     (MilterClient  *client,
+                                                      guint          worker_id);
+
+/**
+ * milter_client_get_n_io_threads:
+ * @client: a %MilterClient.
+ *
+ * Gets the number of I/O threads. If it is 1 or more,
+ * accepted connections are processed in the I/O threads
+ * instead of the main event loop. Each I/O thread runs its
+ * own event loop and a new connection is assigned to the
+ * I/O thread that processes the fewest sessions. Each
+ * worker process has its own I/O threads.
+ *
+ * "connection-established" is emitted in the I/O thread
+ * that processes the connection. "sessions-finished" and
+ * "maintain" are still emitted in the main thread.
+ *
+ * Returns: the number of I/O threads. 0 means that all
+ * connections are processed in the main event loop.
+ */
+guint                milter_client_get_n_io_threads  (MilterClient  *client);
+
+/**
+ * milter_client_set_n_io_threads:
+ * @client: a %MilterClient.
+ * @n_io_threads: the number of I/O threads.
+ *
+ * Sets the number of I/O threads. See
+ * milter_client_get_n_io_threads() for more details.
+ */
+void                 milter_client_set_n_io_threads  (MilterClient  *client,
+                                                      guint          n_io_threads);
+
+/**
+ * milter_client_get_io_thread_n_sessions:
+ * @client: a %MilterClient.
+ * @io_thread_id: the ID of an I/O thread. It starts from 1.
+ *
+ * Gets the number of sessions assigned to the I/O thread.
+ *
+ * Returns: the number of sessions. 0 when @io_thread_id is
+ * unknown or I/O threads aren't running.
+ */
+guint                milter_client_get_io_thread_n_sessions
+                                                     (MilterClient  *client,
+                                                      guint          io_thread_id);
+
 G_END_DECLS
 
 #endif /* __MILTER_CLIENT_CLIENT_H__ */
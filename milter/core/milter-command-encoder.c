@@ -351,15 +351,16 @@ milter_command_encoder_encode_body (MilterCommandEncoder *encoder,
 {
     MilterEncoder *base_encoder;
     GString *buffer;
-    gsize packed_chunk_size;
+    gsize packed_chunk_size, max_data_size;
 
     base_encoder = MILTER_ENCODER(encoder);
     milter_encoder_clear_buffer(base_encoder);
     buffer = milter_encoder_get_buffer(base_encoder);
 
     g_string_append_c(buffer, MILTER_COMMAND_BODY);
-    if (size > MILTER_CHUNK_SIZE)
-        packed_chunk_size = MILTER_CHUNK_SIZE;
+    max_data_size = milter_encoder_get_max_data_size(base_encoder);
+    if (size > max_data_size)
+        packed_chunk_size = max_data_size;
     else
         packed_chunk_size = size;
     g_string_append_len(buffer, chunk, packed_chunk_size);
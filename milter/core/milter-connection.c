@@ -327,11 +327,11 @@ milter_connection_parse_spec (const gchar      *spec,
     return TRUE;
 }
 
-GIOChannel *
-milter_connection_listen (const gchar *spec, gint backlog,
-                          struct sockaddr **address, socklen_t *address_size,
-                          gboolean remove_unix_socket,
-                          GError **error)
+static GIOChannel *
+listen_socket (const gchar *spec, gint backlog,
+               struct sockaddr **address, socklen_t *address_size,
+               gboolean remove_unix_socket, gboolean reuse_port,
+               GError **error)
 {
     GIOChannel *socket_channel;
     gint fd;
@@ -386,6 +386,22 @@ milter_connection_listen (const gchar *spec, gint backlog,
         return NULL;
     }
 
+    if (reuse_port) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT,
+                       &reuse_address, sizeof(reuse_address)) == -1) {
+            g_set_error(error,
+                        MILTER_CONNECTION_ERROR,
+                        MILTER_CONNECTION_ERROR_SET_SOCKET_OPTION_FAILURE,
+                        "failed to setsockopt(SO_REUSEPORT): %s: %s",
+                        spec, g_strerror(errno));
+            g_free(local_address);
+            close(fd);
+            return NULL;
+        }
+#endif
+    }
+
     if (bind(fd, local_address, local_address_size) == -1) {
         g_set_error(error,
                     MILTER_CONNECTION_ERROR,
@@ -423,6 +439,54 @@ milter_connection_listen (const gchar *spec, gint backlog,
     return socket_channel;
 }
 
+GIOChannel *
+milter_connection_listen (const gchar *spec, gint backlog,
+                          struct sockaddr **address, socklen_t *address_size,
+                          gboolean remove_unix_socket,
+                          GError **error)
+{
+    return listen_socket(spec, backlog, address, address_size,
+                         remove_unix_socket, FALSE, error);
+}
+
+gboolean
+milter_connection_is_reuse_port_available (const gchar *spec)
+{
+#ifdef SO_REUSEPORT
+    gint domain;
+    struct sockaddr *address;
+    socklen_t address_size;
+
+    if (!milter_connection_parse_spec(spec, &domain,
+                                      &address, &address_size,
+                                      NULL))
+        return FALSE;
+    g_free(address);
+
+    return domain == PF_INET || domain == PF_INET6;
+#else
+    return FALSE;
+#endif
+}
+
+GIOChannel *
+milter_connection_listen_reuse_port (const gchar *spec, gint backlog,
+                                     struct sockaddr **address,
+                                     socklen_t *address_size,
+                                     GError **error)
+{
+    if (!milter_connection_is_reuse_port_available(spec)) {
+        g_set_error(error,
+                    MILTER_CONNECTION_ERROR,
+                    MILTER_CONNECTION_ERROR_SET_SOCKET_OPTION_FAILURE,
+                    "SO_REUSEPORT isn't available: <%s>", spec);
+        return NULL;
+    }
+
+    return listen_socket(spec, backlog, address, address_size,
+                         FALSE, TRUE, error);
+}
+
 
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
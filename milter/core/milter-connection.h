@@ -72,6 +72,24 @@ GIOChannel      *milter_connection_listen      (const gchar      *spec,
                                                 socklen_t        *address_size,
                                                 gboolean          remove_unix_socket,
                                                 GError          **error);
+/*
+ * Returns TRUE if @spec is an inet or inet6 spec and the
+ * system supports SO_REUSEPORT.
+ */
+gboolean         milter_connection_is_reuse_port_available
+                                               (const gchar      *spec);
+/*
+ * Same as milter_connection_listen() but the socket is
+ * bound with SO_REUSEPORT. Each process can listen its own
+ * socket on the same address and the kernel distributes
+ * new connections to them.
+ */
+GIOChannel      *milter_connection_listen_reuse_port
+                                               (const gchar      *spec,
+                                                gint              backlog,
+                                                struct sockaddr **address,
+                                                socklen_t        *address_size,
+                                                GError          **error);
 gchar           *milter_connection_address_to_spec
                                                (const struct sockaddr *address);
 
@@ -34,6 +34,7 @@
 #include "milter-decoder.h"
 #include "milter-enum-types.h"
 #include "milter-marshalers.h"
+#include "milter-probes.h"
 
 #define COMMAND_LENGTH_BYTES (sizeof(guint32))
 
@@ -405,6 +406,11 @@ milter_decoder_decode (MilterDecoder *decoder, const gchar *chunk, gsize size,
                 milter_trace("[%u] [decoder][decode][content][fill] "
                              "<%d> (%" G_GSIZE_FORMAT ")",
                              priv->tag, priv->command_length, priv->buffer->len);
+                MILTER_PROBE3(decode,
+                              priv->tag,
+                              priv->command_length > 0 ?
+                                priv->buffer->str[0] : '\0',
+                              priv->command_length);
                 g_signal_emit(decoder, signals[DECODE], 0, error, &success);
                 if (success) {
                     priv->state = IN_START;
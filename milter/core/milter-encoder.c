@@ -47,6 +47,7 @@ struct _MilterEncoderPrivate
 {
     GString *buffer;
     guint tag;
+    gsize max_data_size;
 };
 
 enum
@@ -97,6 +98,7 @@ milter_encoder_init (MilterEncoder *encoder)
     priv = MILTER_ENCODER_GET_PRIVATE(encoder);
     priv->buffer = g_string_new(NULL);
     priv->tag = 0;
+    priv->max_data_size = MILTER_CHUNK_SIZE;
 }
 
 static void
@@ -225,6 +227,24 @@ milter_encoder_set_tag (MilterEncoder *encoder, guint tag)
     MILTER_ENCODER_GET_PRIVATE(encoder)->tag = tag;
 }
 
+gsize
+milter_encoder_get_max_data_size (MilterEncoder *encoder)
+{
+    return MILTER_ENCODER_GET_PRIVATE(encoder)->max_data_size;
+}
+
+void
+milter_encoder_set_max_data_size (MilterEncoder *encoder, gsize size)
+{
+    MilterEncoderPrivate *priv;
+
+    priv = MILTER_ENCODER_GET_PRIVATE(encoder);
+    if (size == 0)
+        priv->max_data_size = MILTER_CHUNK_SIZE;
+    else
+        priv->max_data_size = size;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
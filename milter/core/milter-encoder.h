@@ -68,6 +68,12 @@ guint            milter_encoder_get_tag        (MilterEncoder *encoder);
 void             milter_encoder_set_tag        (MilterEncoder *encoder,
                                                 guint          tag);
 
+gsize            milter_encoder_get_max_data_size
+                                               (MilterEncoder *encoder);
+void             milter_encoder_set_max_data_size
+                                               (MilterEncoder *encoder,
+                                                gsize          size);
+
 G_END_DECLS
 
 #endif /* __MILTER_ENCODER_H__ */
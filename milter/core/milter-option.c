@@ -22,6 +22,7 @@
 #endif /* HAVE_CONFIG_H */
 
 #include "milter-option.h"
+#include "milter-protocol.h"
 #include "milter-utils.h"
 #include "milter-enum-types.h"
 
@@ -293,6 +294,20 @@ milter_option_get_step_yes (MilterOption *option)
     return milter_option_get_step(option) & MILTER_STEP_YES_MASK;
 }
 
+gsize
+milter_option_get_max_data_size (MilterOption *option)
+{
+    MilterStepFlags step;
+
+    step = milter_option_get_step(option);
+    if (step & MILTER_STEP_MAX_DATA_SIZE_1M)
+        return MILTER_MAX_DATA_SIZE_1M;
+    else if (step & MILTER_STEP_MAX_DATA_SIZE_256K)
+        return MILTER_MAX_DATA_SIZE_256K;
+    else
+        return MILTER_CHUNK_SIZE;
+}
+
 void
 milter_option_set_step (MilterOption *option, MilterStepFlags step)
 {
@@ -360,6 +375,7 @@ milter_step_flags_merge (MilterStepFlags dest, MilterStepFlags src)
 {
     MilterStepFlags dest_no_step_flags;
     MilterStepFlags dest_yes_step_flags;
+    MilterStepFlags dest_max_data_size_step_flags;
 
     dest_no_step_flags = dest & MILTER_STEP_NO_MASK;
     dest_no_step_flags &= (src & MILTER_STEP_NO_MASK);
@@ -367,7 +383,11 @@ milter_step_flags_merge (MilterStepFlags dest, MilterStepFlags src)
     dest_yes_step_flags = dest & MILTER_STEP_YES_MASK;
     dest_yes_step_flags |= (src & MILTER_STEP_YES_MASK);
 
-    return dest_no_step_flags | dest_yes_step_flags;
+    dest_max_data_size_step_flags = dest & MILTER_STEP_MAX_DATA_SIZE_MASK;
+    dest_max_data_size_step_flags |= (src & MILTER_STEP_MAX_DATA_SIZE_MASK);
+
+    return dest_no_step_flags | dest_yes_step_flags |
+        dest_max_data_size_step_flags;
 }
 
 gchar *
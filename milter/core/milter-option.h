@@ -99,7 +99,11 @@ typedef enum
     /* No reply for body chunk */
     MILTER_STEP_NO_REPLY_BODY =          0x00080000L,
     /* header value with leading space */
-    MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE = 0x00100000L
+    MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE = 0x00100000L,
+    /* data (body chunk and so on) size can be up to 256KB */
+    MILTER_STEP_MAX_DATA_SIZE_256K =     0x10000000L,
+    /* data (body chunk and so on) size can be up to 1MB */
+    MILTER_STEP_MAX_DATA_SIZE_1M =       0x20000000L
 } MilterStepFlags;
 
 #define MILTER_STEP_NO_EVENT_MASK               \
@@ -132,6 +136,9 @@ typedef enum
      MILTER_STEP_ENVELOPE_RECIPIENT_REJECTED |          \
      MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE)
 
+#define MILTER_STEP_MAX_DATA_SIZE_MASK          \
+    (MILTER_STEP_MAX_DATA_SIZE_256K |           \
+     MILTER_STEP_MAX_DATA_SIZE_1M)
 
 MilterStepFlags milter_step_flags_merge (MilterStepFlags a, MilterStepFlags b);
 
@@ -176,6 +183,7 @@ MilterStepFlags    milter_option_get_step_no_event (MilterOption      *option);
 MilterStepFlags    milter_option_get_step_no_reply (MilterOption      *option);
 MilterStepFlags    milter_option_get_step_no       (MilterOption      *option);
 MilterStepFlags    milter_option_get_step_yes      (MilterOption      *option);
+gsize              milter_option_get_max_data_size (MilterOption      *option);
 void               milter_option_set_step          (MilterOption      *option,
                                                     MilterStepFlags    step);
 void               milter_option_add_step          (MilterOption      *option,
@@ -0,0 +1,68 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_PROBES_H__
+#define __MILTER_PROBES_H__
+
+/*
+ * Static probes for SystemTap/DTrace/bpftrace. They are
+ * enabled by --enable-probes. All probes are registered
+ * under the "milter_manager" provider. A probe is a nop
+ * instruction until a tracer attaches to it. All probes
+ * expand to nothing without --enable-probes.
+ *
+ * Probes:
+ *   read(tag, n_bytes)
+ *   write(tag, n_bytes, n_remained_bytes)
+ *   decode(tag, command, length)
+ *   child__send(tag, child_name, command)
+ *   child__reply(tag, child_name, status)
+ *   child__timeout(tag, child_name, state)
+ *   session__start(tag)
+ *   session__finish(tag, state)
+ *   session__disconnect(tag)
+ *
+ * Example:
+ *   % sudo bpftrace -e \
+ *       'usdt:/usr/lib/libmilter-core.so:milter_manager:read
+ *          { @bytes = hist(arg1); }'
+ */
+
+#ifdef MILTER_ENABLE_PROBES
+#  include <sys/sdt.h>
+#  define MILTER_PROBE0(name)                                   \
+    DTRACE_PROBE(milter_manager, name)
+#  define MILTER_PROBE1(name, a1)                               \
+    DTRACE_PROBE1(milter_manager, name, a1)
+#  define MILTER_PROBE2(name, a1, a2)                           \
+    DTRACE_PROBE2(milter_manager, name, a1, a2)
+#  define MILTER_PROBE3(name, a1, a2, a3)                       \
+    DTRACE_PROBE3(milter_manager, name, a1, a2, a3)
+#else
+#  define MILTER_PROBE0(name)
+#  define MILTER_PROBE1(name, a1)
+#  define MILTER_PROBE2(name, a1, a2)
+#  define MILTER_PROBE3(name, a1, a2, a3)
+#endif
+
+#endif /* __MILTER_PROBES_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -30,6 +30,8 @@
 G_BEGIN_DECLS
 
 #define MILTER_CHUNK_SIZE 65535
+#define MILTER_MAX_DATA_SIZE_256K ((256 * 1024) - 1)
+#define MILTER_MAX_DATA_SIZE_1M ((1024 * 1024) - 1)
 
 typedef enum
 {
@@ -29,6 +29,7 @@
 #include "milter-reader.h"
 #include "milter-logger.h"
 #include "milter-utils.h"
+#include "milter-probes.h"
 #include "milter-marshalers.h"
 
 #define MILTER_READER_GET_PRIVATE(obj)                  \
@@ -177,6 +178,7 @@ read_from_channel (MilterReader *reader, GIOChannel *channel)
                          priv->tag, length,
                          (condition & G_IO_IN) ? "contain" : "empty");
         }
+        MILTER_PROBE2(read, priv->tag, length);
         g_signal_emit(reader, signals[FLOW], 0, stream, length);
     }
 
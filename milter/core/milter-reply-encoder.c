@@ -427,6 +427,7 @@ milter_reply_encoder_encode_replace_body (MilterReplyEncoder *encoder,
 {
     MilterEncoder *base_encoder;
     GString *buffer;
+    gsize max_data_size;
 
     if (body_size <= 0 || (body == NULL && body_size > 0)) {
         *packet = NULL;
@@ -440,8 +441,9 @@ milter_reply_encoder_encode_replace_body (MilterReplyEncoder *encoder,
     buffer = milter_encoder_get_buffer(base_encoder);
 
     g_string_append_c(buffer, MILTER_REPLY_REPLACE_BODY);
-    if (body_size > MILTER_CHUNK_SIZE)
-        *packed_size = MILTER_CHUNK_SIZE;
+    max_data_size = milter_encoder_get_max_data_size(base_encoder);
+    if (body_size > max_data_size)
+        *packed_size = max_data_size;
     else
         *packed_size = body_size;
     g_string_append_len(buffer, body, *packed_size);
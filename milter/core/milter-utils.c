@@ -921,6 +921,49 @@ milter_utils_parse_file_mode (const gchar *string,
     return success;
 }
 
+gdouble
+milter_utils_moving_average (gdouble average, gdouble value, gdouble weight,
+                             guint n_samples)
+{
+    if (n_samples == 0)
+        return value;
+    return average + (value - average) * weight;
+}
+
+#define RECENT_LATENCY_WEIGHT 0.2
+#define BASELINE_LATENCY_WEIGHT 0.01
+#define N_WARM_UP_SAMPLES 10
+
+void
+milter_utils_latency_trend_init (MilterUtilsLatencyTrend *trend)
+{
+    trend->latency = 0.0;
+    trend->baseline_latency = 0.0;
+    trend->n_samples = 0;
+}
+
+void
+milter_utils_latency_trend_add (MilterUtilsLatencyTrend *trend,
+                                gdouble latency)
+{
+    trend->latency = milter_utils_moving_average(trend->latency,
+                                                 latency,
+                                                 RECENT_LATENCY_WEIGHT,
+                                                 trend->n_samples);
+    trend->baseline_latency =
+        milter_utils_moving_average(trend->baseline_latency,
+                                    latency,
+                                    BASELINE_LATENCY_WEIGHT,
+                                    trend->n_samples);
+    trend->n_samples++;
+}
+
+gboolean
+milter_utils_latency_trend_is_warmed_up (MilterUtilsLatencyTrend *trend)
+{
+    return trend->n_samples >= N_WARM_UP_SAMPLES;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -159,6 +159,32 @@ gboolean         milter_utils_parse_file_mode(const gchar  *string,
                                               guint        *mode,
                                               gchar       **error_message);
 
+gdouble          milter_utils_moving_average (gdouble average,
+                                              gdouble value,
+                                              gdouble weight,
+                                              guint   n_samples);
+
+/*
+ * A recent and a baseline moving average of latencies.
+ * A recent average that is much larger than the baseline
+ * means that the latencies are getting worse.
+ */
+typedef struct _MilterUtilsLatencyTrend MilterUtilsLatencyTrend;
+struct _MilterUtilsLatencyTrend
+{
+    gdouble latency;
+    gdouble baseline_latency;
+    guint n_samples;
+};
+
+void             milter_utils_latency_trend_init
+                                             (MilterUtilsLatencyTrend *trend);
+void             milter_utils_latency_trend_add
+                                             (MilterUtilsLatencyTrend *trend,
+                                              gdouble                  latency);
+gboolean         milter_utils_latency_trend_is_warmed_up
+                                             (MilterUtilsLatencyTrend *trend);
+
 typedef enum {
     MILTER_UTILS_READ_PIPE,
     MILTER_UTILS_WRITE_PIPE
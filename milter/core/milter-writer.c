@@ -29,6 +29,7 @@
 #include "milter-writer.h"
 #include "milter-logger.h"
 #include "milter-utils.h"
+#include "milter-probes.h"
 
 #define MILTER_WRITER_GET_PRIVATE(obj)                  \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                 \
@@ -381,6 +382,7 @@ write_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
                 }
             }
             g_string_erase(priv->buffer, 0, written_size);
+            MILTER_PROBE3(write, priv->tag, written_size, priv->buffer->len);
             milter_trace("[%u] [writer][write-callback][wrote] [%u] "
                          "written: <%" G_GSIZE_FORMAT "> "
                          "rest: <%" G_GSIZE_FORMAT "> "
@@ -24,7 +24,16 @@
 #include <milter/manager/milter-manager-leader.h>
 #include <milter/manager/milter-manager-child.h>
 #include <milter/manager/milter-manager-children.h>
+#include <milter/manager/milter-manager-mirror.h>
 #include <milter/manager/milter-manager-egg.h>
+#include <milter/manager/milter-manager-circuit-breaker.h>
+#include <milter/manager/milter-manager-latency-histogram.h>
+#include <milter/manager/milter-manager-session-limiter.h>
+#include <milter/manager/milter-manager-replica-set.h>
+#include <milter/manager/milter-manager-verdict-cache.h>
+#include <milter/manager/milter-manager-stress-detector.h>
+#include <milter/manager/milter-manager-regexp-table.h>
+#include <milter/manager/milter-manager-cidr-table.h>
 #include <milter/manager/milter-manager-control-command-decoder.h>
 #include <milter/manager/milter-manager-control-reply-decoder.h>
 #include <milter/manager/milter-manager-control-command-encoder.h>
@@ -32,6 +41,7 @@
 #include <milter/manager/milter-manager-controller-context.h>
 #include <milter/manager/milter-manager-controller.h>
 #include <milter/manager/milter-manager-process-launcher.h>
+#include <milter/manager/milter-manager-connection-table.h>
 #include <milter/manager/milter-manager-enum-types.h>
 #include <milter/manager/milter-manager.h>
 
@@ -0,0 +1,239 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "milter-manager-address-trie.h"
+
+typedef struct _Node Node;
+struct _Node
+{
+    Node *children[2];
+    /* 0 means "no entry". */
+    guint entry_number;
+};
+
+struct _MilterManagerAddressTrie
+{
+    Node *ipv4_networks;
+    Node *ipv6_networks;
+};
+
+MilterManagerAddressTrie *
+milter_manager_address_trie_new (void)
+{
+    return g_new0(MilterManagerAddressTrie, 1);
+}
+
+static void
+node_free (Node *node)
+{
+    if (!node)
+        return;
+
+    node_free(node->children[0]);
+    node_free(node->children[1]);
+    g_free(node);
+}
+
+void
+milter_manager_address_trie_free (MilterManagerAddressTrie *trie)
+{
+    node_free(trie->ipv4_networks);
+    node_free(trie->ipv6_networks);
+    g_free(trie);
+}
+
+gboolean
+milter_manager_address_trie_is_empty (MilterManagerAddressTrie *trie)
+{
+    return !trie->ipv4_networks && !trie->ipv6_networks;
+}
+
+#define BIT_AT(bytes, i) (((bytes)[(i) / 8] >> (7 - (i) % 8)) & 1)
+
+static void
+insert (Node **root, const guint8 *bytes, guint prefix_length,
+        guint entry_number)
+{
+    Node *node;
+    guint i;
+
+    if (!*root)
+        *root = g_new0(Node, 1);
+
+    node = *root;
+    for (i = 0; i < prefix_length; i++) {
+        gint bit = BIT_AT(bytes, i);
+
+        if (!node->children[bit])
+            node->children[bit] = g_new0(Node, 1);
+        node = node->children[bit];
+    }
+
+    /* The first entry wins like Postfix. */
+    if (node->entry_number == 0)
+        node->entry_number = entry_number;
+}
+
+/*
+ * Every network on the path includes the address. The one
+ * that is added first is used.
+ */
+static guint
+lookup (Node *node, const guint8 *bytes, guint n_bits)
+{
+    guint entry_number = 0;
+    guint i;
+
+    for (i = 0; node; i++) {
+        if (node->entry_number > 0 &&
+            (entry_number == 0 || node->entry_number < entry_number))
+            entry_number = node->entry_number;
+        if (i == n_bits)
+            break;
+        node = node->children[BIT_AT(bytes, i)];
+    }
+
+    return entry_number;
+}
+
+/*
+ * An IPv4-mapped address is included in the IPv4 networks
+ * that include the mapped address and in the IPv6 networks
+ * that include the address as is.
+ */
+static guint
+lookup_ipv6 (MilterManagerAddressTrie *trie, const struct in6_addr *address)
+{
+    const guint8 *bytes = (const guint8 *)address;
+    guint entry_number, ipv4_entry_number;
+
+    entry_number = lookup(trie->ipv6_networks, bytes, 128);
+    if (!IN6_IS_ADDR_V4MAPPED(address))
+        return entry_number;
+
+    ipv4_entry_number = lookup(trie->ipv4_networks, bytes + 12, 32);
+    if (ipv4_entry_number > 0 &&
+        (entry_number == 0 || ipv4_entry_number < entry_number))
+        return ipv4_entry_number;
+    return entry_number;
+}
+
+gboolean
+milter_manager_address_trie_add (MilterManagerAddressTrie *trie,
+                                 const gchar *network,
+                                 guint entry_number,
+                                 const gchar **error_message)
+{
+    gchar **components;
+    guint8 bytes[sizeof(struct in6_addr)];
+    Node **root;
+    guint max_prefix_length;
+    guint64 prefix_length;
+    gboolean success = TRUE;
+
+    components = g_strsplit(network, "/", 2);
+    if (inet_pton(AF_INET, components[0], bytes) == 1) {
+        root = &(trie->ipv4_networks);
+        max_prefix_length = 32;
+    } else if (inet_pton(AF_INET6, components[0], bytes) == 1) {
+        root = &(trie->ipv6_networks);
+        max_prefix_length = 128;
+    } else {
+        if (error_message)
+            *error_message = "invalid address";
+        g_strfreev(components);
+        return FALSE;
+    }
+
+    prefix_length = max_prefix_length;
+    if (components[1]) {
+        gchar *end = NULL;
+
+        prefix_length = g_ascii_strtoull(components[1], &end, 10);
+        if (components[1][0] == '\0' || end[0] != '\0' ||
+            prefix_length > max_prefix_length) {
+            if (error_message)
+                *error_message = "invalid prefix length";
+            success = FALSE;
+        }
+    }
+    g_strfreev(components);
+
+    if (success)
+        insert(root, bytes, prefix_length, entry_number);
+
+    return success;
+}
+
+guint
+milter_manager_address_trie_lookup (MilterManagerAddressTrie *trie,
+                                    const gchar *address)
+{
+    struct in_addr address_inet;
+    struct in6_addr address_inet6;
+
+    if (inet_pton(AF_INET, address, &address_inet) == 1)
+        return lookup(trie->ipv4_networks, (const guint8 *)&address_inet, 32);
+    if (inet_pton(AF_INET6, address, &address_inet6) == 1)
+        return lookup_ipv6(trie, &address_inet6);
+
+    return 0;
+}
+
+guint
+milter_manager_address_trie_lookup_address (MilterManagerAddressTrie *trie,
+                                            const struct sockaddr *address,
+                                            socklen_t address_length)
+{
+    switch (address->sa_family) {
+    case AF_INET:
+    {
+        const struct sockaddr_in *address_inet;
+
+        if (address_length < sizeof(struct sockaddr_in))
+            return 0;
+        address_inet = (const struct sockaddr_in *)address;
+        return lookup(trie->ipv4_networks,
+                      (const guint8 *)&(address_inet->sin_addr),
+                      32);
+    }
+    case AF_INET6:
+    {
+        const struct sockaddr_in6 *address_inet6;
+
+        if (address_length < sizeof(struct sockaddr_in6))
+            return 0;
+        address_inet6 = (const struct sockaddr_in6 *)address;
+        return lookup_ipv6(trie, &(address_inet6->sin6_addr));
+    }
+    default:
+        return 0;
+    }
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,58 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_ADDRESS_TRIE_H__
+#define __MILTER_MANAGER_ADDRESS_TRIE_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A binary trie of IPv4 and IPv6 networks shared by CIDR
+ * tables and condition rules. Each network has an entry
+ * number that is greater than 0. An IPv4-mapped IPv6
+ * address is looked up as the IPv4 address.
+ */
+typedef struct _MilterManagerAddressTrie MilterManagerAddressTrie;
+
+MilterManagerAddressTrie *
+              milter_manager_address_trie_new       (void);
+void          milter_manager_address_trie_free      (MilterManagerAddressTrie *trie);
+gboolean      milter_manager_address_trie_is_empty  (MilterManagerAddressTrie *trie);
+gboolean      milter_manager_address_trie_add       (MilterManagerAddressTrie *trie,
+                                                     const gchar              *network,
+                                                     guint                     entry_number,
+                                                     const gchar             **error_message);
+guint         milter_manager_address_trie_lookup    (MilterManagerAddressTrie *trie,
+                                                     const gchar              *address);
+guint         milter_manager_address_trie_lookup_address
+                                                    (MilterManagerAddressTrie *trie,
+                                                     const struct sockaddr    *address,
+                                                     socklen_t                 address_length);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_ADDRESS_TRIE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
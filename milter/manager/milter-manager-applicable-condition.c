@@ -21,8 +21,11 @@
 #  include "../../config.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <string.h>
+
 #include "milter-manager-applicable-condition.h"
 #include "milter-manager-enum-types.h"
+#include <milter/core/milter-logger.h>
 #include <milter/core/milter-marshalers.h>
 
 #define MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(obj)            \
@@ -36,6 +39,7 @@ struct _MilterManagerApplicableConditionPrivate
     gchar *name;
     gchar *description;
     gchar *data;
+    GList *rules;
 };
 
 enum
@@ -67,6 +71,10 @@ static void get_property   (GObject         *object,
                             guint            prop_id,
                             GValue          *value,
                             GParamSpec      *pspec);
+static void attach_to      (MilterManagerApplicableCondition *condition,
+                            MilterManagerChild               *child,
+                            MilterManagerChildren            *children,
+                            MilterClientContext              *context);
 
 static void
 milter_manager_applicable_condition_class_init (MilterManagerApplicableConditionClass *klass)
@@ -80,6 +88,8 @@ milter_manager_applicable_condition_class_init (MilterManagerApplicableCondition
     gobject_class->set_property = set_property;
     gobject_class->get_property = get_property;
 
+    klass->attach_to = attach_to;
+
     spec = g_param_spec_string("name",
                                "Name",
                                "The name of the applicable condition",
@@ -127,6 +137,7 @@ milter_manager_applicable_condition_init (MilterManagerApplicableCondition *appl
     priv->name = NULL;
     priv->description = NULL;
     priv->data = NULL;
+    priv->rules = NULL;
 }
 
 static void
@@ -151,6 +162,12 @@ dispose (GObject *object)
         priv->data = NULL;
     }
 
+    if (priv->rules) {
+        g_list_foreach(priv->rules, (GFunc)g_object_unref, NULL);
+        g_list_free(priv->rules);
+        priv->rules = NULL;
+    }
+
     G_OBJECT_CLASS(milter_manager_applicable_condition_parent_class)->dispose(object);
 }
 
@@ -270,12 +287,45 @@ milter_manager_applicable_condition_get_data (MilterManagerApplicableCondition *
     return MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition)->data;
 }
 
+void
+milter_manager_applicable_condition_add_rule (MilterManagerApplicableCondition *condition,
+                                              MilterManagerConditionRule       *rule)
+{
+    MilterManagerApplicableConditionPrivate *priv;
+
+    g_return_if_fail(rule != NULL);
+
+    priv = MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition);
+    g_object_ref(rule);
+    priv->rules = g_list_append(priv->rules, rule);
+}
+
+const GList *
+milter_manager_applicable_condition_get_rules (MilterManagerApplicableCondition *condition)
+{
+    return MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition)->rules;
+}
+
+void
+milter_manager_applicable_condition_clear_rules (MilterManagerApplicableCondition *condition)
+{
+    MilterManagerApplicableConditionPrivate *priv;
+
+    priv = MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition);
+    if (priv->rules) {
+        g_list_foreach(priv->rules, (GFunc)g_object_unref, NULL);
+        g_list_free(priv->rules);
+        priv->rules = NULL;
+    }
+}
+
 void
 milter_manager_applicable_condition_merge (MilterManagerApplicableCondition *condition,
                                            MilterManagerApplicableCondition *other_condition)
 {
     const gchar *description;
     const gchar *data;
+    const GList *node;
 
     description = milter_manager_applicable_condition_get_description(other_condition);
     if (description)
@@ -283,6 +333,126 @@ milter_manager_applicable_condition_merge (MilterManagerApplicableCondition *con
     data = milter_manager_applicable_condition_get_data(other_condition);
     if (data)
         milter_manager_applicable_condition_set_data(condition, data);
+    node = milter_manager_applicable_condition_get_rules(other_condition);
+    if (node) {
+        milter_manager_applicable_condition_clear_rules(condition);
+        for (; node; node = g_list_next(node)) {
+            milter_manager_applicable_condition_add_rule(condition, node->data);
+        }
+    }
+}
+
+static gboolean
+evaluate_rules (MilterManagerApplicableCondition *condition,
+                MilterManagerConditionStage stage,
+                MilterManagerChild *child,
+                const gchar *subject,
+                const struct sockaddr *address,
+                socklen_t address_length)
+{
+    MilterManagerApplicableConditionPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition);
+    for (node = priv->rules; node; node = g_list_next(node)) {
+        MilterManagerConditionRule *rule = node->data;
+        gboolean stop;
+
+        if (milter_manager_condition_rule_get_stage(rule) != stage)
+            continue;
+        if (!milter_manager_condition_rule_match(rule,
+                                                 MILTER_PROTOCOL_AGENT(child),
+                                                 subject,
+                                                 address,
+                                                 address_length))
+            continue;
+
+        stop = (milter_manager_condition_rule_get_action(rule) ==
+                MILTER_MANAGER_CONDITION_ACTION_STOP);
+        milter_debug("[%u] [applicable-condition][rule][%s] <%s>: <%s>",
+                     milter_agent_get_tag(MILTER_AGENT(child)),
+                     stop ? "stop" : "apply",
+                     priv->name ? priv->name : "(null)",
+                     subject ? subject : "(null)");
+        return stop;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+cb_stop_on_connect (MilterManagerChild *child,
+                    const gchar *host_name,
+                    const struct sockaddr *address,
+                    socklen_t address_length,
+                    gpointer user_data)
+{
+    return evaluate_rules(MILTER_MANAGER_APPLICABLE_CONDITION(user_data),
+                          MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+                          child, host_name, address, address_length);
+}
+
+static gboolean
+cb_stop_on_helo (MilterManagerChild *child, const gchar *fqdn,
+                 gpointer user_data)
+{
+    return evaluate_rules(MILTER_MANAGER_APPLICABLE_CONDITION(user_data),
+                          MILTER_MANAGER_CONDITION_STAGE_HELO,
+                          child, fqdn, NULL, 0);
+}
+
+static gboolean
+cb_stop_on_envelope_from (MilterManagerChild *child, const gchar *from,
+                          gpointer user_data)
+{
+    return evaluate_rules(MILTER_MANAGER_APPLICABLE_CONDITION(user_data),
+                          MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_FROM,
+                          child, from, NULL, 0);
+}
+
+static gboolean
+cb_stop_on_envelope_recipient (MilterManagerChild *child,
+                               const gchar *recipient,
+                               gpointer user_data)
+{
+    return evaluate_rules(MILTER_MANAGER_APPLICABLE_CONDITION(user_data),
+                          MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_RECIPIENT,
+                          child, recipient, NULL, 0);
+}
+
+static void
+attach_to (MilterManagerApplicableCondition *condition,
+           MilterManagerChild               *child,
+           MilterManagerChildren            *children,
+           MilterClientContext              *context)
+{
+    MilterManagerApplicableConditionPrivate *priv;
+    GList *node;
+    gboolean stages[MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_RECIPIENT + 1];
+
+    priv = MILTER_MANAGER_APPLICABLE_CONDITION_GET_PRIVATE(condition);
+    if (!priv->rules)
+        return;
+
+    memset(stages, 0, sizeof(stages));
+    for (node = priv->rules; node; node = g_list_next(node)) {
+        MilterManagerConditionRule *rule = node->data;
+        stages[milter_manager_condition_rule_get_stage(rule)] = TRUE;
+    }
+
+#define CONNECT_STOPPER(stage, signal_name, callback)                   \
+    if (stages[MILTER_MANAGER_CONDITION_STAGE_ ## stage])               \
+        g_signal_connect_object(child, signal_name,                     \
+                                G_CALLBACK(callback), condition, 0)
+
+    CONNECT_STOPPER(CONNECT, "stop-on-connect", cb_stop_on_connect);
+    CONNECT_STOPPER(HELO, "stop-on-helo", cb_stop_on_helo);
+    CONNECT_STOPPER(ENVELOPE_FROM, "stop-on-envelope-from",
+                    cb_stop_on_envelope_from);
+    CONNECT_STOPPER(ENVELOPE_RECIPIENT, "stop-on-envelope-recipient",
+                    cb_stop_on_envelope_recipient);
+
+#undef CONNECT_STOPPER
 }
 
 void
@@ -27,6 +27,7 @@
 #include <milter/manager/milter-manager-objects.h>
 #include <milter/manager/milter-manager-child.h>
 #include <milter/manager/milter-manager-children.h>
+#include <milter/manager/milter-manager-condition-rule.h>
 
 G_BEGIN_DECLS
 
@@ -75,6 +76,20 @@ void         milter_manager_applicable_condition_set_data
                                     const gchar *data);
 const gchar *milter_manager_applicable_condition_get_data
                                    (MilterManagerApplicableCondition *condition);
+/*
+ * Adds a rule that is evaluated without any callback. Rules
+ * are evaluated in added order for each stage. The first
+ * matched rule decides whether the child milter is stopped
+ * or not. If no rule is matched, the child milter isn't
+ * stopped.
+ */
+void         milter_manager_applicable_condition_add_rule
+                                   (MilterManagerApplicableCondition *condition,
+                                    MilterManagerConditionRule       *rule);
+const GList *milter_manager_applicable_condition_get_rules
+                                   (MilterManagerApplicableCondition *condition);
+void         milter_manager_applicable_condition_clear_rules
+                                   (MilterManagerApplicableCondition *condition);
 void         milter_manager_applicable_condition_merge
                                    (MilterManagerApplicableCondition *condition,
                                     MilterManagerApplicableCondition *other_condition);
@@ -44,6 +44,15 @@ struct _MilterManagerChildPrivate
     gboolean search_path;
     MilterStatus fallback_status;
     gboolean evaluation_mode;
+    MilterManagerCircuitBreaker *circuit_breaker;
+    MilterManagerSessionLimiter *session_limiter;
+    MilterManagerReplicaSet *replica_set;
+    gint replica_index;
+    gboolean replica_active;
+    guint n_failovers;
+    gdouble hedge_delay;
+    MilterManagerVerdictCache *verdict_cache;
+    MilterManagerVerdictCache *body_cache;
 };
 
 enum
@@ -55,7 +64,14 @@ enum
     PROP_WORKING_DIRECTORY,
     PROP_SEARCH_PATH,
     PROP_FALLBACK_STATUS,
-    PROP_REPUTATION_MODE
+    PROP_REPUTATION_MODE,
+    PROP_CIRCUIT_BREAKER,
+    PROP_SESSION_LIMITER,
+    PROP_REPLICA_SET,
+    PROP_REPLICA_INDEX,
+    PROP_HEDGE_DELAY,
+    PROP_VERDICT_CACHE,
+    PROP_BODY_CACHE
 };
 
 MILTER_DEFINE_ERROR_EMITTABLE_TYPE(MilterManagerChild,
@@ -135,6 +151,66 @@ milter_manager_child_class_init (MilterManagerChildClass *klass)
                                 G_PARAM_READWRITE);
     g_object_class_install_property(gobject_class, PROP_REPUTATION_MODE, spec);
 
+    spec = g_param_spec_object("circuit-breaker",
+                               "Circuit breaker",
+                               "The circuit breaker shared with other "
+                               "children hatched from the same egg",
+                               MILTER_TYPE_MANAGER_CIRCUIT_BREAKER,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_CIRCUIT_BREAKER, spec);
+
+    spec = g_param_spec_object("session-limiter",
+                               "Session limiter",
+                               "The concurrent sessions limiter shared with "
+                               "other children hatched from the same egg",
+                               MILTER_TYPE_MANAGER_SESSION_LIMITER,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_SESSION_LIMITER, spec);
+
+    spec = g_param_spec_object("replica-set",
+                               "Replica set",
+                               "The replicas shared with other "
+                               "children hatched from the same egg",
+                               MILTER_TYPE_MANAGER_REPLICA_SET,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REPLICA_SET, spec);
+
+    spec = g_param_spec_int("replica-index",
+                            "Replica index",
+                            "The index of the replica connected by the child",
+                            -1,
+                            G_MAXINT,
+                            -1,
+                            G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_REPLICA_INDEX, spec);
+
+    spec = g_param_spec_double("hedge-delay",
+                               "Hedge delay",
+                               "The seconds to wait for a reply before "
+                               "sending the same command to another replica",
+                               0,
+                               G_MAXDOUBLE,
+                               0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_HEDGE_DELAY, spec);
+
+    spec = g_param_spec_object("verdict-cache",
+                               "Verdict cache",
+                               "The CONNECT and HELO verdicts shared with "
+                               "other children hatched from the same egg",
+                               MILTER_TYPE_MANAGER_VERDICT_CACHE,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_VERDICT_CACHE, spec);
+
+    spec = g_param_spec_object("body-cache",
+                               "Body cache",
+                               "The end-of-message verdicts by message body "
+                               "shared with other children hatched from "
+                               "the same egg",
+                               MILTER_TYPE_MANAGER_VERDICT_CACHE,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_BODY_CACHE, spec);
+
     g_type_class_add_private(gobject_class,
                              sizeof(MilterManagerChildPrivate));
 }
@@ -152,6 +228,15 @@ milter_manager_child_init (MilterManagerChild *milter)
     priv->search_path = TRUE;
     priv->fallback_status = MILTER_STATUS_ACCEPT;
     priv->evaluation_mode = FALSE;
+    priv->circuit_breaker = NULL;
+    priv->session_limiter = NULL;
+    priv->replica_set = NULL;
+    priv->replica_index = -1;
+    priv->replica_active = FALSE;
+    priv->n_failovers = 0;
+    priv->hedge_delay = 0;
+    priv->verdict_cache = NULL;
+    priv->body_cache = NULL;
 }
 
 static void
@@ -181,6 +266,34 @@ dispose (GObject *object)
         priv->command_options = NULL;
     }
 
+    if (priv->circuit_breaker) {
+        g_object_unref(priv->circuit_breaker);
+        priv->circuit_breaker = NULL;
+    }
+
+    if (priv->session_limiter) {
+        g_object_unref(priv->session_limiter);
+        priv->session_limiter = NULL;
+    }
+
+    if (priv->verdict_cache) {
+        g_object_unref(priv->verdict_cache);
+        priv->verdict_cache = NULL;
+    }
+
+    if (priv->body_cache) {
+        g_object_unref(priv->body_cache);
+        priv->body_cache = NULL;
+    }
+
+    if (priv->replica_set) {
+        if (priv->replica_active)
+            milter_manager_replica_set_end(priv->replica_set,
+                                           priv->replica_index);
+        g_object_unref(priv->replica_set);
+        priv->replica_set = NULL;
+    }
+
     G_OBJECT_CLASS(milter_manager_child_parent_class)->dispose(object);
 }
 
@@ -223,6 +336,37 @@ set_property (GObject      *object,
     case PROP_REPUTATION_MODE:
         priv->evaluation_mode = g_value_get_boolean(value);
         break;
+    case PROP_CIRCUIT_BREAKER:
+        if (priv->circuit_breaker)
+            g_object_unref(priv->circuit_breaker);
+        priv->circuit_breaker = g_value_dup_object(value);
+        break;
+    case PROP_SESSION_LIMITER:
+        if (priv->session_limiter)
+            g_object_unref(priv->session_limiter);
+        priv->session_limiter = g_value_dup_object(value);
+        break;
+    case PROP_REPLICA_SET:
+        if (priv->replica_set)
+            g_object_unref(priv->replica_set);
+        priv->replica_set = g_value_dup_object(value);
+        break;
+    case PROP_REPLICA_INDEX:
+        priv->replica_index = g_value_get_int(value);
+        break;
+    case PROP_HEDGE_DELAY:
+        priv->hedge_delay = g_value_get_double(value);
+        break;
+    case PROP_VERDICT_CACHE:
+        if (priv->verdict_cache)
+            g_object_unref(priv->verdict_cache);
+        priv->verdict_cache = g_value_dup_object(value);
+        break;
+    case PROP_BODY_CACHE:
+        if (priv->body_cache)
+            g_object_unref(priv->body_cache);
+        priv->body_cache = g_value_dup_object(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -260,6 +404,27 @@ get_property (GObject    *object,
     case PROP_REPUTATION_MODE:
         g_value_set_boolean(value, priv->evaluation_mode);
         break;
+    case PROP_CIRCUIT_BREAKER:
+        g_value_set_object(value, priv->circuit_breaker);
+        break;
+    case PROP_SESSION_LIMITER:
+        g_value_set_object(value, priv->session_limiter);
+        break;
+    case PROP_REPLICA_SET:
+        g_value_set_object(value, priv->replica_set);
+        break;
+    case PROP_REPLICA_INDEX:
+        g_value_set_int(value, priv->replica_index);
+        break;
+    case PROP_HEDGE_DELAY:
+        g_value_set_double(value, priv->hedge_delay);
+        break;
+    case PROP_VERDICT_CACHE:
+        g_value_set_object(value, priv->verdict_cache);
+        break;
+    case PROP_BODY_CACHE:
+        g_value_set_object(value, priv->body_cache);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -332,6 +497,124 @@ milter_manager_child_is_evaluation_mode (MilterManagerChild *milter)
     return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->evaluation_mode;
 }
 
+MilterManagerCircuitBreaker *
+milter_manager_child_get_circuit_breaker (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->circuit_breaker;
+}
+
+MilterManagerSessionLimiter *
+milter_manager_child_get_session_limiter (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->session_limiter;
+}
+
+MilterManagerReplicaSet *
+milter_manager_child_get_replica_set (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->replica_set;
+}
+
+gint
+milter_manager_child_get_replica_index (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->replica_index;
+}
+
+gdouble
+milter_manager_child_get_hedge_delay (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->hedge_delay;
+}
+
+MilterManagerVerdictCache *
+milter_manager_child_get_verdict_cache (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->verdict_cache;
+}
+
+MilterManagerVerdictCache *
+milter_manager_child_get_body_cache (MilterManagerChild *milter)
+{
+    return MILTER_MANAGER_CHILD_GET_PRIVATE(milter)->body_cache;
+}
+
+void
+milter_manager_child_begin_replica (MilterManagerChild *milter)
+{
+    MilterManagerChildPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILD_GET_PRIVATE(milter);
+    if (!priv->replica_set || priv->replica_index < 0 || priv->replica_active)
+        return;
+
+    milter_manager_replica_set_begin(priv->replica_set, priv->replica_index);
+    priv->replica_active = TRUE;
+}
+
+void
+milter_manager_child_end_replica (MilterManagerChild *milter,
+                                  gboolean success,
+                                  gdouble elapsed)
+{
+    MilterManagerChildPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILD_GET_PRIVATE(milter);
+    if (!priv->replica_active)
+        return;
+
+    milter_manager_replica_set_end(priv->replica_set, priv->replica_index);
+    if (success)
+        milter_manager_replica_set_record_success(priv->replica_set,
+                                                  priv->replica_index,
+                                                  elapsed);
+    else
+        milter_manager_replica_set_record_failure(priv->replica_set,
+                                                  priv->replica_index);
+    priv->replica_active = FALSE;
+}
+
+gboolean
+milter_manager_child_failover (MilterManagerChild *milter)
+{
+    MilterManagerChildPrivate *priv;
+    gint next_index;
+    const gchar *connection_spec;
+    GError *error = NULL;
+
+    priv = MILTER_MANAGER_CHILD_GET_PRIVATE(milter);
+    if (!priv->replica_set || priv->replica_index < 0)
+        return FALSE;
+    if (priv->n_failovers + 1 >=
+        milter_manager_replica_set_get_size(priv->replica_set))
+        return FALSE;
+
+    milter_manager_child_end_replica(milter, FALSE, 0.0);
+
+    next_index = milter_manager_replica_set_select_next(priv->replica_set,
+                                                        priv->replica_index);
+    if (next_index < 0)
+        return FALSE;
+
+    connection_spec =
+        milter_manager_replica_set_get_connection_spec(priv->replica_set,
+                                                       next_index);
+    if (!milter_server_context_set_connection_spec(MILTER_SERVER_CONTEXT(milter),
+                                                   connection_spec,
+                                                   &error)) {
+        milter_error("[child][failover][error][%s] %s: %s",
+                     milter_server_context_get_name(MILTER_SERVER_CONTEXT(milter)),
+                     connection_spec,
+                     error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    priv->replica_index = next_index;
+    priv->n_failovers++;
+    return TRUE;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
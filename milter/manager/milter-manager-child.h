@@ -26,6 +26,10 @@
 #include <glib-object.h>
 
 #include <milter/server.h>
+#include <milter/manager/milter-manager-circuit-breaker.h>
+#include <milter/manager/milter-manager-session-limiter.h>
+#include <milter/manager/milter-manager-replica-set.h>
+#include <milter/manager/milter-manager-verdict-cache.h>
 
 G_BEGIN_DECLS
 
@@ -82,6 +86,36 @@ void                  milter_manager_child_set_evaluation_mode
                                                         gboolean evaluation_mode);
 gboolean              milter_manager_child_is_evaluation_mode
                                                        (MilterManagerChild *milter);
+MilterManagerCircuitBreaker *
+                      milter_manager_child_get_circuit_breaker
+                                                       (MilterManagerChild *milter);
+MilterManagerSessionLimiter *
+                      milter_manager_child_get_session_limiter
+                                                       (MilterManagerChild *milter);
+MilterManagerReplicaSet *
+                      milter_manager_child_get_replica_set
+                                                       (MilterManagerChild *milter);
+gint                  milter_manager_child_get_replica_index
+                                                       (MilterManagerChild *milter);
+void                  milter_manager_child_begin_replica
+                                                       (MilterManagerChild *milter);
+void                  milter_manager_child_end_replica (MilterManagerChild *milter,
+                                                        gboolean            success,
+                                                        gdouble             elapsed);
+/*
+ * Switches the connection spec to another replica after
+ * recording a failure of the current one. Each replica is
+ * tried at most once per child.
+ */
+gboolean              milter_manager_child_failover    (MilterManagerChild *milter);
+gdouble               milter_manager_child_get_hedge_delay
+                                                       (MilterManagerChild *milter);
+MilterManagerVerdictCache *
+                      milter_manager_child_get_verdict_cache
+                                                       (MilterManagerChild *milter);
+MilterManagerVerdictCache *
+                      milter_manager_child_get_body_cache
+                                                       (MilterManagerChild *milter);
 
 #endif /* __MILTER_MANAGER_CHILD_H__ */
 
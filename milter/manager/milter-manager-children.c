@@ -27,11 +27,18 @@
 #include "milter-manager-configuration.h"
 #include "milter/core.h"
 #include "milter-manager-launch-command-encoder.h"
+#include "milter/core/milter-probes.h"
 
 #define MAX_ON_MEMORY_BODY_SIZE 5242880 /* 5Mbyte */
 
 #define MAX_SUPPORTED_MILTER_PROTOCOL_VERSION 6
 
+#define MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, status)  \
+    MILTER_PROBE3(child__reply,                                         \
+                  MILTER_MANAGER_CHILDREN_GET_PRIVATE(children)->tag,   \
+                  milter_server_context_get_name(context),               \
+                  status)
+
 #define MILTER_MANAGER_CHILDREN_GET_PRIVATE(obj)                    \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                             \
                                  MILTER_TYPE_MANAGER_CHILDREN,      \
@@ -71,6 +78,7 @@ struct _MilterManagerChildrenPrivate
     MilterOption *option;
     MilterStepFlags initial_yes_steps;
     MilterStepFlags requested_yes_steps;
+    MilterStepFlags initial_max_data_size_steps;
     gboolean negotiated;
     gboolean all_expired_as_fallback_on_negotiated;
     MilterServerContextState state;
@@ -93,6 +101,7 @@ struct _MilterManagerChildrenPrivate
     gsize end_of_message_size;
     guint sending_body;
     guint sent_body_offset;
+    gsize spooled_body_size;
     gboolean replaced_body_for_each_child;
     gboolean replaced_body;
     gchar *change_from;
@@ -109,6 +118,24 @@ struct _MilterManagerChildrenPrivate
     MilterEventLoop *event_loop;
 
     guint lazy_reply_negotiate_id;
+
+    GHashTable *circuit_breaker_recorded_children;
+    GHashTable *slowest_reply_times;
+
+    GTimer *session_timer;
+
+    GHashTable *session_limited_children;
+    GHashTable *session_limiter_wait_ids;
+
+    GHashTable *hedges;
+
+    gchar *helo_fqdn;
+    gboolean ignore_verdict;
+
+    gboolean need_body_checksum;
+    GChecksum *body_checksum;
+    gchar *body_cache_key;
+    gboolean message_modified;
 };
 
 typedef struct _NegotiateData NegotiateData;
@@ -167,6 +194,15 @@ static void teardown_server_context_signals
                            (MilterManagerChild *child,
                             gpointer user_data);
 
+static gboolean failover_negotiate
+                           (NegotiateData *data);
+static void cancel_hedge   (MilterManagerChildren *children,
+                            MilterServerContext *context);
+static void prepare_hedges (MilterManagerChildren *children,
+                            GList *targets,
+                            MilterServerContextState state);
+static void hedge_data_hash_value_free
+                           (gpointer data);
 static gboolean child_establish_connection
                            (MilterManagerChild *child,
                             MilterOption *option,
@@ -201,6 +237,16 @@ static MilterStatus send_next_command
 static MilterStatus send_first_command_to_next_child
                            (MilterManagerChildren *children,
                             MilterServerContext *context);
+static void cb_continue          (MilterServerContext *context,
+                                  gpointer user_data);
+static void cb_temporary_failure (MilterServerContext *context,
+                                  gpointer user_data);
+static void cb_reject            (MilterServerContext *context,
+                                  gpointer user_data);
+static void cb_accept            (MilterServerContext *context,
+                                  gpointer user_data);
+static void cb_discard           (MilterServerContext *context,
+                                  gpointer user_data);
 
 static NegotiateData *negotiate_data_new  (MilterManagerChildren *children,
                                            MilterManagerChild *child,
@@ -271,6 +317,7 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->option = NULL;
     priv->initial_yes_steps = MILTER_STEP_NONE;
     priv->requested_yes_steps = MILTER_STEP_NONE;
+    priv->initial_max_data_size_steps = MILTER_STEP_NONE;
     priv->negotiated = FALSE;
     priv->all_expired_as_fallback_on_negotiated = FALSE;
     priv->reply_statuses = g_hash_table_new(g_direct_hash, g_direct_equal);
@@ -287,6 +334,7 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->end_of_message_size = 0;
     priv->sending_body = FALSE;
     priv->sent_body_offset = 0;
+    priv->spooled_body_size = 0;
     priv->replaced_body = FALSE;
     priv->replaced_body_for_each_child = FALSE;
     priv->change_from = NULL;
@@ -312,6 +360,31 @@ milter_manager_children_init (MilterManagerChildren *milter)
     priv->event_loop = NULL;
 
     priv->lazy_reply_negotiate_id = 0;
+
+    priv->circuit_breaker_recorded_children =
+        g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->slowest_reply_times =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+    priv->session_timer = g_timer_new();
+
+    priv->session_limited_children =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                              NULL, g_object_unref);
+    priv->session_limiter_wait_ids =
+        g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    priv->hedges =
+        g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                              NULL, hedge_data_hash_value_free);
+
+    priv->helo_fqdn = NULL;
+    priv->ignore_verdict = FALSE;
+
+    priv->need_body_checksum = FALSE;
+    priv->body_checksum = NULL;
+    priv->body_cache_key = NULL;
+    priv->message_modified = FALSE;
 }
 
 static void
@@ -431,6 +504,18 @@ dispose_body_related_data (MilterManagerChildrenPrivate *priv)
         g_free(priv->body_file_name);
         priv->body_file_name = NULL;
     }
+
+    priv->spooled_body_size = 0;
+
+    if (priv->body_checksum) {
+        g_checksum_free(priv->body_checksum);
+        priv->body_checksum = NULL;
+    }
+
+    if (priv->body_cache_key) {
+        g_free(priv->body_cache_key);
+        priv->body_cache_key = NULL;
+    }
 }
 
 static void
@@ -475,6 +560,7 @@ dispose_message_related_data (MilterManagerChildrenPrivate *priv)
     }
 
     dispose_body_related_data(priv);
+    priv->need_body_checksum = FALSE;
 
     if (priv->end_of_message_chunk) {
         g_free(priv->end_of_message_chunk);
@@ -507,6 +593,24 @@ dispose_smtp_client_address (MilterManagerChildrenPrivate *priv)
     priv->smtp_client_address_length = 0;
 }
 
+static void
+cancel_session_limiter_wait (gpointer key, gpointer value, gpointer user_data)
+{
+    NegotiateData *data = key;
+    MilterManagerSessionLimiter *limiter;
+
+    limiter = milter_manager_child_get_session_limiter(data->child);
+    if (limiter)
+        milter_manager_session_limiter_cancel(limiter,
+                                              GPOINTER_TO_UINT(value));
+}
+
+static void
+release_session_limiter_slot (gpointer key, gpointer value, gpointer user_data)
+{
+    milter_manager_session_limiter_release(value);
+}
+
 static void
 dispose (GObject *object)
 {
@@ -518,18 +622,57 @@ dispose (GObject *object)
 
     dispose_lazy_reply_negotiate_id(priv);
 
+    if (priv->hedges) {
+        g_hash_table_unref(priv->hedges);
+        priv->hedges = NULL;
+    }
+
     if (priv->reply_queue) {
         g_queue_free(priv->reply_queue);
         priv->reply_queue = NULL;
     }
 
+    if (priv->session_limiter_wait_ids) {
+        g_hash_table_foreach(priv->session_limiter_wait_ids,
+                             cancel_session_limiter_wait, NULL);
+        g_hash_table_unref(priv->session_limiter_wait_ids);
+        priv->session_limiter_wait_ids = NULL;
+    }
+
     if (priv->try_negotiate_ids) {
         g_hash_table_unref(priv->try_negotiate_ids);
         priv->try_negotiate_ids = NULL;
     }
 
+    if (priv->session_limited_children) {
+        g_hash_table_foreach(priv->session_limited_children,
+                             release_session_limiter_slot, NULL);
+        g_hash_table_unref(priv->session_limited_children);
+        priv->session_limited_children = NULL;
+    }
+
+    if (priv->circuit_breaker_recorded_children) {
+        g_hash_table_unref(priv->circuit_breaker_recorded_children);
+        priv->circuit_breaker_recorded_children = NULL;
+    }
+
+    if (priv->slowest_reply_times) {
+        g_hash_table_unref(priv->slowest_reply_times);
+        priv->slowest_reply_times = NULL;
+    }
+
+    if (priv->session_timer) {
+        g_timer_destroy(priv->session_timer);
+        priv->session_timer = NULL;
+    }
+
     dispose_smtp_client_address(priv);
 
+    if (priv->helo_fqdn) {
+        g_free(priv->helo_fqdn);
+        priv->helo_fqdn = NULL;
+    }
+
     if (priv->configuration) {
         g_object_unref(priv->configuration);
         priv->configuration = NULL;
@@ -670,6 +813,9 @@ milter_manager_children_add_child (MilterManagerChildren *children,
 
     priv->milters = g_list_append(priv->milters, g_object_ref(child));
     milter_agent_set_event_loop(MILTER_AGENT(child), priv->event_loop);
+    milter_server_context_set_replay_recording(
+        MILTER_SERVER_CONTEXT(child),
+        milter_manager_child_get_hedge_delay(child) > 0);
 }
 
 guint
@@ -893,11 +1039,98 @@ report_result (MilterManagerChildren *children,
     g_free(last_state_name);
 }
 
+static gboolean
+mark_circuit_breaker_recorded (MilterManagerChildren *children,
+                               MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (g_hash_table_lookup(priv->circuit_breaker_recorded_children, context))
+        return FALSE;
+
+    g_hash_table_insert(priv->circuit_breaker_recorded_children,
+                        context, context);
+    return TRUE;
+}
+
+/* Replica health follows the same results as the circuit breaker. */
+static void
+record_circuit_breaker_failure (MilterManagerChildren *children,
+                                MilterServerContext *context)
+{
+    MilterManagerCircuitBreaker *breaker;
+
+    milter_manager_child_end_replica(MILTER_MANAGER_CHILD(context),
+                                     FALSE, 0.0);
+
+    breaker = milter_manager_child_get_circuit_breaker(MILTER_MANAGER_CHILD(context));
+    if (!breaker)
+        return;
+
+    if (mark_circuit_breaker_recorded(children, context))
+        milter_manager_circuit_breaker_record_failure(breaker);
+}
+
+/*
+ * Only a child that replied to a command after negotiation
+ * succeeded. A skipped child or a child stopped before its
+ * first command isn't a result of the milter. Slowness is
+ * checked with the slowest reply, not with the whole
+ * session.
+ */
+static void
+record_circuit_breaker_success (MilterManagerChildren *children,
+                                MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerCircuitBreaker *breaker;
+    gdouble *slowest_reply_time;
+
+    milter_manager_child_end_replica(MILTER_MANAGER_CHILD(context),
+                                     TRUE,
+                                     milter_server_context_get_elapsed(context));
+
+    breaker = milter_manager_child_get_circuit_breaker(MILTER_MANAGER_CHILD(context));
+    if (!breaker)
+        return;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    slowest_reply_time = g_hash_table_lookup(priv->slowest_reply_times,
+                                             context);
+    if (!slowest_reply_time)
+        return;
+
+    if (mark_circuit_breaker_recorded(children, context))
+        milter_manager_circuit_breaker_record_success(breaker,
+                                                      *slowest_reply_time);
+}
+
+static void
+release_session_limiter (MilterManagerChildren *children,
+                         MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerSessionLimiter *limiter;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    limiter = g_hash_table_lookup(priv->session_limited_children, context);
+    if (!limiter)
+        return;
+
+    g_object_ref(limiter);
+    g_hash_table_remove(priv->session_limited_children, context);
+    milter_manager_session_limiter_release(limiter);
+    g_object_unref(limiter);
+}
+
 static void
 expire_child (MilterManagerChildren *children,
               MilterServerContext *context)
 {
     report_result(children, context);
+    record_circuit_breaker_success(children, context);
+    release_session_limiter(children, context);
     milter_server_context_set_quitted(context, TRUE);
     teardown_server_context_signals(MILTER_MANAGER_CHILD(context), children);
 }
@@ -1043,6 +1276,7 @@ remove_child_from_queue (MilterManagerChildren *children,
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    cancel_hedge(children, context);
     g_queue_remove(priv->reply_queue, context);
 
     if (!g_queue_is_empty(priv->reply_queue))
@@ -1085,6 +1319,7 @@ emit_replace_body_signal_file (MilterManagerChildren *children)
     GError *error = NULL;
     GIOStatus status = G_IO_STATUS_NORMAL;
     gsize chunk_size;
+    gchar *buffer;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
@@ -1101,8 +1336,8 @@ emit_replace_body_signal_file (MilterManagerChildren *children)
 
     chunk_size =
         milter_manager_configuration_get_chunk_size(priv->configuration);
+    buffer = g_malloc(chunk_size);
     while (status == G_IO_STATUS_NORMAL) {
-        gchar buffer[MILTER_CHUNK_SIZE + 1];
         gsize read_size;
 
         status = g_io_channel_read_chars(priv->body_file,
@@ -1112,6 +1347,7 @@ emit_replace_body_signal_file (MilterManagerChildren *children)
         if (status == G_IO_STATUS_NORMAL)
             g_signal_emit_by_name(children, "replace-body", buffer, read_size);
     }
+    g_free(buffer);
 
     if (error) {
         milter_error("[%u] [children][error][body][read] %s",
@@ -1158,6 +1394,190 @@ emit_replace_body_signal (MilterManagerChildren *children)
         return emit_replace_body_signal_file(children);
 }
 
+static gboolean
+need_body_checksum (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    for (node = priv->milters; node; node = g_list_next(node)) {
+        if (milter_manager_child_get_body_cache(MILTER_MANAGER_CHILD(node->data)))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+update_body_checksum (MilterManagerChildren *children,
+                      const gchar *chunk, gsize size)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!chunk || size == 0)
+        return;
+
+    if (!priv->need_body_checksum)
+        return;
+
+    if (!priv->body_checksum)
+        priv->body_checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(priv->body_checksum, (const guchar *)chunk, size);
+}
+
+/*
+ * Returns "BODY_HASH:HEADERS_HASH" for the current message.
+ * HEADERS_HASH covers only headers that change how the body
+ * is interpreted.
+ */
+static const gchar *
+get_body_cache_key (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    GChecksum *checksum;
+    gchar *body_digest;
+    const gchar *header_names[] = {
+        "Content-Type",
+        "Content-Transfer-Encoding",
+        "Subject",
+        NULL
+    };
+    gint i;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->body_cache_key)
+        return priv->body_cache_key;
+
+    if (priv->body_checksum)
+        checksum = g_checksum_copy(priv->body_checksum);
+    else
+        checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    if (priv->end_of_message_chunk && priv->end_of_message_size > 0)
+        g_checksum_update(checksum,
+                          (const guchar *)priv->end_of_message_chunk,
+                          priv->end_of_message_size);
+    body_digest = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+
+    checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    for (i = 0; header_names[i]; i++) {
+        MilterHeader *header = NULL;
+
+        if (priv->original_headers)
+            header = milter_headers_lookup_by_name(priv->original_headers,
+                                                   header_names[i]);
+        g_checksum_update(checksum, (const guchar *)header_names[i], -1);
+        g_checksum_update(checksum, (const guchar *)"\n", 1);
+        if (header && header->value)
+            g_checksum_update(checksum, (const guchar *)header->value, -1);
+        g_checksum_update(checksum, (const guchar *)"\n", 1);
+    }
+    priv->body_cache_key = g_strdup_printf("%s:%s",
+                                           body_digest,
+                                           g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+    g_free(body_digest);
+
+    return priv->body_cache_key;
+}
+
+/*
+ * Remembers the child's own end-of-message verdict for the
+ * message content. Verdicts with modifications aren't
+ * remembered because they can't be replayed.
+ */
+static void
+store_body_verdict (MilterManagerChildren *children,
+                    MilterServerContext *context,
+                    MilterStatus status)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerVerdictCache *cache;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->message_modified || priv->replaced_body)
+        return;
+
+    cache = milter_manager_child_get_body_cache(MILTER_MANAGER_CHILD(context));
+    if (!cache)
+        return;
+
+    milter_manager_verdict_cache_store_key(cache,
+                                           get_body_cache_key(children),
+                                           status);
+}
+
+/*
+ * Handles the cached end-of-message verdict for the message
+ * content instead of sending the rest of the message to the
+ * child.
+ */
+static gboolean
+apply_cached_body_verdict (MilterManagerChildren *children,
+                           MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerVerdictCache *cache;
+    MilterStatus status;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->state != MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE)
+        return FALSE;
+    if (priv->replaced_body)
+        return FALSE;
+
+    cache = milter_manager_child_get_body_cache(MILTER_MANAGER_CHILD(context));
+    if (!cache)
+        return FALSE;
+
+    status = milter_manager_verdict_cache_lookup_key(cache,
+                                                     get_body_cache_key(children));
+    if (status == MILTER_STATUS_NOT_CHANGE)
+        return FALSE;
+
+    if (milter_need_debug_log()) {
+        gchar *status_name;
+
+        status_name = milter_utils_get_enum_nick_name(MILTER_TYPE_STATUS,
+                                                      status);
+        milter_debug("[%u] [children][body-cache][hit] [%u] <%s>: %s",
+                     priv->tag,
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     status_name,
+                     milter_server_context_get_name(context));
+        g_free(status_name);
+    }
+
+    priv->sending_body = FALSE;
+    priv->processing_state = MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE;
+    milter_server_context_abort(context);
+    milter_server_context_set_state(context,
+                                    MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE);
+    priv->ignore_verdict = TRUE;
+    switch (status) {
+    case MILTER_STATUS_CONTINUE:
+        cb_continue(context, children);
+        break;
+    case MILTER_STATUS_TEMPORARY_FAILURE:
+        cb_temporary_failure(context, children);
+        break;
+    case MILTER_STATUS_ACCEPT:
+        cb_accept(context, children);
+        break;
+    case MILTER_STATUS_DISCARD:
+        cb_discard(context, children);
+        break;
+    default:
+        cb_reject(context, children);
+        break;
+    }
+    priv->ignore_verdict = FALSE;
+
+    return TRUE;
+}
+
 static MilterStatus
 send_command_to_child (MilterManagerChildren *children,
                        MilterServerContext *context,
@@ -1171,6 +1591,10 @@ send_command_to_child (MilterManagerChildren *children,
     status = milter_manager_child_get_fallback_status(child);
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    MILTER_PROBE3(child__send,
+                  priv->tag,
+                  milter_server_context_get_name(context),
+                  command);
     switch (command) {
     case MILTER_COMMAND_HEADER:
         status = send_next_header_to_child(children, context);
@@ -1186,11 +1610,20 @@ send_command_to_child (MilterManagerChildren *children,
         }
         break;
     case MILTER_COMMAND_BODY:
+        if (apply_cached_body_verdict(children, context)) {
+            status = MILTER_STATUS_PROGRESS;
+            break;
+        }
         status = send_body_to_child(children, context);
         break;
     case MILTER_COMMAND_END_OF_MESSAGE:
         priv->processing_header_index = 0;
+        if (apply_cached_body_verdict(children, context)) {
+            status = MILTER_STATUS_PROGRESS;
+            break;
+        }
         priv->processing_state = MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE;
+        priv->message_modified = FALSE;
         if (milter_server_context_end_of_message(context,
                                                  priv->end_of_message_chunk,
                                                  priv->end_of_message_size))
@@ -1352,6 +1785,44 @@ send_first_command_to_next_child (MilterManagerChildren *children,
     return MILTER_STATUS_PROGRESS;
 }
 
+/*
+ * Remembers the child's own verdict for CONNECT or HELO so
+ * that the next sessions from the same SMTP client don't
+ * need to ask the child. END_OF_MESSAGE verdicts are
+ * remembered by store_body_verdict().
+ */
+static void
+store_verdict (MilterManagerChildren *children,
+               MilterServerContext *context,
+               MilterServerContextState state,
+               MilterStatus status)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerVerdictCache *cache;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (priv->ignore_verdict)
+        return;
+    if (state == MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE) {
+        store_body_verdict(children, context, status);
+        return;
+    }
+    if (state != MILTER_SERVER_CONTEXT_STATE_CONNECT &&
+        state != MILTER_SERVER_CONTEXT_STATE_HELO)
+        return;
+
+    cache = milter_manager_child_get_verdict_cache(MILTER_MANAGER_CHILD(context));
+    if (!cache)
+        return;
+
+    milter_manager_verdict_cache_store(cache,
+                                       priv->smtp_client_address,
+                                       priv->smtp_client_address_length,
+                                       state == MILTER_SERVER_CONTEXT_STATE_HELO ?
+                                       priv->helo_fqdn : NULL,
+                                       status);
+}
+
 static void
 handle_status (MilterManagerChildren *children,
                MilterStatus status)
@@ -1372,7 +1843,10 @@ cb_continue (MilterServerContext *context, gpointer user_data)
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_CONTINUE);
     state = milter_server_context_get_state(context);
+    if (state == MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE)
+        store_verdict(children, context, state, MILTER_STATUS_CONTINUE);
     compile_reply_status(children, state, MILTER_STATUS_CONTINUE);
 
     switch (state) {
@@ -1422,7 +1896,9 @@ cb_temporary_failure (MilterServerContext *context, gpointer user_data)
     gboolean evaluation_mode;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_TEMPORARY_FAILURE);
     state = milter_server_context_get_state(context);
+    store_verdict(children, context, state, MILTER_STATUS_TEMPORARY_FAILURE);
 
     evaluation_mode =
         milter_manager_child_is_evaluation_mode(MILTER_MANAGER_CHILD(context));
@@ -1493,7 +1969,9 @@ cb_reject (MilterServerContext *context, gpointer user_data)
     gboolean evaluation_mode;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_REJECT);
     state = milter_server_context_get_state(context);
+    store_verdict(children, context, state, MILTER_STATUS_REJECT);
 
     evaluation_mode =
         milter_manager_child_is_evaluation_mode(MILTER_MANAGER_CHILD(context));
@@ -1562,19 +2040,25 @@ cb_reply_code (MilterServerContext *context,
 {
     MilterManagerChildren *children = user_data;
     MilterManagerChildrenPrivate *priv;
+    gboolean ignore_verdict;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, code);
     dispose_reply_related_data(priv);
     priv->reply_code = code;
     priv->reply_extended_code = g_strdup(extended_code);
     priv->reply_message = g_strdup(message);
 
+    /* The verdict cache doesn't keep custom replies. */
+    ignore_verdict = priv->ignore_verdict;
+    priv->ignore_verdict = TRUE;
     if ((priv->reply_code / 100) == 4) {
         cb_temporary_failure(context, user_data);
     } else {
         cb_reject(context, user_data);
     }
+    priv->ignore_verdict = ignore_verdict;
 }
 
 static void
@@ -1585,7 +2069,9 @@ cb_accept (MilterServerContext *context, gpointer user_data)
     MilterServerContextState state;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_ACCEPT);
     state = milter_server_context_get_state(context);
+    store_verdict(children, context, state, MILTER_STATUS_ACCEPT);
 
     compile_reply_status(children, state, MILTER_STATUS_ACCEPT);
     switch (state) {
@@ -1637,7 +2123,9 @@ cb_discard (MilterServerContext *context, gpointer user_data)
     gboolean evaluation_mode;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_DISCARD);
     state = milter_server_context_get_state(context);
+    store_verdict(children, context, state, MILTER_STATUS_DISCARD);
 
     evaluation_mode =
         milter_manager_child_is_evaluation_mode(MILTER_MANAGER_CHILD(context));
@@ -1700,6 +2188,7 @@ cb_skip (MilterServerContext *context, gpointer user_data)
     MilterServerContextState state;
     MilterManagerChildrenPrivate *priv;
 
+    MILTER_MANAGER_CHILDREN_PROBE_REPLY(children, context, MILTER_STATUS_SKIP);
     state = milter_server_context_get_state(context);
 
     compile_reply_status(children, state, MILTER_STATUS_SKIP);
@@ -1756,8 +2245,11 @@ is_end_of_message_state (MilterManagerChildren *children,
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
     state = milter_server_context_get_state(context);
 
-    if (state == MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE)
+    if (state == MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE) {
+        if (!g_str_equal(requested_action_name, "progress"))
+            priv->message_modified = TRUE;
         return TRUE;
+    }
 
     if (milter_need_error_log()) {
         gchar *state_name;
@@ -2204,6 +2696,10 @@ cb_writing_timeout (MilterServerContext *context, gpointer user_data)
     state = milter_server_context_get_state(context);
     child = MILTER_MANAGER_CHILD(context);
     fallback_status = milter_manager_child_get_fallback_status(child);
+    MILTER_PROBE3(child__timeout,
+                  priv->tag,
+                  milter_server_context_get_name(context),
+                  state);
 
     if (milter_need_error_log()) {
         gchar *state_name;
@@ -2226,6 +2722,7 @@ cb_writing_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    record_circuit_breaker_failure(children, context);
     expire_child(children, context);
     remove_child_from_queue(children, context);
 }
@@ -2244,6 +2741,10 @@ cb_reading_timeout (MilterServerContext *context, gpointer user_data)
     state = milter_server_context_get_state(context);
     child = MILTER_MANAGER_CHILD(context);
     fallback_status = milter_manager_child_get_fallback_status(child);
+    MILTER_PROBE3(child__timeout,
+                  priv->tag,
+                  milter_server_context_get_name(context),
+                  state);
 
     if (milter_need_error_log()) {
         gchar *state_name;
@@ -2266,6 +2767,7 @@ cb_reading_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    record_circuit_breaker_failure(children, context);
     expire_child(children, context);
     remove_child_from_queue(children, context);
 }
@@ -2284,6 +2786,10 @@ cb_end_of_message_timeout (MilterServerContext *context, gpointer user_data)
     state = milter_server_context_get_state(context);
     child = MILTER_MANAGER_CHILD(context);
     fallback_status = milter_manager_child_get_fallback_status(child);
+    MILTER_PROBE3(child__timeout,
+                  priv->tag,
+                  milter_server_context_get_name(context),
+                  state);
 
     if (milter_need_error_log()) {
         gchar *state_name;
@@ -2307,6 +2813,7 @@ cb_end_of_message_timeout (MilterServerContext *context, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    record_circuit_breaker_failure(children, context);
     expire_child(children, context);
     remove_child_from_queue(children, context);
 }
@@ -2350,6 +2857,7 @@ cb_error (MilterErrorEmittable *emittable, GError *error, gpointer user_data)
     }
 
     compile_reply_status(children, state, fallback_status);
+    record_circuit_breaker_failure(children, context);
     expire_child(children, context);
     remove_child_from_queue(children, context);
 }
@@ -2374,6 +2882,7 @@ cb_finished (MilterAgent *agent, gpointer user_data)
         state = milter_server_context_get_state(context);
         milter_server_context_set_status(context, fallback_status);
         compile_reply_status(children, state, fallback_status);
+        record_circuit_breaker_failure(children, context);
     }
 
     expire_child(children, context);
@@ -2417,6 +2926,36 @@ cb_finished (MilterAgent *agent, gpointer user_data)
     }
 }
 
+static void
+cb_latency_observed (MilterServerContext *context,
+                     MilterServerContextTimeoutType type,
+                     gdouble elapsed,
+                     gpointer user_data)
+{
+    MilterManagerChildren *children = user_data;
+    MilterManagerChildrenPrivate *priv;
+    gdouble *slowest_reply_time;
+
+    if (type != MILTER_SERVER_CONTEXT_TIMEOUT_READING &&
+        type != MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE)
+        return;
+    /* Negotiation isn't a command exchange with the milter. */
+    if (milter_server_context_get_state(context) ==
+        MILTER_SERVER_CONTEXT_STATE_NEGOTIATE)
+        return;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    slowest_reply_time = g_hash_table_lookup(priv->slowest_reply_times,
+                                             context);
+    if (!slowest_reply_time) {
+        slowest_reply_time = g_new0(gdouble, 1);
+        g_hash_table_insert(priv->slowest_reply_times,
+                            context, slowest_reply_time);
+    }
+    if (elapsed > *slowest_reply_time)
+        *slowest_reply_time = elapsed;
+}
+
 static void
 setup_server_context_signals (MilterManagerChildren *children,
                               MilterServerContext *server_context)
@@ -2451,6 +2990,7 @@ setup_server_context_signals (MilterManagerChildren *children,
     CONNECT(writing_timeout);
     CONNECT(reading_timeout);
     CONNECT(end_of_message_timeout);
+    CONNECT(latency_observed);
 
     CONNECT(error);
     CONNECT(finished);
@@ -2492,6 +3032,7 @@ teardown_server_context_signals (MilterManagerChild *child,
     DISCONNECT(writing_timeout);
     DISCONNECT(reading_timeout);
     DISCONNECT(end_of_message_timeout);
+    DISCONNECT(latency_observed);
 
     DISCONNECT(error);
     DISCONNECT(finished);
@@ -2684,6 +3225,17 @@ reply_negotiate (MilterManagerChildren *children)
                               (MILTER_STEP_YES_MASK &
                                ~(priv->initial_yes_steps &
                                  priv->requested_yes_steps)));
+    /*
+     * Children receive body chunks split by their own
+     * negotiated maximum data size. So we can always accept
+     * the largest data size offered by MTA.
+     */
+    milter_option_remove_step(priv->option, MILTER_STEP_MAX_DATA_SIZE_MASK);
+    if (priv->initial_max_data_size_steps & MILTER_STEP_MAX_DATA_SIZE_1M)
+        milter_option_add_step(priv->option, MILTER_STEP_MAX_DATA_SIZE_1M);
+    else if (priv->initial_max_data_size_steps &
+             MILTER_STEP_MAX_DATA_SIZE_256K)
+        milter_option_add_step(priv->option, MILTER_STEP_MAX_DATA_SIZE_256K);
     g_signal_emit_by_name(children, "negotiate-reply",
                           priv->option, priv->macros_requests);
 
@@ -2717,6 +3269,8 @@ clear_try_negotiate_data (NegotiateData *data)
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(data->children);
 
     remove_queue_in_negotiate(data->children, data->child);
+    record_circuit_breaker_failure(data->children,
+                                   MILTER_SERVER_CONTEXT(data->child));
     expire_child(data->children, MILTER_SERVER_CONTEXT(data->child));
     g_hash_table_remove(priv->try_negotiate_ids, data);
 }
@@ -2732,6 +3286,8 @@ cb_connection_timeout (MilterServerContext *context, gpointer user_data)
                  priv->tag,
                  milter_agent_get_tag(MILTER_AGENT(context)),
                  milter_server_context_get_name(context));
+    if (failover_negotiate(data))
+        return;
     clear_try_negotiate_data(data);
 }
 
@@ -2751,6 +3307,9 @@ cb_connection_error (MilterErrorEmittable *emittable, GError *error, gpointer us
                  error->message,
                  milter_server_context_get_name(context));
 
+    if (failover_negotiate(data))
+        return;
+
     /* ignore MILTER_MANAGER_CHILD_ERROR_MILTER_EXIT */
     if (error->domain != MILTER_SERVER_CONTEXT_ERROR ||
         data->is_retry) {
@@ -2904,30 +3463,938 @@ prepare_negotiate (MilterManagerChild *child,
 }
 
 static gboolean
-child_establish_connection (MilterManagerChild *child,
-                            MilterOption *option,
-                            MilterManagerChildren *children,
-                            gboolean is_retry)
+cb_idle_bypass_child (gpointer user_data)
+{
+    NegotiateData *data = user_data;
+
+    clear_try_negotiate_data(data);
+
+    return FALSE;
+}
+
+static gboolean
+is_circuit_breaker_open (MilterManagerChildren *children,
+                         MilterManagerChild *child)
 {
     MilterManagerChildrenPrivate *priv;
+    MilterManagerCircuitBreaker *breaker;
     MilterServerContext *context;
-    GError *error = NULL;
 
+    breaker = milter_manager_child_get_circuit_breaker(child);
+    if (!breaker)
+        return FALSE;
+
+    if (milter_manager_circuit_breaker_try(breaker))
+        return FALSE;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
     context = MILTER_SERVER_CONTEXT(child);
+    milter_info("[%u] [children][circuit-breaker][bypass] [%u] %s",
+                priv->tag,
+                milter_agent_get_tag(MILTER_AGENT(context)),
+                milter_server_context_get_name(context));
+    return TRUE;
+}
+
+/*
+ * Expires a child whose circuit breaker is open without
+ * connecting to it. It is expired in the next iteration
+ * like other connection failures so that negotiate reply
+ * isn't emitted in milter_manager_children_negotiate().
+ */
+static void
+prepare_bypass_child (MilterManagerChild *child,
+                      MilterOption *option,
+                      MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    NegotiateData *negotiate_data;
+    NegotiateTimeoutID *negotiate_timeout_id;
+    guint idle_id;
+
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
-    if (!milter_server_context_establish_connection(context, &error)) {
-        milter_error("[%u] [children][error][connection] [%u] %s: %s",
-                     priv->tag,
+    /* Bypassing isn't a result of the milter. */
+    mark_circuit_breaker_recorded(children, MILTER_SERVER_CONTEXT(child));
+
+    negotiate_data = negotiate_data_new(children, child, option, TRUE);
+    idle_id = milter_event_loop_add_idle_full(priv->event_loop,
+                                              G_PRIORITY_DEFAULT,
+                                              cb_idle_bypass_child,
+                                              negotiate_data,
+                                              NULL);
+    negotiate_timeout_id =
+        negotiate_timeout_id_new(priv->event_loop, idle_id);
+
+    g_hash_table_insert(priv->try_negotiate_ids,
+                        negotiate_data, negotiate_timeout_id);
+}
+
+static void
+negotiate_child (MilterManagerChild *child,
+                 MilterOption *option,
+                 MilterManagerChildren *children,
+                 gboolean privilege)
+{
+    if (!child_establish_connection(child, option, children, FALSE)) {
+        if (privilege &&
+            milter_manager_children_start_child(children, child)) {
+            prepare_retry_establish_connection(child, option, children,
+                                               FALSE);
+        }
+    }
+}
+
+static gboolean
+acquire_session_limiter (MilterManagerChildren *children,
+                         MilterManagerChild *child)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerSessionLimiter *limiter;
+
+    limiter = milter_manager_child_get_session_limiter(child);
+    if (!limiter)
+        return TRUE;
+
+    if (!milter_manager_session_limiter_acquire(limiter))
+        return FALSE;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    g_hash_table_insert(priv->session_limited_children,
+                        child, g_object_ref(limiter));
+    return TRUE;
+}
+
+static gboolean
+cb_idle_negotiate_waited_child (gpointer user_data)
+{
+    NegotiateData *data = user_data;
+    MilterManagerChildren *children;
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerChild *child;
+    MilterOption *option;
+    gboolean privilege;
+
+    children = data->children;
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    child = g_object_ref(data->child);
+    option = g_object_ref(data->option);
+    g_hash_table_remove(priv->try_negotiate_ids, data);
+
+    privilege =
+        milter_manager_configuration_is_privilege_mode(priv->configuration);
+    negotiate_child(child, option, children, privilege);
+
+    g_object_unref(child);
+    g_object_unref(option);
+
+    return FALSE;
+}
+
+static void
+prepare_idle_negotiate (NegotiateData *data)
+{
+    MilterManagerChildrenPrivate *priv;
+    NegotiateTimeoutID *negotiate_timeout_id;
+    guint idle_id;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(data->children);
+
+    negotiate_timeout_id = g_hash_table_lookup(priv->try_negotiate_ids, data);
+    g_hash_table_steal(priv->try_negotiate_ids, data);
+    if (negotiate_timeout_id)
+        negotiate_timeout_id_free(negotiate_timeout_id);
+    idle_id = milter_event_loop_add_idle_full(priv->event_loop,
+                                              G_PRIORITY_DEFAULT,
+                                              cb_idle_negotiate_waited_child,
+                                              data,
+                                              NULL);
+    g_hash_table_insert(priv->try_negotiate_ids,
+                        data,
+                        negotiate_timeout_id_new(priv->event_loop, idle_id));
+}
+
+static void
+cb_session_limiter_ready (gpointer user_data)
+{
+    NegotiateData *data = user_data;
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerSessionLimiter *limiter;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(data->children);
+
+    g_hash_table_remove(priv->session_limiter_wait_ids, data);
+    limiter = milter_manager_child_get_session_limiter(data->child);
+    g_hash_table_insert(priv->session_limited_children,
+                        data->child, g_object_ref(limiter));
+
+    /* Connect in the next iteration because this may be
+     * called while another session releases its slot. */
+    prepare_idle_negotiate(data);
+}
+
+/*
+ * Switches the child to another replica when the current
+ * one can't be connected. The connection is retried in the
+ * next iteration because this is called from the signal
+ * handlers of the failed connection.
+ */
+static gboolean
+failover_negotiate (NegotiateData *data)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context;
+
+    if (!milter_manager_child_failover(data->child))
+        return FALSE;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(data->children);
+    context = MILTER_SERVER_CONTEXT(data->child);
+    milter_info("[%u] [children][replica][failover] [%u] <%d>: %s",
+                priv->tag,
+                milter_agent_get_tag(MILTER_AGENT(context)),
+                milter_manager_child_get_replica_index(data->child),
+                milter_server_context_get_name(context));
+    prepare_idle_negotiate(data);
+    return TRUE;
+}
+
+static gboolean
+cb_session_limiter_wait_timeout (gpointer user_data)
+{
+    NegotiateData *data = user_data;
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerSessionLimiter *limiter;
+    MilterServerContext *context;
+    gpointer wait_id;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(data->children);
+    context = MILTER_SERVER_CONTEXT(data->child);
+
+    wait_id = g_hash_table_lookup(priv->session_limiter_wait_ids, data);
+    g_hash_table_remove(priv->session_limiter_wait_ids, data);
+    limiter = milter_manager_child_get_session_limiter(data->child);
+    milter_manager_session_limiter_cancel(limiter, GPOINTER_TO_UINT(wait_id));
+
+    milter_info("[%u] [children][session-limiter][timeout] [%u] %s",
+                priv->tag,
+                milter_agent_get_tag(MILTER_AGENT(context)),
+                milter_server_context_get_name(context));
+
+    /* Saturation isn't a result of the milter. */
+    mark_circuit_breaker_recorded(data->children, context);
+    clear_try_negotiate_data(data);
+
+    return FALSE;
+}
+
+/*
+ * Waits for a slot of the child's session limiter. If too
+ * many sessions are already waiting, the child is bypassed
+ * and its fallback status is used.
+ */
+static void
+prepare_wait_session_limiter (MilterManagerChild *child,
+                              MilterOption *option,
+                              MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerSessionLimiter *limiter;
+    NegotiateData *negotiate_data;
+    NegotiateTimeoutID *negotiate_timeout_id;
+    guint wait_id, timeout_id;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    limiter = milter_manager_child_get_session_limiter(child);
+
+    negotiate_data = negotiate_data_new(children, child, option, FALSE);
+    wait_id = milter_manager_session_limiter_wait_full(limiter,
+                                                       priv->event_loop,
+                                                       cb_session_limiter_ready,
+                                                       negotiate_data);
+    if (wait_id == 0) {
+        MilterServerContext *context = MILTER_SERVER_CONTEXT(child);
+
+        milter_info("[%u] [children][session-limiter][full] [%u] %s",
+                    priv->tag,
+                    milter_agent_get_tag(MILTER_AGENT(context)),
+                    milter_server_context_get_name(context));
+        negotiate_data_free(negotiate_data);
+        prepare_bypass_child(child, option, children);
+        return;
+    }
+
+    g_hash_table_insert(priv->session_limiter_wait_ids,
+                        negotiate_data, GUINT_TO_POINTER(wait_id));
+    timeout_id =
+        milter_event_loop_add_timeout(priv->event_loop,
+                                      milter_manager_session_limiter_get_max_wait_time(limiter),
+                                      cb_session_limiter_wait_timeout,
+                                      negotiate_data);
+    negotiate_timeout_id =
+        negotiate_timeout_id_new(priv->event_loop, timeout_id);
+    g_hash_table_insert(priv->try_negotiate_ids,
+                        negotiate_data, negotiate_timeout_id);
+}
+
+static void
+apply_session_deadline (MilterManagerChildren *children,
+                        MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    gdouble session_deadline, rest;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->configuration)
+        return;
+
+    session_deadline =
+        milter_manager_configuration_get_session_deadline(priv->configuration);
+    if (session_deadline <= 0)
+        return;
+
+    rest = session_deadline - g_timer_elapsed(priv->session_timer, NULL);
+    if (rest <= 0)
+        rest = 0.001;
+    milter_debug("[%u] [children][session-deadline] [%u] <%g>: %s",
+                 priv->tag,
+                 milter_agent_get_tag(MILTER_AGENT(context)),
+                 rest,
+                 milter_server_context_get_name(context));
+    milter_server_context_set_deadline(context, rest);
+}
+
+/*
+ * A connection may carry several messages. Each message
+ * gets the full deadline from its MAIL FROM.
+ */
+static void
+restart_session_deadline (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    g_timer_start(priv->session_timer);
+    for (node = priv->milters; node; node = g_list_next(node)) {
+        MilterServerContext *context = MILTER_SERVER_CONTEXT(node->data);
+
+        if (!milter_server_context_is_quitted(context))
+            apply_session_deadline(children, context);
+    }
+}
+
+typedef struct _HedgeData HedgeData;
+struct _HedgeData
+{
+    MilterManagerChildren *children;
+    MilterManagerChild *child;
+    MilterManagerChild *standby;
+    MilterEventLoop *loop;
+    MilterServerContextState state;
+    guint timeout_id;
+    guint swap_id;
+    gboolean racing;
+    gboolean won;
+    MilterStatus status;
+    guint reply_code;
+    gchar *reply_extended_code;
+    gchar *reply_message;
+};
+
+static gboolean
+cb_idle_unref_standby (gpointer user_data)
+{
+    g_object_unref(user_data);
+    return FALSE;
+}
+
+static void
+hedge_data_free (HedgeData *hedge)
+{
+    if (hedge->timeout_id > 0)
+        milter_event_loop_remove(hedge->loop, hedge->timeout_id);
+    if (hedge->swap_id > 0)
+        milter_event_loop_remove(hedge->loop, hedge->swap_id);
+
+    if (hedge->standby) {
+        MilterServerContext *context = MILTER_SERVER_CONTEXT(hedge->standby);
+
+        g_signal_handlers_disconnect_matched(hedge->standby,
+                                             G_SIGNAL_MATCH_DATA,
+                                             0, 0, NULL, NULL, hedge);
+        milter_manager_child_end_replica(hedge->standby,
+                                         TRUE,
+                                         milter_server_context_get_elapsed(context));
+        if (milter_server_context_is_negotiated(context) &&
+            !milter_server_context_is_quitted(context))
+            milter_server_context_quit(context);
+        /* This may be called while the standby emits a signal. */
+        milter_event_loop_add_idle_full(hedge->loop,
+                                        G_PRIORITY_DEFAULT,
+                                        cb_idle_unref_standby,
+                                        hedge->standby,
+                                        NULL);
+    }
+
+    g_object_unref(hedge->child);
+    g_object_unref(hedge->loop);
+    g_free(hedge->reply_extended_code);
+    g_free(hedge->reply_message);
+    g_free(hedge);
+}
+
+static void
+hedge_data_hash_value_free (gpointer data)
+{
+    hedge_data_free(data);
+}
+
+static void
+cancel_hedge (MilterManagerChildren *children,
+              MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    g_hash_table_remove(priv->hedges, context);
+}
+
+static void
+abandon_hedge (HedgeData *hedge, const gchar *reason)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(hedge->children);
+    milter_info("[%u] [children][hedge][abandon][%s] [%u] %s",
+                priv->tag,
+                reason,
+                milter_agent_get_tag(MILTER_AGENT(hedge->child)),
+                milter_server_context_get_name(MILTER_SERVER_CONTEXT(hedge->child)));
+    g_hash_table_remove(priv->hedges, hedge->child);
+}
+
+static void
+swap_hedged_child (MilterManagerChildren *children, HedgeData *hedge)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context, *standby_context;
+    MilterManagerSessionLimiter *limiter;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    context = MILTER_SERVER_CONTEXT(hedge->child);
+    standby_context = MILTER_SERVER_CONTEXT(hedge->standby);
+
+    /* A slow reply isn't a failure of the milter. */
+    teardown_server_context_signals(hedge->child, children);
+    mark_circuit_breaker_recorded(children, context);
+    milter_manager_child_end_replica(hedge->child,
+                                     TRUE,
+                                     milter_server_context_get_elapsed(context));
+    milter_server_context_quit(context);
+
+    node = g_list_find(priv->milters, hedge->child);
+    if (node) {
+        node->data = g_object_ref(hedge->standby);
+        g_object_unref(hedge->child);
+    }
+    g_object_unref(hedge->standby);
+    node = g_queue_find(priv->reply_queue, hedge->child);
+    if (node)
+        node->data = hedge->standby;
+
+    limiter = g_hash_table_lookup(priv->session_limited_children, context);
+    if (limiter) {
+        g_hash_table_steal(priv->session_limited_children, context);
+        g_hash_table_insert(priv->session_limited_children,
+                            hedge->standby, limiter);
+    }
+
+    setup_server_context_signals(children, standby_context);
+}
+
+static gboolean
+cb_idle_hedge_swap (gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+    MilterManagerChildren *children;
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context;
+
+    children = hedge->children;
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    hedge->swap_id = 0;
+
+    if (priv->processing_state != hedge->state ||
+        !g_queue_find(priv->reply_queue, hedge->child)) {
+        abandon_hedge(hedge, "expired");
+        return FALSE;
+    }
+
+    g_hash_table_steal(priv->hedges, hedge->child);
+    g_signal_handlers_disconnect_matched(hedge->standby,
+                                         G_SIGNAL_MATCH_DATA,
+                                         0, 0, NULL, NULL, hedge);
+
+    milter_info("[%u] [children][hedge][win] [%u] <%d>: %s",
+                priv->tag,
+                milter_agent_get_tag(MILTER_AGENT(hedge->standby)),
+                milter_manager_child_get_replica_index(hedge->standby),
+                milter_server_context_get_name(MILTER_SERVER_CONTEXT(hedge->standby)));
+    swap_hedged_child(children, hedge);
+
+    context = MILTER_SERVER_CONTEXT(hedge->standby);
+    switch (hedge->status) {
+    case MILTER_STATUS_CONTINUE:
+        cb_continue(context, children);
+        break;
+    case MILTER_STATUS_ACCEPT:
+        cb_accept(context, children);
+        break;
+    case MILTER_STATUS_DISCARD:
+        cb_discard(context, children);
+        break;
+    case MILTER_STATUS_TEMPORARY_FAILURE:
+        if (hedge->reply_code > 0)
+            cb_reply_code(context, hedge->reply_code,
+                          hedge->reply_extended_code, hedge->reply_message,
+                          children);
+        else
+            cb_temporary_failure(context, children);
+        break;
+    default:
+        if (hedge->reply_code > 0)
+            cb_reply_code(context, hedge->reply_code,
+                          hedge->reply_extended_code, hedge->reply_message,
+                          children);
+        else
+            cb_reject(context, children);
+        break;
+    }
+
+    hedge->standby = NULL;
+    hedge_data_free(hedge);
+
+    return FALSE;
+}
+
+/*
+ * The standby replied to the hedged command first. The
+ * children are switched in the next iteration because this
+ * is called while the standby emits the reply.
+ */
+static void
+win_hedge (HedgeData *hedge, MilterStatus status)
+{
+    hedge->won = TRUE;
+    hedge->status = status;
+    hedge->swap_id = milter_event_loop_add_idle_full(hedge->loop,
+                                                     G_PRIORITY_DEFAULT,
+                                                     cb_idle_hedge_swap,
+                                                     hedge,
+                                                     NULL);
+}
+
+static void
+replay_hedge (HedgeData *hedge)
+{
+    MilterServerContext *standby_context;
+
+    standby_context = MILTER_SERVER_CONTEXT(hedge->standby);
+    /* The last replayed command is the hedged command. */
+    if (milter_server_context_get_n_replay_commands(standby_context) == 1)
+        hedge->racing = TRUE;
+    if (!milter_server_context_replay_next(standby_context))
+        abandon_hedge(hedge, "replay");
+}
+
+static void
+cb_hedge_ready (MilterServerContext *context, gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(hedge->children);
+    milter_server_context_negotiate(context, priv->option);
+}
+
+static void
+cb_hedge_negotiate_reply (MilterServerContext *context,
+                          MilterOption *option,
+                          MilterMacrosRequests *macros_requests,
+                          gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+
+    milter_server_context_prepare_replay(context,
+                                         MILTER_SERVER_CONTEXT(hedge->child));
+    replay_hedge(hedge);
+}
+
+static void
+cb_hedge_continue (MilterServerContext *context, gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+
+    if (hedge->won)
+        return;
+
+    if (hedge->racing)
+        win_hedge(hedge, MILTER_STATUS_CONTINUE);
+    else
+        replay_hedge(hedge);
+}
+
+#define DEFINE_HEDGE_REPLY_HANDLER(name, STATUS)                        \
+static void                                                             \
+cb_hedge_ ## name (MilterServerContext *context, gpointer user_data)    \
+{                                                                       \
+    HedgeData *hedge = user_data;                                       \
+                                                                        \
+    if (hedge->won)                                                     \
+        return;                                                         \
+                                                                        \
+    if (hedge->racing)                                                  \
+        win_hedge(hedge, MILTER_STATUS_ ## STATUS);                     \
+    else                                                                \
+        abandon_hedge(hedge, "replay-" #name);                          \
+}
+
+DEFINE_HEDGE_REPLY_HANDLER(reject, REJECT)
+DEFINE_HEDGE_REPLY_HANDLER(temporary_failure, TEMPORARY_FAILURE)
+DEFINE_HEDGE_REPLY_HANDLER(accept, ACCEPT)
+DEFINE_HEDGE_REPLY_HANDLER(discard, DISCARD)
+
+#undef DEFINE_HEDGE_REPLY_HANDLER
+
+static void
+cb_hedge_reply_code (MilterServerContext *context,
+                     guint code,
+                     const gchar *extended_code,
+                     const gchar *message,
+                     gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+
+    if (hedge->won)
+        return;
+
+    if (!hedge->racing) {
+        abandon_hedge(hedge, "replay-reply-code");
+        return;
+    }
+
+    hedge->reply_code = code;
+    hedge->reply_extended_code = g_strdup(extended_code);
+    hedge->reply_message = g_strdup(message);
+    win_hedge(hedge,
+              (code / 100) == 4 ?
+              MILTER_STATUS_TEMPORARY_FAILURE :
+              MILTER_STATUS_REJECT);
+}
+
+static void
+cb_hedge_failure (MilterServerContext *context, gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+
+    if (hedge->won)
+        return;
+
+    milter_manager_child_end_replica(hedge->standby, FALSE, 0.0);
+    abandon_hedge(hedge, "failure");
+}
+
+static void
+cb_hedge_error (MilterErrorEmittable *emittable,
+                GError *error,
+                gpointer user_data)
+{
+    cb_hedge_failure(MILTER_SERVER_CONTEXT(emittable), user_data);
+}
+
+static MilterManagerChild *
+hatch_standby (MilterManagerChildren *children, MilterManagerChild *child)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerEgg *egg;
+    MilterManagerChild *standby;
+    const gchar *name;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    name = milter_server_context_get_name(MILTER_SERVER_CONTEXT(child));
+    egg = milter_manager_configuration_find_egg(priv->configuration, name);
+    if (!egg)
+        return NULL;
+
+    standby = milter_manager_egg_hatch(egg);
+    if (!standby)
+        return NULL;
+
+    if (milter_manager_child_get_replica_index(standby) ==
+        milter_manager_child_get_replica_index(child) &&
+        !milter_manager_child_failover(standby)) {
+        g_object_unref(standby);
+        return NULL;
+    }
+
+    milter_agent_set_tag(MILTER_AGENT(standby), priv->tag);
+    milter_agent_set_event_loop(MILTER_AGENT(standby), priv->event_loop);
+    /* The standby may be hedged after it wins. */
+    milter_server_context_set_replay_recording(MILTER_SERVER_CONTEXT(standby),
+                                               TRUE);
+    return standby;
+}
+
+static gboolean
+cb_hedge_timeout (gpointer user_data)
+{
+    HedgeData *hedge = user_data;
+    MilterManagerChildren *children;
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *standby_context;
+    GError *error = NULL;
+
+    children = hedge->children;
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    hedge->timeout_id = 0;
+
+    if (priv->processing_state != hedge->state ||
+        !g_queue_find(priv->reply_queue, hedge->child)) {
+        abandon_hedge(hedge, "expired");
+        return FALSE;
+    }
+
+    hedge->standby = hatch_standby(children, hedge->child);
+    if (!hedge->standby) {
+        abandon_hedge(hedge, "no-standby");
+        return FALSE;
+    }
+
+    standby_context = MILTER_SERVER_CONTEXT(hedge->standby);
+    milter_info("[%u] [children][hedge][start] [%u] <%d>: %s",
+                priv->tag,
+                milter_agent_get_tag(MILTER_AGENT(hedge->child)),
+                milter_manager_child_get_replica_index(hedge->standby),
+                milter_server_context_get_name(standby_context));
+
+#define CONNECT(name, callback)                                 \
+    g_signal_connect(hedge->standby, name,                      \
+                     G_CALLBACK(callback), hedge)
+
+    CONNECT("ready", cb_hedge_ready);
+    CONNECT("negotiate-reply", cb_hedge_negotiate_reply);
+    CONNECT("continue", cb_hedge_continue);
+    CONNECT("reject", cb_hedge_reject);
+    CONNECT("temporary-failure", cb_hedge_temporary_failure);
+    CONNECT("accept", cb_hedge_accept);
+    CONNECT("discard", cb_hedge_discard);
+    CONNECT("reply-code", cb_hedge_reply_code);
+    CONNECT("connection-timeout", cb_hedge_failure);
+    CONNECT("writing-timeout", cb_hedge_failure);
+    CONNECT("reading-timeout", cb_hedge_failure);
+    CONNECT("error", cb_hedge_error);
+
+#undef CONNECT
+
+    apply_session_deadline(children, standby_context);
+    milter_manager_child_begin_replica(hedge->standby);
+    if (!milter_server_context_establish_connection(standby_context, &error)) {
+        milter_error("[%u] [children][hedge][error][connection] [%u] %s: %s",
+                     priv->tag,
+                     milter_agent_get_tag(MILTER_AGENT(hedge->child)),
+                     error->message,
+                     milter_server_context_get_name(standby_context));
+        g_error_free(error);
+        milter_manager_child_end_replica(hedge->standby, FALSE, 0.0);
+        abandon_hedge(hedge, "connection");
+    }
+
+    return FALSE;
+}
+
+/*
+ * Sends the command to a standby replica too if the child
+ * doesn't reply within its hedge delay. Only envelope
+ * commands are hedged because they don't modify the
+ * message.
+ */
+static void
+prepare_hedge (MilterManagerChildren *children,
+               MilterServerContext *context,
+               MilterServerContextState state)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterManagerChild *child;
+    HedgeData *hedge;
+    gdouble delay;
+
+    child = MILTER_MANAGER_CHILD(context);
+    delay = milter_manager_child_get_hedge_delay(child);
+    if (delay <= 0)
+        return;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->option ||
+        !milter_server_context_is_processing(context) ||
+        !g_queue_find(priv->reply_queue, context) ||
+        !milter_server_context_need_reply(context, state))
+        return;
+
+    hedge = g_new0(HedgeData, 1);
+    hedge->children = children;
+    hedge->child = g_object_ref(child);
+    hedge->loop = g_object_ref(priv->event_loop);
+    hedge->state = state;
+    hedge->status = MILTER_STATUS_NOT_CHANGE;
+    hedge->timeout_id = milter_event_loop_add_timeout(priv->event_loop,
+                                                      delay,
+                                                      cb_hedge_timeout,
+                                                      hedge);
+    g_hash_table_replace(priv->hedges, child, hedge);
+}
+
+static void
+prepare_hedges (MilterManagerChildren *children,
+                GList *targets,
+                MilterServerContextState state)
+{
+    GList *node;
+
+    for (node = targets; node; node = g_list_next(node)) {
+        prepare_hedge(children, MILTER_SERVER_CONTEXT(node->data), state);
+    }
+}
+
+static GHashTable *
+lookup_cached_verdicts (MilterManagerChildren *children,
+                        GList *targets,
+                        MilterServerContextState state)
+{
+    MilterManagerChildrenPrivate *priv;
+    GHashTable *verdicts = NULL;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    for (node = targets; node; node = g_list_next(node)) {
+        MilterServerContext *context = MILTER_SERVER_CONTEXT(node->data);
+        MilterManagerVerdictCache *cache;
+        MilterStatus status;
+
+        cache = milter_manager_child_get_verdict_cache(MILTER_MANAGER_CHILD(context));
+        if (!cache)
+            continue;
+
+        status = milter_manager_verdict_cache_lookup(
+            cache,
+            priv->smtp_client_address,
+            priv->smtp_client_address_length,
+            state == MILTER_SERVER_CONTEXT_STATE_HELO ? priv->helo_fqdn : NULL);
+        if (status == MILTER_STATUS_NOT_CHANGE)
+            continue;
+
+        if (milter_need_debug_log()) {
+            gchar *status_name;
+
+            status_name = milter_utils_get_enum_nick_name(MILTER_TYPE_STATUS,
+                                                          status);
+            milter_debug("[%u] [children][verdict-cache][hit] [%u] <%s>: %s",
+                         priv->tag,
+                         milter_agent_get_tag(MILTER_AGENT(context)),
+                         status_name,
+                         milter_server_context_get_name(context));
+            g_free(status_name);
+        }
+        if (!verdicts)
+            verdicts = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(verdicts, context, GINT_TO_POINTER(status));
+    }
+
+    return verdicts;
+}
+
+static MilterStatus
+get_cached_verdict (GHashTable *verdicts, MilterServerContext *context)
+{
+    if (!verdicts)
+        return MILTER_STATUS_NOT_CHANGE;
+    if (!g_hash_table_lookup_extended(verdicts, context, NULL, NULL))
+        return MILTER_STATUS_NOT_CHANGE;
+    return GPOINTER_TO_INT(g_hash_table_lookup(verdicts, context));
+}
+
+/*
+ * Handles a cached verdict as if the child replied it to the
+ * command that isn't sent to the child.
+ */
+static void
+apply_cached_verdict (MilterManagerChildren *children,
+                      MilterServerContext *context,
+                      MilterServerContextState state,
+                      MilterStatus status)
+{
+    MilterManagerChildrenPrivate *priv;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    milter_server_context_set_state(context, state);
+    priv->ignore_verdict = TRUE;
+    switch (status) {
+    case MILTER_STATUS_TEMPORARY_FAILURE:
+        cb_temporary_failure(context, children);
+        break;
+    case MILTER_STATUS_ACCEPT:
+        cb_accept(context, children);
+        break;
+    case MILTER_STATUS_DISCARD:
+        cb_discard(context, children);
+        break;
+    default:
+        cb_reject(context, children);
+        break;
+    }
+    priv->ignore_verdict = FALSE;
+}
+
+static gboolean
+child_establish_connection (MilterManagerChild *child,
+                            MilterOption *option,
+                            MilterManagerChildren *children,
+                            gboolean is_retry)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterServerContext *context;
+    GError *error = NULL;
+
+    context = MILTER_SERVER_CONTEXT(child);
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+
+    apply_session_deadline(children, context);
+    milter_manager_child_begin_replica(child);
+
+    if (!milter_server_context_establish_connection(context, &error)) {
+        milter_error("[%u] [children][error][connection] [%u] %s: %s",
+                     priv->tag,
                      milter_agent_get_tag(MILTER_AGENT(context)),
                      error->message,
                      milter_server_context_get_name(context));
+        if (milter_manager_child_failover(child)) {
+            milter_info("[%u] [children][replica][failover] [%u] <%d>: %s",
+                        priv->tag,
+                        milter_agent_get_tag(MILTER_AGENT(context)),
+                        milter_manager_child_get_replica_index(child),
+                        milter_server_context_get_name(context));
+            g_error_free(error);
+            return child_establish_connection(child, option, children,
+                                              is_retry);
+        }
         milter_error_emittable_emit(MILTER_ERROR_EMITTABLE(children),
                                     error);
 
         g_error_free(error);
         if (is_retry) {
             remove_queue_in_negotiate(children, child);
+            record_circuit_breaker_failure(children, context);
             expire_child(children, context);
         } else {
             prepare_retry_establish_connection(child, option, children, TRUE);
@@ -3102,6 +4569,9 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
                                       MAX_SUPPORTED_MILTER_PROTOCOL_VERSION);
         }
         priv->initial_yes_steps = milter_option_get_step_yes(priv->option);
+        priv->initial_max_data_size_steps =
+            milter_option_get_step(priv->option) &
+            MILTER_STEP_MAX_DATA_SIZE_MASK;
     }
 
     if (!priv->milters) {
@@ -3116,6 +4586,15 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
         return success;
     }
 
+    /*
+     * Each child's chunks are split by its own negotiated
+     * maximum data size. So every child can be offered the
+     * largest data size even if MTA doesn't offer it.
+     * reply_negotiate() restores the MTA's offer.
+     */
+    if (priv->option)
+        milter_option_add_step(priv->option, MILTER_STEP_MAX_DATA_SIZE_MASK);
+
     privilege =
         milter_manager_configuration_is_privilege_mode(priv->configuration);
 
@@ -3129,13 +4608,17 @@ milter_manager_children_negotiate (MilterManagerChildren *children,
     for (node = copied_milters; node; node = g_list_next(node)) {
         MilterManagerChild *child = MILTER_MANAGER_CHILD(node->data);
 
-        if (!child_establish_connection(child, option, children, FALSE)) {
-            if (privilege &&
-                milter_manager_children_start_child(children, child)) {
-                prepare_retry_establish_connection(child, option, children,
-                                                   FALSE);
-            }
+        if (is_circuit_breaker_open(children, child)) {
+            prepare_bypass_child(child, option, children);
+            continue;
         }
+
+        if (!acquire_session_limiter(children, child)) {
+            prepare_wait_session_limiter(child, option, children);
+            continue;
+        }
+
+        negotiate_child(child, option, children, privilege);
     }
     g_list_free(copied_milters);
 
@@ -3262,6 +4745,7 @@ milter_manager_children_connect (MilterManagerChildren *children,
                                  socklen_t              address_length)
 {
     GList *child, *targets;
+    GHashTable *verdicts;
     MilterManagerChildrenPrivate *priv;
     gboolean success = FALSE;
     gint n_queued_milters;
@@ -3286,8 +4770,13 @@ milter_manager_children_connect (MilterManagerChildren *children,
 
     n_queued_milters = priv->reply_queue->length;
     targets = g_list_copy(priv->reply_queue->head);
+    verdicts = lookup_cached_verdicts(children, targets, state);
     for (child = targets; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
+        if (get_cached_verdict(verdicts, context) != MILTER_STATUS_NOT_CHANGE) {
+            success = TRUE;
+            continue;
+        }
         if (milter_server_context_connect(context,
                                           host_name,
                                           address,
@@ -3295,14 +4784,22 @@ milter_manager_children_connect (MilterManagerChildren *children,
             success = TRUE;
         }
     }
+    prepare_hedges(children, targets, state);
     milter_debug("[%u] [children][connect][sent] %d",
                  priv->tag, n_queued_milters);
     for (child = targets; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
-        if (!milter_server_context_need_reply(context, state)) {
+        MilterStatus verdict;
+
+        verdict = get_cached_verdict(verdicts, context);
+        if (verdict != MILTER_STATUS_NOT_CHANGE) {
+            apply_cached_verdict(children, context, state, verdict);
+        } else if (!milter_server_context_need_reply(context, state)) {
             cb_continue(context, children);
         }
     }
+    if (verdicts)
+        g_hash_table_unref(verdicts);
     g_list_free(targets);
 
     return success;
@@ -3313,6 +4810,7 @@ milter_manager_children_helo (MilterManagerChildren *children,
                               const gchar           *fqdn)
 {
     GList *child, *targets;
+    GHashTable *verdicts;
     MilterManagerChildrenPrivate *priv;
     gboolean success = FALSE;
     gint n_queued_milters;
@@ -3323,6 +4821,10 @@ milter_manager_children_helo (MilterManagerChildren *children,
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    if (priv->helo_fqdn)
+        g_free(priv->helo_fqdn);
+    priv->helo_fqdn = g_strdup(fqdn);
+
     init_reply_queue(children, state);
     for (child = priv->milters; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
@@ -3333,19 +4835,32 @@ milter_manager_children_helo (MilterManagerChildren *children,
 
     n_queued_milters = priv->reply_queue->length;
     targets = g_list_copy(priv->reply_queue->head);
+    verdicts = lookup_cached_verdicts(children, targets, state);
     for (child = targets; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
+        if (get_cached_verdict(verdicts, context) != MILTER_STATUS_NOT_CHANGE) {
+            success = TRUE;
+            continue;
+        }
         if (milter_server_context_helo(context, fqdn))
             success = TRUE;
     }
+    prepare_hedges(children, targets, state);
     milter_debug("[%u] [children][helo][sent] %d",
                  priv->tag, n_queued_milters);
     for (child = targets; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
-        if (!milter_server_context_need_reply(context, state)) {
+        MilterStatus verdict;
+
+        verdict = get_cached_verdict(verdicts, context);
+        if (verdict != MILTER_STATUS_NOT_CHANGE) {
+            apply_cached_verdict(children, context, state, verdict);
+        } else if (!milter_server_context_need_reply(context, state)) {
             cb_continue(context, children);
         }
     }
+    if (verdicts)
+        g_hash_table_unref(verdicts);
     g_list_free(targets);
 
     return success;
@@ -3366,6 +4881,7 @@ milter_manager_children_envelope_from (MilterManagerChildren *children,
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    restart_session_deadline(children);
     init_reply_queue(children, state);
     for (child = priv->milters; child; child = g_list_next(child)) {
         MilterServerContext *context = MILTER_SERVER_CONTEXT(child->data);
@@ -3381,6 +4897,7 @@ milter_manager_children_envelope_from (MilterManagerChildren *children,
         if (milter_server_context_envelope_from(context, from))
             success = TRUE;
     }
+    prepare_hedges(children, targets, state);
     milter_debug("[%u] [children][envelope-from][sent] %d",
                  priv->tag, n_queued_milters);
     for (child = targets; child; child = g_list_next(child)) {
@@ -3425,6 +4942,7 @@ milter_manager_children_envelope_recipient (MilterManagerChildren *children,
         if (milter_server_context_envelope_recipient(context, recipient))
             success = TRUE;
     }
+    prepare_hedges(children, targets, state);
     milter_debug("[%u] [children][envelope-recipient][sent] %d",
                  priv->tag, n_queued_milters);
     for (child = targets; child; child = g_list_next(child)) {
@@ -3633,6 +5151,9 @@ milter_manager_children_end_of_header (MilterManagerChildren *children)
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    /* The children don't change until the body. */
+    priv->need_body_checksum = need_body_checksum(children);
+
     if (need_data_commmand_emulation(priv)) {
         gboolean success;
         milter_debug("[%u] [children][data-command-emulation][end-of-header]",
@@ -3758,13 +5279,53 @@ write_body (MilterManagerChildren *children,
             const gchar *chunk, gsize size)
 {
     MilterManagerChildrenPrivate *priv;
+    gboolean success;
 
     priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
 
+    /* A body replaced by a child isn't the received content. */
+    if (priv->state != MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE)
+        update_body_checksum(children, chunk, size);
+
     if (priv->body_file)
-        return write_body_to_file(children, chunk, size);
+        success = write_body_to_file(children, chunk, size);
     else
-        return write_body_to_string(children, chunk, size);
+        success = write_body_to_string(children, chunk, size);
+    if (success)
+        priv->spooled_body_size += size;
+
+    return success;
+}
+
+/*
+ * Body chunks are streamed to the first child in the queue.
+ * The rest of the children receive the spooled body after
+ * the first child finishes the message. So the body needs
+ * to be spooled only when one of them still wants it.
+ */
+static gboolean
+need_body_spool (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->command_waiting_child_queue)
+        return FALSE;
+
+    for (node = g_list_next(priv->command_waiting_child_queue);
+         node;
+         node = g_list_next(node)) {
+        MilterServerContext *context = node->data;
+
+        if (milter_server_context_get_skip_body(context))
+            continue;
+        if (milter_server_context_is_enable_step(context, MILTER_STEP_NO_BODY))
+            continue;
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
 gboolean
@@ -3807,8 +5368,15 @@ milter_manager_children_body (MilterManagerChildren *children,
     if (!first_child)
         return FALSE;
 
-    if (!write_body(children, chunk, size))
-        return FALSE;
+    if (need_body_spool(children)) {
+        if (!write_body(children, chunk, size))
+            return FALSE;
+    } else {
+        milter_debug("[%u] [children][body][spool][skip] "
+                     "size=%" G_GSIZE_FORMAT,
+                     priv->tag, size);
+        update_body_checksum(children, chunk, size);
+    }
 
     priv->state = state;
     priv->processing_state = state;
@@ -3894,6 +5462,21 @@ init_child_for_body (MilterManagerChildren *children,
         return init_child_for_body_file(children, context);
 }
 
+static gsize
+get_child_chunk_size (MilterManagerChildren *children,
+                      MilterServerContext *context)
+{
+    MilterManagerChildrenPrivate *priv;
+    MilterEncoder *encoder;
+    gsize chunk_size;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    chunk_size =
+        milter_manager_configuration_get_chunk_size(priv->configuration);
+    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+    return MIN(chunk_size, milter_encoder_get_max_data_size(encoder));
+}
+
 static MilterStatus
 send_body_to_child_file (MilterManagerChildren *children,
                          MilterServerContext *context)
@@ -3902,7 +5485,7 @@ send_body_to_child_file (MilterManagerChildren *children,
     GError *error = NULL;
     GIOStatus io_status = G_IO_STATUS_NORMAL;
     MilterManagerChildrenPrivate *priv;
-    gchar buffer[MILTER_CHUNK_SIZE + 1];
+    gchar *buffer;
     gsize read_size, chunk_size;
     MilterManagerChild *child;
 
@@ -3910,8 +5493,8 @@ send_body_to_child_file (MilterManagerChildren *children,
     if (!priv->body_file)
         return MILTER_STATUS_NOT_CHANGE;
 
-    chunk_size =
-        milter_manager_configuration_get_chunk_size(priv->configuration);
+    chunk_size = get_child_chunk_size(children, context);
+    buffer = g_malloc(chunk_size);
     io_status = g_io_channel_read_chars(priv->body_file,
                                         buffer, chunk_size,
                                         &read_size, &error);
@@ -3938,6 +5521,7 @@ send_body_to_child_file (MilterManagerChildren *children,
         status = milter_manager_child_get_fallback_status(child);
         break;
     }
+    g_free(buffer);
 
     if (error) {
         milter_error("[%u] [children][error][body][send] [%u] %s: %s",
@@ -3966,8 +5550,7 @@ send_body_to_child_string (MilterManagerChildren *children,
     if (priv->sent_body_offset >= priv->body->len)
         return MILTER_STATUS_NOT_CHANGE;
 
-    chunk_size =
-        milter_manager_configuration_get_chunk_size(priv->configuration);
+    chunk_size = get_child_chunk_size(children, context);
     write_size = MIN(priv->body->len - priv->sent_body_offset, chunk_size);
     if (milter_server_context_body(context,
                                    priv->body->str + priv->sent_body_offset,
@@ -4252,6 +5835,30 @@ milter_manager_children_get_option (MilterManagerChildren *children)
     return MILTER_MANAGER_CHILDREN_GET_PRIVATE(children)->option;
 }
 
+gsize
+milter_manager_children_get_spooled_body_size (MilterManagerChildren *children)
+{
+    return MILTER_MANAGER_CHILDREN_GET_PRIVATE(children)->spooled_body_size;
+}
+
+gchar *
+milter_manager_children_get_body_digest (MilterManagerChildren *children)
+{
+    MilterManagerChildrenPrivate *priv;
+    GChecksum *checksum;
+    gchar *digest;
+
+    priv = MILTER_MANAGER_CHILDREN_GET_PRIVATE(children);
+    if (!priv->body_checksum)
+        return NULL;
+
+    checksum = g_checksum_copy(priv->body_checksum);
+    digest = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+
+    return digest;
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -144,6 +144,10 @@ MilterOption          *milter_manager_children_get_option   (MilterManagerChildr
 
 gboolean               milter_manager_children_is_waiting_reply
                                                             (MilterManagerChildren *children);
+gsize                  milter_manager_children_get_spooled_body_size
+                                                            (MilterManagerChildren *children);
+gchar                 *milter_manager_children_get_body_digest
+                                                            (MilterManagerChildren *children);
 
 
 #endif /* __MILTER_MANAGER_CHILDREN_H__ */
@@ -0,0 +1,170 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <milter/core.h>
+#include "milter-manager-cidr-table.h"
+#include "milter-manager-address-trie.h"
+
+#define MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(obj)                      \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_CIDR_TABLE,        \
+                                 MilterManagerCIDRTablePrivate))
+
+typedef struct _MilterManagerCIDRTablePrivate MilterManagerCIDRTablePrivate;
+struct _MilterManagerCIDRTablePrivate
+{
+    /* Entry numbers are "action index + 1". */
+    MilterManagerAddressTrie *networks;
+    GPtrArray *actions;
+};
+
+G_DEFINE_TYPE(MilterManagerCIDRTable,
+              milter_manager_cidr_table,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_cidr_table_class_init (MilterManagerCIDRTableClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerCIDRTablePrivate));
+}
+
+static void
+milter_manager_cidr_table_init (MilterManagerCIDRTable *table)
+{
+    MilterManagerCIDRTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(table);
+    priv->networks = milter_manager_address_trie_new();
+    priv->actions = g_ptr_array_new();
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerCIDRTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(object);
+
+    if (priv->networks) {
+        milter_manager_address_trie_free(priv->networks);
+        priv->networks = NULL;
+    }
+
+    if (priv->actions) {
+        g_ptr_array_foreach(priv->actions, (GFunc)g_free, NULL);
+        g_ptr_array_free(priv->actions, TRUE);
+        priv->actions = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_cidr_table_parent_class)->dispose(object);
+}
+
+GQuark
+milter_manager_cidr_table_error_quark (void)
+{
+    return g_quark_from_static_string("milter-manager-cidr-table-error-quark");
+}
+
+MilterManagerCIDRTable *
+milter_manager_cidr_table_new (void)
+{
+    return g_object_new(MILTER_TYPE_MANAGER_CIDR_TABLE, NULL);
+}
+
+gboolean
+milter_manager_cidr_table_add (MilterManagerCIDRTable *table,
+                               const gchar            *network,
+                               const gchar            *action,
+                               GError                **error)
+{
+    MilterManagerCIDRTablePrivate *priv;
+    const gchar *error_message = NULL;
+
+    priv = MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(table);
+
+    if (!milter_manager_address_trie_add(priv->networks,
+                                         network,
+                                         priv->actions->len + 1,
+                                         &error_message)) {
+        g_set_error(error,
+                    MILTER_MANAGER_CIDR_TABLE_ERROR,
+                    MILTER_MANAGER_CIDR_TABLE_ERROR_INVALID_ADDRESS,
+                    "%s: <%s>", error_message, network);
+        return FALSE;
+    }
+    g_ptr_array_add(priv->actions, g_strdup(action));
+
+    return TRUE;
+}
+
+guint
+milter_manager_cidr_table_get_n_entries (MilterManagerCIDRTable *table)
+{
+    return MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(table)->actions->len;
+}
+
+static const gchar *
+entry_action (MilterManagerCIDRTablePrivate *priv, guint entry_number)
+{
+    if (entry_number == 0)
+        return NULL;
+    return g_ptr_array_index(priv->actions, entry_number - 1);
+}
+
+const gchar *
+milter_manager_cidr_table_lookup (MilterManagerCIDRTable *table,
+                                  const gchar            *address)
+{
+    MilterManagerCIDRTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(table);
+    return entry_action(priv,
+                        milter_manager_address_trie_lookup(priv->networks,
+                                                           address));
+}
+
+const gchar *
+milter_manager_cidr_table_lookup_address (MilterManagerCIDRTable *table,
+                                          const struct sockaddr  *address,
+                                          socklen_t               address_length)
+{
+    MilterManagerCIDRTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CIDR_TABLE_GET_PRIVATE(table);
+    return entry_action(priv,
+                        milter_manager_address_trie_lookup_address(
+                            priv->networks, address, address_length));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
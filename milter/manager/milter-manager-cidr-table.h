@@ -0,0 +1,99 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_CIDR_TABLE_H__
+#define __MILTER_MANAGER_CIDR_TABLE_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_CIDR_TABLE_ERROR           (milter_manager_cidr_table_error_quark())
+
+#define MILTER_TYPE_MANAGER_CIDR_TABLE            (milter_manager_cidr_table_get_type())
+#define MILTER_MANAGER_CIDR_TABLE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_CIDR_TABLE, MilterManagerCIDRTable))
+#define MILTER_MANAGER_CIDR_TABLE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_CIDR_TABLE, MilterManagerCIDRTableClass))
+#define MILTER_MANAGER_IS_CIDR_TABLE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_CIDR_TABLE))
+#define MILTER_MANAGER_IS_CIDR_TABLE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_CIDR_TABLE))
+#define MILTER_MANAGER_CIDR_TABLE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_CIDR_TABLE, MilterManagerCIDRTableClass))
+
+typedef enum
+{
+    MILTER_MANAGER_CIDR_TABLE_ERROR_INVALID_ADDRESS
+} MilterManagerCIDRTableError;
+
+typedef struct _MilterManagerCIDRTable         MilterManagerCIDRTable;
+typedef struct _MilterManagerCIDRTableClass    MilterManagerCIDRTableClass;
+
+struct _MilterManagerCIDRTable
+{
+    GObject object;
+};
+
+struct _MilterManagerCIDRTableClass
+{
+    GObjectClass parent_class;
+};
+
+GQuark                  milter_manager_cidr_table_error_quark  (void);
+
+GType                   milter_manager_cidr_table_get_type     (void) G_GNUC_CONST;
+
+/*
+ * Creates a table that works like Postfix's cidr_table:
+ * the action of the first network that includes the
+ * address is used. Networks are stored in a binary radix
+ * trie. So a lookup visits at most 32 (IPv4) or 128 (IPv6)
+ * nodes regardless of the number of entries. Lookups don't
+ * change the table.
+ */
+MilterManagerCIDRTable *milter_manager_cidr_table_new          (void);
+
+/*
+ * Adds an IPv4 or IPv6 network such as "192.168.0.0/16"
+ * and "2001:db8::/32". The prefix length can be omitted.
+ */
+gboolean                milter_manager_cidr_table_add          (MilterManagerCIDRTable *table,
+                                                                const gchar            *network,
+                                                                const gchar            *action,
+                                                                GError                **error);
+guint                   milter_manager_cidr_table_get_n_entries
+                                                               (MilterManagerCIDRTable *table);
+
+/*
+ * Returns the action of the first network that includes
+ * @address. NULL is returned if no network includes
+ * @address or @address isn't an IP address.
+ */
+const gchar            *milter_manager_cidr_table_lookup       (MilterManagerCIDRTable *table,
+                                                                const gchar            *address);
+const gchar            *milter_manager_cidr_table_lookup_address
+                                                               (MilterManagerCIDRTable *table,
+                                                                const struct sockaddr  *address,
+                                                                socklen_t               address_length);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_CIDR_TABLE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,359 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <milter/core.h>
+#include "milter-manager-circuit-breaker.h"
+
+#define MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(obj)                 \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_CIRCUIT_BREAKER,   \
+                                 MilterManagerCircuitBreakerPrivate))
+
+typedef struct _MilterManagerCircuitBreakerPrivate MilterManagerCircuitBreakerPrivate;
+struct _MilterManagerCircuitBreakerPrivate
+{
+    GMutex *mutex;
+    gchar *name;
+    guint failure_threshold;
+    gdouble open_time;
+    gdouble slow_time;
+
+    MilterManagerCircuitBreakerState state;
+    guint n_failures;
+    GTimer *timer;
+    gdouble opened_at;
+    gboolean probing;
+    gdouble probe_started_at;
+};
+
+G_DEFINE_TYPE(MilterManagerCircuitBreaker,
+              milter_manager_circuit_breaker,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_circuit_breaker_class_init (MilterManagerCircuitBreakerClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerCircuitBreakerPrivate));
+}
+
+static void
+milter_manager_circuit_breaker_init (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    priv->mutex = g_mutex_new();
+    priv->name = NULL;
+    priv->failure_threshold = 0;
+    priv->open_time = MILTER_MANAGER_CIRCUIT_BREAKER_DEFAULT_OPEN_TIME;
+    priv->slow_time = 0.0;
+
+    priv->state = MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED;
+    priv->n_failures = 0;
+    priv->timer = g_timer_new();
+    priv->opened_at = 0.0;
+    priv->probing = FALSE;
+    priv->probe_started_at = 0.0;
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(object);
+
+    if (priv->name) {
+        g_free(priv->name);
+        priv->name = NULL;
+    }
+
+    if (priv->timer) {
+        g_timer_destroy(priv->timer);
+        priv->timer = NULL;
+    }
+
+    if (priv->mutex) {
+        g_mutex_free(priv->mutex);
+        priv->mutex = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_circuit_breaker_parent_class)->dispose(object);
+}
+
+MilterManagerCircuitBreaker *
+milter_manager_circuit_breaker_new (const gchar *name)
+{
+    MilterManagerCircuitBreaker *breaker;
+
+    breaker = g_object_new(MILTER_TYPE_MANAGER_CIRCUIT_BREAKER, NULL);
+    MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->name = g_strdup(name);
+
+    return breaker;
+}
+
+static void
+reset (MilterManagerCircuitBreakerPrivate *priv)
+{
+    priv->n_failures = 0;
+    priv->state = MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED;
+    priv->probing = FALSE;
+}
+
+void
+milter_manager_circuit_breaker_set_failure_threshold (MilterManagerCircuitBreaker *breaker,
+                                                      guint threshold)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    priv->failure_threshold = threshold;
+    if (threshold == 0)
+        reset(priv);
+    g_mutex_unlock(priv->mutex);
+}
+
+guint
+milter_manager_circuit_breaker_get_failure_threshold (MilterManagerCircuitBreaker *breaker)
+{
+    return MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->failure_threshold;
+}
+
+void
+milter_manager_circuit_breaker_set_open_time (MilterManagerCircuitBreaker *breaker,
+                                              gdouble open_time)
+{
+    MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->open_time = open_time;
+}
+
+gdouble
+milter_manager_circuit_breaker_get_open_time (MilterManagerCircuitBreaker *breaker)
+{
+    return MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->open_time;
+}
+
+void
+milter_manager_circuit_breaker_set_slow_time (MilterManagerCircuitBreaker *breaker,
+                                              gdouble slow_time)
+{
+    MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->slow_time = slow_time;
+}
+
+gdouble
+milter_manager_circuit_breaker_get_slow_time (MilterManagerCircuitBreaker *breaker)
+{
+    return MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker)->slow_time;
+}
+
+MilterManagerCircuitBreakerState
+milter_manager_circuit_breaker_get_state (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+    MilterManagerCircuitBreakerState state;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    state = priv->state;
+    g_mutex_unlock(priv->mutex);
+
+    return state;
+}
+
+guint
+milter_manager_circuit_breaker_get_n_failures (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+    guint n_failures;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    n_failures = priv->n_failures;
+    g_mutex_unlock(priv->mutex);
+
+    return n_failures;
+}
+
+static const gchar *
+state_name (MilterManagerCircuitBreakerState state)
+{
+    switch (state) {
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED:
+        return "closed";
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN:
+        return "open";
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN:
+        return "half-open";
+    default:
+        return "unknown";
+    }
+}
+
+static void
+set_state (MilterManagerCircuitBreakerPrivate *priv,
+           MilterManagerCircuitBreakerState state)
+{
+    if (priv->state == state)
+        return;
+
+    milter_statistics("[circuit-breaker][%s] %s: <%u>",
+                      state_name(state),
+                      MILTER_LOG_NULL_SAFE_STRING(priv->name),
+                      priv->n_failures);
+    priv->state = state;
+    priv->probing = FALSE;
+    if (state == MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN)
+        priv->opened_at = g_timer_elapsed(priv->timer, NULL);
+}
+
+static gboolean
+try_pass (MilterManagerCircuitBreakerPrivate *priv)
+{
+    gdouble now;
+
+    if (priv->failure_threshold == 0)
+        return TRUE;
+
+    now = g_timer_elapsed(priv->timer, NULL);
+    switch (priv->state) {
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED:
+        return TRUE;
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN:
+        if (now - priv->opened_at < priv->open_time)
+            return FALSE;
+        set_state(priv, MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN);
+        break;
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN:
+        /* A probe that never reports its result must not keep
+         * the milter bypassed forever. */
+        if (priv->probing && now - priv->probe_started_at < priv->open_time)
+            return FALSE;
+        break;
+    default:
+        return TRUE;
+    }
+
+    milter_debug("[circuit-breaker][probe] %s",
+                 MILTER_LOG_NULL_SAFE_STRING(priv->name));
+    priv->probing = TRUE;
+    priv->probe_started_at = now;
+    return TRUE;
+}
+
+gboolean
+milter_manager_circuit_breaker_try (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+    gboolean success;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    success = try_pass(priv);
+    g_mutex_unlock(priv->mutex);
+
+    return success;
+}
+
+static void
+record_failure (MilterManagerCircuitBreakerPrivate *priv)
+{
+    if (priv->failure_threshold == 0)
+        return;
+
+    priv->n_failures++;
+    switch (priv->state) {
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED:
+        if (priv->n_failures >= priv->failure_threshold)
+            set_state(priv, MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN);
+        break;
+    case MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN:
+        set_state(priv, MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+record_success (MilterManagerCircuitBreakerPrivate *priv, gdouble elapsed)
+{
+    if (priv->failure_threshold == 0)
+        return;
+
+    if (priv->slow_time > 0 && elapsed >= priv->slow_time) {
+        milter_debug("[circuit-breaker][slow] %s: <%g>",
+                     MILTER_LOG_NULL_SAFE_STRING(priv->name), elapsed);
+        record_failure(priv);
+        return;
+    }
+
+    priv->n_failures = 0;
+    set_state(priv, MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED);
+}
+
+void
+milter_manager_circuit_breaker_record_success (MilterManagerCircuitBreaker *breaker,
+                                               gdouble elapsed)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    record_success(priv, elapsed);
+    g_mutex_unlock(priv->mutex);
+}
+
+void
+milter_manager_circuit_breaker_record_failure (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    record_failure(priv);
+    g_mutex_unlock(priv->mutex);
+}
+
+void
+milter_manager_circuit_breaker_reset (MilterManagerCircuitBreaker *breaker)
+{
+    MilterManagerCircuitBreakerPrivate *priv;
+
+    priv = MILTER_MANAGER_CIRCUIT_BREAKER_GET_PRIVATE(breaker);
+    g_mutex_lock(priv->mutex);
+    reset(priv);
+    g_mutex_unlock(priv->mutex);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
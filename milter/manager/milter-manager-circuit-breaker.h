@@ -0,0 +1,103 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_CIRCUIT_BREAKER_H__
+#define __MILTER_MANAGER_CIRCUIT_BREAKER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_CIRCUIT_BREAKER_DEFAULT_OPEN_TIME 30.0
+
+#define MILTER_TYPE_MANAGER_CIRCUIT_BREAKER            (milter_manager_circuit_breaker_get_type())
+#define MILTER_MANAGER_CIRCUIT_BREAKER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_CIRCUIT_BREAKER, MilterManagerCircuitBreaker))
+#define MILTER_MANAGER_CIRCUIT_BREAKER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_CIRCUIT_BREAKER, MilterManagerCircuitBreakerClass))
+#define MILTER_MANAGER_IS_CIRCUIT_BREAKER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_CIRCUIT_BREAKER))
+#define MILTER_MANAGER_IS_CIRCUIT_BREAKER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_CIRCUIT_BREAKER))
+#define MILTER_MANAGER_CIRCUIT_BREAKER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_CIRCUIT_BREAKER, MilterManagerCircuitBreakerClass))
+
+typedef enum
+{
+    MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED,
+    MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN,
+    MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN
+} MilterManagerCircuitBreakerState;
+
+typedef struct _MilterManagerCircuitBreaker         MilterManagerCircuitBreaker;
+typedef struct _MilterManagerCircuitBreakerClass    MilterManagerCircuitBreakerClass;
+
+struct _MilterManagerCircuitBreaker
+{
+    GObject object;
+};
+
+struct _MilterManagerCircuitBreakerClass
+{
+    GObjectClass parent_class;
+};
+
+GType                        milter_manager_circuit_breaker_get_type    (void) G_GNUC_CONST;
+
+MilterManagerCircuitBreaker *milter_manager_circuit_breaker_new         (const gchar *name);
+
+void                         milter_manager_circuit_breaker_set_failure_threshold
+                                                        (MilterManagerCircuitBreaker *breaker,
+                                                         guint                        threshold);
+guint                        milter_manager_circuit_breaker_get_failure_threshold
+                                                        (MilterManagerCircuitBreaker *breaker);
+void                         milter_manager_circuit_breaker_set_open_time
+                                                        (MilterManagerCircuitBreaker *breaker,
+                                                         gdouble                      open_time);
+gdouble                      milter_manager_circuit_breaker_get_open_time
+                                                        (MilterManagerCircuitBreaker *breaker);
+void                         milter_manager_circuit_breaker_set_slow_time
+                                                        (MilterManagerCircuitBreaker *breaker,
+                                                         gdouble                      slow_time);
+gdouble                      milter_manager_circuit_breaker_get_slow_time
+                                                        (MilterManagerCircuitBreaker *breaker);
+
+MilterManagerCircuitBreakerState
+                             milter_manager_circuit_breaker_get_state
+                                                        (MilterManagerCircuitBreaker *breaker);
+guint                        milter_manager_circuit_breaker_get_n_failures
+                                                        (MilterManagerCircuitBreaker *breaker);
+
+/*
+ * Returns whether a new session may use the milter. An
+ * open breaker turns into half-open after open-time
+ * seconds and allows only one probe session at a time.
+ */
+gboolean                     milter_manager_circuit_breaker_try
+                                                        (MilterManagerCircuitBreaker *breaker);
+void                         milter_manager_circuit_breaker_record_success
+                                                        (MilterManagerCircuitBreaker *breaker,
+                                                         gdouble                      elapsed);
+void                         milter_manager_circuit_breaker_record_failure
+                                                        (MilterManagerCircuitBreaker *breaker);
+void                         milter_manager_circuit_breaker_reset
+                                                        (MilterManagerCircuitBreaker *breaker);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_CIRCUIT_BREAKER_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,563 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include <milter/core.h>
+#include "milter-manager-condition-rule.h"
+#include "milter-manager-address-trie.h"
+#include "milter-manager-enum-types.h"
+
+#define MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(obj)                  \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_CONDITION_RULE,    \
+                                 MilterManagerConditionRulePrivate))
+
+typedef struct _DomainNode DomainNode;
+struct _DomainNode
+{
+    GHashTable *children;
+    gboolean self_match;
+    gboolean sub_match;
+};
+
+typedef struct _MacroTest MacroTest;
+struct _MacroTest
+{
+    gchar *name;
+    gchar *value;
+};
+
+typedef struct _MilterManagerConditionRulePrivate MilterManagerConditionRulePrivate;
+struct _MilterManagerConditionRulePrivate
+{
+    MilterManagerConditionStage stage;
+    MilterManagerConditionAction action;
+    MilterManagerAddressTrie *addresses;
+    DomainNode *domains;
+    GPtrArray *patterns;
+    GRegex *regex;
+    GList *macros;
+};
+
+enum
+{
+    PROP_0,
+    PROP_STAGE,
+    PROP_ACTION
+};
+
+G_DEFINE_TYPE(MilterManagerConditionRule,
+              milter_manager_condition_rule,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+static void set_property   (GObject         *object,
+                            guint            prop_id,
+                            const GValue    *value,
+                            GParamSpec      *pspec);
+static void get_property   (GObject         *object,
+                            guint            prop_id,
+                            GValue          *value,
+                            GParamSpec      *pspec);
+
+static void
+milter_manager_condition_rule_class_init (MilterManagerConditionRuleClass *klass)
+{
+    GObjectClass *gobject_class;
+    GParamSpec *spec;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+    gobject_class->set_property = set_property;
+    gobject_class->get_property = get_property;
+
+    spec = g_param_spec_enum("stage",
+                             "Stage",
+                             "The stage that the rule is evaluated",
+                             MILTER_TYPE_MANAGER_CONDITION_STAGE,
+                             MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property(gobject_class, PROP_STAGE, spec);
+
+    spec = g_param_spec_enum("action",
+                             "Action",
+                             "The action when the rule is matched",
+                             MILTER_TYPE_MANAGER_CONDITION_ACTION,
+                             MILTER_MANAGER_CONDITION_ACTION_STOP,
+                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+    g_object_class_install_property(gobject_class, PROP_ACTION, spec);
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerConditionRulePrivate));
+}
+
+static void
+milter_manager_condition_rule_init (MilterManagerConditionRule *rule)
+{
+    MilterManagerConditionRulePrivate *priv;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+    priv->stage = MILTER_MANAGER_CONDITION_STAGE_CONNECT;
+    priv->action = MILTER_MANAGER_CONDITION_ACTION_STOP;
+    priv->addresses = NULL;
+    priv->domains = NULL;
+    priv->patterns = NULL;
+    priv->regex = NULL;
+    priv->macros = NULL;
+}
+
+static DomainNode *
+domain_node_new (void)
+{
+    DomainNode *node;
+
+    node = g_new0(DomainNode, 1);
+    node->children = NULL;
+    node->self_match = FALSE;
+    node->sub_match = FALSE;
+
+    return node;
+}
+
+static void
+domain_node_free (DomainNode *node)
+{
+    if (!node)
+        return;
+
+    if (node->children)
+        g_hash_table_unref(node->children);
+    g_free(node);
+}
+
+static void
+macro_test_free (MacroTest *test)
+{
+    g_free(test->name);
+    g_free(test->value);
+    g_free(test);
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerConditionRulePrivate *priv;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(object);
+
+    if (priv->addresses) {
+        milter_manager_address_trie_free(priv->addresses);
+        priv->addresses = NULL;
+    }
+
+    if (priv->domains) {
+        domain_node_free(priv->domains);
+        priv->domains = NULL;
+    }
+
+    if (priv->patterns) {
+        g_ptr_array_foreach(priv->patterns, (GFunc)g_free, NULL);
+        g_ptr_array_free(priv->patterns, TRUE);
+        priv->patterns = NULL;
+    }
+
+    if (priv->regex) {
+        g_regex_unref(priv->regex);
+        priv->regex = NULL;
+    }
+
+    if (priv->macros) {
+        g_list_foreach(priv->macros, (GFunc)macro_test_free, NULL);
+        g_list_free(priv->macros);
+        priv->macros = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_condition_rule_parent_class)->dispose(object);
+}
+
+static void
+set_property (GObject      *object,
+              guint         prop_id,
+              const GValue *value,
+              GParamSpec   *pspec)
+{
+    MilterManagerConditionRulePrivate *priv;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(object);
+    switch (prop_id) {
+    case PROP_STAGE:
+        priv->stage = g_value_get_enum(value);
+        break;
+    case PROP_ACTION:
+        priv->action = g_value_get_enum(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+get_property (GObject    *object,
+              guint       prop_id,
+              GValue     *value,
+              GParamSpec *pspec)
+{
+    MilterManagerConditionRulePrivate *priv;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(object);
+    switch (prop_id) {
+    case PROP_STAGE:
+        g_value_set_enum(value, priv->stage);
+        break;
+    case PROP_ACTION:
+        g_value_set_enum(value, priv->action);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+GQuark
+milter_manager_condition_rule_error_quark (void)
+{
+    return g_quark_from_static_string("milter-manager-condition-rule-error-quark");
+}
+
+MilterManagerConditionRule *
+milter_manager_condition_rule_new (MilterManagerConditionStage  stage,
+                                   MilterManagerConditionAction action)
+{
+    return g_object_new(MILTER_TYPE_MANAGER_CONDITION_RULE,
+                        "stage", stage,
+                        "action", action,
+                        NULL);
+}
+
+MilterManagerConditionStage
+milter_manager_condition_rule_get_stage (MilterManagerConditionRule *rule)
+{
+    return MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule)->stage;
+}
+
+MilterManagerConditionAction
+milter_manager_condition_rule_get_action (MilterManagerConditionRule *rule)
+{
+    return MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule)->action;
+}
+
+gboolean
+milter_manager_condition_rule_add_address (MilterManagerConditionRule *rule,
+                                           const gchar                *network,
+                                           GError                    **error)
+{
+    MilterManagerConditionRulePrivate *priv;
+    const gchar *error_message = NULL;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+
+    if (!priv->addresses)
+        priv->addresses = milter_manager_address_trie_new();
+    if (!milter_manager_address_trie_add(priv->addresses, network, 1,
+                                         &error_message)) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_ADDRESS,
+                    "%s: <%s>", error_message, network);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gchar **
+split_domain (const gchar *domain)
+{
+    gchar *normalized;
+    gchar **labels;
+    gsize length;
+
+    normalized = g_ascii_strdown(domain, -1);
+    length = strlen(normalized);
+    if (length > 0 && normalized[length - 1] == '.')
+        normalized[length - 1] = '\0';
+    labels = g_strsplit(normalized, ".", -1);
+    g_free(normalized);
+
+    return labels;
+}
+
+void
+milter_manager_condition_rule_add_domain (MilterManagerConditionRule *rule,
+                                          const gchar                *domain)
+{
+    MilterManagerConditionRulePrivate *priv;
+    DomainNode *node;
+    gboolean sub_domain_only = FALSE;
+    gchar **labels;
+    gint i;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+
+    if (domain[0] == '.') {
+        sub_domain_only = TRUE;
+        domain++;
+    }
+
+    if (!priv->domains)
+        priv->domains = domain_node_new();
+
+    node = priv->domains;
+    labels = split_domain(domain);
+    for (i = g_strv_length(labels) - 1; i >= 0; i--) {
+        DomainNode *child = NULL;
+
+        if (node->children)
+            child = g_hash_table_lookup(node->children, labels[i]);
+        if (!child) {
+            if (!node->children)
+                node->children =
+                    g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify)domain_node_free);
+            child = domain_node_new();
+            g_hash_table_insert(node->children, g_strdup(labels[i]), child);
+        }
+        node = child;
+    }
+    g_strfreev(labels);
+
+    if (!sub_domain_only)
+        node->self_match = TRUE;
+    node->sub_match = TRUE;
+}
+
+static gboolean
+match_domain (MilterManagerConditionRulePrivate *priv, const gchar *domain)
+{
+    DomainNode *node;
+    gchar **labels;
+    gint i;
+    gboolean matched = FALSE;
+
+    node = priv->domains;
+    labels = split_domain(domain);
+    for (i = g_strv_length(labels) - 1; i >= 0; i--) {
+        if (!node->children)
+            break;
+        node = g_hash_table_lookup(node->children, labels[i]);
+        if (!node)
+            break;
+        if (i > 0 && node->sub_match) {
+            matched = TRUE;
+            break;
+        }
+        if (i == 0 && node->self_match) {
+            matched = TRUE;
+            break;
+        }
+    }
+    g_strfreev(labels);
+
+    return matched;
+}
+
+static gchar *
+extract_domain (const gchar *envelope_address)
+{
+    const gchar *at_mark;
+    const gchar *end;
+
+    at_mark = strrchr(envelope_address, '@');
+    if (!at_mark)
+        return NULL;
+
+    end = strchr(at_mark, '>');
+    if (end)
+        return g_strndup(at_mark + 1, end - at_mark - 1);
+    return g_strdup(at_mark + 1);
+}
+
+gboolean
+milter_manager_condition_rule_add_regex (MilterManagerConditionRule *rule,
+                                         const gchar                *pattern,
+                                         GError                    **error)
+{
+    MilterManagerConditionRulePrivate *priv;
+    GRegex *regex;
+    GError *regex_error = NULL;
+    GString *combined_pattern;
+    guint i;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+
+    regex = g_regex_new(pattern, 0, 0, &regex_error);
+    if (!regex) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_REGEX,
+                    "invalid regular expression: <%s>: %s",
+                    pattern, regex_error->message);
+        g_error_free(regex_error);
+        return FALSE;
+    }
+    g_regex_unref(regex);
+
+    if (!priv->patterns)
+        priv->patterns = g_ptr_array_new();
+    g_ptr_array_add(priv->patterns, g_strdup(pattern));
+
+    combined_pattern = g_string_new(NULL);
+    for (i = 0; i < priv->patterns->len; i++) {
+        if (i > 0)
+            g_string_append_c(combined_pattern, '|');
+        g_string_append_printf(combined_pattern, "(?:%s)",
+                               (const gchar *)g_ptr_array_index(priv->patterns,
+                                                                i));
+    }
+    regex = g_regex_new(combined_pattern->str, G_REGEX_OPTIMIZE, 0,
+                        &regex_error);
+    g_string_free(combined_pattern, TRUE);
+    if (!regex) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR,
+                    MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_REGEX,
+                    "can't combine regular expression: <%s>: %s",
+                    pattern, regex_error->message);
+        g_error_free(regex_error);
+        g_free(g_ptr_array_remove_index(priv->patterns,
+                                        priv->patterns->len - 1));
+        return FALSE;
+    }
+
+    if (priv->regex)
+        g_regex_unref(priv->regex);
+    priv->regex = regex;
+
+    return TRUE;
+}
+
+void
+milter_manager_condition_rule_add_macro (MilterManagerConditionRule *rule,
+                                         const gchar                *name,
+                                         const gchar                *value)
+{
+    MilterManagerConditionRulePrivate *priv;
+    MacroTest *test;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+
+    test = g_new(MacroTest, 1);
+    test->name = g_strdup(name);
+    test->value = g_strdup(value);
+    priv->macros = g_list_append(priv->macros, test);
+}
+
+static gboolean
+match_macros (MilterManagerConditionRulePrivate *priv,
+              MilterProtocolAgent *agent)
+{
+    GList *node;
+
+    if (!agent)
+        return FALSE;
+
+    for (node = priv->macros; node; node = g_list_next(node)) {
+        MacroTest *test = node->data;
+        const gchar *value;
+
+        value = milter_protocol_agent_get_macro(agent, test->name);
+        if (value && g_str_equal(value, test->value))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean
+milter_manager_condition_rule_match (MilterManagerConditionRule *rule,
+                                     MilterProtocolAgent        *agent,
+                                     const gchar                *subject,
+                                     const struct sockaddr      *address,
+                                     socklen_t                   address_length)
+{
+    MilterManagerConditionRulePrivate *priv;
+
+    priv = MILTER_MANAGER_CONDITION_RULE_GET_PRIVATE(rule);
+
+    if (priv->addresses &&
+        !milter_manager_address_trie_is_empty(priv->addresses)) {
+        if (!address)
+            return FALSE;
+        if (milter_manager_address_trie_lookup_address(priv->addresses,
+                                                       address,
+                                                       address_length) == 0)
+            return FALSE;
+    }
+
+    if (priv->domains) {
+        gboolean matched;
+
+        if (!subject)
+            return FALSE;
+        switch (priv->stage) {
+        case MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_FROM:
+        case MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_RECIPIENT:
+        {
+            gchar *domain;
+
+            domain = extract_domain(subject);
+            matched = domain && match_domain(priv, domain);
+            g_free(domain);
+            break;
+        }
+        default:
+            matched = match_domain(priv, subject);
+            break;
+        }
+        if (!matched)
+            return FALSE;
+    }
+
+    if (priv->regex) {
+        if (!subject)
+            return FALSE;
+        if (!g_regex_match(priv->regex, subject, 0, NULL))
+            return FALSE;
+    }
+
+    if (priv->macros) {
+        if (!match_macros(priv, agent))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,138 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef __MILTER_MANAGER_CONDITION_RULE_H__
+#define __MILTER_MANAGER_CONDITION_RULE_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib-object.h>
+#include <milter/core/milter-protocol-agent.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_CONDITION_RULE_ERROR           (milter_manager_condition_rule_error_quark())
+
+#define MILTER_TYPE_MANAGER_CONDITION_RULE            (milter_manager_condition_rule_get_type())
+#define MILTER_MANAGER_CONDITION_RULE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_CONDITION_RULE, MilterManagerConditionRule))
+#define MILTER_MANAGER_CONDITION_RULE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_CONDITION_RULE, MilterManagerConditionRuleClass))
+#define MILTER_MANAGER_IS_CONDITION_RULE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_CONDITION_RULE))
+#define MILTER_MANAGER_IS_CONDITION_RULE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_CONDITION_RULE))
+#define MILTER_MANAGER_CONDITION_RULE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_CONDITION_RULE, MilterManagerConditionRuleClass))
+
+typedef enum
+{
+    MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_ADDRESS,
+    MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_REGEX
+} MilterManagerConditionRuleError;
+
+typedef enum
+{
+    MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+    MILTER_MANAGER_CONDITION_STAGE_HELO,
+    MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_FROM,
+    MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_RECIPIENT
+} MilterManagerConditionStage;
+
+typedef enum
+{
+    MILTER_MANAGER_CONDITION_ACTION_APPLY,
+    MILTER_MANAGER_CONDITION_ACTION_STOP
+} MilterManagerConditionAction;
+
+typedef struct _MilterManagerConditionRule         MilterManagerConditionRule;
+typedef struct _MilterManagerConditionRuleClass    MilterManagerConditionRuleClass;
+
+struct _MilterManagerConditionRule
+{
+    GObject object;
+};
+
+struct _MilterManagerConditionRuleClass
+{
+    GObjectClass parent_class;
+};
+
+GQuark                      milter_manager_condition_rule_error_quark (void);
+
+GType                       milter_manager_condition_rule_get_type    (void) G_GNUC_CONST;
+
+/*
+ * Creates a rule that is evaluated at @stage. If the rule
+ * matches, @action decides whether the child milter is
+ * stopped or not.
+ *
+ * A rule matches when every non-empty set of it matches.
+ * A set matches when any entry of it matches. A rule that
+ * has no entries matches everything.
+ */
+MilterManagerConditionRule *milter_manager_condition_rule_new         (MilterManagerConditionStage  stage,
+                                                                       MilterManagerConditionAction action);
+
+MilterManagerConditionStage milter_manager_condition_rule_get_stage   (MilterManagerConditionRule *rule);
+MilterManagerConditionAction
+                            milter_manager_condition_rule_get_action  (MilterManagerConditionRule *rule);
+
+/*
+ * Adds an IPv4 or IPv6 network such as "192.168.0.0/16"
+ * and "2001:db8::/32". The prefix length can be
+ * omitted. Addresses are only matched at
+ * MILTER_MANAGER_CONDITION_STAGE_CONNECT.
+ */
+gboolean                    milter_manager_condition_rule_add_address (MilterManagerConditionRule *rule,
+                                                                       const gchar                *network,
+                                                                       GError                    **error);
+/*
+ * Adds a domain. "example.com" matches "example.com" and
+ * its sub domains. ".example.com" matches only sub
+ * domains. The host name, the HELO FQDN or the domain
+ * part of the envelope address is matched.
+ */
+void                        milter_manager_condition_rule_add_domain  (MilterManagerConditionRule *rule,
+                                                                       const gchar                *domain);
+/*
+ * Adds a regular expression. All regular expressions of a
+ * rule are compiled into one. The host name, the HELO FQDN
+ * or the envelope address is matched.
+ */
+gboolean                    milter_manager_condition_rule_add_regex   (MilterManagerConditionRule *rule,
+                                                                       const gchar                *pattern,
+                                                                       GError                    **error);
+/*
+ * Adds a macro test that matches when the macro @name is
+ * @value.
+ */
+void                        milter_manager_condition_rule_add_macro   (MilterManagerConditionRule *rule,
+                                                                       const gchar                *name,
+                                                                       const gchar                *value);
+
+gboolean                    milter_manager_condition_rule_match       (MilterManagerConditionRule *rule,
+                                                                       MilterProtocolAgent        *agent,
+                                                                       const gchar                *subject,
+                                                                       const struct sockaddr      *address,
+                                                                       socklen_t                   address_length);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_CONDITION_RULE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -31,6 +31,7 @@
 #include "milter-manager-configuration.h"
 #include "milter-manager-leader.h"
 #include "milter-manager-children.h"
+#include "milter-manager-stress-detector.h"
 #include <milter/core/milter-marshalers.h>
 
 #define DEFAULT_FALLBACK_STATUS MILTER_STATUS_ACCEPT
@@ -82,6 +83,13 @@ struct _MilterManagerConfigurationPrivate
     gchar *syslog_facility;
     guint chunk_size;
     guint max_pending_finished_sessions;
+    gdouble session_deadline;
+    gboolean adaptive_max_connections;
+    MilterManagerStressDetector *stress_detector;
+    gboolean reuse_port;
+    gboolean pin_workers;
+    guint n_io_threads;
+    guint mirror_buffer_size;
 };
 
 enum
@@ -119,7 +127,14 @@ enum
     PROP_USE_SYSLOG,
     PROP_SYSLOG_FACILITY,
     PROP_CHUNK_SIZE,
-    PROP_MAX_PENDING_FINISHED_SESSIONS
+    PROP_MAX_PENDING_FINISHED_SESSIONS,
+    PROP_SESSION_DEADLINE,
+    PROP_ADAPTIVE_MAX_CONNECTIONS,
+    PROP_LOAD_SHEDDING,
+    PROP_REUSE_PORT,
+    PROP_PIN_WORKERS,
+    PROP_N_IO_THREADS,
+    PROP_MIRROR_BUFFER_SIZE
 };
 
 enum
@@ -451,8 +466,8 @@ milter_manager_configuration_class_init (MilterManagerConfigurationClass *klass)
                              "Chunk Size",
                              "The chunk size of the milter-manager",
                              1,
-                             MILTER_CHUNK_SIZE,
-                             MILTER_CHUNK_SIZE,
+                             MILTER_MAX_DATA_SIZE_1M,
+                             MILTER_MAX_DATA_SIZE_1M,
                              G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
     g_object_class_install_property(gobject_class, PROP_CHUNK_SIZE, spec);
 
@@ -466,6 +481,71 @@ milter_manager_configuration_class_init (MilterManagerConfigurationClass *klass)
                                     PROP_MAX_PENDING_FINISHED_SESSIONS,
                                     spec);
 
+    spec = g_param_spec_double("session-deadline",
+                               "Session deadline",
+                               "The maximum seconds for child milters "
+                               "to process a session. 0 disables it.",
+                               0, G_MAXDOUBLE, 0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_SESSION_DEADLINE,
+                                    spec);
+
+    spec = g_param_spec_boolean("adaptive-max-connections",
+                                "Adaptive max connections",
+                                "Whether the limit of concurrent "
+                                "connections is adjusted by latency.",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_ADAPTIVE_MAX_CONNECTIONS,
+                                    spec);
+
+    spec = g_param_spec_boolean("load-shedding",
+                                "Load shedding",
+                                "Whether optional milters are skipped "
+                                "under stress.",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_LOAD_SHEDDING,
+                                    spec);
+
+    spec = g_param_spec_boolean("reuse-port",
+                                "Reuse port",
+                                "Whether each worker listens its own "
+                                "socket with SO_REUSEPORT.",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_REUSE_PORT,
+                                    spec);
+
+    spec = g_param_spec_boolean("pin-workers",
+                                "Pin workers",
+                                "Whether each worker is pinned to a CPU.",
+                                FALSE,
+                                G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_PIN_WORKERS,
+                                    spec);
+
+    spec = g_param_spec_uint("n-io-threads",
+                             "Number of I/O threads",
+                             "The number of I/O threads of each process",
+                             0, MILTER_CLIENT_MAX_N_IO_THREADS, 0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_N_IO_THREADS, spec);
+
+    spec = g_param_spec_uint("mirror-buffer-size",
+                             "Mirror buffer size",
+                             "The max buffer size in bytes of commands for "
+                             "milters in evaluation mode",
+                             0, G_MAXUINT, 0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class, PROP_MIRROR_BUFFER_SIZE,
+                                    spec);
+
     signals[CONNECTED] =
         g_signal_new("connected",
                      G_TYPE_FROM_CLASS(klass),
@@ -518,8 +598,15 @@ milter_manager_configuration_init (MilterManagerConfiguration *configuration)
     priv->n_workers = 0;
     priv->default_packet_buffer_size = 0;
     priv->syslog_facility = NULL;
-    priv->chunk_size = MILTER_CHUNK_SIZE;
+    priv->chunk_size = MILTER_MAX_DATA_SIZE_1M;
     priv->max_pending_finished_sessions = 0;
+    priv->session_deadline = 0;
+    priv->adaptive_max_connections = FALSE;
+    priv->stress_detector = NULL;
+    priv->reuse_port = FALSE;
+    priv->pin_workers = FALSE;
+    priv->n_io_threads = 0;
+    priv->mirror_buffer_size = 0;
 
     config_dir_env = g_getenv("MILTER_MANAGER_CONFIG_DIR");
     if (config_dir_env)
@@ -697,6 +784,34 @@ set_property (GObject      *object,
         milter_manager_configuration_set_max_pending_finished_sessions(
             config, g_value_get_uint(value));
         break;
+    case PROP_SESSION_DEADLINE:
+        milter_manager_configuration_set_session_deadline(
+            config, g_value_get_double(value));
+        break;
+    case PROP_ADAPTIVE_MAX_CONNECTIONS:
+        milter_manager_configuration_set_adaptive_max_connections(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_LOAD_SHEDDING:
+        milter_manager_configuration_set_load_shedding(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_REUSE_PORT:
+        milter_manager_configuration_set_reuse_port(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_PIN_WORKERS:
+        milter_manager_configuration_set_pin_workers(
+            config, g_value_get_boolean(value));
+        break;
+    case PROP_N_IO_THREADS:
+        milter_manager_configuration_set_n_io_threads(
+            config, g_value_get_uint(value));
+        break;
+    case PROP_MIRROR_BUFFER_SIZE:
+        milter_manager_configuration_set_mirror_buffer_size(
+            config, g_value_get_uint(value));
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -812,6 +927,27 @@ get_property (GObject    *object,
     case PROP_MAX_PENDING_FINISHED_SESSIONS:
         g_value_set_uint(value, priv->max_pending_finished_sessions);
         break;
+    case PROP_SESSION_DEADLINE:
+        g_value_set_double(value, priv->session_deadline);
+        break;
+    case PROP_ADAPTIVE_MAX_CONNECTIONS:
+        g_value_set_boolean(value, priv->adaptive_max_connections);
+        break;
+    case PROP_LOAD_SHEDDING:
+        g_value_set_boolean(value, priv->stress_detector != NULL);
+        break;
+    case PROP_REUSE_PORT:
+        g_value_set_boolean(value, priv->reuse_port);
+        break;
+    case PROP_PIN_WORKERS:
+        g_value_set_boolean(value, priv->pin_workers);
+        break;
+    case PROP_N_IO_THREADS:
+        g_value_set_uint(value, priv->n_io_threads);
+        break;
+    case PROP_MIRROR_BUFFER_SIZE:
+        g_value_set_uint(value, priv->mirror_buffer_size);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -1170,6 +1306,123 @@ milter_manager_configuration_reload (MilterManagerConfiguration *configuration,
     return TRUE;
 }
 
+MilterManagerConfiguration *
+milter_manager_configuration_build (MilterManagerConfiguration *configuration,
+                                    GError                    **error)
+{
+    MilterManagerConfiguration *new_configuration;
+    const GList *node;
+
+    new_configuration = milter_manager_configuration_new(NULL);
+    milter_manager_configuration_clear_load_paths(new_configuration);
+    for (node = milter_manager_configuration_get_load_paths(configuration);
+         node;
+         node = g_list_next(node)) {
+        milter_manager_configuration_append_load_path(new_configuration,
+                                                      node->data);
+    }
+
+    if (!milter_manager_configuration_reload(new_configuration, error)) {
+        g_object_unref(new_configuration);
+        return NULL;
+    }
+
+    return new_configuration;
+}
+
+static void
+copy_properties (MilterManagerConfiguration *configuration,
+                 MilterManagerConfiguration *source)
+{
+    GParamSpec **specs;
+    guint i, n_specs;
+
+    specs = g_object_class_list_properties(
+        g_type_class_peek(MILTER_TYPE_MANAGER_CONFIGURATION), &n_specs);
+    for (i = 0; i < n_specs; i++) {
+        GParamSpec *spec = specs[i];
+        GValue value = {0,};
+
+        if (!(spec->flags & G_PARAM_READABLE) ||
+            !(spec->flags & G_PARAM_WRITABLE) ||
+            (spec->flags & G_PARAM_CONSTRUCT_ONLY))
+            continue;
+
+        g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(spec));
+        g_object_get_property(G_OBJECT(source), spec->name, &value);
+        g_object_set_property(G_OBJECT(configuration), spec->name, &value);
+        g_value_unset(&value);
+    }
+    g_free(specs);
+}
+
+MilterManagerConfiguration *
+milter_manager_configuration_copy (MilterManagerConfiguration *configuration,
+                                   GError                    **error)
+{
+    MilterManagerConfiguration *new_configuration;
+    const GList *node;
+
+    new_configuration = milter_manager_configuration_new(NULL);
+    milter_manager_configuration_clear_load_paths(new_configuration);
+    for (node = milter_manager_configuration_get_load_paths(configuration);
+         node;
+         node = g_list_next(node)) {
+        milter_manager_configuration_append_load_path(new_configuration,
+                                                      node->data);
+    }
+
+    copy_properties(new_configuration, configuration);
+
+    node = milter_manager_configuration_get_applicable_conditions(configuration);
+    for (; node; node = g_list_next(node)) {
+        MilterManagerApplicableCondition *condition, *new_condition;
+
+        condition = node->data;
+        new_condition = milter_manager_applicable_condition_new(
+            milter_manager_applicable_condition_get_name(condition));
+        milter_manager_applicable_condition_merge(new_condition, condition);
+        milter_manager_configuration_add_applicable_condition(new_configuration,
+                                                              new_condition);
+        g_object_unref(new_condition);
+    }
+
+    for (node = milter_manager_configuration_get_eggs(configuration);
+         node;
+         node = g_list_next(node)) {
+        MilterManagerEgg *egg, *new_egg;
+        const GList *condition_node;
+
+        egg = node->data;
+        new_egg = milter_manager_egg_new(milter_manager_egg_get_name(egg));
+        if (!milter_manager_egg_merge(new_egg, egg, error)) {
+            g_object_unref(new_egg);
+            g_object_unref(new_configuration);
+            return NULL;
+        }
+
+        milter_manager_egg_clear_applicable_conditions(new_egg);
+        condition_node = milter_manager_egg_get_applicable_conditions(egg);
+        for (; condition_node; condition_node = g_list_next(condition_node)) {
+            MilterManagerApplicableCondition *condition;
+
+            condition =
+                milter_manager_configuration_find_applicable_condition(
+                    new_configuration,
+                    milter_manager_applicable_condition_get_name(
+                        condition_node->data));
+            if (condition)
+                milter_manager_egg_add_applicable_condition(new_egg,
+                                                            condition);
+        }
+
+        milter_manager_configuration_add_egg(new_configuration, new_egg);
+        g_object_unref(new_egg);
+    }
+
+    return new_configuration;
+}
+
 gboolean
 milter_manager_configuration_save_custom (MilterManagerConfiguration *configuration,
                                           const gchar                *content,
@@ -1708,15 +1961,22 @@ milter_manager_configuration_clear_eggs (MilterManagerConfiguration *configurati
     }
 }
 
-void
-milter_manager_configuration_setup_children (MilterManagerConfiguration *configuration,
-                                             MilterManagerChildren *children,
-                                             MilterClientContext *context)
+static void
+setup_children (MilterManagerConfiguration *configuration,
+                MilterManagerChildren *children,
+                MilterClientContext *context,
+                gboolean mirror)
 {
     GList *node;
     MilterManagerConfigurationPrivate *priv;
+    gboolean skip_decided = FALSE;
+    gboolean skip_optional = FALSE;
+    gboolean mirror_evaluation_mode;
 
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    mirror_evaluation_mode = priv->mirror_buffer_size > 0;
+    if (mirror && !mirror_evaluation_mode)
+        return;
 
     for (node = priv->eggs; node; node = g_list_next(node)) {
         MilterManagerChild *child;
@@ -1725,6 +1985,26 @@ milter_manager_configuration_setup_children (MilterManagerConfiguration *configu
         if (!milter_manager_egg_is_enabled(egg))
             continue;
 
+        if (mirror_evaluation_mode &&
+            milter_manager_egg_is_evaluation_mode(egg) != mirror)
+            continue;
+
+        if (priv->stress_detector &&
+            milter_manager_egg_get_priority(egg) ==
+            MILTER_MANAGER_EGG_PRIORITY_OPTIONAL) {
+            if (!skip_decided) {
+                skip_optional =
+                    milter_manager_stress_detector_should_skip_optional(
+                        priv->stress_detector);
+                skip_decided = TRUE;
+            }
+            if (skip_optional) {
+                milter_debug("[configuration][setup-children][shed] <%s>",
+                             milter_manager_egg_get_name(egg));
+                continue;
+            }
+        }
+
         child = milter_manager_egg_hatch(egg);
         if (child) {
             milter_manager_children_add_child(children, child);
@@ -1736,6 +2016,22 @@ milter_manager_configuration_setup_children (MilterManagerConfiguration *configu
     }
 }
 
+void
+milter_manager_configuration_setup_children (MilterManagerConfiguration *configuration,
+                                             MilterManagerChildren *children,
+                                             MilterClientContext *context)
+{
+    setup_children(configuration, children, context, FALSE);
+}
+
+void
+milter_manager_configuration_setup_mirror_children (MilterManagerConfiguration *configuration,
+                                                    MilterManagerChildren *children,
+                                                    MilterClientContext *context)
+{
+    setup_children(configuration, children, context, TRUE);
+}
+
 MilterStatus
 milter_manager_configuration_get_fallback_status
                                      (MilterManagerConfiguration *configuration)
@@ -1948,8 +2244,18 @@ clear_manager (MilterManagerConfigurationPrivate *priv)
     priv->event_loop_backend = MILTER_CLIENT_EVENT_LOOP_BACKEND_GLIB;
     priv->n_workers = 0;
     priv->default_packet_buffer_size = 0;
-    priv->chunk_size = MILTER_CHUNK_SIZE;
+    priv->chunk_size = MILTER_MAX_DATA_SIZE_1M;
     priv->max_pending_finished_sessions = 0;
+    priv->session_deadline = 0;
+    priv->adaptive_max_connections = FALSE;
+    if (priv->stress_detector) {
+        g_object_unref(priv->stress_detector);
+        priv->stress_detector = NULL;
+    }
+    priv->reuse_port = FALSE;
+    priv->pin_workers = FALSE;
+    priv->n_io_threads = 0;
+    priv->mirror_buffer_size = 0;
 }
 
 static void
@@ -2412,7 +2718,7 @@ milter_manager_configuration_set_chunk_size (MilterManagerConfiguration *configu
     MilterManagerConfigurationPrivate *priv;
 
     priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
-    priv->chunk_size = MIN(size, MILTER_CHUNK_SIZE);
+    priv->chunk_size = MIN(size, MILTER_MAX_DATA_SIZE_1M);
 }
 
 guint
@@ -2434,6 +2740,214 @@ milter_manager_configuration_set_max_pending_finished_sessions (MilterManagerCon
     priv->max_pending_finished_sessions = n_sessions;
 }
 
+gdouble
+milter_manager_configuration_get_session_deadline (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->session_deadline;
+}
+
+void
+milter_manager_configuration_set_session_deadline (MilterManagerConfiguration *configuration,
+                                                   gdouble                     deadline)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->session_deadline = deadline;
+}
+
+gboolean
+milter_manager_configuration_is_adaptive_max_connections (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->adaptive_max_connections;
+}
+
+void
+milter_manager_configuration_set_adaptive_max_connections (MilterManagerConfiguration *configuration,
+                                                           gboolean                    adaptive)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->adaptive_max_connections = adaptive;
+}
+
+gboolean
+milter_manager_configuration_is_load_shedding (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->stress_detector != NULL;
+}
+
+void
+milter_manager_configuration_set_load_shedding (MilterManagerConfiguration *configuration,
+                                                gboolean                    load_shedding)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    if (load_shedding) {
+        if (!priv->stress_detector)
+            priv->stress_detector = milter_manager_stress_detector_new();
+    } else {
+        if (priv->stress_detector) {
+            g_object_unref(priv->stress_detector);
+            priv->stress_detector = NULL;
+        }
+    }
+}
+
+MilterManagerStressDetector *
+milter_manager_configuration_get_stress_detector (MilterManagerConfiguration *configuration)
+{
+    return MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration)->stress_detector;
+}
+
+gboolean
+milter_manager_configuration_is_reuse_port (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->reuse_port;
+}
+
+void
+milter_manager_configuration_set_reuse_port (MilterManagerConfiguration *configuration,
+                                             gboolean                    reuse_port)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->reuse_port = reuse_port;
+}
+
+gboolean
+milter_manager_configuration_is_pin_workers (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->pin_workers;
+}
+
+void
+milter_manager_configuration_set_pin_workers (MilterManagerConfiguration *configuration,
+                                              gboolean                    pin_workers)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->pin_workers = pin_workers;
+}
+
+guint
+milter_manager_configuration_get_n_io_threads (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->n_io_threads;
+}
+
+void
+milter_manager_configuration_set_n_io_threads (MilterManagerConfiguration *configuration,
+                                               guint                       n_io_threads)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->n_io_threads = n_io_threads;
+}
+
+guint
+milter_manager_configuration_get_mirror_buffer_size (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    return priv->mirror_buffer_size;
+}
+
+void
+milter_manager_configuration_set_mirror_buffer_size (MilterManagerConfiguration *configuration,
+                                                     guint                       size)
+{
+    MilterManagerConfigurationPrivate *priv;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    priv->mirror_buffer_size = size;
+}
+
+/*
+ * Sessions in I/O threads must not call Ruby. Ruby hooks
+ * are connected as signal handlers. The default handlers
+ * such as native applicable condition rules are safe.
+ */
+gboolean
+milter_manager_configuration_is_thread_safe (MilterManagerConfiguration *configuration)
+{
+    MilterManagerConfigurationPrivate *priv;
+    GList *node;
+    guint attach_to_signal_id;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+
+    if (priv->privilege_mode)
+        return FALSE;
+
+    if (g_signal_has_handler_pending(configuration, signals[CONNECTED],
+                                     0, TRUE))
+        return FALSE;
+
+    attach_to_signal_id =
+        g_signal_lookup("attach-to", MILTER_TYPE_MANAGER_APPLICABLE_CONDITION);
+    for (node = priv->applicable_conditions; node; node = g_list_next(node)) {
+        MilterManagerApplicableCondition *condition = node->data;
+
+        if (g_signal_has_handler_pending(condition, attach_to_signal_id,
+                                         0, TRUE))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+void
+milter_manager_configuration_share_runtime_state (MilterManagerConfiguration *configuration,
+                                                  MilterManagerConfiguration *source)
+{
+    MilterManagerConfigurationPrivate *priv, *source_priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(configuration);
+    source_priv = MILTER_MANAGER_CONFIGURATION_GET_PRIVATE(source);
+
+    if (priv->stress_detector && source_priv->stress_detector) {
+        g_object_unref(priv->stress_detector);
+        priv->stress_detector = g_object_ref(source_priv->stress_detector);
+    }
+
+    for (node = priv->eggs; node; node = g_list_next(node)) {
+        MilterManagerEgg *egg = node->data;
+        MilterManagerEgg *source_egg;
+
+        source_egg =
+            milter_manager_configuration_find_egg(source,
+                                                  milter_manager_egg_get_name(egg));
+        if (source_egg)
+            milter_manager_egg_share_runtime_state(egg, source_egg);
+    }
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -25,6 +25,7 @@
 #include <milter/manager/milter-manager-objects.h>
 #include <milter/manager/milter-manager-child.h>
 #include <milter/manager/milter-manager-egg.h>
+#include <milter/manager/milter-manager-stress-detector.h>
 
 G_BEGIN_DECLS
 
@@ -122,6 +123,28 @@ gboolean      milter_manager_configuration_load_custom_if_exist
 gboolean      milter_manager_configuration_reload
                                      (MilterManagerConfiguration *configuration,
                                       GError                    **error);
+/*
+ * Creates a new configuration that has the same load paths
+ * as @configuration and loads the configuration files into
+ * it. @configuration isn't changed. NULL is returned if the
+ * configuration files can't be loaded.
+ */
+MilterManagerConfiguration *
+              milter_manager_configuration_build
+                                     (MilterManagerConfiguration *configuration,
+                                      GError                    **error);
+/*
+ * Creates a new configuration that has the same load paths,
+ * properties, applicable conditions and eggs as
+ * @configuration without loading the configuration
+ * files. Condition rules are shared because they aren't
+ * changed while they are matched. NULL is returned if an
+ * egg can't be copied.
+ */
+MilterManagerConfiguration *
+              milter_manager_configuration_copy
+                                     (MilterManagerConfiguration *configuration,
+                                      GError                    **error);
 
 gboolean      milter_manager_configuration_save_custom
                                      (MilterManagerConfiguration *configuration,
@@ -289,6 +312,16 @@ void          milter_manager_configuration_setup_children
                                      (MilterManagerConfiguration *configuration,
                                       MilterManagerChildren      *children,
                                       MilterClientContext        *context);
+/*
+ * Adds children for milters in evaluation mode. They are
+ * added only when mirror buffer size is 1 or more. In the
+ * case, milter_manager_configuration_setup_children()
+ * doesn't add them.
+ */
+void          milter_manager_configuration_setup_mirror_children
+                                     (MilterManagerConfiguration *configuration,
+                                      MilterManagerChildren      *children,
+                                      MilterClientContext        *context);
 void          milter_manager_configuration_add_applicable_condition
                                      (MilterManagerConfiguration *configuration,
                                       MilterManagerApplicableCondition *condition);
@@ -396,6 +429,74 @@ void          milter_manager_configuration_set_max_pending_finished_sessions
                                      (MilterManagerConfiguration *configuration,
                                       guint                       n_sessions);
 
+gdouble       milter_manager_configuration_get_session_deadline
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_session_deadline
+                                     (MilterManagerConfiguration *configuration,
+                                      gdouble                     deadline);
+gboolean      milter_manager_configuration_is_adaptive_max_connections
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_adaptive_max_connections
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    adaptive);
+gboolean      milter_manager_configuration_is_load_shedding
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_load_shedding
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    load_shedding);
+MilterManagerStressDetector *
+              milter_manager_configuration_get_stress_detector
+                                     (MilterManagerConfiguration *configuration);
+gboolean      milter_manager_configuration_is_reuse_port
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_reuse_port
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    reuse_port);
+gboolean      milter_manager_configuration_is_pin_workers
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_pin_workers
+                                     (MilterManagerConfiguration *configuration,
+                                      gboolean                    pin_workers);
+guint         milter_manager_configuration_get_n_io_threads
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_n_io_threads
+                                     (MilterManagerConfiguration *configuration,
+                                      guint                       n_io_threads);
+
+/*
+ * Milters in evaluation mode are fed asynchronously from a
+ * copy of the session when mirror buffer size is 1 or
+ * more. The mirror is dropped when its queued commands use
+ * more than the size in bytes. 0 means that milters in
+ * evaluation mode are processed in the session.
+ */
+guint         milter_manager_configuration_get_mirror_buffer_size
+                                     (MilterManagerConfiguration *configuration);
+void          milter_manager_configuration_set_mirror_buffer_size
+                                     (MilterManagerConfiguration *configuration,
+                                      guint                       size);
+
+/*
+ * Returns TRUE when sessions can be processed in I/O
+ * threads with a copy of @configuration. It is FALSE when
+ * privilege mode is enabled or Ruby handlers are connected
+ * to "connected" or to "attach-to" of an applicable
+ * condition because they must run in the main thread.
+ */
+gboolean      milter_manager_configuration_is_thread_safe
+                                     (MilterManagerConfiguration *configuration);
+
+/*
+ * Makes @configuration use the thread safe runtime state
+ * of @source: the stress detector and the verdict and body
+ * caches, the circuit breakers and the session limiters of
+ * eggs that have the same name. It is used for per I/O
+ * thread copies of a configuration.
+ */
+void          milter_manager_configuration_share_runtime_state
+                                     (MilterManagerConfiguration *configuration,
+                                      MilterManagerConfiguration *source);
+
 G_END_DECLS
 
 #endif /* __MILTER_MANAGER_CONFIGURATION_H__ */
@@ -0,0 +1,532 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef HAVE_LINUX_INET_DIAG_H
+#  include <linux/netlink.h>
+#  include <linux/sock_diag.h>
+#  include <linux/inet_diag.h>
+#endif
+
+#include <milter/core.h>
+#include "milter-manager-connection-table.h"
+
+#define PROC_NET_TCP_PATH "/proc/net/tcp"
+#define PROC_NET_TCP6_PATH "/proc/net/tcp6"
+
+/* TCP states in the Linux kernel. */
+#define TCP_STATE_LISTEN 10
+
+#define MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(obj)                \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_CONNECTION_TABLE,  \
+                                 MilterManagerConnectionTablePrivate))
+
+typedef struct _MilterManagerConnectionTablePrivate MilterManagerConnectionTablePrivate;
+struct _MilterManagerConnectionTablePrivate
+{
+    /* "FOREIGN_ADDRESS:FOREIGN_PORT" -> MilterManagerConnectionInfo */
+    GHashTable *connections;
+};
+
+G_DEFINE_TYPE(MilterManagerConnectionTable,
+              milter_manager_connection_table,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_connection_table_class_init (MilterManagerConnectionTableClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerConnectionTablePrivate));
+}
+
+static void
+connection_info_free (gpointer data)
+{
+    MilterManagerConnectionInfo *info = data;
+
+    g_free(info->local_address);
+    g_free(info->foreign_address);
+    g_free(info);
+}
+
+static void
+milter_manager_connection_table_init (MilterManagerConnectionTable *table)
+{
+    MilterManagerConnectionTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+    priv->connections = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              g_free, connection_info_free);
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerConnectionTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(object);
+
+    if (priv->connections) {
+        g_hash_table_unref(priv->connections);
+        priv->connections = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_connection_table_parent_class)->dispose(object);
+}
+
+GQuark
+milter_manager_connection_table_error_quark (void)
+{
+    return g_quark_from_static_string("milter-manager-connection-table-error-quark");
+}
+
+MilterManagerConnectionTable *
+milter_manager_connection_table_new (void)
+{
+    return g_object_new(MILTER_TYPE_MANAGER_CONNECTION_TABLE,
+                        NULL);
+}
+
+static const gchar *
+state_name (guint state)
+{
+    switch (state) {
+    case 1:
+        return "ESTABLISHED";
+    case 2:
+        return "SYN_SENT";
+    case 3:
+        return "SYN_RECV";
+    case 4:
+        return "FIN_WAIT1";
+    case 5:
+        return "FIN_WAIT2";
+    case 6:
+        return "TIME_WAIT";
+    case 7:
+        return "CLOSE";
+    case 8:
+        return "CLOSE_WAIT";
+    case 9:
+        return "LAST_ACK";
+    case 10:
+        return "LISTEN";
+    case 11:
+        return "CLOSING";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+/*
+ * Formats an address. An IPv4-mapped IPv6 address is
+ * formatted as IPv4 address because an SMTP client address
+ * reported by MTA is IPv4 address for the case.
+ */
+static gchar *
+format_address (gint family, gconstpointer address)
+{
+    gchar buffer[INET6_ADDRSTRLEN];
+
+    if (family == AF_INET6 &&
+        IN6_IS_ADDR_V4MAPPED((const struct in6_addr *)address)) {
+        family = AF_INET;
+        address = ((const guint8 *)address) + 12;
+    }
+
+    if (!inet_ntop(family, address, buffer, sizeof(buffer)))
+        return NULL;
+
+    return g_strdup(buffer);
+}
+
+static gchar *
+normalize_address (const gchar *address)
+{
+    struct in_addr address4;
+    struct in6_addr address6;
+
+    if (inet_pton(AF_INET, address, &address4) == 1)
+        return format_address(AF_INET, &address4);
+    if (inet_pton(AF_INET6, address, &address6) == 1)
+        return format_address(AF_INET6, &address6);
+
+    return NULL;
+}
+
+static void
+add_connection (MilterManagerConnectionTablePrivate *priv,
+                gint family,
+                gconstpointer local_address, guint local_port,
+                gconstpointer foreign_address, guint foreign_port,
+                guint state)
+{
+    MilterManagerConnectionInfo *info, *existing_info;
+    gchar *key;
+
+    if (state == TCP_STATE_LISTEN)
+        return;
+
+    info = g_new0(MilterManagerConnectionInfo, 1);
+    info->family = family;
+    info->local_address = format_address(family, local_address);
+    info->local_port = local_port;
+    info->foreign_address = format_address(family, foreign_address);
+    info->foreign_port = foreign_port;
+    info->state = state_name(state);
+    if (!info->local_address || !info->foreign_address) {
+        connection_info_free(info);
+        return;
+    }
+
+    key = g_strdup_printf("%s:%u", info->foreign_address, info->foreign_port);
+    existing_info = g_hash_table_lookup(priv->connections, key);
+    if (existing_info && g_str_equal(existing_info->state, "ESTABLISHED")) {
+        /* Prefer a living connection for the same SMTP client. */
+        g_free(key);
+        connection_info_free(info);
+        return;
+    }
+    g_hash_table_replace(priv->connections, key, info);
+}
+
+static gboolean
+parse_hex_address (const gchar *hex, gint family, guint8 *address)
+{
+    gsize i, n_words;
+
+    n_words = (family == AF_INET) ? 1 : 4;
+    if (strlen(hex) != n_words * 8)
+        return FALSE;
+
+    /* Each 32bit word is formatted in host byte order. */
+    for (i = 0; i < n_words; i++) {
+        gchar word_hex[9];
+        gchar *end;
+        guint32 word;
+
+        memcpy(word_hex, hex + i * 8, 8);
+        word_hex[8] = '\0';
+        word = (guint32)strtoul(word_hex, &end, 16);
+        if (*end != '\0')
+            return FALSE;
+        memcpy(address + i * 4, &word, 4);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Parses a line of /proc/net/tcp{,6}:
+ *   "   0: 0100007F:0019 0100007F:D2A4 01 ..."
+ */
+static gboolean
+parse_proc_net_tcp_line (MilterManagerConnectionTablePrivate *priv,
+                         const gchar *line, gint family)
+{
+    gchar local_hex[33], foreign_hex[33];
+    guint local_port, foreign_port, state;
+    guint8 local_address[16], foreign_address[16];
+
+    if (sscanf(line, " %*u: %32[0-9A-Fa-f]:%x %32[0-9A-Fa-f]:%x %x",
+               local_hex, &local_port,
+               foreign_hex, &foreign_port,
+               &state) != 5)
+        return FALSE;
+
+    if (!parse_hex_address(local_hex, family, local_address) ||
+        !parse_hex_address(foreign_hex, family, foreign_address))
+        return FALSE;
+
+    add_connection(priv, family,
+                   local_address, local_port,
+                   foreign_address, foreign_port,
+                   state);
+    return TRUE;
+}
+
+gboolean
+milter_manager_connection_table_load_proc_net_tcp (MilterManagerConnectionTable *table,
+                                                   const gchar *path,
+                                                   gint family,
+                                                   GError **error)
+{
+    MilterManagerConnectionTablePrivate *priv;
+    FILE *file;
+    gchar line[1024];
+    guint n_lines = 0;
+    gboolean success = TRUE;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+
+    file = fopen(path, "r");
+    if (!file) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR_IO,
+                    "failed to open: <%s>: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+
+    /* Read line by line not to load the whole table. */
+    while (fgets(line, sizeof(line), file)) {
+        n_lines++;
+        if (n_lines == 1)
+            continue;
+        if (!parse_proc_net_tcp_line(priv, line, family)) {
+            g_set_error(error,
+                        MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                        MILTER_MANAGER_CONNECTION_TABLE_ERROR_INVALID_FORMAT,
+                        "invalid line: <%s>:%u: <%s>",
+                        path, n_lines, g_strchomp(line));
+            success = FALSE;
+            break;
+        }
+    }
+    fclose(file);
+
+    return success;
+}
+
+#ifdef HAVE_LINUX_INET_DIAG_H
+static gboolean
+load_sock_diag (MilterManagerConnectionTablePrivate *priv,
+                gint family, GError **error)
+{
+    gint fd;
+    struct sockaddr_nl address;
+    struct {
+        struct nlmsghdr header;
+        struct inet_diag_req_v2 request;
+    } message;
+    gchar buffer[32768];
+    gboolean done = FALSE;
+    gboolean success = TRUE;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
+    if (fd == -1) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR_NOT_SUPPORTED,
+                    "failed to create NETLINK_SOCK_DIAG socket: %s",
+                    g_strerror(errno));
+        return FALSE;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+
+    memset(&message, 0, sizeof(message));
+    message.header.nlmsg_len = sizeof(message);
+    message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    message.header.nlmsg_seq = 1;
+    message.request.sdiag_family = family;
+    message.request.sdiag_protocol = IPPROTO_TCP;
+    message.request.idiag_states = ~(1U << TCP_STATE_LISTEN);
+
+    if (sendto(fd, &message, sizeof(message), 0,
+               (struct sockaddr *)&address, sizeof(address)) == -1) {
+        g_set_error(error,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                    MILTER_MANAGER_CONNECTION_TABLE_ERROR_IO,
+                    "failed to send NETLINK_SOCK_DIAG request: %s",
+                    g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+
+    while (!done && success) {
+        ssize_t length;
+        struct nlmsghdr *header;
+
+        length = recv(fd, buffer, sizeof(buffer), 0);
+        if (length == -1) {
+            if (errno == EINTR)
+                continue;
+            g_set_error(error,
+                        MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                        MILTER_MANAGER_CONNECTION_TABLE_ERROR_IO,
+                        "failed to receive NETLINK_SOCK_DIAG response: %s",
+                        g_strerror(errno));
+            success = FALSE;
+            break;
+        }
+        if (length == 0)
+            break;
+
+        for (header = (struct nlmsghdr *)buffer;
+             NLMSG_OK(header, (guint)length);
+             header = NLMSG_NEXT(header, length)) {
+            struct inet_diag_msg *diag;
+
+            if (header->nlmsg_type == NLMSG_DONE) {
+                done = TRUE;
+                break;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                struct nlmsgerr *netlink_error = NLMSG_DATA(header);
+                g_set_error(error,
+                            MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                            MILTER_MANAGER_CONNECTION_TABLE_ERROR_NOT_SUPPORTED,
+                            "NETLINK_SOCK_DIAG request is failed: %s",
+                            g_strerror(-netlink_error->error));
+                success = FALSE;
+                break;
+            }
+            if (header->nlmsg_type != SOCK_DIAG_BY_FAMILY)
+                continue;
+
+            diag = NLMSG_DATA(header);
+            add_connection(priv, diag->idiag_family,
+                           diag->id.idiag_src, ntohs(diag->id.idiag_sport),
+                           diag->id.idiag_dst, ntohs(diag->id.idiag_dport),
+                           diag->idiag_state);
+        }
+    }
+    close(fd);
+
+    return success;
+}
+#endif
+
+static gboolean
+update_by_sock_diag (MilterManagerConnectionTablePrivate *priv,
+                     GError **error)
+{
+#ifdef HAVE_LINUX_INET_DIAG_H
+    if (!load_sock_diag(priv, AF_INET, error))
+        return FALSE;
+    /* IPv6 may be disabled. */
+    load_sock_diag(priv, AF_INET6, NULL);
+    return TRUE;
+#else
+    g_set_error(error,
+                MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                MILTER_MANAGER_CONNECTION_TABLE_ERROR_NOT_SUPPORTED,
+                "NETLINK_SOCK_DIAG isn't supported");
+    return FALSE;
+#endif
+}
+
+gboolean
+milter_manager_connection_table_update (MilterManagerConnectionTable *table,
+                                        GError **error)
+{
+    MilterManagerConnectionTablePrivate *priv;
+    GError *sock_diag_error = NULL;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+
+    milter_manager_connection_table_clear(table);
+    if (update_by_sock_diag(priv, &sock_diag_error))
+        return TRUE;
+
+    milter_debug("[connection-table][sock-diag][fallback] %s",
+                 sock_diag_error->message);
+    g_error_free(sock_diag_error);
+
+    milter_manager_connection_table_clear(table);
+    if (!milter_manager_connection_table_load_proc_net_tcp(table,
+                                                           PROC_NET_TCP_PATH,
+                                                           AF_INET,
+                                                           error)) {
+        milter_manager_connection_table_clear(table);
+        return FALSE;
+    }
+    if (g_file_test(PROC_NET_TCP6_PATH, G_FILE_TEST_EXISTS)) {
+        if (!milter_manager_connection_table_load_proc_net_tcp(table,
+                                                               PROC_NET_TCP6_PATH,
+                                                               AF_INET6,
+                                                               error)) {
+            milter_manager_connection_table_clear(table);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+void
+milter_manager_connection_table_clear (MilterManagerConnectionTable *table)
+{
+    MilterManagerConnectionTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+    g_hash_table_remove_all(priv->connections);
+}
+
+guint
+milter_manager_connection_table_size (MilterManagerConnectionTable *table)
+{
+    MilterManagerConnectionTablePrivate *priv;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+    return g_hash_table_size(priv->connections);
+}
+
+const MilterManagerConnectionInfo *
+milter_manager_connection_table_lookup (MilterManagerConnectionTable *table,
+                                        const gchar *foreign_address,
+                                        guint foreign_port)
+{
+    MilterManagerConnectionTablePrivate *priv;
+    MilterManagerConnectionInfo *info;
+    gchar *normalized_address;
+    gchar *key;
+
+    priv = MILTER_MANAGER_CONNECTION_TABLE_GET_PRIVATE(table);
+
+    normalized_address = normalize_address(foreign_address);
+    if (!normalized_address)
+        return NULL;
+
+    key = g_strdup_printf("%s:%u", normalized_address, foreign_port);
+    info = g_hash_table_lookup(priv->connections, key);
+    g_free(key);
+    g_free(normalized_address);
+
+    return info;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,97 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_CONNECTION_TABLE_H__
+#define __MILTER_MANAGER_CONNECTION_TABLE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_CONNECTION_TABLE_ERROR           (milter_manager_connection_table_error_quark())
+
+#define MILTER_TYPE_MANAGER_CONNECTION_TABLE            (milter_manager_connection_table_get_type())
+#define MILTER_MANAGER_CONNECTION_TABLE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_CONNECTION_TABLE, MilterManagerConnectionTable))
+#define MILTER_MANAGER_CONNECTION_TABLE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_CONNECTION_TABLE, MilterManagerConnectionTableClass))
+#define MILTER_MANAGER_IS_CONNECTION_TABLE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_CONNECTION_TABLE))
+#define MILTER_MANAGER_IS_CONNECTION_TABLE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_CONNECTION_TABLE))
+#define MILTER_MANAGER_CONNECTION_TABLE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_CONNECTION_TABLE, MilterManagerConnectionTableClass))
+
+typedef enum
+{
+    MILTER_MANAGER_CONNECTION_TABLE_ERROR_NOT_SUPPORTED,
+    MILTER_MANAGER_CONNECTION_TABLE_ERROR_IO,
+    MILTER_MANAGER_CONNECTION_TABLE_ERROR_INVALID_FORMAT
+} MilterManagerConnectionTableError;
+
+/*
+ * A TCP connection. Addresses are formatted by
+ * inet_ntop(). state is a netstat compatible state name
+ * such as "ESTABLISHED" and "CLOSE_WAIT".
+ */
+typedef struct _MilterManagerConnectionInfo
+{
+    gint family;
+    gchar *local_address;
+    guint local_port;
+    gchar *foreign_address;
+    guint foreign_port;
+    const gchar *state;
+} MilterManagerConnectionInfo;
+
+typedef struct _MilterManagerConnectionTable         MilterManagerConnectionTable;
+typedef struct _MilterManagerConnectionTableClass    MilterManagerConnectionTableClass;
+
+struct _MilterManagerConnectionTable
+{
+    GObject object;
+};
+
+struct _MilterManagerConnectionTableClass
+{
+    GObjectClass parent_class;
+};
+
+GQuark                        milter_manager_connection_table_error_quark (void);
+
+GType                         milter_manager_connection_table_get_type (void) G_GNUC_CONST;
+
+MilterManagerConnectionTable *milter_manager_connection_table_new     (void);
+
+gboolean                      milter_manager_connection_table_update  (MilterManagerConnectionTable *table,
+                                                                       GError                      **error);
+gboolean                      milter_manager_connection_table_load_proc_net_tcp
+                                                                      (MilterManagerConnectionTable *table,
+                                                                       const gchar                  *path,
+                                                                       gint                          family,
+                                                                       GError                      **error);
+void                          milter_manager_connection_table_clear   (MilterManagerConnectionTable *table);
+guint                         milter_manager_connection_table_size    (MilterManagerConnectionTable *table);
+const MilterManagerConnectionInfo *
+                              milter_manager_connection_table_lookup  (MilterManagerConnectionTable *table,
+                                                                       const gchar                  *foreign_address,
+                                                                       guint                         foreign_port);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_CONNECTION_TABLE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -181,7 +181,6 @@ cb_decoder_reload (MilterManagerControlCommandDecoder *decoder,
 {
     MilterManagerControllerContext *context = user_data;
     MilterManagerControllerContextPrivate *priv;
-    MilterManagerConfiguration *config;
     GError *error = NULL;
     MilterAgent *agent;
     MilterEncoder *base_encoder;
@@ -190,8 +189,7 @@ cb_decoder_reload (MilterManagerControlCommandDecoder *decoder,
     gsize packet_size;
 
     priv = MILTER_MANAGER_CONTROLLER_CONTEXT_GET_PRIVATE(context);
-    config = milter_manager_get_configuration(priv->manager);
-    if (!milter_manager_configuration_reload(config, &error)) {
+    if (!milter_manager_rebuild_configuration(priv->manager, &error)) {
         milter_error("[controller][reload][error] %s",
                      error->message);
         g_error_free(error);
@@ -21,9 +21,12 @@
 #  include "../../config.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <string.h>
+
 #include <milter/core/milter-marshalers.h>
 #include "milter-manager-egg.h"
 #include "milter-manager-enum-types.h"
+#include "milter-manager-latency-histogram.h"
 
 #define TIMEOUT_LEEWAY 3
 #define DEFAULT_CONNECTION_TIMEOUT \
@@ -35,6 +38,13 @@
 #define DEFAULT_END_OF_MESSAGE_TIMEOUT \
     (MILTER_SERVER_CONTEXT_DEFAULT_END_OF_MESSAGE_TIMEOUT - TIMEOUT_LEEWAY)
 
+#define DEFAULT_ADAPTIVE_TIMEOUT_FLOOR 1.0
+#define ADAPTIVE_TIMEOUT_PERCENTILE 99.9
+#define ADAPTIVE_TIMEOUT_MIN_SAMPLES 100
+#define MIN_ADAPTIVE_TIMEOUT_MULTIPLIER 1.0
+#define ADAPTIVE_TIMEOUT_CAPACITY 100000
+#define N_TIMEOUT_TYPES (MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE + 1)
+
 #define MILTER_MANAGER_EGG_GET_PRIVATE(obj)                     \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                         \
                                  MILTER_TYPE_MANAGER_EGG,       \
@@ -57,6 +67,29 @@ struct _MilterManagerEggPrivate
     GList *applicable_conditions;
     MilterStatus fallback_status;
     gboolean evaluation_mode;
+    guint circuit_breaker_threshold;
+    gdouble circuit_breaker_open_time;
+    gdouble circuit_breaker_slow_time;
+    MilterManagerCircuitBreaker *circuit_breaker;
+    gdouble adaptive_timeout_multiplier;
+    gdouble adaptive_timeout_floor;
+    gdouble adaptive_timeout_ceiling;
+    MilterManagerLatencyHistogram *latencies[N_TIMEOUT_TYPES];
+    guint max_concurrent_sessions;
+    guint max_waiting_sessions;
+    gdouble max_wait_time;
+    MilterManagerSessionLimiter *session_limiter;
+    GList *replica_connection_specs;
+    MilterManagerReplicaPolicy replica_policy;
+    MilterManagerReplicaSet *replica_set;
+    gdouble hedge_percentile;
+    guint verdict_cache_size;
+    gdouble verdict_cache_ttl;
+    MilterManagerVerdictCache *verdict_cache;
+    guint body_cache_size;
+    gdouble body_cache_ttl;
+    MilterManagerVerdictCache *body_cache;
+    MilterManagerEggPriority priority;
 };
 
 enum
@@ -74,7 +107,23 @@ enum
     PROP_COMMAND,
     PROP_COMMAND_OPTIONS,
     PROP_FALLBACK_STATUS,
-    PROP_REPUTATION_MODE
+    PROP_REPUTATION_MODE,
+    PROP_CIRCUIT_BREAKER_THRESHOLD,
+    PROP_CIRCUIT_BREAKER_OPEN_TIME,
+    PROP_CIRCUIT_BREAKER_SLOW_TIME,
+    PROP_ADAPTIVE_TIMEOUT_MULTIPLIER,
+    PROP_ADAPTIVE_TIMEOUT_FLOOR,
+    PROP_ADAPTIVE_TIMEOUT_CEILING,
+    PROP_MAX_CONCURRENT_SESSIONS,
+    PROP_MAX_WAITING_SESSIONS,
+    PROP_MAX_WAIT_TIME,
+    PROP_REPLICA_POLICY,
+    PROP_HEDGE_PERCENTILE,
+    PROP_VERDICT_CACHE_SIZE,
+    PROP_VERDICT_CACHE_TTL,
+    PROP_BODY_CACHE_SIZE,
+    PROP_BODY_CACHE_TTL,
+    PROP_PRIORITY
 };
 
 enum
@@ -216,6 +265,198 @@ milter_manager_egg_class_init (MilterManagerEggClass *klass)
                                 G_PARAM_READWRITE);
     g_object_class_install_property(gobject_class, PROP_REPUTATION_MODE, spec);
 
+    spec = g_param_spec_uint("circuit-breaker-threshold",
+                             "Circuit breaker threshold",
+                             "The number of consecutive failures "
+                             "to bypass the milter. 0 disables it.",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_CIRCUIT_BREAKER_THRESHOLD,
+                                    spec);
+
+    spec = g_param_spec_double("circuit-breaker-open-time",
+                               "Circuit breaker open time",
+                               "The seconds to bypass the milter "
+                               "before probing it again",
+                               0,
+                               G_MAXDOUBLE,
+                               MILTER_MANAGER_CIRCUIT_BREAKER_DEFAULT_OPEN_TIME,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_CIRCUIT_BREAKER_OPEN_TIME,
+                                    spec);
+
+    spec = g_param_spec_double("circuit-breaker-slow-time",
+                               "Circuit breaker slow time",
+                               "The seconds a session is treated as "
+                               "a failure. 0 disables it.",
+                               0,
+                               G_MAXDOUBLE,
+                               0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_CIRCUIT_BREAKER_SLOW_TIME,
+                                    spec);
+
+    spec = g_param_spec_double("adaptive-timeout-multiplier",
+                               "Adaptive timeout multiplier",
+                               "The multiplier of the observed p99.9 "
+                               "latency used as timeout. 0 disables it. "
+                               "Other values less than 1.0 are "
+                               "treated as 1.0.",
+                               0,
+                               G_MAXDOUBLE,
+                               0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_ADAPTIVE_TIMEOUT_MULTIPLIER,
+                                    spec);
+
+    spec = g_param_spec_double("adaptive-timeout-floor",
+                               "Adaptive timeout floor",
+                               "The minimum seconds of adaptive timeouts",
+                               0,
+                               G_MAXDOUBLE,
+                               DEFAULT_ADAPTIVE_TIMEOUT_FLOOR,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_ADAPTIVE_TIMEOUT_FLOOR,
+                                    spec);
+
+    spec = g_param_spec_double("adaptive-timeout-ceiling",
+                               "Adaptive timeout ceiling",
+                               "The maximum seconds of adaptive timeouts. "
+                               "0 uses the configured timeouts.",
+                               0,
+                               G_MAXDOUBLE,
+                               0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_ADAPTIVE_TIMEOUT_CEILING,
+                                    spec);
+
+    spec = g_param_spec_uint("max-concurrent-sessions",
+                             "Max concurrent sessions",
+                             "The maximum number of sessions that use "
+                             "the milter at once. 0 means no limit.",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_MAX_CONCURRENT_SESSIONS,
+                                    spec);
+
+    spec = g_param_spec_uint("max-waiting-sessions",
+                             "Max waiting sessions",
+                             "The maximum number of sessions that wait "
+                             "for the milter",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_MAX_WAITING_SESSIONS,
+                                    spec);
+
+    spec = g_param_spec_double("max-wait-time",
+                               "Max wait time",
+                               "The maximum seconds that a session "
+                               "waits for the milter",
+                               0,
+                               G_MAXDOUBLE,
+                               MILTER_MANAGER_SESSION_LIMITER_DEFAULT_MAX_WAIT_TIME,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_MAX_WAIT_TIME,
+                                    spec);
+
+    spec = g_param_spec_enum("replica-policy",
+                             "Replica policy",
+                             "The policy to choose a replica for a session",
+                             MILTER_TYPE_MANAGER_REPLICA_POLICY,
+                             MILTER_MANAGER_REPLICA_POLICY_ROUND_ROBIN,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_REPLICA_POLICY,
+                                    spec);
+
+    spec = g_param_spec_double("hedge-percentile",
+                               "Hedge percentile",
+                               "The percentile of the observed reply "
+                               "latency after which an envelope command "
+                               "is also sent to another replica. "
+                               "0 disables it.",
+                               0,
+                               100,
+                               0,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_HEDGE_PERCENTILE,
+                                    spec);
+
+    spec = g_param_spec_uint("verdict-cache-size",
+                             "Verdict cache size",
+                             "The number of cached CONNECT and HELO "
+                             "verdicts. 0 disables the cache.",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_VERDICT_CACHE_SIZE,
+                                    spec);
+
+    spec = g_param_spec_double("verdict-cache-ttl",
+                               "Verdict cache TTL",
+                               "The seconds that a cached verdict is used",
+                               0,
+                               G_MAXDOUBLE,
+                               MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_VERDICT_CACHE_TTL,
+                                    spec);
+
+    spec = g_param_spec_uint("body-cache-size",
+                             "Body cache size",
+                             "The number of cached end-of-message "
+                             "verdicts by message body. "
+                             "0 disables the cache.",
+                             0,
+                             G_MAXUINT,
+                             0,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_BODY_CACHE_SIZE,
+                                    spec);
+
+    spec = g_param_spec_double("body-cache-ttl",
+                               "Body cache TTL",
+                               "The seconds that a cached verdict "
+                               "by message body is used",
+                               0,
+                               G_MAXDOUBLE,
+                               MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL,
+                               G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_BODY_CACHE_TTL,
+                                    spec);
+
+    spec = g_param_spec_enum("priority",
+                             "Priority",
+                             "The priority of the milter. Optional "
+                             "milters may be skipped under stress.",
+                             MILTER_TYPE_MANAGER_EGG_PRIORITY,
+                             MILTER_MANAGER_EGG_PRIORITY_ESSENTIAL,
+                             G_PARAM_READWRITE);
+    g_object_class_install_property(gobject_class,
+                                    PROP_PRIORITY,
+                                    spec);
+
     signals[HATCHED] =
         g_signal_new("hatched",
                      G_TYPE_FROM_CLASS(klass),
@@ -259,6 +500,30 @@ milter_manager_egg_init (MilterManagerEgg *egg)
     priv->applicable_conditions = NULL;
     priv->fallback_status = MILTER_STATUS_ACCEPT;
     priv->evaluation_mode = FALSE;
+    priv->circuit_breaker_threshold = 0;
+    priv->circuit_breaker_open_time =
+        MILTER_MANAGER_CIRCUIT_BREAKER_DEFAULT_OPEN_TIME;
+    priv->circuit_breaker_slow_time = 0;
+    priv->circuit_breaker = NULL;
+    priv->adaptive_timeout_multiplier = 0;
+    priv->adaptive_timeout_floor = DEFAULT_ADAPTIVE_TIMEOUT_FLOOR;
+    priv->adaptive_timeout_ceiling = 0;
+    memset(priv->latencies, 0, sizeof(priv->latencies));
+    priv->max_concurrent_sessions = 0;
+    priv->max_waiting_sessions = 0;
+    priv->max_wait_time = MILTER_MANAGER_SESSION_LIMITER_DEFAULT_MAX_WAIT_TIME;
+    priv->session_limiter = NULL;
+    priv->replica_connection_specs = NULL;
+    priv->replica_policy = MILTER_MANAGER_REPLICA_POLICY_ROUND_ROBIN;
+    priv->replica_set = NULL;
+    priv->hedge_percentile = 0;
+    priv->verdict_cache_size = 0;
+    priv->verdict_cache_ttl = MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL;
+    priv->verdict_cache = NULL;
+    priv->body_cache_size = 0;
+    priv->body_cache_ttl = MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL;
+    priv->body_cache = NULL;
+    priv->priority = MILTER_MANAGER_EGG_PRIORITY_ESSENTIAL;
 }
 
 static void
@@ -266,6 +531,7 @@ dispose (GObject *object)
 {
     MilterManagerEgg *egg;
     MilterManagerEggPrivate *priv;
+    guint i;
 
     egg = MILTER_MANAGER_EGG(object);
     priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
@@ -302,6 +568,35 @@ dispose (GObject *object)
 
     milter_manager_egg_clear_applicable_conditions(egg);
 
+    if (priv->circuit_breaker) {
+        g_object_unref(priv->circuit_breaker);
+        priv->circuit_breaker = NULL;
+    }
+
+    if (priv->session_limiter) {
+        g_object_unref(priv->session_limiter);
+        priv->session_limiter = NULL;
+    }
+
+    if (priv->verdict_cache) {
+        g_object_unref(priv->verdict_cache);
+        priv->verdict_cache = NULL;
+    }
+
+    if (priv->body_cache) {
+        g_object_unref(priv->body_cache);
+        priv->body_cache = NULL;
+    }
+
+    milter_manager_egg_clear_replica_connection_specs(egg);
+
+    for (i = 0; i < N_TIMEOUT_TYPES; i++) {
+        if (priv->latencies[i]) {
+            milter_manager_latency_histogram_unref(priv->latencies[i]);
+            priv->latencies[i] = NULL;
+        }
+    }
+
     G_OBJECT_CLASS(milter_manager_egg_parent_class)->dispose(object);
 }
 
@@ -356,6 +651,55 @@ set_property (GObject      *object,
     case PROP_REPUTATION_MODE:
         milter_manager_egg_set_evaluation_mode(egg, g_value_get_boolean(value));
         break;
+    case PROP_CIRCUIT_BREAKER_THRESHOLD:
+        priv->circuit_breaker_threshold = g_value_get_uint(value);
+        break;
+    case PROP_CIRCUIT_BREAKER_OPEN_TIME:
+        priv->circuit_breaker_open_time = g_value_get_double(value);
+        break;
+    case PROP_CIRCUIT_BREAKER_SLOW_TIME:
+        priv->circuit_breaker_slow_time = g_value_get_double(value);
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_MULTIPLIER:
+        milter_manager_egg_set_adaptive_timeout_multiplier(
+            egg, g_value_get_double(value));
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_FLOOR:
+        priv->adaptive_timeout_floor = g_value_get_double(value);
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_CEILING:
+        priv->adaptive_timeout_ceiling = g_value_get_double(value);
+        break;
+    case PROP_MAX_CONCURRENT_SESSIONS:
+        priv->max_concurrent_sessions = g_value_get_uint(value);
+        break;
+    case PROP_MAX_WAITING_SESSIONS:
+        priv->max_waiting_sessions = g_value_get_uint(value);
+        break;
+    case PROP_MAX_WAIT_TIME:
+        priv->max_wait_time = g_value_get_double(value);
+        break;
+    case PROP_REPLICA_POLICY:
+        priv->replica_policy = g_value_get_enum(value);
+        break;
+    case PROP_HEDGE_PERCENTILE:
+        priv->hedge_percentile = g_value_get_double(value);
+        break;
+    case PROP_VERDICT_CACHE_SIZE:
+        milter_manager_egg_set_verdict_cache_size(egg, g_value_get_uint(value));
+        break;
+    case PROP_VERDICT_CACHE_TTL:
+        priv->verdict_cache_ttl = g_value_get_double(value);
+        break;
+    case PROP_BODY_CACHE_SIZE:
+        milter_manager_egg_set_body_cache_size(egg, g_value_get_uint(value));
+        break;
+    case PROP_BODY_CACHE_TTL:
+        priv->body_cache_ttl = g_value_get_double(value);
+        break;
+    case PROP_PRIORITY:
+        priv->priority = g_value_get_enum(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -411,6 +755,54 @@ get_property (GObject    *object,
     case PROP_REPUTATION_MODE:
         g_value_set_boolean(value, priv->evaluation_mode);
         break;
+    case PROP_CIRCUIT_BREAKER_THRESHOLD:
+        g_value_set_uint(value, priv->circuit_breaker_threshold);
+        break;
+    case PROP_CIRCUIT_BREAKER_OPEN_TIME:
+        g_value_set_double(value, priv->circuit_breaker_open_time);
+        break;
+    case PROP_CIRCUIT_BREAKER_SLOW_TIME:
+        g_value_set_double(value, priv->circuit_breaker_slow_time);
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_MULTIPLIER:
+        g_value_set_double(value, priv->adaptive_timeout_multiplier);
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_FLOOR:
+        g_value_set_double(value, priv->adaptive_timeout_floor);
+        break;
+    case PROP_ADAPTIVE_TIMEOUT_CEILING:
+        g_value_set_double(value, priv->adaptive_timeout_ceiling);
+        break;
+    case PROP_MAX_CONCURRENT_SESSIONS:
+        g_value_set_uint(value, priv->max_concurrent_sessions);
+        break;
+    case PROP_MAX_WAITING_SESSIONS:
+        g_value_set_uint(value, priv->max_waiting_sessions);
+        break;
+    case PROP_MAX_WAIT_TIME:
+        g_value_set_double(value, priv->max_wait_time);
+        break;
+    case PROP_REPLICA_POLICY:
+        g_value_set_enum(value, priv->replica_policy);
+        break;
+    case PROP_HEDGE_PERCENTILE:
+        g_value_set_double(value, priv->hedge_percentile);
+        break;
+    case PROP_VERDICT_CACHE_SIZE:
+        g_value_set_uint(value, priv->verdict_cache_size);
+        break;
+    case PROP_VERDICT_CACHE_TTL:
+        g_value_set_double(value, priv->verdict_cache_ttl);
+        break;
+    case PROP_BODY_CACHE_SIZE:
+        g_value_set_uint(value, priv->body_cache_size);
+        break;
+    case PROP_BODY_CACHE_TTL:
+        g_value_set_double(value, priv->body_cache_ttl);
+        break;
+    case PROP_PRIORITY:
+        g_value_set_enum(value, priv->priority);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
@@ -444,33 +836,236 @@ hatch (const gchar *first_name, ...)
     return child;
 }
 
+static const gchar *
+timeout_type_to_name (MilterServerContextTimeoutType type)
+{
+    switch (type) {
+    case MILTER_SERVER_CONTEXT_TIMEOUT_CONNECTION:
+        return "connection";
+    case MILTER_SERVER_CONTEXT_TIMEOUT_WRITING:
+        return "writing";
+    case MILTER_SERVER_CONTEXT_TIMEOUT_READING:
+        return "reading";
+    case MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE:
+        return "end-of-message";
+    default:
+        return "none";
+    }
+}
+
+static void
+cb_latency_observed (MilterServerContext *context,
+                     MilterServerContextTimeoutType type,
+                     gdouble elapsed,
+                     gpointer user_data)
+{
+    MilterManagerEgg *egg = user_data;
+    MilterManagerEggPrivate *priv;
+
+    if (type <= MILTER_SERVER_CONTEXT_TIMEOUT_NONE || type >= N_TIMEOUT_TYPES)
+        return;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (!priv->latencies[type])
+        priv->latencies[type] =
+            milter_manager_latency_histogram_new(ADAPTIVE_TIMEOUT_CAPACITY);
+    milter_manager_latency_histogram_add(priv->latencies[type], elapsed);
+}
+
+static gdouble
+adapt_timeout (MilterManagerEgg *egg,
+               MilterServerContextTimeoutType type,
+               gdouble timeout)
+{
+    MilterManagerEggPrivate *priv;
+    MilterManagerLatencyHistogram *latencies;
+    gdouble adapted_timeout, ceiling;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    latencies = priv->latencies[type];
+    if (!latencies ||
+        milter_manager_latency_histogram_get_n_samples(latencies) <
+        ADAPTIVE_TIMEOUT_MIN_SAMPLES)
+        return timeout;
+
+    adapted_timeout = priv->adaptive_timeout_multiplier *
+        milter_manager_latency_histogram_get_percentile(
+            latencies, ADAPTIVE_TIMEOUT_PERCENTILE);
+    ceiling = priv->adaptive_timeout_ceiling;
+    if (ceiling <= 0)
+        ceiling = timeout;
+    adapted_timeout = CLAMP(adapted_timeout,
+                            MIN(priv->adaptive_timeout_floor, ceiling),
+                            ceiling);
+
+    milter_debug("[egg][adaptive-timeout][%s] %s: %g -> %g",
+                 priv->name ? priv->name : "(null)",
+                 timeout_type_to_name(type),
+                 timeout,
+                 adapted_timeout);
+
+    return adapted_timeout;
+}
+
+/*
+ * Hedging replays the session on another replica by the
+ * children. Applicable conditions are attached by the
+ * configuration with the client context that the children
+ * doesn't have. So milters with applicable conditions
+ * aren't hedged.
+ */
+static gdouble
+compute_hedge_delay (MilterManagerEgg *egg)
+{
+    MilterManagerEggPrivate *priv;
+    MilterManagerLatencyHistogram *latencies;
+    gdouble hedge_delay;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (priv->hedge_percentile <= 0)
+        return 0;
+    if (!priv->replica_set ||
+        milter_manager_replica_set_get_size(priv->replica_set) < 2)
+        return 0;
+    if (priv->applicable_conditions)
+        return 0;
+
+    latencies = priv->latencies[MILTER_SERVER_CONTEXT_TIMEOUT_READING];
+    if (!latencies ||
+        milter_manager_latency_histogram_get_n_samples(latencies) <
+        ADAPTIVE_TIMEOUT_MIN_SAMPLES)
+        return 0;
+
+    hedge_delay =
+        milter_manager_latency_histogram_get_percentile(latencies,
+                                                        priv->hedge_percentile);
+    milter_debug("[egg][hedge][%s] <%g>: %g",
+                 priv->name ? priv->name : "(null)",
+                 priv->hedge_percentile,
+                 hedge_delay);
+
+    return hedge_delay;
+}
+
 MilterManagerChild *
 milter_manager_egg_hatch (MilterManagerEgg *egg)
 {
     MilterManagerChild *child;
     MilterManagerEggPrivate *priv;
+    gdouble connection_timeout;
+    gdouble writing_timeout;
+    gdouble reading_timeout;
+    gdouble end_of_message_timeout;
+    const gchar *connection_spec;
+    gint replica_index = -1;
+    gdouble hedge_delay = 0;
 
     priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
 
+    connection_timeout = priv->connection_timeout;
+    writing_timeout = priv->writing_timeout;
+    reading_timeout = priv->reading_timeout;
+    end_of_message_timeout = priv->end_of_message_timeout;
+    if (priv->adaptive_timeout_multiplier > 0) {
+        connection_timeout =
+            adapt_timeout(egg, MILTER_SERVER_CONTEXT_TIMEOUT_CONNECTION,
+                          connection_timeout);
+        writing_timeout =
+            adapt_timeout(egg, MILTER_SERVER_CONTEXT_TIMEOUT_WRITING,
+                          writing_timeout);
+        reading_timeout =
+            adapt_timeout(egg, MILTER_SERVER_CONTEXT_TIMEOUT_READING,
+                          reading_timeout);
+        end_of_message_timeout =
+            adapt_timeout(egg, MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE,
+                          end_of_message_timeout);
+    }
+
+    if (priv->circuit_breaker_threshold > 0) {
+        if (!priv->circuit_breaker)
+            priv->circuit_breaker = milter_manager_circuit_breaker_new(priv->name);
+        milter_manager_circuit_breaker_set_failure_threshold(
+            priv->circuit_breaker, priv->circuit_breaker_threshold);
+        milter_manager_circuit_breaker_set_open_time(
+            priv->circuit_breaker, priv->circuit_breaker_open_time);
+        milter_manager_circuit_breaker_set_slow_time(
+            priv->circuit_breaker, priv->circuit_breaker_slow_time);
+    } else if (priv->circuit_breaker) {
+        g_object_unref(priv->circuit_breaker);
+        priv->circuit_breaker = NULL;
+    }
+
+    /* The limiter is kept even if the limit is removed
+     * because running children may still hold its slots. */
+    if (priv->max_concurrent_sessions > 0 && !priv->session_limiter)
+        priv->session_limiter = milter_manager_session_limiter_new(priv->name);
+    if (priv->session_limiter) {
+        milter_manager_session_limiter_set_max_waiting_sessions(
+            priv->session_limiter, priv->max_waiting_sessions);
+        milter_manager_session_limiter_set_max_wait_time(
+            priv->session_limiter, priv->max_wait_time);
+        milter_manager_session_limiter_set_max_sessions(
+            priv->session_limiter, priv->max_concurrent_sessions);
+    }
+
+    if (priv->verdict_cache)
+        milter_manager_verdict_cache_set_ttl(priv->verdict_cache,
+                                             priv->verdict_cache_ttl);
+    if (priv->body_cache)
+        milter_manager_verdict_cache_set_ttl(priv->body_cache,
+                                             priv->body_cache_ttl);
+
+    connection_spec = priv->connection_spec;
+    if (priv->replica_connection_specs) {
+        if (!priv->replica_set) {
+            GList *node;
+
+            priv->replica_set = milter_manager_replica_set_new(priv->name);
+            for (node = priv->replica_connection_specs;
+                 node;
+                 node = g_list_next(node)) {
+                milter_manager_replica_set_add(priv->replica_set, node->data);
+            }
+        }
+        milter_manager_replica_set_set_policy(priv->replica_set,
+                                              priv->replica_policy);
+        replica_index = milter_manager_replica_set_select(priv->replica_set);
+        connection_spec =
+            milter_manager_replica_set_get_connection_spec(priv->replica_set,
+                                                           replica_index);
+        hedge_delay = compute_hedge_delay(egg);
+    }
+
     child = hatch("name", priv->name,
-                  "connection-timeout", priv->connection_timeout,
-                  "writing-timeout", priv->writing_timeout,
-                  "reading-timeout", priv->reading_timeout,
-                  "end-of-message-timeout", priv->end_of_message_timeout,
+                  "connection-timeout", connection_timeout,
+                  "writing-timeout", writing_timeout,
+                  "reading-timeout", reading_timeout,
+                  "end-of-message-timeout", end_of_message_timeout,
                   "user-name", priv->user_name,
                   "command", priv->command,
                   "command-options", priv->command_options,
                   "fallback-status", priv->fallback_status,
                   "evaluation-mode", priv->evaluation_mode,
+                  "circuit-breaker", priv->circuit_breaker,
+                  "session-limiter", priv->session_limiter,
+                  "replica-set", replica_index < 0 ? NULL : priv->replica_set,
+                  "replica-index", replica_index,
+                  "hedge-delay", hedge_delay,
+                  "verdict-cache", priv->verdict_cache,
+                  "body-cache", priv->body_cache,
                   NULL);
 
-    if (priv->connection_spec) {
+    if (priv->adaptive_timeout_multiplier > 0 || priv->hedge_percentile > 0)
+        g_signal_connect_object(child, "latency-observed",
+                                G_CALLBACK(cb_latency_observed), egg, 0);
+
+    if (connection_spec) {
         GError *error = NULL;
         MilterServerContext *context;
 
         context = MILTER_SERVER_CONTEXT(child);
         if (milter_server_context_set_connection_spec(context,
-                                                      priv->connection_spec,
+                                                      connection_spec,
                                                       &error)) {
             g_signal_emit(egg, signals[HATCHED], 0, child);
         } else {
@@ -536,10 +1131,9 @@ milter_manager_egg_is_enabled (MilterManagerEgg *egg)
     return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->enabled;
 }
 
-gboolean
-milter_manager_egg_set_connection_spec (MilterManagerEgg *egg,
-                                        const gchar *spec, GError **error)
-
+static gboolean
+validate_connection_spec (MilterManagerEgg *egg,
+                          const gchar *spec, GError **error)
 {
     MilterManagerEggPrivate *priv;
     GError *spec_error = NULL;
@@ -560,11 +1154,7 @@ milter_manager_egg_set_connection_spec (MilterManagerEgg *egg,
     if (address)
         g_free(address);
 
-    if (success) {
-        if (priv->connection_spec)
-            g_free(priv->connection_spec);
-        priv->connection_spec = g_strdup(spec);
-    } else {
+    if (!success) {
         GError *wrapped_error = NULL;
 
         milter_utils_set_error_with_sub_error(&wrapped_error,
@@ -582,12 +1172,109 @@ milter_manager_egg_set_connection_spec (MilterManagerEgg *egg,
     return success;
 }
 
+gboolean
+milter_manager_egg_set_connection_spec (MilterManagerEgg *egg,
+                                        const gchar *spec, GError **error)
+
+{
+    MilterManagerEggPrivate *priv;
+
+    if (!validate_connection_spec(egg, spec, error))
+        return FALSE;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (priv->connection_spec)
+        g_free(priv->connection_spec);
+    priv->connection_spec = g_strdup(spec);
+
+    return TRUE;
+}
+
 const gchar *
 milter_manager_egg_get_connection_spec (MilterManagerEgg *egg)
 {
     return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->connection_spec;
 }
 
+static void
+reset_replica_set (MilterManagerEggPrivate *priv)
+{
+    if (priv->replica_set) {
+        g_object_unref(priv->replica_set);
+        priv->replica_set = NULL;
+    }
+}
+
+gboolean
+milter_manager_egg_add_replica_connection_spec (MilterManagerEgg *egg,
+                                                const gchar *spec,
+                                                GError **error)
+{
+    MilterManagerEggPrivate *priv;
+
+    if (!spec || !validate_connection_spec(egg, spec, error))
+        return FALSE;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    priv->replica_connection_specs =
+        g_list_append(priv->replica_connection_specs, g_strdup(spec));
+    reset_replica_set(priv);
+
+    return TRUE;
+}
+
+const GList *
+milter_manager_egg_get_replica_connection_specs (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->replica_connection_specs;
+}
+
+void
+milter_manager_egg_clear_replica_connection_specs (MilterManagerEgg *egg)
+{
+    MilterManagerEggPrivate *priv;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (priv->replica_connection_specs) {
+        g_list_foreach(priv->replica_connection_specs, (GFunc)g_free, NULL);
+        g_list_free(priv->replica_connection_specs);
+        priv->replica_connection_specs = NULL;
+    }
+    reset_replica_set(priv);
+}
+
+void
+milter_manager_egg_set_replica_policy (MilterManagerEgg *egg,
+                                       MilterManagerReplicaPolicy policy)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->replica_policy = policy;
+}
+
+MilterManagerReplicaPolicy
+milter_manager_egg_get_replica_policy (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->replica_policy;
+}
+
+MilterManagerReplicaSet *
+milter_manager_egg_get_replica_set (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->replica_set;
+}
+
+void
+milter_manager_egg_set_hedge_percentile (MilterManagerEgg *egg,
+                                         gdouble           percentile)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->hedge_percentile = percentile;
+}
+
+gdouble
+milter_manager_egg_get_hedge_percentile (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->hedge_percentile;
+}
+
 void
 milter_manager_egg_set_connection_timeout (MilterManagerEgg *egg,
                                            gdouble connection_timeout)
@@ -732,6 +1419,309 @@ milter_manager_egg_is_evaluation_mode (MilterManagerEgg *egg)
     return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->evaluation_mode;
 }
 
+void
+milter_manager_egg_set_circuit_breaker_threshold (MilterManagerEgg *egg,
+                                                  guint             threshold)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_threshold = threshold;
+}
+
+guint
+milter_manager_egg_get_circuit_breaker_threshold (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_threshold;
+}
+
+void
+milter_manager_egg_set_circuit_breaker_open_time (MilterManagerEgg *egg,
+                                                  gdouble           open_time)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_open_time = open_time;
+}
+
+gdouble
+milter_manager_egg_get_circuit_breaker_open_time (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_open_time;
+}
+
+void
+milter_manager_egg_set_circuit_breaker_slow_time (MilterManagerEgg *egg,
+                                                  gdouble           slow_time)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_slow_time = slow_time;
+}
+
+gdouble
+milter_manager_egg_get_circuit_breaker_slow_time (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker_slow_time;
+}
+
+MilterManagerCircuitBreaker *
+milter_manager_egg_get_circuit_breaker (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->circuit_breaker;
+}
+
+void
+milter_manager_egg_set_adaptive_timeout_multiplier (MilterManagerEgg *egg,
+                                                    gdouble           multiplier)
+{
+    /* A timeout shorter than the observed p99.9 latency
+     * times out healthy sessions. */
+    if (multiplier > 0 && multiplier < MIN_ADAPTIVE_TIMEOUT_MULTIPLIER)
+        multiplier = MIN_ADAPTIVE_TIMEOUT_MULTIPLIER;
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_multiplier =
+        multiplier;
+}
+
+gdouble
+milter_manager_egg_get_adaptive_timeout_multiplier (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_multiplier;
+}
+
+void
+milter_manager_egg_set_adaptive_timeout_floor (MilterManagerEgg *egg,
+                                               gdouble           floor_time)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_floor = floor_time;
+}
+
+gdouble
+milter_manager_egg_get_adaptive_timeout_floor (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_floor;
+}
+
+void
+milter_manager_egg_set_adaptive_timeout_ceiling (MilterManagerEgg *egg,
+                                                 gdouble           ceiling_time)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_ceiling = ceiling_time;
+}
+
+gdouble
+milter_manager_egg_get_adaptive_timeout_ceiling (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->adaptive_timeout_ceiling;
+}
+
+void
+milter_manager_egg_set_max_concurrent_sessions (MilterManagerEgg *egg,
+                                                guint             n_sessions)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_concurrent_sessions = n_sessions;
+}
+
+guint
+milter_manager_egg_get_max_concurrent_sessions (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_concurrent_sessions;
+}
+
+void
+milter_manager_egg_set_max_waiting_sessions (MilterManagerEgg *egg,
+                                             guint             n_sessions)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_waiting_sessions = n_sessions;
+}
+
+guint
+milter_manager_egg_get_max_waiting_sessions (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_waiting_sessions;
+}
+
+void
+milter_manager_egg_set_max_wait_time (MilterManagerEgg *egg,
+                                      gdouble           wait_time)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_wait_time = wait_time;
+}
+
+gdouble
+milter_manager_egg_get_max_wait_time (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->max_wait_time;
+}
+
+MilterManagerSessionLimiter *
+milter_manager_egg_get_session_limiter (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->session_limiter;
+}
+
+/*
+ * The cache is created here instead of hatch because it
+ * must exist before workers are forked to be shared by
+ * them.
+ */
+void
+milter_manager_egg_set_verdict_cache_size (MilterManagerEgg *egg,
+                                           guint             size)
+{
+    MilterManagerEggPrivate *priv;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (priv->verdict_cache_size == size && (size == 0 || priv->verdict_cache))
+        return;
+
+    priv->verdict_cache_size = size;
+    if (priv->verdict_cache) {
+        g_object_unref(priv->verdict_cache);
+        priv->verdict_cache = NULL;
+    }
+    if (size > 0)
+        priv->verdict_cache = milter_manager_verdict_cache_new(priv->name, size);
+}
+
+guint
+milter_manager_egg_get_verdict_cache_size (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->verdict_cache_size;
+}
+
+void
+milter_manager_egg_set_verdict_cache_ttl (MilterManagerEgg *egg,
+                                          gdouble           ttl)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->verdict_cache_ttl = ttl;
+}
+
+gdouble
+milter_manager_egg_get_verdict_cache_ttl (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->verdict_cache_ttl;
+}
+
+MilterManagerVerdictCache *
+milter_manager_egg_get_verdict_cache (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->verdict_cache;
+}
+
+void
+milter_manager_egg_set_body_cache_size (MilterManagerEgg *egg,
+                                        guint             size)
+{
+    MilterManagerEggPrivate *priv;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    if (priv->body_cache_size == size && (size == 0 || priv->body_cache))
+        return;
+
+    priv->body_cache_size = size;
+    if (priv->body_cache) {
+        g_object_unref(priv->body_cache);
+        priv->body_cache = NULL;
+    }
+    if (size > 0)
+        priv->body_cache = milter_manager_verdict_cache_new(priv->name, size);
+}
+
+guint
+milter_manager_egg_get_body_cache_size (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->body_cache_size;
+}
+
+void
+milter_manager_egg_set_body_cache_ttl (MilterManagerEgg *egg,
+                                       gdouble           ttl)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->body_cache_ttl = ttl;
+}
+
+gdouble
+milter_manager_egg_get_body_cache_ttl (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->body_cache_ttl;
+}
+
+MilterManagerVerdictCache *
+milter_manager_egg_get_body_cache (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->body_cache;
+}
+
+static void
+share_cache (MilterManagerVerdictCache **cache,
+             MilterManagerVerdictCache *source_cache)
+{
+    if (!*cache || !source_cache || *cache == source_cache)
+        return;
+    if (milter_manager_verdict_cache_get_size(*cache) !=
+        milter_manager_verdict_cache_get_size(source_cache))
+        return;
+
+    g_object_unref(*cache);
+    *cache = g_object_ref(source_cache);
+}
+
+void
+milter_manager_egg_share_runtime_state (MilterManagerEgg *egg,
+                                        MilterManagerEgg *source)
+{
+    MilterManagerEggPrivate *priv, *source_priv;
+
+    priv = MILTER_MANAGER_EGG_GET_PRIVATE(egg);
+    source_priv = MILTER_MANAGER_EGG_GET_PRIVATE(source);
+    share_cache(&(priv->verdict_cache), source_priv->verdict_cache);
+    share_cache(&(priv->body_cache), source_priv->body_cache);
+
+    /* They are created here instead of the first hatch
+     * because @source may hatch in another thread. */
+    if (priv->circuit_breaker_threshold > 0) {
+        if (!source_priv->circuit_breaker)
+            source_priv->circuit_breaker =
+                milter_manager_circuit_breaker_new(source_priv->name);
+        if (priv->circuit_breaker)
+            g_object_unref(priv->circuit_breaker);
+        priv->circuit_breaker = g_object_ref(source_priv->circuit_breaker);
+    }
+
+    if (priv->max_concurrent_sessions > 0 || source_priv->session_limiter) {
+        if (!source_priv->session_limiter)
+            source_priv->session_limiter =
+                milter_manager_session_limiter_new(source_priv->name);
+        if (priv->session_limiter)
+            g_object_unref(priv->session_limiter);
+        priv->session_limiter = g_object_ref(source_priv->session_limiter);
+    }
+
+    if (priv->adaptive_timeout_multiplier > 0 || priv->hedge_percentile > 0) {
+        gint i;
+
+        for (i = MILTER_SERVER_CONTEXT_TIMEOUT_NONE + 1;
+             i < N_TIMEOUT_TYPES;
+             i++) {
+            if (!source_priv->latencies[i])
+                source_priv->latencies[i] =
+                    milter_manager_latency_histogram_new(
+                        ADAPTIVE_TIMEOUT_CAPACITY);
+            if (priv->latencies[i])
+                milter_manager_latency_histogram_unref(priv->latencies[i]);
+            priv->latencies[i] =
+                milter_manager_latency_histogram_ref(source_priv->latencies[i]);
+        }
+    }
+}
+
+void
+milter_manager_egg_set_priority (MilterManagerEgg *egg,
+                                 MilterManagerEggPriority priority)
+{
+    MILTER_MANAGER_EGG_GET_PRIVATE(egg)->priority = priority;
+}
+
+MilterManagerEggPriority
+milter_manager_egg_get_priority (MilterManagerEgg *egg)
+{
+    return MILTER_MANAGER_EGG_GET_PRIVATE(egg)->priority;
+}
+
 void
 milter_manager_egg_add_applicable_condition (MilterManagerEgg *egg,
                                              MilterManagerApplicableCondition *condition)
@@ -797,6 +1787,19 @@ milter_manager_egg_merge (MilterManagerEgg *egg,
         !milter_manager_egg_set_connection_spec(egg, connection_spec, error))
         return FALSE;
 
+    milter_manager_egg_clear_replica_connection_specs(egg);
+    node = milter_manager_egg_get_replica_connection_specs(other_egg);
+    for (; node; node = g_list_next(node)) {
+        if (!milter_manager_egg_add_replica_connection_spec(egg,
+                                                            node->data,
+                                                            error))
+            return FALSE;
+    }
+    milter_manager_egg_set_replica_policy(
+        egg, milter_manager_egg_get_replica_policy(other_egg));
+    milter_manager_egg_set_hedge_percentile(
+        egg, milter_manager_egg_get_hedge_percentile(other_egg));
+
 #define MERGE_TIMEOUT(name)                                     \
     milter_manager_egg_set_ ## name ## _timeout(                \
         egg,                                                    \
@@ -809,6 +1812,35 @@ milter_manager_egg_merge (MilterManagerEgg *egg,
 
 #undef MERGE_TIMEOUT
 
+    milter_manager_egg_set_circuit_breaker_threshold(
+        egg, milter_manager_egg_get_circuit_breaker_threshold(other_egg));
+    milter_manager_egg_set_circuit_breaker_open_time(
+        egg, milter_manager_egg_get_circuit_breaker_open_time(other_egg));
+    milter_manager_egg_set_circuit_breaker_slow_time(
+        egg, milter_manager_egg_get_circuit_breaker_slow_time(other_egg));
+    milter_manager_egg_set_adaptive_timeout_multiplier(
+        egg, milter_manager_egg_get_adaptive_timeout_multiplier(other_egg));
+    milter_manager_egg_set_adaptive_timeout_floor(
+        egg, milter_manager_egg_get_adaptive_timeout_floor(other_egg));
+    milter_manager_egg_set_adaptive_timeout_ceiling(
+        egg, milter_manager_egg_get_adaptive_timeout_ceiling(other_egg));
+    milter_manager_egg_set_max_concurrent_sessions(
+        egg, milter_manager_egg_get_max_concurrent_sessions(other_egg));
+    milter_manager_egg_set_max_waiting_sessions(
+        egg, milter_manager_egg_get_max_waiting_sessions(other_egg));
+    milter_manager_egg_set_max_wait_time(
+        egg, milter_manager_egg_get_max_wait_time(other_egg));
+    milter_manager_egg_set_verdict_cache_size(
+        egg, milter_manager_egg_get_verdict_cache_size(other_egg));
+    milter_manager_egg_set_verdict_cache_ttl(
+        egg, milter_manager_egg_get_verdict_cache_ttl(other_egg));
+    milter_manager_egg_set_body_cache_size(
+        egg, milter_manager_egg_get_body_cache_size(other_egg));
+    milter_manager_egg_set_body_cache_ttl(
+        egg, milter_manager_egg_get_body_cache_ttl(other_egg));
+    milter_manager_egg_set_priority(
+        egg, milter_manager_egg_get_priority(other_egg));
+
     description = milter_manager_egg_get_description(other_egg);
     if (description)
         milter_manager_egg_set_description(egg, description);
@@ -880,6 +1912,36 @@ milter_manager_egg_to_xml_string (MilterManagerEgg *egg,
                                             "evaluation-mode",
                                             priv->evaluation_mode,
                                             indent + 2);
+    if (priv->circuit_breaker_threshold > 0) {
+        gchar *value;
+
+        value = g_strdup_printf("%u", priv->circuit_breaker_threshold);
+        milter_utils_xml_append_text_element(string,
+                                             "circuit-breaker-threshold",
+                                             value,
+                                             indent + 2);
+        g_free(value);
+    }
+    if (priv->max_concurrent_sessions > 0) {
+        gchar *value;
+
+        value = g_strdup_printf("%u", priv->max_concurrent_sessions);
+        milter_utils_xml_append_text_element(string,
+                                             "max-concurrent-sessions",
+                                             value,
+                                             indent + 2);
+        g_free(value);
+    }
+    if (priv->verdict_cache_size > 0) {
+        gchar *value;
+
+        value = g_strdup_printf("%u", priv->verdict_cache_size);
+        milter_utils_xml_append_text_element(string,
+                                             "verdict-cache-size",
+                                             value,
+                                             indent + 2);
+        g_free(value);
+    }
     if (priv->connection_spec)
         milter_utils_xml_append_text_element(string,
                                              "connection-spec",
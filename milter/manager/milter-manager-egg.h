@@ -44,6 +44,12 @@ typedef enum
     MILTER_MANAGER_EGG_ERROR_INVALID
 } MilterManagerEggError;
 
+typedef enum
+{
+    MILTER_MANAGER_EGG_PRIORITY_ESSENTIAL,
+    MILTER_MANAGER_EGG_PRIORITY_OPTIONAL
+} MilterManagerEggPriority;
+
 typedef struct _MilterManagerEggClass    MilterManagerEggClass;
 
 struct _MilterManagerEgg
@@ -89,6 +95,28 @@ gboolean            milter_manager_egg_set_connection_spec
                                                  GError      **error);
 const gchar        *milter_manager_egg_get_connection_spec
                                                 (MilterManagerEgg *egg);
+gboolean            milter_manager_egg_add_replica_connection_spec
+                                                (MilterManagerEgg *egg,
+                                                 const gchar *connection_spec,
+                                                 GError      **error);
+const GList        *milter_manager_egg_get_replica_connection_specs
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_clear_replica_connection_specs
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_replica_policy
+                                                (MilterManagerEgg *egg,
+                                                 MilterManagerReplicaPolicy policy);
+MilterManagerReplicaPolicy
+                    milter_manager_egg_get_replica_policy
+                                                (MilterManagerEgg *egg);
+MilterManagerReplicaSet *
+                    milter_manager_egg_get_replica_set
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_hedge_percentile
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           percentile);
+gdouble             milter_manager_egg_get_hedge_percentile
+                                                (MilterManagerEgg *egg);
 void                milter_manager_egg_set_connection_timeout
                                                 (MilterManagerEgg *egg,
                                                  gdouble connection_timeout);
@@ -134,6 +162,100 @@ void                milter_manager_egg_set_evaluation_mode
                                                  gboolean          evaluation_mode);
 gboolean            milter_manager_egg_is_evaluation_mode
                                                 (MilterManagerEgg *egg);
+void                milter_manager_egg_set_circuit_breaker_threshold
+                                                (MilterManagerEgg *egg,
+                                                 guint             threshold);
+guint               milter_manager_egg_get_circuit_breaker_threshold
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_circuit_breaker_open_time
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           open_time);
+gdouble             milter_manager_egg_get_circuit_breaker_open_time
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_circuit_breaker_slow_time
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           slow_time);
+gdouble             milter_manager_egg_get_circuit_breaker_slow_time
+                                                (MilterManagerEgg *egg);
+MilterManagerCircuitBreaker *
+                    milter_manager_egg_get_circuit_breaker
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_adaptive_timeout_multiplier
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           multiplier);
+gdouble             milter_manager_egg_get_adaptive_timeout_multiplier
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_adaptive_timeout_floor
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           floor_time);
+gdouble             milter_manager_egg_get_adaptive_timeout_floor
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_adaptive_timeout_ceiling
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           ceiling_time);
+gdouble             milter_manager_egg_get_adaptive_timeout_ceiling
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_max_concurrent_sessions
+                                                (MilterManagerEgg *egg,
+                                                 guint             n_sessions);
+guint               milter_manager_egg_get_max_concurrent_sessions
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_max_waiting_sessions
+                                                (MilterManagerEgg *egg,
+                                                 guint             n_sessions);
+guint               milter_manager_egg_get_max_waiting_sessions
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_max_wait_time
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           wait_time);
+gdouble             milter_manager_egg_get_max_wait_time
+                                                (MilterManagerEgg *egg);
+MilterManagerSessionLimiter *
+                    milter_manager_egg_get_session_limiter
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_verdict_cache_size
+                                                (MilterManagerEgg *egg,
+                                                 guint             size);
+guint               milter_manager_egg_get_verdict_cache_size
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_verdict_cache_ttl
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           ttl);
+gdouble             milter_manager_egg_get_verdict_cache_ttl
+                                                (MilterManagerEgg *egg);
+MilterManagerVerdictCache *
+                    milter_manager_egg_get_verdict_cache
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_body_cache_size
+                                                (MilterManagerEgg *egg,
+                                                 guint             size);
+guint               milter_manager_egg_get_body_cache_size
+                                                (MilterManagerEgg *egg);
+void                milter_manager_egg_set_body_cache_ttl
+                                                (MilterManagerEgg *egg,
+                                                 gdouble           ttl);
+gdouble             milter_manager_egg_get_body_cache_ttl
+                                                (MilterManagerEgg *egg);
+MilterManagerVerdictCache *
+                    milter_manager_egg_get_body_cache
+                                                (MilterManagerEgg *egg);
+/*
+ * Makes @egg use the verdict cache and the body cache of
+ * @source when they have the same size, and the circuit
+ * breaker, the session limiter and the latency histograms
+ * of @source. They are safe to be used from multiple
+ * threads. So they are shared by all threads and survive
+ * reloads.
+ */
+void                milter_manager_egg_share_runtime_state
+                                                (MilterManagerEgg *egg,
+                                                 MilterManagerEgg *source);
+void                milter_manager_egg_set_priority
+                                                (MilterManagerEgg *egg,
+                                                 MilterManagerEggPriority priority);
+MilterManagerEggPriority
+                    milter_manager_egg_get_priority
+                                                (MilterManagerEgg *egg);
 
 void                milter_manager_egg_add_applicable_condition
                                                 (MilterManagerEgg *egg,
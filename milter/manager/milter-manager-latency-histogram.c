@@ -0,0 +1,208 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "milter-manager-latency-histogram.h"
+
+#define MINIMUM_VALUE 0.001
+#define MAXIMUM_VALUE 1000.0
+#define GROWTH_RATE 1.02
+/* log(MAXIMUM_VALUE / MINIMUM_VALUE) / log(GROWTH_RATE) + 1 */
+#define N_BUCKETS 700
+
+/* The upper bound of each bucket. It is computed by
+ * multiplication to avoid depending on libm. */
+static gdouble bucket_bounds[N_BUCKETS];
+
+struct _MilterManagerLatencyHistogram
+{
+    gint ref_count;
+    GMutex *mutex;
+    guint capacity;
+    guint n_samples;
+    guint buckets[N_BUCKETS];
+};
+
+static void
+init_bucket_bounds (void)
+{
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        guint i;
+        gdouble bound = MINIMUM_VALUE;
+
+        for (i = 0; i < N_BUCKETS; i++) {
+            bucket_bounds[i] = bound;
+            bound *= GROWTH_RATE;
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+MilterManagerLatencyHistogram *
+milter_manager_latency_histogram_new (guint capacity)
+{
+    MilterManagerLatencyHistogram *histogram;
+
+    init_bucket_bounds();
+
+    histogram = g_new0(MilterManagerLatencyHistogram, 1);
+    histogram->ref_count = 1;
+    histogram->mutex = g_mutex_new();
+    histogram->capacity = MAX(capacity, 2);
+
+    return histogram;
+}
+
+MilterManagerLatencyHistogram *
+milter_manager_latency_histogram_ref (MilterManagerLatencyHistogram *histogram)
+{
+    g_atomic_int_inc(&(histogram->ref_count));
+    return histogram;
+}
+
+void
+milter_manager_latency_histogram_unref (MilterManagerLatencyHistogram *histogram)
+{
+    if (!g_atomic_int_dec_and_test(&(histogram->ref_count)))
+        return;
+
+    g_mutex_free(histogram->mutex);
+    g_free(histogram);
+}
+
+static guint
+value_to_index (gdouble value)
+{
+    guint low = 0, high = N_BUCKETS - 1;
+
+    if (value <= bucket_bounds[0])
+        return 0;
+    if (value >= bucket_bounds[N_BUCKETS - 1])
+        return N_BUCKETS - 1;
+
+    while (low < high) {
+        guint middle = (low + high) / 2;
+        if (bucket_bounds[middle] < value)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+static void
+age (MilterManagerLatencyHistogram *histogram)
+{
+    guint i;
+
+    histogram->n_samples = 0;
+    for (i = 0; i < N_BUCKETS; i++) {
+        histogram->buckets[i] /= 2;
+        histogram->n_samples += histogram->buckets[i];
+    }
+}
+
+void
+milter_manager_latency_histogram_add (MilterManagerLatencyHistogram *histogram,
+                                      gdouble seconds)
+{
+    guint index;
+
+    index = value_to_index(seconds);
+    g_mutex_lock(histogram->mutex);
+    if (histogram->n_samples >= histogram->capacity)
+        age(histogram);
+
+    histogram->buckets[index]++;
+    histogram->n_samples++;
+    g_mutex_unlock(histogram->mutex);
+}
+
+guint
+milter_manager_latency_histogram_get_n_samples (MilterManagerLatencyHistogram *histogram)
+{
+    guint n_samples;
+
+    g_mutex_lock(histogram->mutex);
+    n_samples = histogram->n_samples;
+    g_mutex_unlock(histogram->mutex);
+
+    return n_samples;
+}
+
+static gdouble
+get_percentile (MilterManagerLatencyHistogram *histogram, gdouble percentile)
+{
+    guint i;
+    guint rank, n_seen = 0;
+
+    if (histogram->n_samples == 0)
+        return 0.0;
+
+    percentile = CLAMP(percentile, 0.0, 100.0);
+    rank = (guint)(histogram->n_samples * percentile / 100.0);
+    if (rank < histogram->n_samples * percentile / 100.0)
+        rank++;
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < N_BUCKETS; i++) {
+        n_seen += histogram->buckets[i];
+        if (n_seen >= rank)
+            return bucket_bounds[i];
+    }
+
+    return bucket_bounds[N_BUCKETS - 1];
+}
+
+gdouble
+milter_manager_latency_histogram_get_percentile (MilterManagerLatencyHistogram *histogram,
+                                                 gdouble percentile)
+{
+    gdouble value;
+
+    g_mutex_lock(histogram->mutex);
+    value = get_percentile(histogram, percentile);
+    g_mutex_unlock(histogram->mutex);
+
+    return value;
+}
+
+void
+milter_manager_latency_histogram_clear (MilterManagerLatencyHistogram *histogram)
+{
+    guint i;
+
+    g_mutex_lock(histogram->mutex);
+    histogram->n_samples = 0;
+    for (i = 0; i < N_BUCKETS; i++) {
+        histogram->buckets[i] = 0;
+    }
+    g_mutex_unlock(histogram->mutex);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
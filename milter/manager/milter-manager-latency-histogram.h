@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_LATENCY_HISTOGRAM_H__
+#define __MILTER_MANAGER_LATENCY_HISTOGRAM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A streaming latency histogram with logarithmic buckets.
+ * Each bucket covers about 2% of its value between 1ms and
+ * 1000s. Old samples are aged out by halving all counts
+ * when the number of samples reaches the capacity. It is
+ * safe to be used from multiple threads.
+ */
+typedef struct _MilterManagerLatencyHistogram MilterManagerLatencyHistogram;
+
+MilterManagerLatencyHistogram *milter_manager_latency_histogram_new
+                                            (guint capacity);
+MilterManagerLatencyHistogram *milter_manager_latency_histogram_ref
+                                            (MilterManagerLatencyHistogram *histogram);
+void     milter_manager_latency_histogram_unref
+                                            (MilterManagerLatencyHistogram *histogram);
+
+void     milter_manager_latency_histogram_add
+                                            (MilterManagerLatencyHistogram *histogram,
+                                             gdouble                        seconds);
+guint    milter_manager_latency_histogram_get_n_samples
+                                            (MilterManagerLatencyHistogram *histogram);
+gdouble  milter_manager_latency_histogram_get_percentile
+                                            (MilterManagerLatencyHistogram *histogram,
+                                             gdouble                        percentile);
+void     milter_manager_latency_histogram_clear
+                                            (MilterManagerLatencyHistogram *histogram);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_LATENCY_HISTOGRAM_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -22,9 +22,11 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <milter/core/milter-marshalers.h>
+#include <milter/core/milter-probes.h>
 #include "milter-manager-leader.h"
 #include "milter-manager-enum-types.h"
 #include "milter-manager-children.h"
+#include "milter-manager-mirror.h"
 
 #define MILTER_MANAGER_LEADER_GET_PRIVATE(obj)                   \
     (G_TYPE_INSTANCE_GET_PRIVATE((obj),                          \
@@ -37,12 +39,14 @@ struct _MilterManagerLeaderPrivate
     MilterManagerConfiguration *configuration;
     MilterClientContext *client_context;
     MilterManagerChildren *children;
+    MilterManagerMirror *mirror;
     MilterManagerLeaderState state;
     gboolean sent_end_of_message;
     GIOChannel *launcher_read_channel;
     GIOChannel *launcher_write_channel;
     gboolean processing;
     guint tag;
+    guint connection_checker_id;
 };
 
 enum
@@ -149,12 +153,91 @@ milter_manager_leader_init (MilterManagerLeader *leader)
     priv->configuration = NULL;
     priv->client_context = NULL;
     priv->children = NULL;
+    priv->mirror = NULL;
     priv->state = MILTER_MANAGER_LEADER_STATE_START;
     priv->sent_end_of_message = FALSE;
     priv->launcher_read_channel = NULL;
     priv->launcher_write_channel = NULL;
     priv->processing = FALSE;
     priv->tag = 0;
+    priv->connection_checker_id = 0;
+}
+
+static void
+dispose_connection_checker (MilterManagerLeader *leader)
+{
+    MilterManagerLeaderPrivate *priv;
+    MilterEventLoop *loop;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    if (priv->connection_checker_id == 0)
+        return;
+
+    loop = milter_agent_get_event_loop(MILTER_AGENT(priv->client_context));
+    milter_event_loop_remove(loop, priv->connection_checker_id);
+    priv->connection_checker_id = 0;
+}
+
+static gboolean
+cb_connection_check (gpointer user_data)
+{
+    MilterManagerLeader *leader = user_data;
+    MilterManagerLeaderPrivate *priv;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+
+    if (!priv->children ||
+        !milter_manager_children_is_waiting_reply(priv->children)) {
+        milter_debug("[%u] [leader][connection-check][stop] not milter turn",
+                     priv->tag);
+        priv->connection_checker_id = 0;
+        return FALSE;
+    }
+
+    if (!milter_manager_leader_check_connection(leader)) {
+        priv->connection_checker_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * A leader checks its SMTP connection only while it waits
+ * for replies from its children. It's started when a
+ * command is passed to children and stopped when children
+ * reply or the session is finished.
+ */
+static void
+start_connection_checker (MilterManagerLeader *leader)
+{
+    MilterManagerLeaderPrivate *priv;
+    MilterEventLoop *loop;
+    guint interval;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+    if (priv->connection_checker_id > 0)
+        return;
+
+    interval =
+        milter_manager_configuration_get_connection_check_interval(
+            priv->configuration);
+    if (interval == 0)
+        return;
+
+    loop = milter_agent_get_event_loop(MILTER_AGENT(priv->client_context));
+    priv->connection_checker_id =
+        milter_event_loop_add_timeout(loop, interval,
+                                      cb_connection_check, leader);
+    milter_debug("[%u] [leader][connection-check][start] <%u>",
+                 priv->tag, interval);
+}
+
+static MilterStatus
+progress (MilterManagerLeader *leader)
+{
+    start_connection_checker(leader);
+    return MILTER_STATUS_PROGRESS;
 }
 
 gboolean
@@ -218,6 +301,7 @@ milter_manager_leader_check_connection (MilterManagerLeader *leader)
         MilterStatus fallback_status;
 
         milter_statistics("[session][disconnected][%g](%u)", elapsed, priv->tag);
+        MILTER_PROBE1(session__disconnect, priv->tag);
 
         fallback_status =
             milter_manager_configuration_get_fallback_status_at_disconnect(
@@ -237,6 +321,10 @@ milter_manager_leader_check_connection (MilterManagerLeader *leader)
             milter_manager_children_abort(priv->children);
             milter_manager_children_quit(priv->children);
         }
+        if (priv->mirror) {
+            milter_manager_mirror_abort(priv->mirror);
+            milter_manager_mirror_quit(priv->mirror);
+        }
     }
 
     if (state_nick)
@@ -256,6 +344,8 @@ dispose (GObject *object)
 
     milter_debug("[%u] [leader][dispose]", priv->tag);
 
+    dispose_connection_checker(leader);
+
     if (priv->configuration) {
         g_object_unref(priv->configuration);
         priv->configuration = NULL;
@@ -271,6 +361,13 @@ dispose (GObject *object)
         g_object_unref(priv->children);
         priv->children = NULL;
     }
+
+    if (priv->mirror) {
+        /* The mirror finishes its session by itself. */
+        milter_manager_mirror_quit(priv->mirror);
+        g_object_unref(priv->mirror);
+        priv->mirror = NULL;
+    }
     milter_manager_leader_set_launcher_channel(leader, NULL, NULL);
 
 
@@ -381,6 +478,8 @@ finished (MilterFinishedEmittable *emittable)
 
     priv = MILTER_MANAGER_LEADER_GET_PRIVATE(emittable);
     priv->processing = FALSE;
+    dispose_connection_checker(MILTER_MANAGER_LEADER(emittable));
+    MILTER_PROBE2(session__finish, priv->tag, priv->state);
 }
 
 static const gchar *
@@ -985,6 +1084,38 @@ teardown_children_signals (MilterManagerLeader *leader,
 #undef DISCONNECT
 }
 
+static void
+setup_mirror (MilterManagerLeader *leader, MilterEventLoop *event_loop)
+{
+    MilterManagerLeaderPrivate *priv;
+    MilterManagerChildren *mirror_children;
+    guint buffer_size;
+
+    priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
+
+    buffer_size =
+        milter_manager_configuration_get_mirror_buffer_size(priv->configuration);
+    if (buffer_size == 0)
+        return;
+
+    mirror_children = milter_manager_children_new(priv->configuration,
+                                                  event_loop);
+    milter_manager_configuration_setup_mirror_children(priv->configuration,
+                                                       mirror_children,
+                                                       priv->client_context);
+    if (milter_manager_children_length(mirror_children) > 0) {
+        milter_manager_children_set_launcher_channel(mirror_children,
+                                                     priv->launcher_read_channel,
+                                                     priv->launcher_write_channel);
+        priv->mirror = milter_manager_mirror_new(mirror_children,
+                                                 event_loop,
+                                                 buffer_size);
+        milter_manager_mirror_set_tag(priv->mirror, priv->tag);
+        milter_debug("[%u] [leader][setup][mirror]", priv->tag);
+    }
+    g_object_unref(mirror_children);
+}
+
 MilterStatus
 milter_manager_leader_negotiate (MilterManagerLeader *leader,
                                  MilterOption *option,
@@ -996,6 +1127,7 @@ milter_manager_leader_negotiate (MilterManagerLeader *leader,
 
     priv = MILTER_MANAGER_LEADER_GET_PRIVATE(leader);
     priv->state = MILTER_MANAGER_LEADER_STATE_NEGOTIATE;
+    MILTER_PROBE1(session__start, priv->tag);
 
     event_loop = milter_agent_get_event_loop(MILTER_AGENT(priv->client_context));
     priv->children = milter_manager_children_new(priv->configuration,
@@ -1015,9 +1147,13 @@ milter_manager_leader_negotiate (MilterManagerLeader *leader,
                                                  priv->launcher_write_channel);
     milter_debug("[%u] [leader][setup][children]", priv->tag);
 
+    setup_mirror(leader, event_loop);
+    if (priv->mirror)
+        milter_manager_mirror_negotiate(priv->mirror, option, macros_requests);
+
     if (milter_manager_children_negotiate(priv->children, option,
                                           macros_requests)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1040,9 +1176,12 @@ milter_manager_leader_connect (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_connect(priv->mirror, host_name,
+                                      address, address_length);
     if (milter_manager_children_connect(priv->children, host_name,
                                         address, address_length)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1062,8 +1201,10 @@ milter_manager_leader_helo (MilterManagerLeader *leader, const gchar *fqdn)
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_helo(priv->mirror, fqdn);
     if (milter_manager_children_helo(priv->children, fqdn)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1084,8 +1225,10 @@ milter_manager_leader_envelope_from (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_envelope_from(priv->mirror, from);
     if (milter_manager_children_envelope_from(priv->children, from)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1106,8 +1249,10 @@ milter_manager_leader_envelope_recipient (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_envelope_recipient(priv->mirror, recipient);
     if (milter_manager_children_envelope_recipient(priv->children, recipient)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1127,8 +1272,10 @@ milter_manager_leader_data (MilterManagerLeader *leader)
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_data(priv->mirror);
     if (milter_manager_children_data(priv->children)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1149,8 +1296,10 @@ milter_manager_leader_unknown (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_unknown(priv->mirror, command);
     if (milter_manager_children_unknown(priv->children, command)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1171,8 +1320,10 @@ milter_manager_leader_header (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_header(priv->mirror, name, value);
     if (milter_manager_children_header(priv->children, name, value)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1192,8 +1343,10 @@ milter_manager_leader_end_of_header (MilterManagerLeader *leader)
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_end_of_header(priv->mirror);
     if (milter_manager_children_end_of_header(priv->children)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1214,8 +1367,10 @@ milter_manager_leader_body (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_body(priv->mirror, chunk, size);
     if (milter_manager_children_body(priv->children, chunk, size)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1265,8 +1420,10 @@ milter_manager_leader_end_of_message (MilterManagerLeader *leader,
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_end_of_message(priv->mirror, chunk, size);
     if (milter_manager_children_end_of_message(priv->children, chunk, size)) {
-        return MILTER_STATUS_PROGRESS;
+        return progress(leader);
     } else {
         return fallback_status;
     }
@@ -1286,6 +1443,19 @@ milter_manager_leader_quit (MilterManagerLeader *leader)
     if (!priv->children)
         return fallback_status;
 
+    dispose_connection_checker(leader);
+    if (priv->mirror)
+        milter_manager_mirror_quit(priv->mirror);
+    if (milter_manager_children_is_waiting_reply(priv->children)) {
+        gdouble elapsed;
+
+        /* The MTA has gone while children are processing. */
+        elapsed = milter_agent_get_elapsed(MILTER_AGENT(priv->client_context));
+        milter_statistics("[session][disconnected][%g](%u)",
+                          elapsed, priv->tag);
+        MILTER_PROBE1(session__disconnect, priv->tag);
+        milter_manager_children_abort(priv->children);
+    }
     milter_manager_children_quit(priv->children);
     return MILTER_STATUS_DEFAULT;
 }
@@ -1304,6 +1474,8 @@ milter_manager_leader_abort (MilterManagerLeader *leader)
     if (!priv->children)
         return fallback_status;
 
+    if (priv->mirror)
+        milter_manager_mirror_abort(priv->mirror);
     milter_manager_children_abort(priv->children);
     return MILTER_STATUS_DEFAULT;
 }
@@ -1320,6 +1492,8 @@ milter_manager_leader_define_macro (MilterManagerLeader *leader,
     if (!priv->children)
         return;
 
+    if (priv->mirror)
+        milter_manager_mirror_define_macro(priv->mirror, command, macros);
     milter_manager_children_define_macro(priv->children,
                                          command, macros);
 }
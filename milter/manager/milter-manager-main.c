@@ -204,7 +204,7 @@ cb_idle_reload_configuration (gpointer user_data)
     if (the_manager) {
         GError *error = NULL;
 
-        if (!milter_manager_reload(the_manager, &error)) {
+        if (!milter_manager_rebuild_configuration(the_manager, &error)) {
             milter_error("[manager][reload][signal][error] %s",
                          error->message);
             g_error_free(error);
@@ -0,0 +1,851 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include "milter-manager-mirror.h"
+
+#define MILTER_MANAGER_MIRROR_GET_PRIVATE(obj)                  \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                         \
+                                 MILTER_TYPE_MANAGER_MIRROR,    \
+                                 MilterManagerMirrorPrivate))
+
+typedef struct _MirrorCommand MirrorCommand;
+struct _MirrorCommand
+{
+    MilterCommand command;
+    MilterCommand macro_context;
+    gchar *string;
+    gchar *value;
+    gsize size;
+    struct sockaddr *address;
+    socklen_t address_length;
+    GHashTable *macros;
+    MilterOption *option;
+    MilterMacrosRequests *macros_requests;
+    gsize buffer_size;
+};
+
+typedef struct _MilterManagerMirrorPrivate MilterManagerMirrorPrivate;
+struct _MilterManagerMirrorPrivate
+{
+    MilterManagerChildren *children;
+    MilterEventLoop *event_loop;
+    GQueue *commands;
+    gsize buffer_size;
+    gsize max_buffer_size;
+    guint flush_id;
+    guint tag;
+    gboolean waiting;
+    gboolean quit_queued;
+    gboolean stopped;
+    gboolean skipping_message;
+    gboolean dropped;
+    gboolean finished;
+    gboolean children_finished;
+    gboolean alive;
+};
+
+G_DEFINE_TYPE(MilterManagerMirror, milter_manager_mirror, G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_mirror_class_init (MilterManagerMirrorClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class, sizeof(MilterManagerMirrorPrivate));
+}
+
+static void
+milter_manager_mirror_init (MilterManagerMirror *mirror)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    priv->children = NULL;
+    priv->event_loop = NULL;
+    priv->commands = g_queue_new();
+    priv->buffer_size = 0;
+    priv->max_buffer_size = 0;
+    priv->flush_id = 0;
+    priv->tag = 0;
+    priv->waiting = FALSE;
+    priv->quit_queued = FALSE;
+    priv->stopped = FALSE;
+    priv->skipping_message = FALSE;
+    priv->dropped = FALSE;
+    priv->finished = FALSE;
+    priv->children_finished = FALSE;
+    priv->alive = FALSE;
+}
+
+static void
+mirror_command_free (MirrorCommand *command)
+{
+    if (command->string)
+        g_free(command->string);
+    if (command->value)
+        g_free(command->value);
+    if (command->address)
+        g_free(command->address);
+    if (command->macros)
+        g_hash_table_unref(command->macros);
+    if (command->option)
+        g_object_unref(command->option);
+    if (command->macros_requests)
+        g_object_unref(command->macros_requests);
+    g_free(command);
+}
+
+static void
+clear_commands (MilterManagerMirrorPrivate *priv)
+{
+    MirrorCommand *command;
+
+    while ((command = g_queue_pop_head(priv->commands)))
+        mirror_command_free(command);
+    priv->buffer_size = 0;
+}
+
+static void teardown_children_signals (MilterManagerMirror *mirror,
+                                       MilterManagerChildren *children);
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerMirror *mirror;
+    MilterManagerMirrorPrivate *priv;
+
+    mirror = MILTER_MANAGER_MIRROR(object);
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+
+    if (priv->flush_id > 0) {
+        milter_event_loop_remove(priv->event_loop, priv->flush_id);
+        priv->flush_id = 0;
+    }
+
+    if (priv->commands) {
+        clear_commands(priv);
+        g_queue_free(priv->commands);
+        priv->commands = NULL;
+    }
+
+    if (priv->children) {
+        teardown_children_signals(mirror, priv->children);
+        g_object_unref(priv->children);
+        priv->children = NULL;
+    }
+
+    if (priv->event_loop) {
+        g_object_unref(priv->event_loop);
+        priv->event_loop = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_mirror_parent_class)->dispose(object);
+}
+
+static void
+release (MilterManagerMirror *mirror)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    if (!priv->alive)
+        return;
+
+    priv->alive = FALSE;
+    g_object_unref(mirror);
+}
+
+/*
+ * After a message verdict, the rest of the message isn't
+ * sent. Children are reset by ABORT or the next MAIL FROM
+ * like the MTA does after a rejected message.
+ */
+static gboolean
+skip_message_command (MilterManagerMirrorPrivate *priv,
+                      MirrorCommand *command)
+{
+    if (!priv->skipping_message)
+        return FALSE;
+
+    switch (command->command) {
+    case MILTER_COMMAND_DEFINE_MACRO:
+    case MILTER_COMMAND_QUIT:
+        return FALSE;
+    case MILTER_COMMAND_ENVELOPE_FROM:
+    case MILTER_COMMAND_ABORT:
+        priv->skipping_message = FALSE;
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+static void
+flush (MilterManagerMirror *mirror)
+{
+    MilterManagerMirrorPrivate *priv;
+    MirrorCommand *command;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+
+    while (!priv->finished && !priv->stopped && !priv->waiting &&
+           (command = g_queue_pop_head(priv->commands))) {
+        gboolean success = TRUE;
+
+        priv->buffer_size -= command->buffer_size;
+        if (skip_message_command(priv, command)) {
+            mirror_command_free(command);
+            continue;
+        }
+        /* Replies may be emitted before the command returns. */
+        priv->waiting = TRUE;
+        switch (command->command) {
+        case MILTER_COMMAND_NEGOTIATE:
+            success = milter_manager_children_negotiate(priv->children,
+                                                        command->option,
+                                                        command->macros_requests);
+            break;
+        case MILTER_COMMAND_DEFINE_MACRO:
+            milter_manager_children_define_macro(priv->children,
+                                                 command->macro_context,
+                                                 command->macros);
+            success = FALSE;
+            break;
+        case MILTER_COMMAND_CONNECT:
+            success = milter_manager_children_connect(priv->children,
+                                                      command->string,
+                                                      command->address,
+                                                      command->address_length);
+            break;
+        case MILTER_COMMAND_HELO:
+            success = milter_manager_children_helo(priv->children,
+                                                   command->string);
+            break;
+        case MILTER_COMMAND_ENVELOPE_FROM:
+            success = milter_manager_children_envelope_from(priv->children,
+                                                            command->string);
+            break;
+        case MILTER_COMMAND_ENVELOPE_RECIPIENT:
+            success =
+                milter_manager_children_envelope_recipient(priv->children,
+                                                           command->string);
+            break;
+        case MILTER_COMMAND_DATA:
+            success = milter_manager_children_data(priv->children);
+            break;
+        case MILTER_COMMAND_UNKNOWN:
+            success = milter_manager_children_unknown(priv->children,
+                                                      command->string);
+            break;
+        case MILTER_COMMAND_HEADER:
+            success = milter_manager_children_header(priv->children,
+                                                     command->string,
+                                                     command->value);
+            break;
+        case MILTER_COMMAND_END_OF_HEADER:
+            success = milter_manager_children_end_of_header(priv->children);
+            break;
+        case MILTER_COMMAND_BODY:
+            success = milter_manager_children_body(priv->children,
+                                                   command->string,
+                                                   command->size);
+            break;
+        case MILTER_COMMAND_END_OF_MESSAGE:
+            success = milter_manager_children_end_of_message(priv->children,
+                                                             command->string,
+                                                             command->size);
+            break;
+        case MILTER_COMMAND_ABORT:
+            milter_manager_children_abort(priv->children);
+            success = FALSE;
+            break;
+        case MILTER_COMMAND_QUIT:
+            priv->stopped = TRUE;
+            success = FALSE;
+            break;
+        default:
+            success = FALSE;
+            break;
+        }
+        if (!success)
+            priv->waiting = FALSE;
+        mirror_command_free(command);
+    }
+
+    if (priv->stopped && !priv->finished) {
+        milter_debug("[%u] [mirror][quit]%s",
+                     priv->tag, priv->dropped ? "[dropped]" : "");
+        priv->finished = TRUE;
+        clear_commands(priv);
+        /* Children may be released in their "finished" handler. */
+        g_object_ref(mirror);
+        milter_manager_children_quit(priv->children);
+        if (priv->children_finished)
+            release(mirror);
+        g_object_unref(mirror);
+    }
+}
+
+static gboolean
+cb_idle_flush (gpointer user_data)
+{
+    MilterManagerMirror *mirror = user_data;
+
+    MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->flush_id = 0;
+    flush(mirror);
+    return FALSE;
+}
+
+/*
+ * Replies are emitted while children are processing them.
+ * The next command is sent after children finish it.
+ */
+static void
+prepare_flush (MilterManagerMirror *mirror)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    if (priv->flush_id > 0)
+        return;
+
+    priv->flush_id = milter_event_loop_add_idle_full(priv->event_loop,
+                                                     G_PRIORITY_DEFAULT,
+                                                     cb_idle_flush,
+                                                     mirror,
+                                                     NULL);
+}
+
+/*
+ * A verdict is scoped like the children chain scopes it:
+ * a rejected recipient only drops the recipient, a message
+ * verdict only drops the rest of the message and a
+ * connection verdict or an error stops the mirror.
+ */
+static void
+record_verdict (MilterManagerMirror *mirror, MilterStatus status)
+{
+    MilterManagerMirrorPrivate *priv;
+    MilterServerContextState state;
+    gchar *state_name, *status_name;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    if (priv->finished)
+        return;
+
+    state = milter_manager_children_get_processing_state(priv->children);
+    switch (status) {
+    case MILTER_STATUS_ABORT:
+    case MILTER_STATUS_ERROR:
+        priv->stopped = TRUE;
+        break;
+    default:
+        switch (state) {
+        case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
+        case MILTER_SERVER_CONTEXT_STATE_DATA:
+        case MILTER_SERVER_CONTEXT_STATE_HEADER:
+        case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
+        case MILTER_SERVER_CONTEXT_STATE_BODY:
+        case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
+            priv->skipping_message = TRUE;
+            break;
+        case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
+            if (status != MILTER_STATUS_REJECT &&
+                status != MILTER_STATUS_TEMPORARY_FAILURE)
+                priv->skipping_message = TRUE;
+            break;
+        default:
+            priv->stopped = TRUE;
+            break;
+        }
+        break;
+    }
+    priv->waiting = FALSE;
+    prepare_flush(mirror);
+
+    if (!milter_need_log(MILTER_LOG_LEVEL_STATISTICS))
+        return;
+
+    state_name = milter_utils_get_enum_nick_name(
+        MILTER_TYPE_SERVER_CONTEXT_STATE, state);
+    status_name = milter_utils_get_enum_nick_name(MILTER_TYPE_STATUS, status);
+    milter_statistics("[mirror][verdict][%s][%s](%u)",
+                      state_name, status_name, priv->tag);
+    g_free(state_name);
+    g_free(status_name);
+}
+
+static void
+cb_negotiate_reply (MilterReplySignals *_reply,
+                    MilterOption *option,
+                    MilterMacrosRequests *macros_requests,
+                    gpointer user_data)
+{
+    MilterManagerMirror *mirror = user_data;
+
+    MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->waiting = FALSE;
+    prepare_flush(mirror);
+}
+
+static void
+cb_continue (MilterReplySignals *_reply, gpointer user_data)
+{
+    MilterManagerMirror *mirror = user_data;
+
+    MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->waiting = FALSE;
+    prepare_flush(mirror);
+}
+
+static void
+cb_skip (MilterReplySignals *_reply, gpointer user_data)
+{
+    cb_continue(_reply, user_data);
+}
+
+static void
+cb_reply_code (MilterReplySignals *_reply,
+               guint code,
+               const gchar *extended_code,
+               const gchar *message,
+               gpointer user_data)
+{
+    MilterStatus status;
+
+    if (400 <= code && code < 500)
+        status = MILTER_STATUS_TEMPORARY_FAILURE;
+    else
+        status = MILTER_STATUS_REJECT;
+    record_verdict(user_data, status);
+}
+
+static void
+cb_temporary_failure (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_TEMPORARY_FAILURE);
+}
+
+static void
+cb_reject (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_REJECT);
+}
+
+static void
+cb_accept (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_ACCEPT);
+}
+
+static void
+cb_discard (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_DISCARD);
+}
+
+static void
+cb_abort (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_ABORT);
+}
+
+static void
+cb_connection_failure (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_ERROR);
+}
+
+static void
+cb_shutdown (MilterReplySignals *_reply, gpointer user_data)
+{
+    record_verdict(user_data, MILTER_STATUS_ERROR);
+}
+
+static void
+cb_finished (MilterFinishedEmittable *emittable, gpointer user_data)
+{
+    MilterManagerMirror *mirror = user_data;
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    priv->children_finished = TRUE;
+    if (priv->finished) {
+        release(mirror);
+    } else {
+        priv->waiting = FALSE;
+        priv->stopped = TRUE;
+        prepare_flush(mirror);
+    }
+}
+
+static void
+setup_children_signals (MilterManagerMirror *mirror,
+                        MilterManagerChildren *children)
+{
+#define CONNECT(name)                                           \
+    g_signal_connect(children, #name,                           \
+                     G_CALLBACK(cb_ ## name), mirror)
+
+    CONNECT(negotiate_reply);
+    CONNECT(continue);
+    CONNECT(skip);
+    CONNECT(reply_code);
+    CONNECT(temporary_failure);
+    CONNECT(reject);
+    CONNECT(accept);
+    CONNECT(discard);
+    CONNECT(abort);
+    CONNECT(connection_failure);
+    CONNECT(shutdown);
+    CONNECT(finished);
+#undef CONNECT
+}
+
+static void
+teardown_children_signals (MilterManagerMirror *mirror,
+                           MilterManagerChildren *children)
+{
+#define DISCONNECT(name)                                                \
+    g_signal_handlers_disconnect_by_func(children,                      \
+                                         G_CALLBACK(cb_ ## name),       \
+                                         mirror)
+
+    DISCONNECT(negotiate_reply);
+    DISCONNECT(continue);
+    DISCONNECT(skip);
+    DISCONNECT(reply_code);
+    DISCONNECT(temporary_failure);
+    DISCONNECT(reject);
+    DISCONNECT(accept);
+    DISCONNECT(discard);
+    DISCONNECT(abort);
+    DISCONNECT(connection_failure);
+    DISCONNECT(shutdown);
+    DISCONNECT(finished);
+#undef DISCONNECT
+}
+
+MilterManagerMirror *
+milter_manager_mirror_new (MilterManagerChildren *children,
+                           MilterEventLoop *event_loop,
+                           gsize max_buffer_size)
+{
+    MilterManagerMirror *mirror;
+    MilterManagerMirrorPrivate *priv;
+
+    mirror = g_object_new(MILTER_TYPE_MANAGER_MIRROR, NULL);
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    priv->children = g_object_ref(children);
+    priv->event_loop = g_object_ref(event_loop);
+    priv->max_buffer_size = max_buffer_size;
+    setup_children_signals(mirror, children);
+
+    /* Released when children finish after the mirror quits. */
+    priv->alive = TRUE;
+    g_object_ref(mirror);
+
+    return mirror;
+}
+
+MilterManagerChildren *
+milter_manager_mirror_get_children (MilterManagerMirror *mirror)
+{
+    return MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->children;
+}
+
+gsize
+milter_manager_mirror_get_buffer_size (MilterManagerMirror *mirror)
+{
+    return MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->buffer_size;
+}
+
+guint
+milter_manager_mirror_get_n_pending_commands (MilterManagerMirror *mirror)
+{
+    return g_queue_get_length(MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->commands);
+}
+
+gboolean
+milter_manager_mirror_is_dropped (MilterManagerMirror *mirror)
+{
+    return MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror)->dropped;
+}
+
+void
+milter_manager_mirror_set_tag (MilterManagerMirror *mirror, guint tag)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    priv->tag = tag;
+    milter_manager_children_set_tag(priv->children, tag);
+}
+
+static MirrorCommand *
+mirror_command_new (MilterCommand command)
+{
+    MirrorCommand *mirror_command;
+
+    mirror_command = g_new0(MirrorCommand, 1);
+    mirror_command->command = command;
+    mirror_command->buffer_size = sizeof(MirrorCommand);
+
+    return mirror_command;
+}
+
+static void
+mirror_command_set_string (MirrorCommand *command, const gchar *string)
+{
+    if (!string)
+        return;
+    command->string = g_strdup(string);
+    command->buffer_size += strlen(string) + 1;
+}
+
+static void
+mirror_command_set_chunk (MirrorCommand *command,
+                          const gchar *chunk, gsize size)
+{
+    if (!chunk)
+        return;
+    command->string = g_memdup(chunk, size);
+    command->size = size;
+    command->buffer_size += size;
+}
+
+static void
+drop (MilterManagerMirror *mirror)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    milter_statistics("[mirror][drop][%" G_GSIZE_FORMAT "/%" G_GSIZE_FORMAT "]"
+                      "(%u)",
+                      priv->buffer_size, priv->max_buffer_size, priv->tag);
+    priv->dropped = TRUE;
+    priv->stopped = TRUE;
+    clear_commands(priv);
+}
+
+static void
+push_command (MilterManagerMirror *mirror, MirrorCommand *command)
+{
+    MilterManagerMirrorPrivate *priv;
+
+    priv = MILTER_MANAGER_MIRROR_GET_PRIVATE(mirror);
+    if (priv->stopped || priv->quit_queued) {
+        mirror_command_free(command);
+        return;
+    }
+
+    if (command->command == MILTER_COMMAND_QUIT)
+        priv->quit_queued = TRUE;
+
+    if (priv->max_buffer_size > 0 &&
+        priv->buffer_size + command->buffer_size > priv->max_buffer_size &&
+        command->command != MILTER_COMMAND_QUIT) {
+        mirror_command_free(command);
+        drop(mirror);
+    } else {
+        priv->buffer_size += command->buffer_size;
+        g_queue_push_tail(priv->commands, command);
+    }
+
+    flush(mirror);
+}
+
+void
+milter_manager_mirror_negotiate (MilterManagerMirror *mirror,
+                                 MilterOption *option,
+                                 MilterMacrosRequests *macros_requests)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_NEGOTIATE);
+    if (option)
+        command->option = milter_option_copy(option);
+    if (macros_requests)
+        command->macros_requests = g_object_ref(macros_requests);
+    push_command(mirror, command);
+}
+
+static void
+copy_macro (gpointer key, gpointer value, gpointer user_data)
+{
+    MirrorCommand *command = user_data;
+
+    g_hash_table_insert(command->macros, g_strdup(key), g_strdup(value));
+    command->buffer_size += strlen(key) + strlen(value) + 2;
+}
+
+void
+milter_manager_mirror_define_macro (MilterManagerMirror *mirror,
+                                    MilterCommand macro_context,
+                                    GHashTable *macros)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_DEFINE_MACRO);
+    command->macro_context = macro_context;
+    command->macros = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, g_free);
+    if (macros)
+        g_hash_table_foreach(macros, copy_macro, command);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_connect (MilterManagerMirror *mirror,
+                               const gchar *host_name,
+                               struct sockaddr *address,
+                               socklen_t address_length)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_CONNECT);
+    mirror_command_set_string(command, host_name);
+    if (address) {
+        command->address = g_memdup(address, address_length);
+        command->address_length = address_length;
+        command->buffer_size += address_length;
+    }
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_helo (MilterManagerMirror *mirror, const gchar *fqdn)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_HELO);
+    mirror_command_set_string(command, fqdn);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_envelope_from (MilterManagerMirror *mirror,
+                                     const gchar *from)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_ENVELOPE_FROM);
+    mirror_command_set_string(command, from);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_envelope_recipient (MilterManagerMirror *mirror,
+                                          const gchar *recipient)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_ENVELOPE_RECIPIENT);
+    mirror_command_set_string(command, recipient);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_data (MilterManagerMirror *mirror)
+{
+    push_command(mirror, mirror_command_new(MILTER_COMMAND_DATA));
+}
+
+void
+milter_manager_mirror_unknown (MilterManagerMirror *mirror,
+                               const gchar *unknown_command)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_UNKNOWN);
+    mirror_command_set_string(command, unknown_command);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_header (MilterManagerMirror *mirror,
+                              const gchar *name,
+                              const gchar *value)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_HEADER);
+    mirror_command_set_string(command, name);
+    if (value) {
+        command->value = g_strdup(value);
+        command->buffer_size += strlen(value) + 1;
+    }
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_end_of_header (MilterManagerMirror *mirror)
+{
+    push_command(mirror, mirror_command_new(MILTER_COMMAND_END_OF_HEADER));
+}
+
+void
+milter_manager_mirror_body (MilterManagerMirror *mirror,
+                            const gchar *chunk,
+                            gsize size)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_BODY);
+    mirror_command_set_chunk(command, chunk, size);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_end_of_message (MilterManagerMirror *mirror,
+                                      const gchar *chunk,
+                                      gsize size)
+{
+    MirrorCommand *command;
+
+    command = mirror_command_new(MILTER_COMMAND_END_OF_MESSAGE);
+    mirror_command_set_chunk(command, chunk, size);
+    push_command(mirror, command);
+}
+
+void
+milter_manager_mirror_quit (MilterManagerMirror *mirror)
+{
+    push_command(mirror, mirror_command_new(MILTER_COMMAND_QUIT));
+}
+
+void
+milter_manager_mirror_abort (MilterManagerMirror *mirror)
+{
+    push_command(mirror, mirror_command_new(MILTER_COMMAND_ABORT));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
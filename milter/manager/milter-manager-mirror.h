@@ -0,0 +1,123 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_MIRROR_H__
+#define __MILTER_MANAGER_MIRROR_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib-object.h>
+
+#include <milter/core.h>
+#include <milter/manager/milter-manager-objects.h>
+#include <milter/manager/milter-manager-children.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_TYPE_MANAGER_MIRROR            (milter_manager_mirror_get_type())
+#define MILTER_MANAGER_MIRROR(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_MIRROR, MilterManagerMirror))
+#define MILTER_MANAGER_MIRROR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_MIRROR, MilterManagerMirrorClass))
+#define MILTER_MANAGER_IS_MIRROR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_MIRROR))
+#define MILTER_MANAGER_IS_MIRROR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_MIRROR))
+#define MILTER_MANAGER_MIRROR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_MIRROR, MilterManagerMirrorClass))
+
+typedef struct _MilterManagerMirror         MilterManagerMirror;
+typedef struct _MilterManagerMirrorClass    MilterManagerMirrorClass;
+
+struct _MilterManagerMirror
+{
+    GObject object;
+};
+
+struct _MilterManagerMirrorClass
+{
+    GObjectClass parent_class;
+};
+
+GType                milter_manager_mirror_get_type    (void) G_GNUC_CONST;
+
+/*
+ * Creates a mirror that feeds a copy of the session to
+ * @children. Commands are queued while @children are
+ * processing the previous command and nobody waits for
+ * replies from @children. The mirror is dropped when the
+ * queued commands use more than @max_buffer_size bytes.
+ *
+ * The mirror keeps itself alive until @children quit. So
+ * it can be unreferenced before the session of @children
+ * is finished.
+ */
+MilterManagerMirror *milter_manager_mirror_new         (MilterManagerChildren *children,
+                                                        MilterEventLoop       *event_loop,
+                                                        gsize                  max_buffer_size);
+
+MilterManagerChildren *
+                     milter_manager_mirror_get_children(MilterManagerMirror *mirror);
+gsize                milter_manager_mirror_get_buffer_size
+                                                       (MilterManagerMirror *mirror);
+guint                milter_manager_mirror_get_n_pending_commands
+                                                       (MilterManagerMirror *mirror);
+gboolean             milter_manager_mirror_is_dropped  (MilterManagerMirror *mirror);
+
+void                 milter_manager_mirror_negotiate   (MilterManagerMirror   *mirror,
+                                                        MilterOption          *option,
+                                                        MilterMacrosRequests  *macros_requests);
+void                 milter_manager_mirror_define_macro(MilterManagerMirror   *mirror,
+                                                        MilterCommand          command,
+                                                        GHashTable            *macros);
+void                 milter_manager_mirror_connect     (MilterManagerMirror   *mirror,
+                                                        const gchar           *host_name,
+                                                        struct sockaddr       *address,
+                                                        socklen_t              address_length);
+void                 milter_manager_mirror_helo        (MilterManagerMirror   *mirror,
+                                                        const gchar           *fqdn);
+void                 milter_manager_mirror_envelope_from
+                                                       (MilterManagerMirror   *mirror,
+                                                        const gchar           *from);
+void                 milter_manager_mirror_envelope_recipient
+                                                       (MilterManagerMirror   *mirror,
+                                                        const gchar           *recipient);
+void                 milter_manager_mirror_data        (MilterManagerMirror   *mirror);
+void                 milter_manager_mirror_unknown     (MilterManagerMirror   *mirror,
+                                                        const gchar           *command);
+void                 milter_manager_mirror_header      (MilterManagerMirror   *mirror,
+                                                        const gchar           *name,
+                                                        const gchar           *value);
+void                 milter_manager_mirror_end_of_header
+                                                       (MilterManagerMirror   *mirror);
+void                 milter_manager_mirror_body        (MilterManagerMirror   *mirror,
+                                                        const gchar           *chunk,
+                                                        gsize                  size);
+void                 milter_manager_mirror_end_of_message
+                                                       (MilterManagerMirror   *mirror,
+                                                        const gchar           *chunk,
+                                                        gsize                  size);
+void                 milter_manager_mirror_quit        (MilterManagerMirror   *mirror);
+void                 milter_manager_mirror_abort       (MilterManagerMirror   *mirror);
+
+void                 milter_manager_mirror_set_tag     (MilterManagerMirror   *mirror,
+                                                        guint                  tag);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_MIRROR_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
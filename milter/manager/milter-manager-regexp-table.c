@@ -0,0 +1,609 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include <milter/core.h>
+#include "milter-manager-regexp-table.h"
+
+#define MAX_COMBINED_ENTRIES 128
+
+#define MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(obj)                    \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_REGEXP_TABLE,      \
+                                 MilterManagerRegexpTablePrivate))
+
+typedef struct _Condition Condition;
+struct _Condition
+{
+    gchar *pattern;
+    GRegex *regex;
+    gboolean negative;
+};
+
+typedef struct _Entry Entry;
+struct _Entry
+{
+    gchar *pattern;
+    GRegex *regex;
+    gboolean negative;
+    gchar *action;
+    GList *conditions;
+    gboolean combinable;
+};
+
+typedef struct _Chunk Chunk;
+struct _Chunk
+{
+    GRegex *regex;
+    guint first;
+    guint n_entries;
+};
+
+typedef struct _MilterManagerRegexpTablePrivate MilterManagerRegexpTablePrivate;
+struct _MilterManagerRegexpTablePrivate
+{
+    GPtrArray *conditions;
+    GList *condition_stack;
+    GPtrArray *entries;
+    GArray *chunks;
+    gboolean compiled;
+};
+
+G_DEFINE_TYPE(MilterManagerRegexpTable,
+              milter_manager_regexp_table,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_regexp_table_class_init (MilterManagerRegexpTableClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerRegexpTablePrivate));
+}
+
+static void
+milter_manager_regexp_table_init (MilterManagerRegexpTable *table)
+{
+    MilterManagerRegexpTablePrivate *priv;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+    priv->conditions = g_ptr_array_new();
+    priv->condition_stack = NULL;
+    priv->entries = g_ptr_array_new();
+    priv->chunks = g_array_new(FALSE, FALSE, sizeof(Chunk));
+    priv->compiled = TRUE;
+}
+
+static void
+condition_free (Condition *condition)
+{
+    g_free(condition->pattern);
+    g_regex_unref(condition->regex);
+    g_free(condition);
+}
+
+static void
+entry_free (Entry *entry)
+{
+    g_free(entry->pattern);
+    g_regex_unref(entry->regex);
+    g_free(entry->action);
+    g_list_free(entry->conditions);
+    g_free(entry);
+}
+
+static void
+clear_chunks (MilterManagerRegexpTablePrivate *priv)
+{
+    guint i;
+
+    for (i = 0; i < priv->chunks->len; i++) {
+        Chunk *chunk;
+
+        chunk = &g_array_index(priv->chunks, Chunk, i);
+        if (chunk->regex)
+            g_regex_unref(chunk->regex);
+    }
+    g_array_set_size(priv->chunks, 0);
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerRegexpTablePrivate *priv;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(object);
+
+    if (priv->chunks) {
+        clear_chunks(priv);
+        g_array_free(priv->chunks, TRUE);
+        priv->chunks = NULL;
+    }
+
+    if (priv->entries) {
+        g_ptr_array_foreach(priv->entries, (GFunc)entry_free, NULL);
+        g_ptr_array_free(priv->entries, TRUE);
+        priv->entries = NULL;
+    }
+
+    if (priv->condition_stack) {
+        g_list_free(priv->condition_stack);
+        priv->condition_stack = NULL;
+    }
+
+    if (priv->conditions) {
+        g_ptr_array_foreach(priv->conditions, (GFunc)condition_free, NULL);
+        g_ptr_array_free(priv->conditions, TRUE);
+        priv->conditions = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_regexp_table_parent_class)->dispose(object);
+}
+
+GQuark
+milter_manager_regexp_table_error_quark (void)
+{
+    return g_quark_from_static_string("milter-manager-regexp-table-error-quark");
+}
+
+MilterManagerRegexpTable *
+milter_manager_regexp_table_new (void)
+{
+    return g_object_new(MILTER_TYPE_MANAGER_REGEXP_TABLE, NULL);
+}
+
+static GRegex *
+compile_pattern (const gchar *pattern, GError **error)
+{
+    GRegex *regex;
+    GError *regex_error = NULL;
+
+    regex = g_regex_new(pattern, G_REGEX_OPTIMIZE, 0, &regex_error);
+    if (!regex) {
+        g_set_error(error,
+                    MILTER_MANAGER_REGEXP_TABLE_ERROR,
+                    MILTER_MANAGER_REGEXP_TABLE_ERROR_INVALID_REGEX,
+                    "invalid regular expression: <%s>: %s",
+                    pattern, regex_error->message);
+        g_error_free(regex_error);
+    }
+
+    return regex;
+}
+
+/*
+ * A pattern can't be embedded into a combined regular
+ * expression when it refers a group by number, it may
+ * have a "#" comment that eats the following text or it
+ * may have an unterminated "\Q".
+ */
+static gboolean
+is_combinable_pattern (const gchar *pattern)
+{
+    const gchar *p;
+
+    for (p = pattern; *p; p++) {
+        switch (*p) {
+        case '#':
+            return FALSE;
+        case '\\':
+            p++;
+            if (g_ascii_isdigit(*p) || *p == 'g' || *p == 'Q')
+                return FALSE;
+            if (*p == '\0')
+                return FALSE;
+            break;
+        case '(':
+            if (p[1] == '?' &&
+                (g_ascii_isdigit(p[2]) || p[2] == 'R' ||
+                 p[2] == '+' || p[2] == '-' || p[2] == '&'))
+                return FALSE;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+gboolean
+milter_manager_regexp_table_push_condition (MilterManagerRegexpTable *table,
+                                            const gchar              *pattern,
+                                            gboolean                  negative,
+                                            GError                  **error)
+{
+    MilterManagerRegexpTablePrivate *priv;
+    Condition *condition;
+    GRegex *regex;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+
+    regex = compile_pattern(pattern, error);
+    if (!regex)
+        return FALSE;
+
+    condition = g_new0(Condition, 1);
+    condition->pattern = g_strdup(pattern);
+    condition->regex = regex;
+    condition->negative = negative;
+    g_ptr_array_add(priv->conditions, condition);
+    priv->condition_stack = g_list_prepend(priv->condition_stack, condition);
+
+    return TRUE;
+}
+
+gboolean
+milter_manager_regexp_table_pop_condition (MilterManagerRegexpTable *table,
+                                           GError                  **error)
+{
+    MilterManagerRegexpTablePrivate *priv;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+
+    if (!priv->condition_stack) {
+        g_set_error(error,
+                    MILTER_MANAGER_REGEXP_TABLE_ERROR,
+                    MILTER_MANAGER_REGEXP_TABLE_ERROR_UNMATCHED_ENDIF,
+                    "endif isn't matched");
+        return FALSE;
+    }
+
+    priv->condition_stack = g_list_delete_link(priv->condition_stack,
+                                               priv->condition_stack);
+    return TRUE;
+}
+
+gboolean
+milter_manager_regexp_table_add (MilterManagerRegexpTable *table,
+                                 const gchar              *pattern,
+                                 gboolean                  negative,
+                                 const gchar              *action,
+                                 GError                  **error)
+{
+    MilterManagerRegexpTablePrivate *priv;
+    Entry *entry;
+    GRegex *regex;
+    GList *node;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+
+    regex = compile_pattern(pattern, error);
+    if (!regex)
+        return FALSE;
+
+    entry = g_new0(Entry, 1);
+    entry->pattern = g_strdup(pattern);
+    entry->regex = regex;
+    entry->negative = negative;
+    entry->action = g_strdup(action);
+    entry->conditions = g_list_reverse(g_list_copy(priv->condition_stack));
+    entry->combinable = is_combinable_pattern(pattern);
+    for (node = entry->conditions; node; node = g_list_next(node)) {
+        Condition *condition = node->data;
+
+        if (!is_combinable_pattern(condition->pattern))
+            entry->combinable = FALSE;
+    }
+    g_ptr_array_add(priv->entries, entry);
+    priv->compiled = FALSE;
+
+    return TRUE;
+}
+
+guint
+milter_manager_regexp_table_get_n_entries (MilterManagerRegexpTable *table)
+{
+    return MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table)->entries->len;
+}
+
+static void
+append_lookahead (GString *combined_pattern,
+                  const gchar *pattern, gboolean negative)
+{
+    g_string_append_printf(combined_pattern,
+                           "(?%c[\\s\\S]*?(?:%s))",
+                           negative ? '!' : '=',
+                           pattern);
+}
+
+/*
+ * Each entry is an alternative that is anchored at the
+ * start of the text and only looks ahead. So alternatives
+ * are tried in the table order and the empty named group
+ * at the end of the first matched alternative tells which
+ * entry is matched.
+ */
+static GString *
+build_combined_pattern (MilterManagerRegexpTablePrivate *priv,
+                        guint first, guint n_entries)
+{
+    GString *combined_pattern;
+    guint i;
+
+    combined_pattern = g_string_new("\\A(?:");
+    for (i = 0; i < n_entries; i++) {
+        Entry *entry;
+        GList *node;
+
+        entry = g_ptr_array_index(priv->entries, first + i);
+        if (i > 0)
+            g_string_append_c(combined_pattern, '|');
+        for (node = entry->conditions; node; node = g_list_next(node)) {
+            Condition *condition = node->data;
+
+            append_lookahead(combined_pattern,
+                             condition->pattern, condition->negative);
+        }
+        append_lookahead(combined_pattern, entry->pattern, entry->negative);
+        g_string_append_printf(combined_pattern, "(?<e%u>)", i);
+    }
+    g_string_append_c(combined_pattern, ')');
+
+    return combined_pattern;
+}
+
+static void
+compile_entries (MilterManagerRegexpTablePrivate *priv,
+                 guint first, guint n_entries)
+{
+    Chunk chunk;
+
+    chunk.regex = NULL;
+    chunk.first = first;
+    chunk.n_entries = n_entries;
+
+    if (n_entries > 1) {
+        GString *combined_pattern;
+        GError *error = NULL;
+
+        combined_pattern = build_combined_pattern(priv, first, n_entries);
+        chunk.regex = g_regex_new(combined_pattern->str, G_REGEX_OPTIMIZE, 0,
+                                  &error);
+        g_string_free(combined_pattern, TRUE);
+        if (!chunk.regex) {
+            guint n_former_entries = n_entries / 2;
+
+            milter_debug("[regexp-table][compile][split] <%u>: %s",
+                         n_entries, error->message);
+            g_error_free(error);
+            compile_entries(priv, first, n_former_entries);
+            compile_entries(priv,
+                            first + n_former_entries,
+                            n_entries - n_former_entries);
+            return;
+        }
+    }
+
+    g_array_append_val(priv->chunks, chunk);
+}
+
+void
+milter_manager_regexp_table_compile (MilterManagerRegexpTable *table)
+{
+    MilterManagerRegexpTablePrivate *priv;
+    guint i;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+
+    clear_chunks(priv);
+    i = 0;
+    while (i < priv->entries->len) {
+        Entry *entry;
+        guint n_entries = 0;
+
+        entry = g_ptr_array_index(priv->entries, i);
+        if (!entry->combinable) {
+            compile_entries(priv, i, 1);
+            i++;
+            continue;
+        }
+
+        while (i + n_entries < priv->entries->len &&
+               n_entries < MAX_COMBINED_ENTRIES) {
+            entry = g_ptr_array_index(priv->entries, i + n_entries);
+            if (!entry->combinable)
+                break;
+            n_entries++;
+        }
+        compile_entries(priv, i, n_entries);
+        i += n_entries;
+    }
+    priv->compiled = TRUE;
+
+    milter_debug("[regexp-table][compile] <%u> entries -> <%u> chunks",
+                 priv->entries->len, priv->chunks->len);
+}
+
+static gboolean
+match_pattern (GRegex *regex, gboolean negative, const gchar *text)
+{
+    gboolean matched;
+
+    matched = g_regex_match(regex, text, 0, NULL);
+    return negative ? !matched : matched;
+}
+
+static gboolean
+match_entry (Entry *entry, const gchar *text)
+{
+    GList *node;
+
+    for (node = entry->conditions; node; node = g_list_next(node)) {
+        Condition *condition = node->data;
+
+        if (!match_pattern(condition->regex, condition->negative, text))
+            return FALSE;
+    }
+
+    return match_pattern(entry->regex, entry->negative, text);
+}
+
+static gint
+match_chunk (Chunk *chunk, const gchar *text)
+{
+    GMatchInfo *match_info = NULL;
+    gint matched_index = -1;
+
+    if (g_regex_match(chunk->regex, text, 0, &match_info)) {
+        guint i;
+
+        for (i = 0; i < chunk->n_entries; i++) {
+            gchar name[16];
+            gint start = -1;
+
+            g_snprintf(name, sizeof(name), "e%u", i);
+            if (g_match_info_fetch_named_pos(match_info, name, &start, NULL) &&
+                start != -1) {
+                matched_index = chunk->first + i;
+                break;
+            }
+        }
+    }
+    g_match_info_free(match_info);
+
+    return matched_index;
+}
+
+static gboolean
+parse_reference (const gchar *reference, guint *number, const gchar **end)
+{
+    const gchar *p = reference;
+    gchar close = '\0';
+
+    if (*p == '{')
+        close = '}';
+    else if (*p == '(')
+        close = ')';
+    if (close)
+        p++;
+
+    if (!g_ascii_isdigit(*p))
+        return FALSE;
+    *number = 0;
+    while (g_ascii_isdigit(*p)) {
+        *number = *number * 10 + (*p - '0');
+        p++;
+    }
+
+    if (close) {
+        if (*p != close)
+            return FALSE;
+        p++;
+    }
+
+    *end = p;
+    return TRUE;
+}
+
+static gchar *
+expand_action (Entry *entry, const gchar *text)
+{
+    GMatchInfo *match_info = NULL;
+    GString *action;
+    const gchar *p;
+
+    if (entry->negative || !strchr(entry->action, '$'))
+        return g_strdup(entry->action);
+
+    g_regex_match(entry->regex, text, 0, &match_info);
+    action = g_string_new(NULL);
+    for (p = entry->action; *p; p++) {
+        guint number;
+        const gchar *end;
+
+        if (*p != '$') {
+            g_string_append_c(action, *p);
+        } else if (p[1] == '$') {
+            g_string_append_c(action, '$');
+            p++;
+        } else if (parse_reference(p + 1, &number, &end)) {
+            gchar *captured;
+
+            captured = g_match_info_fetch(match_info, number);
+            if (captured) {
+                g_string_append(action, captured);
+                g_free(captured);
+            }
+            p = end - 1;
+        } else {
+            g_string_append_c(action, *p);
+        }
+    }
+    g_match_info_free(match_info);
+
+    return g_string_free(action, FALSE);
+}
+
+gchar *
+milter_manager_regexp_table_lookup (MilterManagerRegexpTable *table,
+                                    const gchar              *text)
+{
+    MilterManagerRegexpTablePrivate *priv;
+    guint i;
+
+    priv = MILTER_MANAGER_REGEXP_TABLE_GET_PRIVATE(table);
+
+    if (!priv->compiled)
+        milter_manager_regexp_table_compile(table);
+
+    for (i = 0; i < priv->chunks->len; i++) {
+        Chunk *chunk;
+        gint matched_index = -1;
+
+        chunk = &g_array_index(priv->chunks, Chunk, i);
+        if (chunk->regex) {
+            matched_index = match_chunk(chunk, text);
+        } else {
+            guint j;
+
+            for (j = 0; j < chunk->n_entries; j++) {
+                if (match_entry(g_ptr_array_index(priv->entries,
+                                                  chunk->first + j),
+                                text)) {
+                    matched_index = chunk->first + j;
+                    break;
+                }
+            }
+        }
+
+        if (matched_index != -1)
+            return expand_action(g_ptr_array_index(priv->entries,
+                                                   matched_index),
+                                 text);
+    }
+
+    return NULL;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,119 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_REGEXP_TABLE_H__
+#define __MILTER_MANAGER_REGEXP_TABLE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_REGEXP_TABLE_ERROR           (milter_manager_regexp_table_error_quark())
+
+#define MILTER_TYPE_MANAGER_REGEXP_TABLE            (milter_manager_regexp_table_get_type())
+#define MILTER_MANAGER_REGEXP_TABLE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_REGEXP_TABLE, MilterManagerRegexpTable))
+#define MILTER_MANAGER_REGEXP_TABLE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_REGEXP_TABLE, MilterManagerRegexpTableClass))
+#define MILTER_MANAGER_IS_REGEXP_TABLE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_REGEXP_TABLE))
+#define MILTER_MANAGER_IS_REGEXP_TABLE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_REGEXP_TABLE))
+#define MILTER_MANAGER_REGEXP_TABLE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_REGEXP_TABLE, MilterManagerRegexpTableClass))
+
+typedef enum
+{
+    MILTER_MANAGER_REGEXP_TABLE_ERROR_INVALID_REGEX,
+    MILTER_MANAGER_REGEXP_TABLE_ERROR_UNMATCHED_ENDIF
+} MilterManagerRegexpTableError;
+
+typedef struct _MilterManagerRegexpTable         MilterManagerRegexpTable;
+typedef struct _MilterManagerRegexpTableClass    MilterManagerRegexpTableClass;
+
+struct _MilterManagerRegexpTable
+{
+    GObject object;
+};
+
+struct _MilterManagerRegexpTableClass
+{
+    GObjectClass parent_class;
+};
+
+GQuark                    milter_manager_regexp_table_error_quark    (void);
+
+GType                     milter_manager_regexp_table_get_type       (void) G_GNUC_CONST;
+
+/*
+ * Creates a table that works like Postfix's regexp_table
+ * and pcre_table: the action of the first entry that
+ * matches is used.
+ *
+ * Entries are compiled into a few combined regular
+ * expressions by milter_manager_regexp_table_compile(). A
+ * lookup runs one match per combined regular expression
+ * instead of one match per entry. A compiled table isn't
+ * changed by lookups. So it can be shared by processes
+ * forked after it is compiled.
+ */
+MilterManagerRegexpTable *milter_manager_regexp_table_new            (void);
+
+/*
+ * Starts an "if /pattern/" block. The following entries
+ * are used only when @pattern matches (doesn't match if
+ * @negative is TRUE) until
+ * milter_manager_regexp_table_pop_condition() is called.
+ */
+gboolean                  milter_manager_regexp_table_push_condition (MilterManagerRegexpTable *table,
+                                                                      const gchar              *pattern,
+                                                                      gboolean                  negative,
+                                                                      GError                  **error);
+gboolean                  milter_manager_regexp_table_pop_condition  (MilterManagerRegexpTable *table,
+                                                                      GError                  **error);
+
+/*
+ * Adds an entry. "$N", "${N}" and "$(N)" in @action are
+ * replaced with the Nth captured string of @pattern. "$$"
+ * is replaced with "$".
+ */
+gboolean                  milter_manager_regexp_table_add            (MilterManagerRegexpTable *table,
+                                                                      const gchar              *pattern,
+                                                                      gboolean                  negative,
+                                                                      const gchar              *action,
+                                                                      GError                  **error);
+guint                     milter_manager_regexp_table_get_n_entries  (MilterManagerRegexpTable *table);
+
+/*
+ * Builds combined regular expressions. It is called by
+ * milter_manager_regexp_table_lookup() automatically if
+ * entries are added after the last compile.
+ */
+void                      milter_manager_regexp_table_compile        (MilterManagerRegexpTable *table);
+
+/*
+ * Returns the expanded action of the first entry that
+ * matches @text. It should be freed by g_free(). NULL is
+ * returned if no entry matches.
+ */
+gchar                    *milter_manager_regexp_table_lookup         (MilterManagerRegexpTable *table,
+                                                                      const gchar              *text);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_REGEXP_TABLE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,366 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <milter/core.h>
+#include "milter-manager-replica-set.h"
+
+/* The weight of the newest latency in the moving average. */
+#define LATENCY_DECAY 0.3
+
+#define MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(obj)                     \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_REPLICA_SET,       \
+                                 MilterManagerReplicaSetPrivate))
+
+typedef struct _Replica Replica;
+struct _Replica
+{
+    gchar *connection_spec;
+    guint n_outstanding;
+    gdouble latency;
+    gboolean measured;
+    gdouble down_until;
+};
+
+typedef struct _MilterManagerReplicaSetPrivate MilterManagerReplicaSetPrivate;
+struct _MilterManagerReplicaSetPrivate
+{
+    gchar *name;
+    GPtrArray *replicas;
+    MilterManagerReplicaPolicy policy;
+    guint next_index;
+    GTimer *timer;
+};
+
+G_DEFINE_TYPE(MilterManagerReplicaSet,
+              milter_manager_replica_set,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_replica_set_class_init (MilterManagerReplicaSetClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerReplicaSetPrivate));
+}
+
+static void
+milter_manager_replica_set_init (MilterManagerReplicaSet *set)
+{
+    MilterManagerReplicaSetPrivate *priv;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set);
+    priv->name = NULL;
+    priv->replicas = g_ptr_array_new();
+    priv->policy = MILTER_MANAGER_REPLICA_POLICY_ROUND_ROBIN;
+    priv->next_index = 0;
+    priv->timer = g_timer_new();
+}
+
+static void
+replica_free (gpointer data, gpointer user_data)
+{
+    Replica *replica = data;
+
+    g_free(replica->connection_spec);
+    g_free(replica);
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerReplicaSetPrivate *priv;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(object);
+
+    if (priv->name) {
+        g_free(priv->name);
+        priv->name = NULL;
+    }
+
+    if (priv->replicas) {
+        g_ptr_array_foreach(priv->replicas, replica_free, NULL);
+        g_ptr_array_free(priv->replicas, TRUE);
+        priv->replicas = NULL;
+    }
+
+    if (priv->timer) {
+        g_timer_destroy(priv->timer);
+        priv->timer = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_replica_set_parent_class)->dispose(object);
+}
+
+MilterManagerReplicaSet *
+milter_manager_replica_set_new (const gchar *name)
+{
+    MilterManagerReplicaSet *set;
+
+    set = g_object_new(MILTER_TYPE_MANAGER_REPLICA_SET, NULL);
+    MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set)->name = g_strdup(name);
+
+    return set;
+}
+
+static Replica *
+get_replica (MilterManagerReplicaSet *set, guint index)
+{
+    MilterManagerReplicaSetPrivate *priv;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set);
+    if (index >= priv->replicas->len)
+        return NULL;
+    return g_ptr_array_index(priv->replicas, index);
+}
+
+void
+milter_manager_replica_set_add (MilterManagerReplicaSet *set,
+                                const gchar *connection_spec)
+{
+    Replica *replica;
+
+    replica = g_new0(Replica, 1);
+    replica->connection_spec = g_strdup(connection_spec);
+    g_ptr_array_add(MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set)->replicas,
+                    replica);
+}
+
+guint
+milter_manager_replica_set_get_size (MilterManagerReplicaSet *set)
+{
+    return MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set)->replicas->len;
+}
+
+const gchar *
+milter_manager_replica_set_get_connection_spec (MilterManagerReplicaSet *set,
+                                                guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    return replica ? replica->connection_spec : NULL;
+}
+
+void
+milter_manager_replica_set_set_policy (MilterManagerReplicaSet *set,
+                                       MilterManagerReplicaPolicy policy)
+{
+    MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set)->policy = policy;
+}
+
+MilterManagerReplicaPolicy
+milter_manager_replica_set_get_policy (MilterManagerReplicaSet *set)
+{
+    return MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set)->policy;
+}
+
+static gboolean
+replica_is_healthy (MilterManagerReplicaSetPrivate *priv, Replica *replica)
+{
+    return replica->down_until <= g_timer_elapsed(priv->timer, NULL);
+}
+
+/* Outstanding sessions are expected to wait for the
+ * earlier ones. Unmeasured replicas are tried first. */
+static gdouble
+replica_cost (MilterManagerReplicaPolicy policy, Replica *replica)
+{
+    switch (policy) {
+    case MILTER_MANAGER_REPLICA_POLICY_LEAST_OUTSTANDING:
+        return replica->n_outstanding;
+    case MILTER_MANAGER_REPLICA_POLICY_LATENCY:
+        if (!replica->measured)
+            return 0.0;
+        return replica->latency * (replica->n_outstanding + 1);
+    default:
+        return 0.0;
+    }
+}
+
+gint
+milter_manager_replica_set_select (MilterManagerReplicaSet *set)
+{
+    MilterManagerReplicaSetPrivate *priv;
+    guint i, n_replicas;
+    gint selected = -1;
+    gdouble selected_cost = 0.0;
+    gboolean healthy_only = TRUE;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set);
+    n_replicas = priv->replicas->len;
+    if (n_replicas == 0)
+        return -1;
+
+retry:
+    /* Start from the next index to rotate among equal costs. */
+    for (i = 0; i < n_replicas; i++) {
+        guint index = (priv->next_index + i) % n_replicas;
+        Replica *replica = g_ptr_array_index(priv->replicas, index);
+        gdouble cost;
+
+        if (healthy_only && !replica_is_healthy(priv, replica))
+            continue;
+
+        cost = replica_cost(priv->policy, replica);
+        if (selected == -1 || cost < selected_cost) {
+            selected = index;
+            selected_cost = cost;
+        }
+    }
+
+    if (selected == -1 && healthy_only) {
+        healthy_only = FALSE;
+        goto retry;
+    }
+
+    priv->next_index = (selected + 1) % n_replicas;
+    return selected;
+}
+
+gint
+milter_manager_replica_set_select_next (MilterManagerReplicaSet *set,
+                                        guint index)
+{
+    MilterManagerReplicaSetPrivate *priv;
+    guint i, n_replicas;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set);
+    n_replicas = priv->replicas->len;
+    if (n_replicas < 2)
+        return -1;
+
+    for (i = 1; i < n_replicas; i++) {
+        guint next_index = (index + i) % n_replicas;
+        Replica *replica = g_ptr_array_index(priv->replicas, next_index);
+
+        if (replica_is_healthy(priv, replica))
+            return next_index;
+    }
+
+    return (index + 1) % n_replicas;
+}
+
+void
+milter_manager_replica_set_begin (MilterManagerReplicaSet *set,
+                                  guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    if (replica)
+        replica->n_outstanding++;
+}
+
+void
+milter_manager_replica_set_end (MilterManagerReplicaSet *set,
+                                guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    if (replica && replica->n_outstanding > 0)
+        replica->n_outstanding--;
+}
+
+void
+milter_manager_replica_set_record_success (MilterManagerReplicaSet *set,
+                                           guint index,
+                                           gdouble elapsed)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    if (!replica)
+        return;
+
+    replica->latency = milter_utils_moving_average(replica->latency,
+                                                   elapsed,
+                                                   LATENCY_DECAY,
+                                                   replica->measured ? 1 : 0);
+    replica->measured = TRUE;
+    replica->down_until = 0.0;
+}
+
+void
+milter_manager_replica_set_record_failure (MilterManagerReplicaSet *set,
+                                           guint index)
+{
+    MilterManagerReplicaSetPrivate *priv;
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    if (!replica)
+        return;
+
+    priv = MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set);
+    replica->down_until =
+        g_timer_elapsed(priv->timer, NULL) +
+        MILTER_MANAGER_REPLICA_SET_DEFAULT_DOWN_TIME;
+    milter_statistics("[replica-set][down][%s] %s",
+                      priv->name, replica->connection_spec);
+}
+
+guint
+milter_manager_replica_set_get_n_outstanding (MilterManagerReplicaSet *set,
+                                              guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    return replica ? replica->n_outstanding : 0;
+}
+
+gdouble
+milter_manager_replica_set_get_latency (MilterManagerReplicaSet *set,
+                                        guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    return replica ? replica->latency : 0.0;
+}
+
+gboolean
+milter_manager_replica_set_is_healthy (MilterManagerReplicaSet *set,
+                                       guint index)
+{
+    Replica *replica;
+
+    replica = get_replica(set, index);
+    if (!replica)
+        return FALSE;
+    return replica_is_healthy(MILTER_MANAGER_REPLICA_SET_GET_PRIVATE(set),
+                              replica);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,111 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_REPLICA_SET_H__
+#define __MILTER_MANAGER_REPLICA_SET_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_REPLICA_SET_DEFAULT_DOWN_TIME 10.0
+
+#define MILTER_TYPE_MANAGER_REPLICA_SET            (milter_manager_replica_set_get_type())
+#define MILTER_MANAGER_REPLICA_SET(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_REPLICA_SET, MilterManagerReplicaSet))
+#define MILTER_MANAGER_REPLICA_SET_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_REPLICA_SET, MilterManagerReplicaSetClass))
+#define MILTER_MANAGER_IS_REPLICA_SET(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_REPLICA_SET))
+#define MILTER_MANAGER_IS_REPLICA_SET_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_REPLICA_SET))
+#define MILTER_MANAGER_REPLICA_SET_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_REPLICA_SET, MilterManagerReplicaSetClass))
+
+typedef enum
+{
+    MILTER_MANAGER_REPLICA_POLICY_ROUND_ROBIN,
+    MILTER_MANAGER_REPLICA_POLICY_LEAST_OUTSTANDING,
+    MILTER_MANAGER_REPLICA_POLICY_LATENCY
+} MilterManagerReplicaPolicy;
+
+typedef struct _MilterManagerReplicaSet         MilterManagerReplicaSet;
+typedef struct _MilterManagerReplicaSetClass    MilterManagerReplicaSetClass;
+
+struct _MilterManagerReplicaSet
+{
+    GObject object;
+};
+
+struct _MilterManagerReplicaSetClass
+{
+    GObjectClass parent_class;
+};
+
+GType                    milter_manager_replica_set_get_type    (void) G_GNUC_CONST;
+
+MilterManagerReplicaSet *milter_manager_replica_set_new         (const gchar *name);
+
+void                     milter_manager_replica_set_add         (MilterManagerReplicaSet *set,
+                                                                 const gchar             *connection_spec);
+guint                    milter_manager_replica_set_get_size    (MilterManagerReplicaSet *set);
+const gchar             *milter_manager_replica_set_get_connection_spec
+                                                                (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+
+void                     milter_manager_replica_set_set_policy  (MilterManagerReplicaSet   *set,
+                                                                 MilterManagerReplicaPolicy policy);
+MilterManagerReplicaPolicy
+                         milter_manager_replica_set_get_policy  (MilterManagerReplicaSet *set);
+
+/*
+ * Chooses a replica for a new session by the policy.
+ * Replicas that failed recently are skipped unless all
+ * replicas failed. Returns -1 for an empty set.
+ */
+gint                     milter_manager_replica_set_select      (MilterManagerReplicaSet *set);
+/*
+ * Chooses a replica to fail over from @index. Returns -1
+ * if there is no other replica.
+ */
+gint                     milter_manager_replica_set_select_next (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+
+void                     milter_manager_replica_set_begin       (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+void                     milter_manager_replica_set_end         (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+void                     milter_manager_replica_set_record_success
+                                                                (MilterManagerReplicaSet *set,
+                                                                 guint                    index,
+                                                                 gdouble                  elapsed);
+void                     milter_manager_replica_set_record_failure
+                                                                (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+
+guint                    milter_manager_replica_set_get_n_outstanding
+                                                                (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+gdouble                  milter_manager_replica_set_get_latency (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+gboolean                 milter_manager_replica_set_is_healthy  (MilterManagerReplicaSet *set,
+                                                                 guint                    index);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_REPLICA_SET_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,825 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <milter/core.h>
+#include "milter-manager-session-limiter.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define N_SLOTS 1024
+#define MAX_LOCK_SPINS 1000
+#define WAITER_POLL_INTERVAL 0.1
+
+#define MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(obj)                 \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_SESSION_LIMITER,   \
+                                 MilterManagerSessionLimiterPrivate))
+
+typedef struct _Waiter Waiter;
+struct _Waiter
+{
+    MilterManagerSessionLimiter *limiter;
+    guint id;
+    MilterManagerSessionLimiterReadyFunc ready;
+    gpointer user_data;
+    gdouble started_at;
+    GThread *thread;
+    MilterEventLoop *loop;
+    GIOChannel *wakeup_channel;
+    gint wakeup_fd;
+    guint wakeup_watch_id;
+    guint poll_id;
+};
+
+typedef struct _Slot Slot;
+struct _Slot
+{
+    gint pid;
+    guint n_sessions;
+};
+
+/*
+ * This is placed in shared memory because sessions of all
+ * worker processes are counted. Each process counts its
+ * sessions in its own slot. So sessions of a dead process
+ * can be reclaimed.
+ */
+typedef struct _Counter Counter;
+struct _Counter
+{
+    volatile gint lock; /* the PID of the owner or 0 */
+    Slot slots[N_SLOTS];
+};
+
+typedef struct _MilterManagerSessionLimiterPrivate MilterManagerSessionLimiterPrivate;
+struct _MilterManagerSessionLimiterPrivate
+{
+    GMutex *mutex;
+    gchar *name;
+    guint max_sessions;
+    guint max_waiting_sessions;
+    gdouble max_wait_time;
+
+    Counter *counter;
+    gboolean shared;
+    GQueue *waiters;
+    GList *woken_waiters;
+    guint last_wait_id;
+    GTimer *timer;
+
+    guint n_waited_sessions;
+    guint n_rejected_sessions;
+    gdouble total_wait_time;
+    gdouble longest_wait_time;
+};
+
+G_DEFINE_TYPE(MilterManagerSessionLimiter,
+              milter_manager_session_limiter,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_session_limiter_class_init (MilterManagerSessionLimiterClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerSessionLimiterPrivate));
+}
+
+static void
+milter_manager_session_limiter_init (MilterManagerSessionLimiter *limiter)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    priv->mutex = g_mutex_new();
+    priv->name = NULL;
+    priv->max_sessions = 0;
+    priv->max_waiting_sessions = 0;
+    priv->max_wait_time = MILTER_MANAGER_SESSION_LIMITER_DEFAULT_MAX_WAIT_TIME;
+
+    priv->counter = NULL;
+    priv->shared = FALSE;
+    priv->waiters = g_queue_new();
+    priv->woken_waiters = NULL;
+    priv->last_wait_id = 0;
+    priv->timer = g_timer_new();
+
+    priv->n_waited_sessions = 0;
+    priv->n_rejected_sessions = 0;
+    priv->total_wait_time = 0.0;
+    priv->longest_wait_time = 0.0;
+}
+
+static void
+waiter_free (Waiter *waiter)
+{
+    if (waiter->poll_id > 0)
+        milter_event_loop_remove(waiter->loop, waiter->poll_id);
+    if (waiter->wakeup_watch_id > 0)
+        milter_event_loop_remove(waiter->loop, waiter->wakeup_watch_id);
+    if (waiter->wakeup_channel)
+        g_io_channel_unref(waiter->wakeup_channel);
+    if (waiter->wakeup_fd != -1)
+        close(waiter->wakeup_fd);
+    if (waiter->loop)
+        g_object_unref(waiter->loop);
+    g_free(waiter);
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(object);
+
+    if (priv->name) {
+        g_free(priv->name);
+        priv->name = NULL;
+    }
+
+    if (priv->waiters) {
+        g_list_foreach(priv->waiters->head, (GFunc)waiter_free, NULL);
+        g_queue_free(priv->waiters);
+        priv->waiters = NULL;
+    }
+
+    if (priv->woken_waiters) {
+        g_list_foreach(priv->woken_waiters, (GFunc)waiter_free, NULL);
+        g_list_free(priv->woken_waiters);
+        priv->woken_waiters = NULL;
+    }
+
+    if (priv->timer) {
+        g_timer_destroy(priv->timer);
+        priv->timer = NULL;
+    }
+
+    if (priv->counter) {
+        if (priv->shared)
+            munmap(priv->counter, sizeof(Counter));
+        else
+            g_free(priv->counter);
+        priv->counter = NULL;
+    }
+
+    if (priv->mutex) {
+        g_mutex_free(priv->mutex);
+        priv->mutex = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_session_limiter_parent_class)->dispose(object);
+}
+
+MilterManagerSessionLimiter *
+milter_manager_session_limiter_new (const gchar *name)
+{
+    MilterManagerSessionLimiter *limiter;
+    MilterManagerSessionLimiterPrivate *priv;
+    gpointer counter;
+
+    limiter = g_object_new(MILTER_TYPE_MANAGER_SESSION_LIMITER, NULL);
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    priv->name = g_strdup(name);
+
+    counter = mmap(NULL, sizeof(Counter), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counter == MAP_FAILED) {
+        milter_warning("[session-limiter][%s][mmap][fallback] %s",
+                       name ? name : "(null)", g_strerror(errno));
+        counter = g_malloc0(sizeof(Counter));
+    } else {
+        priv->shared = TRUE;
+    }
+    priv->counter = counter;
+
+    return limiter;
+}
+
+static gboolean
+is_dead_process (gint pid)
+{
+    return kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+/*
+ * The lock word has the PID of the owner like the verdict
+ * cache. If the owner died while it locked the counter, the
+ * lock is taken over. Sessions of the dead owner are
+ * reclaimed by reclaim_dead_slots() later.
+ */
+static void
+lock_counter (MilterManagerSessionLimiterPrivate *priv)
+{
+    Counter *counter;
+    gint pid, owner;
+    guint i;
+
+    counter = priv->counter;
+    pid = getpid();
+    while (TRUE) {
+        for (i = 0; i < MAX_LOCK_SPINS; i++) {
+            if (g_atomic_int_compare_and_exchange(&(counter->lock), 0, pid))
+                return;
+            sched_yield();
+        }
+
+        owner = g_atomic_int_get(&(counter->lock));
+        if (owner == 0 || owner == pid || !is_dead_process(owner))
+            continue;
+        if (g_atomic_int_compare_and_exchange(&(counter->lock), owner, pid)) {
+            milter_warning("[session-limiter][%s][lock][take-over] "
+                           "the owner died while it locked: <%d>",
+                           priv->name ? priv->name : "(null)", owner);
+            return;
+        }
+    }
+}
+
+static void
+unlock_counter (MilterManagerSessionLimiterPrivate *priv)
+{
+    g_atomic_int_set(&(priv->counter->lock), 0);
+}
+
+/* They must be called with the counter lock. */
+static guint
+count_sessions (MilterManagerSessionLimiterPrivate *priv)
+{
+    guint i, n_sessions = 0;
+
+    for (i = 0; i < N_SLOTS; i++) {
+        n_sessions += priv->counter->slots[i].n_sessions;
+    }
+
+    return n_sessions;
+}
+
+static Slot *
+find_slot (MilterManagerSessionLimiterPrivate *priv, gint pid, gboolean create)
+{
+    Slot *free_slot = NULL;
+    guint i;
+
+    for (i = 0; i < N_SLOTS; i++) {
+        Slot *slot = &(priv->counter->slots[i]);
+
+        if (slot->pid == pid)
+            return slot;
+        if (slot->pid == 0 && !free_slot)
+            free_slot = slot;
+    }
+
+    if (create && free_slot)
+        free_slot->pid = pid;
+    return create ? free_slot : NULL;
+}
+
+static void
+reclaim_dead_slots (MilterManagerSessionLimiterPrivate *priv, gint pid)
+{
+    guint i;
+
+    for (i = 0; i < N_SLOTS; i++) {
+        Slot *slot = &(priv->counter->slots[i]);
+
+        if (slot->pid == 0 || slot->pid == pid || !is_dead_process(slot->pid))
+            continue;
+        milter_warning("[session-limiter][%s][reclaim] "
+                       "the process died while it had sessions: <%d>: <%u>",
+                       priv->name ? priv->name : "(null)",
+                       slot->pid, slot->n_sessions);
+        slot->pid = 0;
+        slot->n_sessions = 0;
+    }
+}
+
+static gboolean
+take_session (MilterManagerSessionLimiterPrivate *priv)
+{
+    Slot *slot;
+    gint pid;
+
+    pid = getpid();
+    if (priv->max_sessions > 0 && count_sessions(priv) >= priv->max_sessions) {
+        reclaim_dead_slots(priv, pid);
+        if (count_sessions(priv) >= priv->max_sessions)
+            return FALSE;
+    }
+
+    slot = find_slot(priv, pid, TRUE);
+    if (!slot) {
+        milter_warning("[session-limiter][%s][slot][full] <%u>",
+                       priv->name ? priv->name : "(null)", N_SLOTS);
+        return FALSE;
+    }
+    slot->n_sessions++;
+
+    return TRUE;
+}
+
+static gboolean
+give_back_session (MilterManagerSessionLimiterPrivate *priv)
+{
+    Slot *slot;
+
+    slot = find_slot(priv, getpid(), FALSE);
+    if (!slot || slot->n_sessions == 0)
+        return FALSE;
+
+    slot->n_sessions--;
+    if (slot->n_sessions == 0)
+        slot->pid = 0;
+
+    return TRUE;
+}
+
+static guint
+get_n_sessions (MilterManagerSessionLimiterPrivate *priv)
+{
+    guint n_sessions;
+
+    lock_counter(priv);
+    n_sessions = count_sessions(priv);
+    unlock_counter(priv);
+
+    return n_sessions;
+}
+
+static void
+record_wait_time (MilterManagerSessionLimiterPrivate *priv, Waiter *waiter)
+{
+    gdouble wait_time;
+
+    wait_time = g_timer_elapsed(priv->timer, NULL) - waiter->started_at;
+    priv->total_wait_time += wait_time;
+    if (wait_time > priv->longest_wait_time)
+        priv->longest_wait_time = wait_time;
+}
+
+/*
+ * Wakes up the event loop of a waiter in another thread.
+ * A full pipe already has a pending wake up. So it doesn't
+ * need to block.
+ */
+static void
+wake_up_waiter_pipe (Waiter *waiter)
+{
+    gchar byte = '\0';
+    ssize_t written_size;
+
+    do {
+        written_size = write(waiter->wakeup_fd, &byte, 1);
+    } while (written_size == -1 && errno == EINTR);
+}
+
+/*
+ * Passes free slots to waiters. It must be called with the
+ * lock. Waiters in other threads are woken up in their
+ * threads. The others are returned and their ready
+ * functions must be called by call_ready_waiters() without
+ * the lock.
+ */
+static GList *
+wake_up_waiters (MilterManagerSessionLimiterPrivate *priv)
+{
+    GList *ready_waiters = NULL;
+
+    while (!g_queue_is_empty(priv->waiters)) {
+        Waiter *waiter;
+        gboolean taken;
+        guint n_sessions;
+
+        lock_counter(priv);
+        taken = take_session(priv);
+        n_sessions = count_sessions(priv);
+        unlock_counter(priv);
+        if (!taken)
+            break;
+
+        waiter = g_queue_pop_head(priv->waiters);
+        priv->n_waited_sessions++;
+        record_wait_time(priv, waiter);
+        milter_statistics("[session-limiter][ready][%s] "
+                          "<%g> sessions=<%u> waiting=<%u>",
+                          priv->name,
+                          g_timer_elapsed(priv->timer, NULL) -
+                          waiter->started_at,
+                          n_sessions,
+                          g_queue_get_length(priv->waiters));
+        if (waiter->loop && waiter->thread != g_thread_self()) {
+            priv->woken_waiters = g_list_prepend(priv->woken_waiters, waiter);
+            wake_up_waiter_pipe(waiter);
+        } else {
+            ready_waiters = g_list_append(ready_waiters, waiter);
+        }
+    }
+
+    return ready_waiters;
+}
+
+static void
+call_ready_waiters (GList *ready_waiters)
+{
+    GList *node;
+
+    for (node = ready_waiters; node; node = g_list_next(node)) {
+        Waiter *waiter = node->data;
+
+        waiter->ready(waiter->user_data);
+        waiter_free(waiter);
+    }
+    g_list_free(ready_waiters);
+}
+
+void
+milter_manager_session_limiter_set_max_sessions (MilterManagerSessionLimiter *limiter,
+                                                 guint max_sessions)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    GList *ready_waiters;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    priv->max_sessions = max_sessions;
+    ready_waiters = wake_up_waiters(priv);
+    g_mutex_unlock(priv->mutex);
+
+    call_ready_waiters(ready_waiters);
+}
+
+guint
+milter_manager_session_limiter_get_max_sessions (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->max_sessions;
+}
+
+void
+milter_manager_session_limiter_set_max_waiting_sessions (MilterManagerSessionLimiter *limiter,
+                                                         guint max_waiting_sessions)
+{
+    MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->max_waiting_sessions =
+        max_waiting_sessions;
+}
+
+guint
+milter_manager_session_limiter_get_max_waiting_sessions (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->max_waiting_sessions;
+}
+
+void
+milter_manager_session_limiter_set_max_wait_time (MilterManagerSessionLimiter *limiter,
+                                                  gdouble max_wait_time)
+{
+    MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->max_wait_time =
+        max_wait_time;
+}
+
+gdouble
+milter_manager_session_limiter_get_max_wait_time (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->max_wait_time;
+}
+
+gboolean
+milter_manager_session_limiter_acquire (MilterManagerSessionLimiter *limiter)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    gboolean acquired = FALSE;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    /* Don't overtake waiting sessions. */
+    if (g_queue_is_empty(priv->waiters)) {
+        lock_counter(priv);
+        acquired = take_session(priv);
+        unlock_counter(priv);
+    }
+    g_mutex_unlock(priv->mutex);
+
+    return acquired;
+}
+
+void
+milter_manager_session_limiter_release (MilterManagerSessionLimiter *limiter)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    GList *ready_waiters = NULL;
+    gboolean released;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    lock_counter(priv);
+    released = give_back_session(priv);
+    unlock_counter(priv);
+    if (released)
+        ready_waiters = wake_up_waiters(priv);
+    g_mutex_unlock(priv->mutex);
+
+    call_ready_waiters(ready_waiters);
+}
+
+static gboolean
+cb_waiter_wakeup (GIOChannel *channel, GIOCondition condition,
+                  gpointer user_data)
+{
+    Waiter *waiter = user_data;
+    MilterManagerSessionLimiterPrivate *priv;
+    GList *node;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(waiter->limiter);
+    g_mutex_lock(priv->mutex);
+    node = g_list_find(priv->woken_waiters, waiter);
+    if (node)
+        priv->woken_waiters = g_list_delete_link(priv->woken_waiters, node);
+    g_mutex_unlock(priv->mutex);
+
+    if (!node)
+        return TRUE;
+
+    waiter->wakeup_watch_id = 0;
+    waiter->ready(waiter->user_data);
+    waiter_free(waiter);
+
+    return FALSE;
+}
+
+/*
+ * Sessions in other processes release slots without
+ * waking up waiters in this process. So waiters check free
+ * slots periodically.
+ */
+static gboolean
+cb_waiter_poll (gpointer user_data)
+{
+    Waiter *waiter = user_data;
+    MilterManagerSessionLimiterPrivate *priv;
+    GList *ready_waiters;
+    gboolean keep = TRUE;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(waiter->limiter);
+    g_mutex_lock(priv->mutex);
+    ready_waiters = wake_up_waiters(priv);
+    g_mutex_unlock(priv->mutex);
+
+    /* @waiter is freed by call_ready_waiters(). */
+    if (g_list_find(ready_waiters, waiter)) {
+        waiter->poll_id = 0;
+        keep = FALSE;
+    }
+    call_ready_waiters(ready_waiters);
+
+    return keep;
+}
+
+static gboolean
+setup_wakeup_pipe (Waiter *waiter, MilterEventLoop *loop)
+{
+    int pipe_fds[2];
+
+    if (pipe(pipe_fds) == -1) {
+        milter_error("[session-limiter][pipe][error] %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    fcntl(pipe_fds[MILTER_UTILS_READ_PIPE], F_SETFL, O_NONBLOCK);
+    fcntl(pipe_fds[MILTER_UTILS_WRITE_PIPE], F_SETFL, O_NONBLOCK);
+    waiter->wakeup_channel =
+        g_io_channel_unix_new(pipe_fds[MILTER_UTILS_READ_PIPE]);
+    g_io_channel_set_close_on_unref(waiter->wakeup_channel, TRUE);
+    waiter->wakeup_fd = pipe_fds[MILTER_UTILS_WRITE_PIPE];
+    waiter->loop = g_object_ref(loop);
+    waiter->wakeup_watch_id =
+        milter_event_loop_watch_io(loop,
+                                   waiter->wakeup_channel,
+                                   G_IO_IN | G_IO_PRI,
+                                   cb_waiter_wakeup,
+                                   waiter);
+
+    return TRUE;
+}
+
+guint
+milter_manager_session_limiter_wait (MilterManagerSessionLimiter *limiter,
+                                     MilterManagerSessionLimiterReadyFunc ready,
+                                     gpointer user_data)
+{
+    return milter_manager_session_limiter_wait_full(limiter, NULL,
+                                                    ready, user_data);
+}
+
+guint
+milter_manager_session_limiter_wait_full (MilterManagerSessionLimiter *limiter,
+                                          MilterEventLoop *loop,
+                                          MilterManagerSessionLimiterReadyFunc ready,
+                                          gpointer user_data)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    Waiter *waiter;
+    guint wait_id = 0;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+
+    waiter = g_new0(Waiter, 1);
+    waiter->limiter = limiter;
+    waiter->ready = ready;
+    waiter->user_data = user_data;
+    waiter->thread = g_thread_self();
+    waiter->wakeup_fd = -1;
+    if (loop && !setup_wakeup_pipe(waiter, loop)) {
+        waiter_free(waiter);
+        return 0;
+    }
+
+    g_mutex_lock(priv->mutex);
+    if (g_queue_get_length(priv->waiters) >= priv->max_waiting_sessions) {
+        priv->n_rejected_sessions++;
+        milter_statistics("[session-limiter][reject][%s] "
+                          "sessions=<%u> waiting=<%u>",
+                          priv->name,
+                          get_n_sessions(priv),
+                          g_queue_get_length(priv->waiters));
+    } else {
+        priv->last_wait_id++;
+        if (priv->last_wait_id == 0)
+            priv->last_wait_id++;
+        waiter->id = priv->last_wait_id;
+        waiter->started_at = g_timer_elapsed(priv->timer, NULL);
+        g_queue_push_tail(priv->waiters, waiter);
+        wait_id = waiter->id;
+        if (waiter->loop && priv->shared)
+            waiter->poll_id = milter_event_loop_add_timeout(waiter->loop,
+                                                            WAITER_POLL_INTERVAL,
+                                                            cb_waiter_poll,
+                                                            waiter);
+    }
+    g_mutex_unlock(priv->mutex);
+
+    if (wait_id == 0)
+        waiter_free(waiter);
+
+    return wait_id;
+}
+
+void
+milter_manager_session_limiter_cancel (MilterManagerSessionLimiter *limiter,
+                                       guint wait_id)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    GList *node;
+    Waiter *canceled_waiter = NULL;
+    GList *ready_waiters = NULL;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    for (node = priv->waiters->head; node; node = g_list_next(node)) {
+        Waiter *waiter = node->data;
+
+        if (waiter->id != wait_id)
+            continue;
+
+        priv->n_rejected_sessions++;
+        record_wait_time(priv, waiter);
+        milter_statistics("[session-limiter][give-up][%s] "
+                          "<%g> sessions=<%u> waiting=<%u>",
+                          priv->name,
+                          g_timer_elapsed(priv->timer, NULL) -
+                          waiter->started_at,
+                          get_n_sessions(priv),
+                          g_queue_get_length(priv->waiters) - 1);
+        g_queue_delete_link(priv->waiters, node);
+        canceled_waiter = waiter;
+        break;
+    }
+
+    if (!canceled_waiter) {
+        /* The slot has been passed to the waiter but its
+         * thread hasn't been woken up yet. It is passed to
+         * the next waiter. */
+        for (node = priv->woken_waiters; node; node = g_list_next(node)) {
+            Waiter *waiter = node->data;
+
+            if (waiter->id != wait_id)
+                continue;
+
+            priv->woken_waiters =
+                g_list_delete_link(priv->woken_waiters, node);
+            canceled_waiter = waiter;
+            lock_counter(priv);
+            give_back_session(priv);
+            unlock_counter(priv);
+            ready_waiters = wake_up_waiters(priv);
+            break;
+        }
+    }
+    g_mutex_unlock(priv->mutex);
+
+    if (canceled_waiter)
+        waiter_free(canceled_waiter);
+    call_ready_waiters(ready_waiters);
+}
+
+guint
+milter_manager_session_limiter_get_n_sessions (MilterManagerSessionLimiter *limiter)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    guint n_sessions;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    n_sessions = get_n_sessions(priv);
+    g_mutex_unlock(priv->mutex);
+
+    return n_sessions;
+}
+
+guint
+milter_manager_session_limiter_get_n_waiting_sessions (MilterManagerSessionLimiter *limiter)
+{
+    MilterManagerSessionLimiterPrivate *priv;
+    guint n_waiting_sessions;
+
+    priv = MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter);
+    g_mutex_lock(priv->mutex);
+    n_waiting_sessions = g_queue_get_length(priv->waiters);
+    g_mutex_unlock(priv->mutex);
+
+    return n_waiting_sessions;
+}
+
+guint
+milter_manager_session_limiter_get_n_waited_sessions (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->n_waited_sessions;
+}
+
+guint
+milter_manager_session_limiter_get_n_rejected_sessions (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->n_rejected_sessions;
+}
+
+gdouble
+milter_manager_session_limiter_get_total_wait_time (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->total_wait_time;
+}
+
+gdouble
+milter_manager_session_limiter_get_longest_wait_time (MilterManagerSessionLimiter *limiter)
+{
+    return MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter)->longest_wait_time;
+}
+
+void
+milter_manager_session_limiter_lock (MilterManagerSessionLimiter *limiter)
+{
+    lock_counter(MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter));
+}
+
+void
+milter_manager_session_limiter_unlock (MilterManagerSessionLimiter *limiter)
+{
+    unlock_counter(MILTER_MANAGER_SESSION_LIMITER_GET_PRIVATE(limiter));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
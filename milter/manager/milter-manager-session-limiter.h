@@ -0,0 +1,140 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_SESSION_LIMITER_H__
+#define __MILTER_MANAGER_SESSION_LIMITER_H__
+
+#include <glib-object.h>
+
+#include <milter/core/milter-event-loop.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_SESSION_LIMITER_DEFAULT_MAX_WAIT_TIME 5.0
+
+#define MILTER_TYPE_MANAGER_SESSION_LIMITER            (milter_manager_session_limiter_get_type())
+#define MILTER_MANAGER_SESSION_LIMITER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_SESSION_LIMITER, MilterManagerSessionLimiter))
+#define MILTER_MANAGER_SESSION_LIMITER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_SESSION_LIMITER, MilterManagerSessionLimiterClass))
+#define MILTER_MANAGER_IS_SESSION_LIMITER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_SESSION_LIMITER))
+#define MILTER_MANAGER_IS_SESSION_LIMITER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_SESSION_LIMITER))
+#define MILTER_MANAGER_SESSION_LIMITER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_SESSION_LIMITER, MilterManagerSessionLimiterClass))
+
+typedef void (*MilterManagerSessionLimiterReadyFunc) (gpointer user_data);
+
+typedef struct _MilterManagerSessionLimiter         MilterManagerSessionLimiter;
+typedef struct _MilterManagerSessionLimiterClass    MilterManagerSessionLimiterClass;
+
+struct _MilterManagerSessionLimiter
+{
+    GObject object;
+};
+
+struct _MilterManagerSessionLimiterClass
+{
+    GObjectClass parent_class;
+};
+
+GType                        milter_manager_session_limiter_get_type    (void) G_GNUC_CONST;
+
+MilterManagerSessionLimiter *milter_manager_session_limiter_new         (const gchar *name);
+
+void                         milter_manager_session_limiter_set_max_sessions
+                                                        (MilterManagerSessionLimiter *limiter,
+                                                         guint                        max_sessions);
+guint                        milter_manager_session_limiter_get_max_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+void                         milter_manager_session_limiter_set_max_waiting_sessions
+                                                        (MilterManagerSessionLimiter *limiter,
+                                                         guint                        max_waiting_sessions);
+guint                        milter_manager_session_limiter_get_max_waiting_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+/*
+ * The maximum seconds that a session waits for a slot.
+ * It is used by the waiting side.
+ */
+void                         milter_manager_session_limiter_set_max_wait_time
+                                                        (MilterManagerSessionLimiter *limiter,
+                                                         gdouble                      max_wait_time);
+gdouble                      milter_manager_session_limiter_get_max_wait_time
+                                                        (MilterManagerSessionLimiter *limiter);
+
+/*
+ * Takes a slot if the number of sessions is less than
+ * max-sessions. 0 max-sessions means no limit. Sessions
+ * are counted across processes forked after the limiter
+ * is created.
+ */
+gboolean                     milter_manager_session_limiter_acquire
+                                                        (MilterManagerSessionLimiter *limiter);
+/*
+ * Gives back a slot. If there are waiting sessions, the
+ * slot is passed to the oldest one and its ready function
+ * is called.
+ */
+void                         milter_manager_session_limiter_release
+                                                        (MilterManagerSessionLimiter *limiter);
+/*
+ * Waits for a slot. Returns 0 if there are already
+ * max-waiting-sessions waiting sessions.
+ */
+guint                        milter_manager_session_limiter_wait
+                                                        (MilterManagerSessionLimiter         *limiter,
+                                                         MilterManagerSessionLimiterReadyFunc ready,
+                                                         gpointer                             user_data);
+/*
+ * Same as milter_manager_session_limiter_wait() but @ready
+ * is called in the thread that runs @loop even if another
+ * thread releases the slot. A limiter shared by threads
+ * must be waited with it.
+ */
+guint                        milter_manager_session_limiter_wait_full
+                                                        (MilterManagerSessionLimiter         *limiter,
+                                                         MilterEventLoop                     *loop,
+                                                         MilterManagerSessionLimiterReadyFunc ready,
+                                                         gpointer                             user_data);
+void                         milter_manager_session_limiter_cancel
+                                                        (MilterManagerSessionLimiter *limiter,
+                                                         guint                        wait_id);
+
+guint                        milter_manager_session_limiter_get_n_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+guint                        milter_manager_session_limiter_get_n_waiting_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+guint                        milter_manager_session_limiter_get_n_waited_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+guint                        milter_manager_session_limiter_get_n_rejected_sessions
+                                                        (MilterManagerSessionLimiter *limiter);
+gdouble                      milter_manager_session_limiter_get_total_wait_time
+                                                        (MilterManagerSessionLimiter *limiter);
+gdouble                      milter_manager_session_limiter_get_longest_wait_time
+                                                        (MilterManagerSessionLimiter *limiter);
+
+/* private */
+void                         milter_manager_session_limiter_lock
+                                                        (MilterManagerSessionLimiter *limiter);
+void                         milter_manager_session_limiter_unlock
+                                                        (MilterManagerSessionLimiter *limiter);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_SESSION_LIMITER_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
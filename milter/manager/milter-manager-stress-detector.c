@@ -0,0 +1,224 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <milter/core.h>
+#include "milter-manager-stress-detector.h"
+
+#define RELAXED_PRESSURE 0.5
+
+#define MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(obj)                 \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_STRESS_DETECTOR,   \
+                                 MilterManagerStressDetectorPrivate))
+
+typedef struct _MilterManagerStressDetectorPrivate MilterManagerStressDetectorPrivate;
+struct _MilterManagerStressDetectorPrivate
+{
+    GMutex *mutex;
+    MilterUtilsLatencyTrend latency_trend;
+    gdouble pressure;
+    gdouble shedding_ratio;
+    gdouble skip_credit;
+};
+
+G_DEFINE_TYPE(MilterManagerStressDetector,
+              milter_manager_stress_detector,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_stress_detector_class_init (MilterManagerStressDetectorClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerStressDetectorPrivate));
+}
+
+static void
+milter_manager_stress_detector_init (MilterManagerStressDetector *detector)
+{
+    MilterManagerStressDetectorPrivate *priv;
+
+    priv = MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector);
+    priv->mutex = g_mutex_new();
+    milter_utils_latency_trend_init(&(priv->latency_trend));
+    priv->pressure = 0.0;
+    priv->shedding_ratio = 0.0;
+    priv->skip_credit = 0.0;
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerStressDetectorPrivate *priv;
+
+    priv = MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(object);
+
+    if (priv->mutex) {
+        g_mutex_free(priv->mutex);
+        priv->mutex = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_stress_detector_parent_class)->dispose(object);
+}
+
+MilterManagerStressDetector *
+milter_manager_stress_detector_new (void)
+{
+    return g_object_new(MILTER_TYPE_MANAGER_STRESS_DETECTOR, NULL);
+}
+
+void
+milter_manager_stress_detector_record_latency (MilterManagerStressDetector *detector,
+                                               gdouble latency)
+{
+    MilterManagerStressDetectorPrivate *priv;
+
+    priv = MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector);
+    g_mutex_lock(priv->mutex);
+    milter_utils_latency_trend_add(&(priv->latency_trend), latency);
+    g_mutex_unlock(priv->mutex);
+}
+
+void
+milter_manager_stress_detector_update (MilterManagerStressDetector *detector,
+                                       gdouble lag,
+                                       gdouble cpu_usage)
+{
+    MilterManagerStressDetectorPrivate *priv;
+    gdouble pressure;
+    gdouble shedding_ratio;
+
+    priv = MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector);
+    g_mutex_lock(priv->mutex);
+
+    pressure = lag / MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_MAX_LAG;
+    pressure = MAX(pressure,
+                   cpu_usage / MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_MAX_CPU_USAGE);
+    if (milter_utils_latency_trend_is_warmed_up(&(priv->latency_trend)) &&
+        priv->latency_trend.baseline_latency > 0.0) {
+        gdouble latency_pressure;
+
+        latency_pressure =
+            priv->latency_trend.latency /
+            (priv->latency_trend.baseline_latency *
+             MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_LATENCY_TOLERANCE);
+        pressure = MAX(pressure, latency_pressure);
+    }
+    priv->pressure = pressure;
+
+    shedding_ratio = priv->shedding_ratio;
+    if (pressure >= 1.0) {
+        shedding_ratio += MILTER_MANAGER_STRESS_DETECTOR_SHEDDING_STEP;
+    } else if (pressure < RELAXED_PRESSURE) {
+        shedding_ratio -= MILTER_MANAGER_STRESS_DETECTOR_SHEDDING_STEP;
+    }
+    shedding_ratio = CLAMP(shedding_ratio, 0.0, 1.0);
+    if (shedding_ratio != priv->shedding_ratio) {
+        milter_statistics("[manager][stress-detector][shedding] "
+                          "%g -> %g: pressure=%g lag=%g cpu=%g "
+                          "latency=%g baseline=%g",
+                          priv->shedding_ratio,
+                          shedding_ratio,
+                          pressure,
+                          lag,
+                          cpu_usage,
+                          priv->latency_trend.latency,
+                          priv->latency_trend.baseline_latency);
+        priv->shedding_ratio = shedding_ratio;
+        if (shedding_ratio == 0.0)
+            priv->skip_credit = 0.0;
+    }
+
+    g_mutex_unlock(priv->mutex);
+}
+
+void
+milter_manager_stress_detector_update_loops (MilterManagerStressDetector *detector,
+                                             const gdouble *lags,
+                                             guint n_loops,
+                                             gdouble cpu_usage)
+{
+    gdouble max_lag = 0.0;
+    guint i;
+
+    for (i = 0; i < n_loops; i++) {
+        max_lag = MAX(max_lag, lags[i]);
+    }
+    if (n_loops > 1)
+        cpu_usage /= n_loops;
+    milter_manager_stress_detector_update(detector, max_lag, cpu_usage);
+}
+
+gboolean
+milter_manager_stress_detector_should_skip_optional (MilterManagerStressDetector *detector)
+{
+    MilterManagerStressDetectorPrivate *priv;
+    gboolean skip = FALSE;
+
+    priv = MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector);
+    g_mutex_lock(priv->mutex);
+    priv->skip_credit += priv->shedding_ratio;
+    if (priv->skip_credit >= 1.0) {
+        priv->skip_credit -= 1.0;
+        skip = TRUE;
+    }
+    g_mutex_unlock(priv->mutex);
+
+    return skip;
+}
+
+gdouble
+milter_manager_stress_detector_get_pressure (MilterManagerStressDetector *detector)
+{
+    return MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector)->pressure;
+}
+
+gdouble
+milter_manager_stress_detector_get_shedding_ratio (MilterManagerStressDetector *detector)
+{
+    return MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector)->shedding_ratio;
+}
+
+gdouble
+milter_manager_stress_detector_get_latency (MilterManagerStressDetector *detector)
+{
+    return MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector)->latency_trend.latency;
+}
+
+gdouble
+milter_manager_stress_detector_get_baseline_latency (MilterManagerStressDetector *detector)
+{
+    return MILTER_MANAGER_STRESS_DETECTOR_GET_PRIVATE(detector)->latency_trend.baseline_latency;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
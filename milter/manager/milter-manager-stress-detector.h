@@ -0,0 +1,110 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef __MILTER_MANAGER_STRESS_DETECTOR_H__
+#define __MILTER_MANAGER_STRESS_DETECTOR_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_MAX_LAG 0.1
+#define MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_LATENCY_TOLERANCE 2.0
+#define MILTER_MANAGER_STRESS_DETECTOR_DEFAULT_MAX_CPU_USAGE 0.9
+#define MILTER_MANAGER_STRESS_DETECTOR_SHEDDING_STEP 0.25
+
+#define MILTER_TYPE_MANAGER_STRESS_DETECTOR            (milter_manager_stress_detector_get_type())
+#define MILTER_MANAGER_STRESS_DETECTOR(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_STRESS_DETECTOR, MilterManagerStressDetector))
+#define MILTER_MANAGER_STRESS_DETECTOR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_STRESS_DETECTOR, MilterManagerStressDetectorClass))
+#define MILTER_MANAGER_IS_STRESS_DETECTOR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_STRESS_DETECTOR))
+#define MILTER_MANAGER_IS_STRESS_DETECTOR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_STRESS_DETECTOR))
+#define MILTER_MANAGER_STRESS_DETECTOR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_STRESS_DETECTOR, MilterManagerStressDetectorClass))
+
+typedef struct _MilterManagerStressDetector         MilterManagerStressDetector;
+typedef struct _MilterManagerStressDetectorClass    MilterManagerStressDetectorClass;
+
+struct _MilterManagerStressDetector
+{
+    GObject object;
+};
+
+struct _MilterManagerStressDetectorClass
+{
+    GObjectClass parent_class;
+};
+
+GType                        milter_manager_stress_detector_get_type    (void) G_GNUC_CONST;
+
+/*
+ * Creates a detector that computes pressure from the event
+ * loop lag, the recent session latency against the long
+ * term one and the CPU usage. Pressure 1.0 means
+ * "overloaded".
+ */
+MilterManagerStressDetector *milter_manager_stress_detector_new         (void);
+
+void                         milter_manager_stress_detector_record_latency
+                                                                        (MilterManagerStressDetector *detector,
+                                                                         gdouble                      latency);
+/*
+ * Recomputes pressure from the latest samples. The
+ * shedding ratio is raised by
+ * MILTER_MANAGER_STRESS_DETECTOR_SHEDDING_STEP while
+ * pressure is 1.0 or more and is lowered by the same step
+ * only after pressure falls below 0.5.
+ */
+void                         milter_manager_stress_detector_update      (MilterManagerStressDetector *detector,
+                                                                         gdouble                      lag,
+                                                                         gdouble                      cpu_usage);
+/*
+ * Same as milter_manager_stress_detector_update() but for
+ * a process that runs @n_loops event loops in their own
+ * threads. The largest lag in @lags is used. @cpu_usage is
+ * the usage of the whole process and is divided by
+ * @n_loops because each loop can use its own CPU.
+ */
+void                         milter_manager_stress_detector_update_loops
+                                                                        (MilterManagerStressDetector *detector,
+                                                                         const gdouble               *lags,
+                                                                         guint                        n_loops,
+                                                                         gdouble                      cpu_usage);
+/*
+ * Returns TRUE if an optional milter should be skipped
+ * for a new session. The ratio of skipped sessions
+ * follows the shedding ratio.
+ */
+gboolean                     milter_manager_stress_detector_should_skip_optional
+                                                                        (MilterManagerStressDetector *detector);
+
+gdouble                      milter_manager_stress_detector_get_pressure
+                                                                        (MilterManagerStressDetector *detector);
+gdouble                      milter_manager_stress_detector_get_shedding_ratio
+                                                                        (MilterManagerStressDetector *detector);
+gdouble                      milter_manager_stress_detector_get_latency (MilterManagerStressDetector *detector);
+gdouble                      milter_manager_stress_detector_get_baseline_latency
+                                                                        (MilterManagerStressDetector *detector);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_STRESS_DETECTOR_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,473 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter/core.h>
+#include "milter-manager-verdict-cache.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define KEY_SIZE 256
+#define N_PROBES 8
+#define MAX_LOCK_SPINS 1000
+
+#define MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(obj)                   \
+    (G_TYPE_INSTANCE_GET_PRIVATE((obj),                                 \
+                                 MILTER_TYPE_MANAGER_VERDICT_CACHE,     \
+                                 MilterManagerVerdictCachePrivate))
+
+typedef struct _Entry Entry;
+struct _Entry
+{
+    guint hash;
+    gint status;
+    gdouble expire_at;
+    gchar key[KEY_SIZE];
+};
+
+/*
+ * This is placed in shared memory. An entry whose status is
+ * MILTER_STATUS_DEFAULT is empty.
+ */
+typedef struct _Table Table;
+struct _Table
+{
+    volatile gint lock; /* the PID of the owner or 0 */
+    volatile gint n_hits;
+    volatile gint n_misses;
+    guint n_entries;
+    Entry entries[1];
+};
+
+typedef struct _MilterManagerVerdictCachePrivate MilterManagerVerdictCachePrivate;
+struct _MilterManagerVerdictCachePrivate
+{
+    gchar *name;
+    gdouble ttl;
+    Table *table;
+    gsize table_size;
+    gboolean shared;
+};
+
+G_DEFINE_TYPE(MilterManagerVerdictCache,
+              milter_manager_verdict_cache,
+              G_TYPE_OBJECT)
+
+static void dispose        (GObject         *object);
+
+static void
+milter_manager_verdict_cache_class_init (MilterManagerVerdictCacheClass *klass)
+{
+    GObjectClass *gobject_class;
+
+    gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->dispose      = dispose;
+
+    g_type_class_add_private(gobject_class,
+                             sizeof(MilterManagerVerdictCachePrivate));
+}
+
+static void
+milter_manager_verdict_cache_init (MilterManagerVerdictCache *cache)
+{
+    MilterManagerVerdictCachePrivate *priv;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    priv->name = NULL;
+    priv->ttl = MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL;
+    priv->table = NULL;
+    priv->table_size = 0;
+    priv->shared = FALSE;
+}
+
+static void
+dispose (GObject *object)
+{
+    MilterManagerVerdictCachePrivate *priv;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(object);
+
+    if (priv->name) {
+        g_free(priv->name);
+        priv->name = NULL;
+    }
+
+    if (priv->table) {
+        if (priv->shared)
+            munmap(priv->table, priv->table_size);
+        else
+            g_free(priv->table);
+        priv->table = NULL;
+    }
+
+    G_OBJECT_CLASS(milter_manager_verdict_cache_parent_class)->dispose(object);
+}
+
+MilterManagerVerdictCache *
+milter_manager_verdict_cache_new (const gchar *name, guint size)
+{
+    MilterManagerVerdictCache *cache;
+    MilterManagerVerdictCachePrivate *priv;
+    gpointer table;
+
+    cache = g_object_new(MILTER_TYPE_MANAGER_VERDICT_CACHE, NULL);
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    priv->name = g_strdup(name);
+
+    size = MAX(size, 1);
+    priv->table_size = sizeof(Table) + sizeof(Entry) * (size - 1);
+    table = mmap(NULL, priv->table_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        milter_warning("[verdict-cache][%s][mmap][fallback] %s",
+                       name ? name : "(null)", g_strerror(errno));
+        table = g_malloc0(priv->table_size);
+    } else {
+        priv->shared = TRUE;
+    }
+    priv->table = table;
+    priv->table->n_entries = size;
+
+    return cache;
+}
+
+guint
+milter_manager_verdict_cache_get_size (MilterManagerVerdictCache *cache)
+{
+    return MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache)->table->n_entries;
+}
+
+void
+milter_manager_verdict_cache_set_ttl (MilterManagerVerdictCache *cache,
+                                      gdouble ttl)
+{
+    MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache)->ttl = ttl;
+}
+
+gdouble
+milter_manager_verdict_cache_get_ttl (MilterManagerVerdictCache *cache)
+{
+    return MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache)->ttl;
+}
+
+/*
+ * Wall-clock time is used because the entries are shared
+ * with other processes.
+ */
+static gdouble
+get_now (void)
+{
+    GTimeVal now;
+
+    g_get_current_time(&now);
+    return now.tv_sec + now.tv_usec / (gdouble)G_USEC_PER_SEC;
+}
+
+static void
+clear_entries (Table *table)
+{
+    guint i;
+
+    for (i = 0; i < table->n_entries; i++) {
+        table->entries[i].status = MILTER_STATUS_DEFAULT;
+    }
+}
+
+/*
+ * The lock word has the PID of the owner. If the owner
+ * died while it locked the table, the lock is taken over
+ * and the entries are cleared because they may be
+ * half-written. A live owner that holds the lock too long
+ * makes us give up instead.
+ */
+static gboolean
+lock_table (MilterManagerVerdictCachePrivate *priv)
+{
+    Table *table;
+    gint pid, owner;
+    guint i;
+
+    table = priv->table;
+    pid = getpid();
+    for (i = 0; i < MAX_LOCK_SPINS; i++) {
+        if (g_atomic_int_compare_and_exchange(&(table->lock), 0, pid))
+            return TRUE;
+        sched_yield();
+    }
+
+    owner = g_atomic_int_get(&(table->lock));
+    if (owner == 0)
+        return g_atomic_int_compare_and_exchange(&(table->lock), 0, pid);
+    if (owner == pid)
+        return FALSE;
+    if (kill(owner, 0) == 0 || errno != ESRCH)
+        return FALSE;
+    if (!g_atomic_int_compare_and_exchange(&(table->lock), owner, pid))
+        return FALSE;
+
+    milter_warning("[verdict-cache][%s][lock][take-over] "
+                   "the owner died while it locked: <%d>",
+                   priv->name ? priv->name : "(null)", owner);
+    clear_entries(table);
+    return TRUE;
+}
+
+static void
+unlock_table (MilterManagerVerdictCachePrivate *priv)
+{
+    g_atomic_int_set(&(priv->table->lock), 0);
+}
+
+static gboolean
+build_key (gchar *key,
+           struct sockaddr *address,
+           socklen_t address_length,
+           const gchar *helo)
+{
+    gchar host[INET6_ADDRSTRLEN];
+    gint length;
+
+    if (!address)
+        return FALSE;
+
+    switch (address->sa_family) {
+    case AF_INET:
+        if (address_length < sizeof(struct sockaddr_in))
+            return FALSE;
+        if (!inet_ntop(AF_INET,
+                       &(((struct sockaddr_in *)address)->sin_addr),
+                       host, sizeof(host)))
+            return FALSE;
+        break;
+    case AF_INET6:
+        if (address_length < sizeof(struct sockaddr_in6))
+            return FALSE;
+        if (!inet_ntop(AF_INET6,
+                       &(((struct sockaddr_in6 *)address)->sin6_addr),
+                       host, sizeof(host)))
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    if (helo)
+        length = g_snprintf(key, KEY_SIZE, "%s\n%s", host, helo);
+    else
+        length = g_snprintf(key, KEY_SIZE, "%s", host);
+
+    return length < KEY_SIZE;
+}
+
+static Entry *
+find_entry (Table *table, guint hash, const gchar *key, gdouble now)
+{
+    guint i;
+
+    for (i = 0; i < N_PROBES && i < table->n_entries; i++) {
+        Entry *entry;
+
+        entry = &(table->entries[(hash + i) % table->n_entries]);
+        if (entry->status == MILTER_STATUS_DEFAULT)
+            continue;
+        if (entry->hash != hash || strcmp(entry->key, key) != 0)
+            continue;
+        if (entry->expire_at <= now)
+            return NULL;
+        return entry;
+    }
+
+    return NULL;
+}
+
+/*
+ * Uses the same key's entry, an empty or expired entry or
+ * the entry that expires first in the probed range.
+ */
+static Entry *
+find_free_entry (Table *table, guint hash, const gchar *key, gdouble now)
+{
+    Entry *victim = NULL;
+    guint i;
+
+    for (i = 0; i < N_PROBES && i < table->n_entries; i++) {
+        Entry *entry;
+
+        entry = &(table->entries[(hash + i) % table->n_entries]);
+        if (entry->status == MILTER_STATUS_DEFAULT ||
+            entry->expire_at <= now)
+            return entry;
+        if (entry->hash == hash && strcmp(entry->key, key) == 0)
+            return entry;
+        if (!victim || entry->expire_at < victim->expire_at)
+            victim = entry;
+    }
+
+    return victim;
+}
+
+MilterStatus
+milter_manager_verdict_cache_lookup_key (MilterManagerVerdictCache *cache,
+                                         const gchar *key)
+{
+    MilterManagerVerdictCachePrivate *priv;
+    MilterStatus status = MILTER_STATUS_NOT_CHANGE;
+    guint hash;
+    Entry *entry;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    if (strlen(key) >= KEY_SIZE)
+        return MILTER_STATUS_NOT_CHANGE;
+
+    hash = g_str_hash(key);
+    if (!lock_table(priv))
+        return MILTER_STATUS_NOT_CHANGE;
+    entry = find_entry(priv->table, hash, key, get_now());
+    if (entry)
+        status = entry->status;
+    unlock_table(priv);
+
+    if (status == MILTER_STATUS_NOT_CHANGE) {
+        g_atomic_int_inc(&(priv->table->n_misses));
+    } else {
+        g_atomic_int_inc(&(priv->table->n_hits));
+    }
+
+    return status;
+}
+
+void
+milter_manager_verdict_cache_store_key (MilterManagerVerdictCache *cache,
+                                        const gchar *key,
+                                        MilterStatus status)
+{
+    MilterManagerVerdictCachePrivate *priv;
+    guint hash;
+    gdouble now;
+    Entry *entry;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    if (priv->ttl <= 0 ||
+        status == MILTER_STATUS_DEFAULT ||
+        status == MILTER_STATUS_NOT_CHANGE)
+        return;
+    if (strlen(key) >= KEY_SIZE)
+        return;
+
+    hash = g_str_hash(key);
+    now = get_now();
+    if (!lock_table(priv))
+        return;
+    entry = find_free_entry(priv->table, hash, key, now);
+    entry->hash = hash;
+    entry->status = status;
+    entry->expire_at = now + priv->ttl;
+    strcpy(entry->key, key);
+    unlock_table(priv);
+}
+
+MilterStatus
+milter_manager_verdict_cache_lookup (MilterManagerVerdictCache *cache,
+                                     struct sockaddr *address,
+                                     socklen_t address_length,
+                                     const gchar *helo)
+{
+    gchar key[KEY_SIZE];
+
+    if (!build_key(key, address, address_length, helo))
+        return MILTER_STATUS_NOT_CHANGE;
+
+    return milter_manager_verdict_cache_lookup_key(cache, key);
+}
+
+void
+milter_manager_verdict_cache_store (MilterManagerVerdictCache *cache,
+                                    struct sockaddr *address,
+                                    socklen_t address_length,
+                                    const gchar *helo,
+                                    MilterStatus status)
+{
+    gchar key[KEY_SIZE];
+
+    if (!build_key(key, address, address_length, helo))
+        return;
+
+    milter_manager_verdict_cache_store_key(cache, key, status);
+}
+
+void
+milter_manager_verdict_cache_clear (MilterManagerVerdictCache *cache)
+{
+    MilterManagerVerdictCachePrivate *priv;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    if (!lock_table(priv))
+        return;
+    clear_entries(priv->table);
+    unlock_table(priv);
+}
+
+gboolean
+milter_manager_verdict_cache_lock (MilterManagerVerdictCache *cache)
+{
+    return lock_table(MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache));
+}
+
+void
+milter_manager_verdict_cache_unlock (MilterManagerVerdictCache *cache)
+{
+    unlock_table(MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache));
+}
+
+guint
+milter_manager_verdict_cache_get_n_hits (MilterManagerVerdictCache *cache)
+{
+    MilterManagerVerdictCachePrivate *priv;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    return g_atomic_int_get(&(priv->table->n_hits));
+}
+
+guint
+milter_manager_verdict_cache_get_n_misses (MilterManagerVerdictCache *cache)
+{
+    MilterManagerVerdictCachePrivate *priv;
+
+    priv = MILTER_MANAGER_VERDICT_CACHE_GET_PRIVATE(cache);
+    return g_atomic_int_get(&(priv->table->n_misses));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,107 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_MANAGER_VERDICT_CACHE_H__
+#define __MILTER_MANAGER_VERDICT_CACHE_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <glib-object.h>
+#include <milter/core/milter-protocol.h>
+
+G_BEGIN_DECLS
+
+#define MILTER_MANAGER_VERDICT_CACHE_DEFAULT_TTL 60.0
+
+#define MILTER_TYPE_MANAGER_VERDICT_CACHE            (milter_manager_verdict_cache_get_type())
+#define MILTER_MANAGER_VERDICT_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), MILTER_TYPE_MANAGER_VERDICT_CACHE, MilterManagerVerdictCache))
+#define MILTER_MANAGER_VERDICT_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), MILTER_TYPE_MANAGER_VERDICT_CACHE, MilterManagerVerdictCacheClass))
+#define MILTER_MANAGER_IS_VERDICT_CACHE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), MILTER_TYPE_MANAGER_VERDICT_CACHE))
+#define MILTER_MANAGER_IS_VERDICT_CACHE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), MILTER_TYPE_MANAGER_VERDICT_CACHE))
+#define MILTER_MANAGER_VERDICT_CACHE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), MILTER_TYPE_MANAGER_VERDICT_CACHE, MilterManagerVerdictCacheClass))
+
+typedef struct _MilterManagerVerdictCache         MilterManagerVerdictCache;
+typedef struct _MilterManagerVerdictCacheClass    MilterManagerVerdictCacheClass;
+
+struct _MilterManagerVerdictCache
+{
+    GObject object;
+};
+
+struct _MilterManagerVerdictCacheClass
+{
+    GObjectClass parent_class;
+};
+
+GType                      milter_manager_verdict_cache_get_type    (void) G_GNUC_CONST;
+
+/*
+ * Creates a cache of verdicts that has @size entries. The
+ * entries are placed in anonymous shared memory. So
+ * processes forked after the cache is created share them.
+ */
+MilterManagerVerdictCache *milter_manager_verdict_cache_new         (const gchar *name,
+                                                                     guint        size);
+
+guint                      milter_manager_verdict_cache_get_size    (MilterManagerVerdictCache *cache);
+void                       milter_manager_verdict_cache_set_ttl     (MilterManagerVerdictCache *cache,
+                                                                     gdouble                    ttl);
+gdouble                    milter_manager_verdict_cache_get_ttl     (MilterManagerVerdictCache *cache);
+
+/*
+ * Returns the cached verdict for the SMTP client. @helo is
+ * NULL for CONNECT. MILTER_STATUS_NOT_CHANGE is returned
+ * if there is no valid verdict.
+ */
+MilterStatus               milter_manager_verdict_cache_lookup      (MilterManagerVerdictCache *cache,
+                                                                     struct sockaddr           *address,
+                                                                     socklen_t                  address_length,
+                                                                     const gchar               *helo);
+void                       milter_manager_verdict_cache_store       (MilterManagerVerdictCache *cache,
+                                                                     struct sockaddr           *address,
+                                                                     socklen_t                  address_length,
+                                                                     const gchar               *helo,
+                                                                     MilterStatus               status);
+/*
+ * Same as milter_manager_verdict_cache_lookup() and
+ * milter_manager_verdict_cache_store() but use @key as
+ * is. Keys must be shorter than 256 bytes.
+ */
+MilterStatus               milter_manager_verdict_cache_lookup_key  (MilterManagerVerdictCache *cache,
+                                                                     const gchar               *key);
+void                       milter_manager_verdict_cache_store_key   (MilterManagerVerdictCache *cache,
+                                                                     const gchar               *key,
+                                                                     MilterStatus               status);
+void                       milter_manager_verdict_cache_clear       (MilterManagerVerdictCache *cache);
+
+guint                      milter_manager_verdict_cache_get_n_hits  (MilterManagerVerdictCache *cache);
+guint                      milter_manager_verdict_cache_get_n_misses
+                                                                    (MilterManagerVerdictCache *cache);
+
+/* private */
+gboolean                   milter_manager_verdict_cache_lock        (MilterManagerVerdictCache *cache);
+void                       milter_manager_verdict_cache_unlock      (MilterManagerVerdictCache *cache);
+
+G_END_DECLS
+
+#endif /* __MILTER_MANAGER_VERDICT_CACHE_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
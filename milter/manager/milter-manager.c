@@ -28,6 +28,8 @@
 #include <signal.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include "milter-manager.h"
 #include "milter-manager-leader.h"
@@ -42,22 +44,45 @@ struct _MilterManagerPrivate
 {
     MilterManagerConfiguration *configuration;
     GList *leaders;
-    GList *next_connection_checked_leader;
-    gboolean connection_checking;
 
     GIOChannel *launcher_read_channel;
     GIOChannel *launcher_write_channel;
 
-    guint periodical_connection_checker_id;
-    guint current_periodical_connection_check_interval;
-
     GList *finished_leaders;
 
     gboolean is_custom_n_workers;
     gboolean is_custom_run_as_daemon;
     gboolean is_custom_max_pending_finished_sessions;
+
+    MilterEventLoop *stress_check_loop;
+    guint stress_check_id;
+    GTimer *stress_check_timer;
+    gdouble stress_check_cpu_time;
+
+    MilterEventLoop *maintain_loop;
+    guint maintain_idle_id;
+    guint maintain_timeout_id;
+
+    GMutex *io_threads_mutex;
+    GList *io_thread_configurations;
+    GList *retired_configurations;
+    GHashTable *configuration_users;
 };
 
+/*
+ * Each I/O thread uses its own copy of the configuration.
+ * The copy is made in the main thread because creating a
+ * configuration runs Ruby.
+ */
+typedef struct _IOThreadConfiguration
+{
+    MilterEventLoop *loop;
+    MilterManagerConfiguration *configuration;
+    guint lag_check_id;
+    GTimer *lag_timer;
+    gint lag_usec;
+} IOThreadConfiguration;
+
 enum
 {
     PROP_0,
@@ -97,6 +122,17 @@ static void   set_suspend_time_on_unacceptable
 static guint  get_max_connections         (MilterClient *client);
 static void   set_max_connections         (MilterClient *client,
                                            guint         max_connections);
+static gboolean is_adaptive_max_connections
+                                          (MilterClient *client);
+static void   set_adaptive_max_connections
+                                          (MilterClient *client,
+                                           gboolean      adaptive);
+static gboolean is_reuse_port             (MilterClient *client);
+static void   set_reuse_port              (MilterClient *client,
+                                           gboolean      reuse_port);
+static gboolean is_pin_workers            (MilterClient *client);
+static void   set_pin_workers             (MilterClient *client,
+                                           gboolean      pin_workers);
 static const gchar *get_effective_user    (MilterClient *client);
 static void         set_effective_user    (MilterClient *client,
                                            const gchar  *effective_user);
@@ -140,6 +176,11 @@ static void   set_max_pending_finished_sessions
 static void   workers_created             (MilterClient *client,
                                            guint         n_workers);
 static void   worker_created              (MilterClient *client);
+static guint  get_n_io_threads            (MilterClient *client);
+static void   set_n_io_threads            (MilterClient *client,
+                                           guint         n_io_threads);
+static void   io_thread_created           (MilterClient *client,
+                                           MilterEventLoop *loop);
 
 static void
 milter_manager_class_init (MilterManagerClass *klass)
@@ -167,6 +208,12 @@ milter_manager_class_init (MilterManagerClass *klass)
     client_class->set_suspend_time_on_unacceptable = set_suspend_time_on_unacceptable;
     client_class->get_max_connections = get_max_connections;
     client_class->set_max_connections = set_max_connections;
+    client_class->is_adaptive_max_connections = is_adaptive_max_connections;
+    client_class->set_adaptive_max_connections = set_adaptive_max_connections;
+    client_class->is_reuse_port = is_reuse_port;
+    client_class->set_reuse_port = set_reuse_port;
+    client_class->is_pin_workers = is_pin_workers;
+    client_class->set_pin_workers = set_pin_workers;
     client_class->get_effective_user = get_effective_user;
     client_class->set_effective_user = set_effective_user;
     client_class->get_effective_group = get_effective_group;
@@ -195,6 +242,9 @@ milter_manager_class_init (MilterManagerClass *klass)
         set_max_pending_finished_sessions;
     client_class->workers_created = workers_created;
     client_class->worker_created = worker_created;
+    client_class->get_n_io_threads = get_n_io_threads;
+    client_class->set_n_io_threads = set_n_io_threads;
+    client_class->io_thread_created = io_thread_created;
 
     spec = g_param_spec_object("configuration",
                                "Configuration",
@@ -216,16 +266,26 @@ milter_manager_init (MilterManager *manager)
 
     priv->configuration = NULL;
     priv->leaders = NULL;
-    priv->next_connection_checked_leader = NULL;
-    priv->connection_checking = FALSE;
 
     priv->launcher_read_channel = NULL;
     priv->launcher_write_channel = NULL;
 
-    priv->periodical_connection_checker_id = 0;
-    priv->current_periodical_connection_check_interval = 0;
-
     priv->finished_leaders = NULL;
+
+    priv->stress_check_loop = NULL;
+    priv->stress_check_id = 0;
+    priv->stress_check_timer = NULL;
+    priv->stress_check_cpu_time = 0.0;
+
+    priv->maintain_loop = NULL;
+    priv->maintain_idle_id = 0;
+    priv->maintain_timeout_id = 0;
+
+    priv->io_threads_mutex = g_mutex_new();
+    priv->io_thread_configurations = NULL;
+    priv->retired_configurations = NULL;
+    priv->configuration_users = g_hash_table_new(g_direct_hash,
+                                                 g_direct_equal);
 }
 
 static void
@@ -235,23 +295,6 @@ configuration_set_manager (MilterManagerConfiguration *configuration,
     g_object_set_data(G_OBJECT(configuration), "manager", manager);
 }
 
-static void
-dispose_periodical_connection_checker (MilterManager *manager)
-{
-    MilterManagerPrivate *priv;
-    MilterEventLoop *loop;
-
-    priv = MILTER_MANAGER_GET_PRIVATE(manager);
-    priv->current_periodical_connection_check_interval = 0;
-
-    if (priv->periodical_connection_checker_id == 0)
-        return;
-
-    loop = milter_client_get_event_loop(MILTER_CLIENT(manager));
-    milter_event_loop_remove(loop, priv->periodical_connection_checker_id);
-    priv->periodical_connection_checker_id = 0;
-}
-
 static void
 dispose_finished_leaders (MilterManagerPrivate *priv)
 {
@@ -272,6 +315,102 @@ dispose_finished_leaders (MilterManagerPrivate *priv)
     milter_debug("[manager][dispose][leaders] %u", n_leaders);
 }
 
+static void
+stop_stress_check (MilterManagerPrivate *priv)
+{
+    if (priv->stress_check_id > 0) {
+        milter_event_loop_remove(priv->stress_check_loop,
+                                 priv->stress_check_id);
+        priv->stress_check_id = 0;
+    }
+    priv->stress_check_loop = NULL;
+
+    if (priv->stress_check_timer) {
+        g_timer_destroy(priv->stress_check_timer);
+        priv->stress_check_timer = NULL;
+    }
+}
+
+static void
+cancel_maintain (MilterManagerPrivate *priv)
+{
+    if (priv->maintain_idle_id > 0) {
+        milter_event_loop_remove(priv->maintain_loop, priv->maintain_idle_id);
+        priv->maintain_idle_id = 0;
+    }
+
+    if (priv->maintain_timeout_id > 0) {
+        milter_event_loop_remove(priv->maintain_loop,
+                                 priv->maintain_timeout_id);
+        priv->maintain_timeout_id = 0;
+    }
+
+    priv->maintain_loop = NULL;
+}
+
+static void
+io_thread_configuration_free (IOThreadConfiguration *data)
+{
+    if (data->lag_check_id > 0)
+        milter_event_loop_remove(data->loop, data->lag_check_id);
+    if (data->lag_timer)
+        g_timer_destroy(data->lag_timer);
+    g_object_unref(data->loop);
+    g_object_unref(data->configuration);
+    g_free(data);
+}
+
+/*
+ * Retired configurations may still be used by leaders in
+ * I/O threads. configuration_users counts the leaders for
+ * each configuration. Retired configurations are released
+ * in the main thread after all their leaders finish.
+ */
+static void
+release_retired_configurations (MilterManagerPrivate *priv)
+{
+    GList *node, *next, *released = NULL;
+
+    g_mutex_lock(priv->io_threads_mutex);
+    for (node = priv->retired_configurations; node; node = next) {
+        MilterManagerConfiguration *configuration = node->data;
+
+        next = g_list_next(node);
+        if (g_hash_table_lookup(priv->configuration_users, configuration))
+            continue;
+        released = g_list_prepend(released, configuration);
+        priv->retired_configurations =
+            g_list_delete_link(priv->retired_configurations, node);
+    }
+    g_mutex_unlock(priv->io_threads_mutex);
+
+    g_list_foreach(released, (GFunc)g_object_unref, NULL);
+    g_list_free(released);
+}
+
+static void
+dispose_io_thread_configurations (MilterManagerPrivate *priv)
+{
+    if (priv->io_thread_configurations) {
+        g_list_foreach(priv->io_thread_configurations,
+                       (GFunc)io_thread_configuration_free, NULL);
+        g_list_free(priv->io_thread_configurations);
+        priv->io_thread_configurations = NULL;
+    }
+
+    if (priv->retired_configurations) {
+        g_list_foreach(priv->retired_configurations,
+                       (GFunc)g_object_unref, NULL);
+        g_list_free(priv->retired_configurations);
+        priv->retired_configurations = NULL;
+    }
+
+    if (priv->configuration_users) {
+        g_hash_table_unref(priv->configuration_users);
+        priv->configuration_users = NULL;
+    }
+}
+
 static void
 dispose (GObject *object)
 {
@@ -281,8 +420,15 @@ dispose (GObject *object)
     manager = MILTER_MANAGER(object);
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
-    dispose_periodical_connection_checker(manager);
+    cancel_maintain(priv);
+    stop_stress_check(priv);
     dispose_finished_leaders(priv);
+    dispose_io_thread_configurations(priv);
+
+    if (priv->io_threads_mutex) {
+        g_mutex_free(priv->io_threads_mutex);
+        priv->io_threads_mutex = NULL;
+    }
 
     if (priv->configuration) {
         configuration_set_manager(priv->configuration, NULL);
@@ -294,7 +440,6 @@ dispose (GObject *object)
         g_list_free(priv->leaders);
         priv->leaders = NULL;
     }
-    priv->next_connection_checked_leader = NULL;
 
     milter_manager_set_launcher_channel(MILTER_MANAGER(object), NULL, NULL);
 
@@ -360,70 +505,6 @@ milter_manager_new (MilterManagerConfiguration *configuration)
                         NULL);
 }
 
-static gboolean
-connection_check (gpointer data)
-{
-    MilterManager *manager = data;
-    MilterManagerPrivate *priv;
-    GList *node, *next_node;
-    guint i;
-    guint n_leaders_per_connection_check = 30; /* FIXME: make customizable */
-
-    priv = MILTER_MANAGER_GET_PRIVATE(manager);
-
-    priv->connection_checking = TRUE;
-
-    if (!priv->next_connection_checked_leader)
-        priv->next_connection_checked_leader = priv->leaders;
-    node = priv->next_connection_checked_leader;
-    i = 0;
-    while (node && i < n_leaders_per_connection_check) {
-        MilterManagerLeader *leader = node->data;
-        next_node = g_list_next(node);
-        if (!milter_manager_leader_check_connection(leader)) {
-            priv->leaders = g_list_delete_link(priv->leaders, node);
-        }
-        node = next_node;
-        i++;
-    }
-    priv->next_connection_checked_leader = node;
-
-    priv->connection_checking = FALSE;
-
-    return priv->leaders != NULL;
-}
-
-static void
-start_periodical_connection_checker (MilterManager *manager)
-{
-    MilterManagerPrivate *priv;
-    guint interval;
-
-    priv = MILTER_MANAGER_GET_PRIVATE(manager);
-
-    interval = milter_manager_configuration_get_connection_check_interval(priv->configuration);
-
-    if (interval > 0) {
-        if (priv->periodical_connection_checker_id == 0 ||
-            interval != priv->current_periodical_connection_check_interval) {
-            MilterEventLoop *loop;
-            milter_debug("[manager][connection-check][start] <%u> -> <%u>: %s",
-                         priv->current_periodical_connection_check_interval,
-                         interval,
-                         priv->periodical_connection_checker_id == 0 ?
-                         "initial" : "update");
-            dispose_periodical_connection_checker(manager);
-            priv->current_periodical_connection_check_interval = interval;
-            loop = milter_client_get_event_loop(MILTER_CLIENT(manager));
-            priv->periodical_connection_checker_id =
-                milter_event_loop_add_timeout(loop, interval,
-                                              connection_check, manager);
-        }
-    } else {
-        dispose_periodical_connection_checker(manager);
-    }
-}
-
 static MilterStatus
 cb_client_negotiate (MilterClientContext *context, MilterOption *option,
                      MilterMacrosRequests *macros_requests, gpointer user_data)
@@ -694,6 +775,9 @@ typedef struct _LeaderFinishData
 {
     MilterManager *manager;
     MilterClientContext *client_context;
+    MilterManagerConfiguration *configuration;
+    MilterEventLoop *io_thread_loop;
+    GTimer *timer;
 } LeaderFinishData;
 
 static void
@@ -729,6 +813,44 @@ teardown_client_context_signals (MilterClientContext *context,
                                          finished_data);
 }
 
+typedef struct _IOThreadLeaderData
+{
+    MilterManager *manager;
+    MilterManagerLeader *leader;
+    MilterManagerConfiguration *configuration;
+} IOThreadLeaderData;
+
+static gboolean
+cb_idle_release_io_thread_leader (gpointer user_data)
+{
+    IOThreadLeaderData *data = user_data;
+    MilterManagerPrivate *priv;
+    guint n_users;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(data->manager);
+
+    /* The main thread keeps its own reference while the
+     * count isn't zero. So the configuration is never
+     * finalized in this thread. */
+    g_object_unref(data->leader);
+    g_object_unref(data->configuration);
+
+    g_mutex_lock(priv->io_threads_mutex);
+    n_users = GPOINTER_TO_UINT(g_hash_table_lookup(priv->configuration_users,
+                                                   data->configuration));
+    if (n_users > 1)
+        g_hash_table_insert(priv->configuration_users,
+                            data->configuration,
+                            GUINT_TO_POINTER(n_users - 1));
+    else
+        g_hash_table_remove(priv->configuration_users, data->configuration);
+    g_mutex_unlock(priv->io_threads_mutex);
+
+    g_free(data);
+
+    return FALSE;
+}
+
 static void
 cb_leader_finished (MilterFinishedEmittable *emittable, gpointer user_data)
 {
@@ -736,6 +858,7 @@ cb_leader_finished (MilterFinishedEmittable *emittable, gpointer user_data)
     MilterClientContext *client_context;
     MilterManagerLeader *leader;
     MilterManagerPrivate *priv;
+    MilterManagerStressDetector *detector;
 
     client_context = finish_data->client_context;
 
@@ -743,37 +866,97 @@ cb_leader_finished (MilterFinishedEmittable *emittable, gpointer user_data)
     teardown_client_context_signals(client_context, leader, finish_data);
 
     priv = MILTER_MANAGER_GET_PRIVATE(finish_data->manager);
-    if (!priv->connection_checking) {
-        GList *node;
-        node = g_list_find(priv->leaders, leader);
-        if (node) {
-            if (priv->next_connection_checked_leader == node)
-                priv->next_connection_checked_leader = g_list_next(node);
-            priv->leaders = g_list_delete_link(priv->leaders, node);
-        }
-        if (!priv->leaders) {
-            milter_debug("[manager][connection-check][dispose] no leaders");
-            dispose_periodical_connection_checker(finish_data->manager);
-        }
+    detector =
+        milter_manager_configuration_get_stress_detector(
+            finish_data->configuration);
+    if (detector)
+        milter_manager_stress_detector_record_latency(
+            detector, g_timer_elapsed(finish_data->timer, NULL));
+
+    if (finish_data->io_thread_loop) {
+        IOThreadLeaderData *data;
+
+        /* Leaders in I/O threads aren't visible from the main
+         * thread. They are released in their own thread. */
+        data = g_new(IOThreadLeaderData, 1);
+        data->manager = finish_data->manager;
+        data->leader = leader;
+        data->configuration = finish_data->configuration;
+        milter_event_loop_add_idle_full(finish_data->io_thread_loop,
+                                        G_PRIORITY_DEFAULT,
+                                        cb_idle_release_io_thread_leader,
+                                        data,
+                                        NULL);
+    } else {
+        priv->leaders = g_list_remove(priv->leaders, leader);
+        priv->finished_leaders = g_list_prepend(priv->finished_leaders, leader);
+        g_object_unref(finish_data->configuration);
     }
 
-    priv->finished_leaders = g_list_prepend(priv->finished_leaders, leader);
-
+    g_timer_destroy(finish_data->timer);
     g_free(finish_data);
 }
 
-static void
+static MilterManagerConfiguration *
+ref_io_thread_configuration (MilterManager *manager, MilterEventLoop *loop)
+{
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration = NULL;
+    GList *node;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    g_mutex_lock(priv->io_threads_mutex);
+    for (node = priv->io_thread_configurations; node; node = g_list_next(node)) {
+        IOThreadConfiguration *data = node->data;
+
+        if (data->loop == loop) {
+            guint n_users;
+
+            configuration = g_object_ref(data->configuration);
+            n_users =
+                GPOINTER_TO_UINT(g_hash_table_lookup(priv->configuration_users,
+                                                     configuration));
+            g_hash_table_insert(priv->configuration_users,
+                                configuration,
+                                GUINT_TO_POINTER(n_users + 1));
+            break;
+        }
+    }
+    g_mutex_unlock(priv->io_threads_mutex);
+
+    return configuration;
+}
+
+static gboolean
 setup_context_signals (MilterClientContext *context,
-                       MilterManager *manager)
+                       MilterManager *manager,
+                       MilterEventLoop *io_thread_loop)
 {
     MilterManagerLeader *leader;
     MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
     LeaderFinishData *finish_data;
 
     priv = MILTER_MANAGER_GET_PRIVATE(manager);
 
-    leader = milter_manager_leader_new(priv->configuration, context);
-    priv->leaders = g_list_prepend(priv->leaders, leader);
+    if (io_thread_loop) {
+        /* The main thread configuration must not be used
+         * from an I/O thread. */
+        configuration = ref_io_thread_configuration(manager, io_thread_loop);
+        if (!configuration) {
+            milter_error("[%u] [manager][io-thread][session][refuse] "
+                         "no configuration for the I/O thread",
+                         milter_agent_get_tag(MILTER_AGENT(context)));
+            milter_agent_shutdown(MILTER_AGENT(context));
+            return FALSE;
+        }
+    } else {
+        configuration = g_object_ref(priv->configuration);
+    }
+
+    leader = milter_manager_leader_new(configuration, context);
+    if (!io_thread_loop)
+        priv->leaders = g_list_prepend(priv->leaders, leader);
 
 #define CONNECT(name)                                   \
     g_signal_connect(context, #name,                    \
@@ -802,27 +985,139 @@ setup_context_signals (MilterClientContext *context,
     finish_data = g_new(LeaderFinishData, 1);
     finish_data->manager = manager;
     finish_data->client_context = context;
+    finish_data->configuration = configuration;
+    finish_data->io_thread_loop = io_thread_loop;
+    finish_data->timer = g_timer_new();
     g_signal_connect(leader, "finished",
                      G_CALLBACK(cb_leader_finished), finish_data);
     milter_manager_leader_set_launcher_channel(leader,
                                                priv->launcher_read_channel,
                                                priv->launcher_write_channel);
 
-    g_signal_emit_by_name(priv->configuration, "connected", leader);
+    g_signal_emit_by_name(configuration, "connected", leader);
+
+    return TRUE;
+}
+
+#define STRESS_CHECK_INTERVAL 1.0
+
+static gdouble
+get_cpu_time (void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+        return 0.0;
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+/* This is called in the I/O thread. */
+static gboolean
+cb_check_io_thread_lag (gpointer user_data)
+{
+    IOThreadConfiguration *data = user_data;
+    gdouble lag;
+
+    lag = g_timer_elapsed(data->lag_timer, NULL) - STRESS_CHECK_INTERVAL;
+    g_atomic_int_set(&(data->lag_usec), (gint)(MAX(lag, 0.0) * G_USEC_PER_SEC));
+    g_timer_start(data->lag_timer);
+
+    return TRUE;
+}
+
+static gboolean
+cb_check_stress (gpointer user_data)
+{
+    MilterManagerPrivate *priv;
+    MilterManagerStressDetector *detector;
+    gdouble elapsed, lag, cpu_time, cpu_usage;
+    GArray *lags;
+    GList *node;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(user_data);
+    detector =
+        milter_manager_configuration_get_stress_detector(priv->configuration);
+    if (!detector) {
+        priv->stress_check_id = 0;
+        stop_stress_check(priv);
+        return FALSE;
+    }
+
+    elapsed = g_timer_elapsed(priv->stress_check_timer, NULL);
+    /* The concurrency limiter measures the lag more often. */
+    if (milter_client_is_adaptive_max_connections(MILTER_CLIENT(user_data)))
+        lag = milter_client_get_event_loop_lag(MILTER_CLIENT(user_data));
+    else
+        lag = MAX(elapsed - STRESS_CHECK_INTERVAL, 0.0);
+    lags = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    g_array_append_val(lags, lag);
+    g_mutex_lock(priv->io_threads_mutex);
+    for (node = priv->io_thread_configurations; node; node = g_list_next(node)) {
+        IOThreadConfiguration *data = node->data;
+
+        lag = g_atomic_int_get(&(data->lag_usec)) / (gdouble)G_USEC_PER_SEC;
+        g_array_append_val(lags, lag);
+    }
+    g_mutex_unlock(priv->io_threads_mutex);
+
+    /* getrusage() counts the CPU time of all threads. */
+    cpu_time = get_cpu_time();
+    cpu_usage = 0.0;
+    if (elapsed > 0.0)
+        cpu_usage = (cpu_time - priv->stress_check_cpu_time) / elapsed;
+    milter_manager_stress_detector_update_loops(detector,
+                                                (gdouble *)lags->data,
+                                                lags->len,
+                                                cpu_usage);
+    g_array_free(lags, TRUE);
+
+    priv->stress_check_cpu_time = cpu_time;
+    g_timer_start(priv->stress_check_timer);
+
+    return TRUE;
+}
+
+static void
+start_stress_check (MilterManager *manager)
+{
+    MilterManagerPrivate *priv;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    if (priv->stress_check_id > 0)
+        return;
+    if (!milter_manager_configuration_get_stress_detector(priv->configuration))
+        return;
+
+    priv->stress_check_loop = milter_client_get_event_loop(MILTER_CLIENT(manager));
+    priv->stress_check_timer = g_timer_new();
+    priv->stress_check_cpu_time = get_cpu_time();
+    priv->stress_check_id =
+        milter_event_loop_add_timeout(priv->stress_check_loop,
+                                      STRESS_CHECK_INTERVAL,
+                                      cb_check_stress,
+                                      manager);
 }
 
 static void
 connection_established (MilterClient *client, MilterClientContext *context)
 {
-    MilterManager *manager;
+    MilterEventLoop *loop;
+    gboolean success;
 
-    manager = MILTER_MANAGER(client);
-    setup_context_signals(context, MILTER_MANAGER(client));
+    loop = milter_agent_get_event_loop(MILTER_AGENT(context));
+    if (loop == milter_client_get_event_loop(client)) {
+        start_stress_check(MILTER_MANAGER(client));
+        success = setup_context_signals(context, MILTER_MANAGER(client), NULL);
+    } else {
+        success = setup_context_signals(context, MILTER_MANAGER(client), loop);
+    }
+    if (!success)
+        return;
 
     milter_debug("[%u] [manager][session][start]",
                  milter_agent_get_tag(MILTER_AGENT(context)));
-
-    start_periodical_connection_checker(manager);
 }
 
 static const gchar *
@@ -1016,6 +1311,85 @@ set_max_connections (MilterClient *client, guint max_connections)
                                                      max_connections);
 }
 
+static gboolean
+is_adaptive_max_connections (MilterClient *client)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    return milter_manager_configuration_is_adaptive_max_connections(configuration);
+}
+
+static void
+set_adaptive_max_connections (MilterClient *client, gboolean adaptive)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    milter_manager_configuration_set_adaptive_max_connections(configuration,
+                                                              adaptive);
+}
+
+static gboolean
+is_reuse_port (MilterClient *client)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    return milter_manager_configuration_is_reuse_port(configuration);
+}
+
+static void
+set_reuse_port (MilterClient *client, gboolean reuse_port)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    milter_manager_configuration_set_reuse_port(configuration, reuse_port);
+}
+
+static gboolean
+is_pin_workers (MilterClient *client)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    return milter_manager_configuration_is_pin_workers(configuration);
+}
+
+static void
+set_pin_workers (MilterClient *client, gboolean pin_workers)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = priv->configuration;
+    milter_manager_configuration_set_pin_workers(configuration, pin_workers);
+}
+
 static const gchar *
 get_effective_user (MilterClient *client)
 {
@@ -1188,15 +1562,82 @@ set_pid_file (MilterClient *client, const gchar *pid_file)
     milter_manager_configuration_set_pid_file(configuration, pid_file);
 }
 
+#define MAINTAIN_MAX_DELAY 1.0
+
 static void
-maintain (MilterClient *client)
+run_maintain (MilterManagerPrivate *priv)
+{
+    cancel_maintain(priv);
+
+    milter_debug("[manager][maintain][run]");
+    milter_manager_configuration_maintain(priv->configuration);
+}
+
+static gboolean
+cb_maintain_idle (gpointer user_data)
 {
     MilterManagerPrivate *priv;
 
-    milter_debug("[manager][maintain]");
+    priv = MILTER_MANAGER_GET_PRIVATE(user_data);
+    priv->maintain_idle_id = 0;
+    run_maintain(priv);
+
+    return FALSE;
+}
+
+static gboolean
+cb_maintain_timeout (gpointer user_data)
+{
+    MilterManagerPrivate *priv;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(user_data);
+    priv->maintain_timeout_id = 0;
+    run_maintain(priv);
+
+    return FALSE;
+}
+
+/*
+ * Maintenance runs configuration hooks such as Ruby's
+ * "maintained" hooks and a full Ruby GC. It is postponed
+ * until the event loop has no other ready events so that
+ * it doesn't run in the middle of a burst. It still runs
+ * in the loop thread, because Ruby must be called from
+ * there, so it still blocks sessions while it runs. The
+ * timeout bounds the delay when the loop is always busy.
+ */
+static void
+maintain (MilterClient *client)
+{
+    MilterManagerPrivate *priv;
+    MilterEventLoop *loop;
 
     priv = MILTER_MANAGER_GET_PRIVATE(client);
-    milter_manager_configuration_maintain(priv->configuration);
+    if (priv->maintain_idle_id > 0) {
+        milter_debug("[manager][maintain][pending]");
+        return;
+    }
+
+    loop = milter_client_get_event_loop(client);
+    if (!loop) {
+        milter_debug("[manager][maintain]");
+        milter_manager_configuration_maintain(priv->configuration);
+        return;
+    }
+
+    milter_debug("[manager][maintain][defer]");
+    priv->maintain_loop = loop;
+    priv->maintain_idle_id =
+        milter_event_loop_add_idle_full(loop,
+                                        G_PRIORITY_LOW,
+                                        cb_maintain_idle,
+                                        client,
+                                        NULL);
+    priv->maintain_timeout_id =
+        milter_event_loop_add_timeout(loop,
+                                      MAINTAIN_MAX_DELAY,
+                                      cb_maintain_timeout,
+                                      client);
 }
 
 static void
@@ -1208,6 +1649,7 @@ sessions_finished (MilterClient *client, guint n_finished_sessions)
 
     priv = MILTER_MANAGER_GET_PRIVATE(client);
     dispose_finished_leaders(priv);
+    release_retired_configurations(priv);
 }
 
 static void
@@ -1222,6 +1664,141 @@ event_loop_created (MilterClient *client, MilterEventLoop *loop)
                                                     loop);
 }
 
+static MilterManagerConfiguration *
+copy_io_thread_configuration (MilterManager *manager, GError **error)
+{
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+    configuration = milter_manager_configuration_copy(priv->configuration,
+                                                      error);
+    if (!configuration)
+        return NULL;
+
+    milter_manager_configuration_share_runtime_state(configuration,
+                                                     priv->configuration);
+    return configuration;
+}
+
+static void
+io_thread_created (MilterClient *client, MilterEventLoop *loop)
+{
+    MilterManager *manager;
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+    IOThreadConfiguration *data;
+    GError *error = NULL;
+
+    milter_debug("[manager][io-thread-created]");
+
+    manager = MILTER_MANAGER(client);
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    /* Sessions in I/O threads don't run on the main loop. */
+    start_stress_check(manager);
+
+    configuration = copy_io_thread_configuration(manager, &error);
+    if (!configuration) {
+        milter_error("[manager][io-thread][configuration][error] "
+                     "sessions in the I/O thread are refused: %s",
+                     error->message);
+        g_error_free(error);
+        return;
+    }
+
+    data = g_new(IOThreadConfiguration, 1);
+    data->loop = g_object_ref(loop);
+    data->configuration = configuration;
+    /* The loop isn't running yet. So the lag check can be
+     * added from the main thread. */
+    data->lag_timer = g_timer_new();
+    data->lag_usec = 0;
+    data->lag_check_id = milter_event_loop_add_timeout(loop,
+                                                       STRESS_CHECK_INTERVAL,
+                                                       cb_check_io_thread_lag,
+                                                       data);
+    g_mutex_lock(priv->io_threads_mutex);
+    priv->io_thread_configurations =
+        g_list_prepend(priv->io_thread_configurations, data);
+    g_mutex_unlock(priv->io_threads_mutex);
+}
+
+/*
+ * Configuration copies for I/O threads are made from the
+ * rebuilt configuration in the main thread without loading
+ * the configuration files again. They are swapped under
+ * the lock.
+ */
+static void
+rebuild_io_thread_configurations (MilterManager *manager)
+{
+    MilterManagerPrivate *priv;
+    GList *io_thread_configurations, *node;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    g_mutex_lock(priv->io_threads_mutex);
+    io_thread_configurations = g_list_copy(priv->io_thread_configurations);
+    g_mutex_unlock(priv->io_threads_mutex);
+
+    for (node = io_thread_configurations; node; node = g_list_next(node)) {
+        IOThreadConfiguration *data = node->data;
+        MilterManagerConfiguration *configuration;
+        GError *error = NULL;
+
+        configuration = copy_io_thread_configuration(manager, &error);
+        if (!configuration) {
+            milter_error("[manager][io-thread][configuration][rebuild][error] "
+                         "%s",
+                         error->message);
+            g_error_free(error);
+            continue;
+        }
+
+        g_mutex_lock(priv->io_threads_mutex);
+        priv->retired_configurations =
+            g_list_prepend(priv->retired_configurations, data->configuration);
+        data->configuration = configuration;
+        g_mutex_unlock(priv->io_threads_mutex);
+    }
+    g_list_free(io_thread_configurations);
+
+    release_retired_configurations(priv);
+}
+
+static guint
+get_n_io_threads (MilterClient *client)
+{
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+    guint n_io_threads;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(client);
+    configuration = priv->configuration;
+    n_io_threads = milter_manager_configuration_get_n_io_threads(configuration);
+    if (n_io_threads > 0 &&
+        !milter_manager_configuration_is_thread_safe(configuration)) {
+        milter_warning("[manager][io-threads][disabled] "
+                       "privilege mode or Ruby hooks for sessions "
+                       "such as applicable conditions written in Ruby "
+                       "need the main thread: <%u>",
+                       n_io_threads);
+        return 0;
+    }
+    return n_io_threads;
+}
+
+static void
+set_n_io_threads (MilterClient *client, guint n_io_threads)
+{
+    MilterManagerPrivate *priv;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(client);
+    milter_manager_configuration_set_n_io_threads(priv->configuration,
+                                                  n_io_threads);
+}
+
 static guint
 get_n_workers (MilterClient *client)
 {
@@ -1553,6 +2130,50 @@ milter_manager_reload (MilterManager *manager, GError **error)
     return success;
 }
 
+/*
+ * Unlike milter_manager_reload(), the current configuration
+ * isn't cleared. A new configuration is loaded and it
+ * replaces the current configuration only when it is
+ * loaded successfully. Leaders that are processing
+ * sessions keep using the old configuration until they
+ * finish. Runtime state such as circuit breakers, session
+ * limits and caches is taken over by the new
+ * configuration.
+ */
+gboolean
+milter_manager_rebuild_configuration (MilterManager *manager, GError **error)
+{
+    MilterManagerPrivate *priv;
+    MilterManagerConfiguration *configuration;
+    GTimer *timer;
+
+    priv = MILTER_MANAGER_GET_PRIVATE(manager);
+
+    timer = g_timer_new();
+    configuration = milter_manager_configuration_build(priv->configuration,
+                                                       error);
+    if (!configuration) {
+        g_timer_destroy(timer);
+        return FALSE;
+    }
+
+    milter_manager_configuration_share_runtime_state(configuration,
+                                                     priv->configuration);
+    g_object_set(manager, "configuration", configuration, NULL);
+    g_object_unref(configuration);
+    apply_syslog_parameters(manager);
+    apply_custom_parameters(manager);
+    rebuild_io_thread_configurations(manager);
+
+    milter_statistics("[manager][configuration][rebuild] "
+                      "elapsed=%g n-processing-leaders=%u",
+                      g_timer_elapsed(timer, NULL),
+                      g_list_length(priv->leaders));
+    g_timer_destroy(timer);
+
+    return TRUE;
+}
+
 void
 milter_manager_set_launcher_channel (MilterManager *manager,
                                      GIOChannel *read_channel,
@@ -54,10 +54,17 @@ GType                 milter_manager_get_type    (void) G_GNUC_CONST;
 MilterManager        *milter_manager_new         (MilterManagerConfiguration *configuration);
 
 MilterManagerConfiguration *milter_manager_get_configuration (MilterManager *manager);
+/*
+ * Leaders that are processing sessions in I/O threads
+ * aren't included.
+ */
 const GList          *milter_manager_get_leaders (MilterManager *manager);
 
 gboolean              milter_manager_reload      (MilterManager *manager,
                                                   GError       **error);
+gboolean              milter_manager_rebuild_configuration
+                                                 (MilterManager *manager,
+                                                  GError       **error);
 void                  milter_manager_set_launcher_channel
                                                  (MilterManager *manager,
                                                   GIOChannel *read_channel,
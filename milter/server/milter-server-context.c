@@ -61,6 +61,8 @@ enum
 
     STATE_TRANSITED,
 
+    LATENCY_OBSERVED,
+
     LAST_SIGNAL
 };
 
@@ -98,6 +100,10 @@ struct _MilterServerContextPrivate
     gdouble reading_timeout;
     gdouble end_of_message_timeout;
     guint timeout_id;
+    MilterServerContextTimeoutType timeout_type;
+    GTimer *timeout_elapsed;
+    gdouble deadline;
+    GTimer *deadline_timer;
     guint connect_watch_id;
 
     gboolean skip_body;
@@ -117,6 +123,19 @@ struct _MilterServerContextPrivate
     gchar *current_recipient;
 
     MilterMessageResult *message_result;
+
+    gboolean replay_recording;
+    GQueue *replay_commands;
+    GQueue *pending_replay_commands;
+};
+
+typedef struct _ReplayCommand ReplayCommand;
+struct _ReplayCommand
+{
+    MilterServerContextState state;
+    gchar *value;
+    struct sockaddr *address;
+    socklen_t address_length;
 };
 
 enum
@@ -445,6 +464,21 @@ milter_server_context_class_init (MilterServerContextClass *klass)
                      g_cclosure_marshal_VOID__ENUM,
                      G_TYPE_NONE, 1, MILTER_TYPE_SERVER_CONTEXT_STATE);
 
+    /*
+     * Emitted when a watched operation is completed before
+     * its timeout. elapsed is the seconds the operation
+     * took.
+     */
+    signals[LATENCY_OBSERVED] =
+        g_signal_new("latency-observed",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     G_STRUCT_OFFSET(MilterServerContextClass, latency_observed),
+                     NULL, NULL,
+                     _milter_marshal_VOID__ENUM_DOUBLE,
+                     G_TYPE_NONE, 2,
+                     MILTER_TYPE_SERVER_CONTEXT_TIMEOUT_TYPE, G_TYPE_DOUBLE);
+
     g_type_class_add_private(gobject_class, sizeof(MilterServerContextPrivate));
 }
 
@@ -474,6 +508,10 @@ milter_server_context_init (MilterServerContext *context)
     priv->sent_end_of_message = FALSE;
 
     priv->timeout_id = 0;
+    priv->timeout_type = MILTER_SERVER_CONTEXT_TIMEOUT_NONE;
+    priv->timeout_elapsed = g_timer_new();
+    priv->deadline = 0;
+    priv->deadline_timer = NULL;
     priv->connection_timeout = MILTER_SERVER_CONTEXT_DEFAULT_CONNECTION_TIMEOUT;
     priv->writing_timeout = MILTER_SERVER_CONTEXT_DEFAULT_WRITING_TIMEOUT;
     priv->reading_timeout = MILTER_SERVER_CONTEXT_DEFAULT_READING_TIMEOUT;
@@ -494,12 +532,146 @@ milter_server_context_init (MilterServerContext *context)
     priv->current_recipient = NULL;
 
     priv->message_result = NULL;
+
+    priv->replay_recording = FALSE;
+    priv->replay_commands = g_queue_new();
+    priv->pending_replay_commands = g_queue_new();
+}
+
+static ReplayCommand *
+replay_command_new (MilterServerContextState state,
+                    const gchar *value,
+                    const struct sockaddr *address,
+                    socklen_t address_length)
+{
+    ReplayCommand *command;
+
+    command = g_new0(ReplayCommand, 1);
+    command->state = state;
+    command->value = g_strdup(value);
+    if (address) {
+        command->address = g_memdup(address, address_length);
+        command->address_length = address_length;
+    }
+
+    return command;
+}
+
+static void
+replay_command_free (ReplayCommand *command)
+{
+    g_free(command->value);
+    g_free(command->address);
+    g_free(command);
+}
+
+/*
+ * Commands are recorded in state order. So commands of
+ * @state and later states are at the tail.
+ */
+static void
+forget_replay_commands (GQueue *commands, MilterServerContextState state)
+{
+    while (!g_queue_is_empty(commands)) {
+        ReplayCommand *command = g_queue_peek_tail(commands);
+
+        if (command->state < state)
+            break;
+        replay_command_free(g_queue_pop_tail(commands));
+    }
+}
+
+/*
+ * Records an envelope command to replay it on another
+ * context. A command drops the recorded commands of the
+ * same and later states because SMTP restarts from there.
+ */
+static void
+record_replay_command (MilterServerContext *context,
+                       MilterServerContextState state,
+                       const gchar *value,
+                       const struct sockaddr *address,
+                       socklen_t address_length)
+{
+    MilterServerContextPrivate *priv;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    if (!priv->replay_recording)
+        return;
+
+    if (state != MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT)
+        forget_replay_commands(priv->replay_commands, state);
+    g_queue_push_tail(priv->replay_commands,
+                      replay_command_new(state, value,
+                                         address, address_length));
+}
+
+/*
+ * A rejected recipient isn't replayed. SMTP doesn't add it
+ * to the envelope and replaying it would be rejected again.
+ */
+static void
+forget_replay_recipient (MilterServerContextPrivate *priv)
+{
+    GList *node;
+
+    if (!priv->current_recipient)
+        return;
+
+    for (node = priv->replay_commands->tail;
+         node;
+         node = g_list_previous(node)) {
+        ReplayCommand *command = node->data;
+
+        if (command->state != MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT)
+            break;
+        if (!g_str_equal(command->value, priv->current_recipient))
+            continue;
+        replay_command_free(command);
+        g_queue_delete_link(priv->replay_commands, node);
+        break;
+    }
+}
+
+static gdouble
+limit_timeout_by_deadline (MilterServerContext *context, gdouble timeout)
+{
+    MilterServerContextPrivate *priv;
+    gdouble rest;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    if (priv->deadline <= 0 || !priv->deadline_timer)
+        return timeout;
+
+    rest = priv->deadline - g_timer_elapsed(priv->deadline_timer, NULL);
+    if (rest < 0)
+        rest = 0;
+    return MIN(timeout, rest);
+}
+
+static void
+start_latency_observation (MilterServerContext *context,
+                           MilterServerContextTimeoutType type)
+{
+    MilterServerContextPrivate *priv;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    priv->timeout_type = type;
+    g_timer_start(priv->timeout_elapsed);
+}
+
+static void
+cancel_latency_observation (MilterServerContext *context)
+{
+    MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->timeout_type =
+        MILTER_SERVER_CONTEXT_TIMEOUT_NONE;
 }
 
 static void
 disable_timeout (MilterServerContext *context)
 {
     MilterServerContextPrivate *priv;
+    MilterServerContextTimeoutType observed_type;
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
     if (milter_need_debug_log()) {
@@ -512,12 +684,20 @@ disable_timeout (MilterServerContext *context)
                      priv->timeout_id,
                      context);
     }
+    observed_type = MILTER_SERVER_CONTEXT_TIMEOUT_NONE;
     if (priv->timeout_id > 0) {
         MilterEventLoop *loop;
         loop = milter_agent_get_event_loop(MILTER_AGENT(context));
         milter_event_loop_remove(loop, priv->timeout_id);
         priv->timeout_id = 0;
+        observed_type = priv->timeout_type;
     }
+    priv->timeout_type = MILTER_SERVER_CONTEXT_TIMEOUT_NONE;
+
+    if (observed_type != MILTER_SERVER_CONTEXT_TIMEOUT_NONE)
+        g_signal_emit(context, signals[LATENCY_OBSERVED], 0,
+                      observed_type,
+                      g_timer_elapsed(priv->timeout_elapsed, NULL));
 }
 
 static void
@@ -612,6 +792,7 @@ dispose (GObject *object)
                  NULL_SAFE_NAME(priv->name),
                  context);
 
+    cancel_latency_observation(context);
     disable_timeout(context);
     dispose_connect_watch(context);
     dispose_client_channel(priv);
@@ -660,6 +841,16 @@ dispose (GObject *object)
         priv->elapsed = NULL;
     }
 
+    if (priv->timeout_elapsed) {
+        g_timer_destroy(priv->timeout_elapsed);
+        priv->timeout_elapsed = NULL;
+    }
+
+    if (priv->deadline_timer) {
+        g_timer_destroy(priv->deadline_timer);
+        priv->deadline_timer = NULL;
+    }
+
     if (priv->current_recipient) {
         g_free(priv->current_recipient);
         priv->current_recipient = NULL;
@@ -667,6 +858,19 @@ dispose (GObject *object)
 
     dispose_message_result(priv);
 
+    if (priv->replay_commands) {
+        forget_replay_commands(priv->replay_commands,
+                               MILTER_SERVER_CONTEXT_STATE_INVALID);
+        g_queue_free(priv->replay_commands);
+        priv->replay_commands = NULL;
+    }
+    if (priv->pending_replay_commands) {
+        forget_replay_commands(priv->pending_replay_commands,
+                               MILTER_SERVER_CONTEXT_STATE_INVALID);
+        g_queue_free(priv->pending_replay_commands);
+        priv->pending_replay_commands = NULL;
+    }
+
     G_OBJECT_CLASS(milter_server_context_parent_class)->dispose(object);
 }
 
@@ -887,6 +1091,7 @@ cb_writing_timeout (gpointer data)
     MilterAgent *agent;
 
     agent = MILTER_AGENT(context);
+    cancel_latency_observation(context);
     if (milter_need_debug_log()) {
         MilterServerContextPrivate *priv;
         const gchar *name = NULL;
@@ -913,6 +1118,7 @@ cb_end_of_message_timeout (gpointer data)
     MilterAgent *agent;
 
     agent = MILTER_AGENT(context);
+    cancel_latency_observation(context);
     if (milter_need_debug_log()) {
         MilterServerContextPrivate *priv;
         const gchar *name = NULL;
@@ -939,6 +1145,7 @@ cb_reading_timeout (gpointer data)
     MilterAgent *agent;
 
     agent = MILTER_AGENT(context);
+    cancel_latency_observation(context);
     if (milter_need_debug_log()) {
         MilterServerContextPrivate *priv;
         const gchar *name = NULL;
@@ -1156,17 +1363,21 @@ reset_end_of_message_timeout (MilterServerContext *context)
     MilterAgent *agent;
     MilterEventLoop *loop;
     MilterServerContextPrivate *priv;
+    gdouble timeout;
 
     disable_timeout(context);
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
     agent = MILTER_AGENT(context);
     loop = milter_agent_get_event_loop(agent);
+    timeout = limit_timeout_by_deadline(context, priv->end_of_message_timeout);
     priv->timeout_id =
         milter_event_loop_add_timeout(loop,
-                                      priv->end_of_message_timeout,
+                                      timeout,
                                       cb_end_of_message_timeout,
                                       context);
+    start_latency_observation(context,
+                              MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE);
     if (milter_need_debug_log()) {
         const gchar *name;
 
@@ -1174,7 +1385,7 @@ reset_end_of_message_timeout (MilterServerContext *context)
         milter_debug("[%u] [server][timeout][end-of-message][registered][%g] "
                      "[%s] <%u> (%p)",
                      milter_agent_get_tag(agent),
-                     priv->end_of_message_timeout,
+                     timeout,
                      NULL_SAFE_NAME(name),
                      priv->timeout_id,
                      context);
@@ -1264,6 +1475,7 @@ process_next_state_body (MilterServerContext *context)
     const gchar *name = NULL;
     MilterServerContextState state = MILTER_SERVER_CONTEXT_STATE_BODY;
     MilterEventLoop *loop;
+    gdouble timeout;
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
@@ -1283,15 +1495,18 @@ process_next_state_body (MilterServerContext *context)
 
     disable_timeout(context);
     loop = milter_agent_get_event_loop(MILTER_AGENT(context));
+    timeout = limit_timeout_by_deadline(context, priv->reading_timeout);
     priv->timeout_id =
         milter_event_loop_add_timeout(loop,
-                                      priv->reading_timeout,
+                                      timeout,
                                       cb_reading_timeout,
                                       context);
+    start_latency_observation(context,
+                              MILTER_SERVER_CONTEXT_TIMEOUT_READING);
     milter_debug("[%u] [server][timeout][reading][registered][%g] "
                  "[%s] <%u> (%p)",
                  tag,
-                 priv->reading_timeout,
+                 timeout,
                  NULL_SAFE_NAME(name),
                  priv->timeout_id,
                  context);
@@ -1392,17 +1607,21 @@ process_next_state (MilterServerContext *context,
         milter_server_context_set_state(context, next_state);
         if (milter_server_context_need_reply(context, next_state)) {
             MilterEventLoop *loop;
+            gdouble timeout;
 
             loop = milter_agent_get_event_loop(agent);
+            timeout = limit_timeout_by_deadline(context, priv->reading_timeout);
             priv->timeout_id =
                 milter_event_loop_add_timeout(loop,
-                                              priv->reading_timeout,
+                                              timeout,
                                               cb_reading_timeout,
                                               context);
+            start_latency_observation(context,
+                                      MILTER_SERVER_CONTEXT_TIMEOUT_READING);
             milter_debug("[%u] [server][timeout][reading][registered][%g] "
                          "[%s] <%u> (%p)",
                          tag,
-                         priv->reading_timeout,
+                         timeout,
                          NULL_SAFE_NAME(name),
                          priv->timeout_id,
                          context);
@@ -1486,6 +1705,7 @@ write_packet (MilterServerContext *context,
     guint tag;
     MilterEventLoop *loop;
     const gchar *name;
+    gdouble timeout;
 
     if (!packet)
         return FALSE;
@@ -1536,10 +1756,13 @@ write_packet (MilterServerContext *context,
             g_timer_continue(priv->elapsed);
         }
         disable_timeout(context);
+        timeout = limit_timeout_by_deadline(context, priv->writing_timeout);
         priv->timeout_id = milter_event_loop_add_timeout(loop,
-                                                         priv->writing_timeout,
+                                                         timeout,
                                                          cb_writing_timeout,
                                                          context);
+        start_latency_observation(context,
+                                  MILTER_SERVER_CONTEXT_TIMEOUT_WRITING);
         if (milter_need_debug_log()) {
             const gchar *name;
 
@@ -1547,7 +1770,7 @@ write_packet (MilterServerContext *context,
             milter_debug("[%u] [server][timeout][writing][registered][%g] "
                          "[%s] <%u> (%p)",
                          tag,
-                         priv->writing_timeout,
+                         timeout,
                          NULL_SAFE_NAME(name),
                          priv->timeout_id,
                          context);
@@ -1596,6 +1819,7 @@ write_packet (MilterServerContext *context,
     if (agent_error) {
         GError *error = NULL;
 
+        cancel_latency_observation(context);
         disable_timeout(context);
         milter_utils_set_error_with_sub_error(
             &error,
@@ -1710,6 +1934,9 @@ milter_server_context_helo (MilterServerContext *context,
 
     milter_debug("[%u] [server][send][helo] <%s>: %s", tag, fqdn, name);
 
+    record_replay_command(context, MILTER_SERVER_CONTEXT_STATE_HELO,
+                          fqdn, NULL, 0);
+
     g_signal_emit(context, signals[STOP_ON_HELO], 0, fqdn, &stop);
     if (stop) {
         stop_on_state(context, MILTER_SERVER_CONTEXT_STATE_HELO);
@@ -1787,6 +2014,9 @@ milter_server_context_connect (MilterServerContext *context,
     milter_debug("[%u] [server][send][connect] <%s>: %s",
                  tag, host_name, name);
 
+    record_replay_command(context, MILTER_SERVER_CONTEXT_STATE_CONNECT,
+                          host_name, address, address_length);
+
     milter_protocol_agent_set_macro_context(MILTER_PROTOCOL_AGENT(context),
                                             MILTER_COMMAND_CONNECT);
     milter_debug("[%u] [server][stop-on-connect][start] %s", tag, name);
@@ -1864,6 +2094,9 @@ milter_server_context_envelope_from (MilterServerContext *context,
     milter_debug("[%u] [server][send][envelope-from] <%s>: %s",
                  tag, from, name);
 
+    record_replay_command(context, MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM,
+                          from, NULL, 0);
+
     /* TODO:
      * Those information will be cleared if both [abort]
      * packet and [envelope-from] packet are flushed at the
@@ -1934,6 +2167,10 @@ milter_server_context_envelope_recipient (MilterServerContext *context,
     milter_debug("[%u] [server][send][envelope-recipient] <%s>: %s",
                  tag, recipient, name);
 
+    record_replay_command(context,
+                          MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT,
+                          recipient, NULL, 0);
+
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
     if (priv->current_recipient)
@@ -1997,6 +2234,10 @@ milter_server_context_data (MilterServerContext *context)
 
     milter_debug("[%u] [server][send][data] %s", tag, name);
 
+    /* Only envelope commands are hedged. */
+    forget_replay_commands(priv->replay_commands,
+                           MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM);
+
     ensure_message_result(priv);
     milter_message_result_set_state(priv->message_result, MILTER_STATE_DATA);
 
@@ -2393,6 +2634,7 @@ cb_decoder_negotiate_reply (MilterDecoder *decoder,
     MilterServerContext *context;
     MilterServerContextState state;
     MilterServerContextPrivate *priv;
+    MilterEncoder *encoder;
     guint tag = 0;
     const gchar *name = NULL;
 
@@ -2437,6 +2679,14 @@ cb_decoder_negotiate_reply (MilterDecoder *decoder,
         priv->option = milter_option_copy(option);
     }
 
+    encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+    milter_encoder_set_max_data_size(
+        encoder, milter_option_get_max_data_size(priv->option));
+    milter_debug("[%u] [server][negotiate][max-data-size] [%s] "
+                 "<%" G_GSIZE_FORMAT ">",
+                 tag, NULL_SAFE_NAME(name),
+                 milter_encoder_get_max_data_size(encoder));
+
     if (state == MILTER_SERVER_CONTEXT_STATE_NEGOTIATE) {
         g_timer_stop(priv->elapsed);
         milter_debug("[%u] [server][timer][stop] [%s] <%g>",
@@ -2618,6 +2868,7 @@ cb_decoder_reply_code (MilterReplyDecoder *decoder,
         }
         milter_message_result_remove_recipient(
             priv->message_result, priv->current_recipient);
+        forget_replay_recipient(priv);
         g_free(priv->current_recipient);
         priv->current_recipient = NULL;
     } else {
@@ -2682,6 +2933,7 @@ cb_decoder_temporary_failure (MilterReplyDecoder *decoder, gpointer user_data)
             priv->message_result, priv->current_recipient);
         milter_message_result_remove_recipient(
             priv->message_result, priv->current_recipient);
+        forget_replay_recipient(priv);
         g_free(priv->current_recipient);
         priv->current_recipient = NULL;
     } else {
@@ -2744,6 +2996,7 @@ cb_decoder_reject (MilterReplyDecoder *decoder, gpointer user_data)
                                                      priv->current_recipient);
         milter_message_result_remove_recipient(priv->message_result,
                                                priv->current_recipient);
+        forget_replay_recipient(priv);
         g_free(priv->current_recipient);
         priv->current_recipient = NULL;
     } else {
@@ -3352,6 +3605,7 @@ cb_connection_timeout (gpointer data)
     if (priv)
         name = milter_server_context_get_name(context);
     agent = MILTER_AGENT(context);
+    cancel_latency_observation(context);
     milter_debug("[%u] [server][timeout][connection] [%s] [%u] (%p)",
                  priv ? milter_agent_get_tag(agent) : 0,
                  NULL_SAFE_NAME(name),
@@ -3405,9 +3659,6 @@ connect_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
-    disable_timeout(context);
-    dispose_connect_watch(context);
-
     option_length = sizeof(socket_errno);
     if (getsockopt(g_io_channel_unix_get_fd(priv->client_channel),
                    SOL_SOCKET, SO_ERROR,
@@ -3415,6 +3666,11 @@ connect_watch_func (GIOChannel *channel, GIOCondition condition, gpointer data)
         socket_errno = errno;
     }
 
+    if (socket_errno)
+        cancel_latency_observation(context);
+    disable_timeout(context);
+    dispose_connect_watch(context);
+
     if (socket_errno) {
         GError *error = NULL;
 
@@ -3462,6 +3718,7 @@ milter_server_context_establish_connection (MilterServerContext *context,
     MilterEventLoop *loop;
     GError *io_error = NULL;
     gint client_fd;
+    gdouble timeout;
 
     priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
 
@@ -3523,10 +3780,13 @@ milter_server_context_establish_connection (MilterServerContext *context,
                                    connect_watch_func, context);
 
     disable_timeout(context);
+    timeout = limit_timeout_by_deadline(context, priv->connection_timeout);
     priv->timeout_id = milter_event_loop_add_timeout(loop,
-                                                     priv->connection_timeout,
+                                                     timeout,
                                                      cb_connection_timeout,
                                                      context);
+    start_latency_observation(context,
+                              MILTER_SERVER_CONTEXT_TIMEOUT_CONNECTION);
     if (milter_need_debug_log()) {
         const gchar *name = NULL;
 
@@ -3535,7 +3795,7 @@ milter_server_context_establish_connection (MilterServerContext *context,
         milter_debug("[%u] [server][timeout][connection][registered][%g] "
                      "[%s] <%u> (%p)",
                      milter_agent_get_tag(agent),
-                     priv->connection_timeout,
+                     timeout,
                      NULL_SAFE_NAME(name),
                      priv->timeout_id,
                      context);
@@ -3545,6 +3805,7 @@ milter_server_context_establish_connection (MilterServerContext *context,
         if (errno == EINPROGRESS)
             return TRUE;
 
+        cancel_latency_observation(context);
         disable_timeout(context);
         dispose_connect_watch(context);
         dispose_client_channel(priv);
@@ -3600,6 +3861,170 @@ milter_server_context_set_end_of_message_timeout (MilterServerContext *context,
     MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->end_of_message_timeout = timeout;
 }
 
+void
+milter_server_context_set_deadline (MilterServerContext *context,
+                                    gdouble deadline)
+{
+    MilterServerContextPrivate *priv;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    priv->deadline = deadline;
+    if (deadline > 0) {
+        if (priv->deadline_timer)
+            g_timer_start(priv->deadline_timer);
+        else
+            priv->deadline_timer = g_timer_new();
+    }
+}
+
+gdouble
+milter_server_context_get_deadline (MilterServerContext *context)
+{
+    return MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->deadline;
+}
+
+static void
+cb_copy_macros (gpointer key, gpointer value, gpointer user_data)
+{
+    MilterProtocolAgent *agent = user_data;
+
+    milter_protocol_agent_set_macros_hash_table(agent,
+                                                GPOINTER_TO_INT(key),
+                                                value);
+}
+
+void
+milter_server_context_set_replay_recording (MilterServerContext *context,
+                                            gboolean recording)
+{
+    MilterServerContextPrivate *priv;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    priv->replay_recording = recording;
+    if (!recording)
+        forget_replay_commands(priv->replay_commands,
+                               MILTER_SERVER_CONTEXT_STATE_INVALID);
+}
+
+gboolean
+milter_server_context_get_replay_recording (MilterServerContext *context)
+{
+    return MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->replay_recording;
+}
+
+void
+milter_server_context_prepare_replay (MilterServerContext *context,
+                                      MilterServerContext *source)
+{
+    MilterServerContextPrivate *priv, *source_priv;
+    MilterProtocolAgent *agent, *source_agent;
+    MilterMacrosRequests *macros_requests;
+    GList *node;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    source_priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(source);
+
+    agent = MILTER_PROTOCOL_AGENT(context);
+    source_agent = MILTER_PROTOCOL_AGENT(source);
+    g_hash_table_foreach(milter_protocol_agent_get_macros(source_agent),
+                         cb_copy_macros, agent);
+    macros_requests = milter_protocol_agent_get_macros_requests(source_agent);
+    if (macros_requests)
+        milter_protocol_agent_set_macros_requests(agent, macros_requests);
+
+    forget_replay_commands(priv->pending_replay_commands,
+                           MILTER_SERVER_CONTEXT_STATE_INVALID);
+    for (node = source_priv->replay_commands->head;
+         node;
+         node = g_list_next(node)) {
+        ReplayCommand *command = node->data;
+
+        g_queue_push_tail(priv->pending_replay_commands,
+                          replay_command_new(command->state,
+                                             command->value,
+                                             command->address,
+                                             command->address_length));
+    }
+}
+
+guint
+milter_server_context_get_n_replay_commands (MilterServerContext *context)
+{
+    return MILTER_SERVER_CONTEXT_GET_PRIVATE(context)->pending_replay_commands->length;
+}
+
+gboolean
+milter_server_context_replay_next (MilterServerContext *context)
+{
+    MilterServerContextPrivate *priv;
+    ReplayCommand *command;
+    MilterStepFlags no_step;
+    gboolean skip, success;
+
+    priv = MILTER_SERVER_CONTEXT_GET_PRIVATE(context);
+    command = g_queue_pop_head(priv->pending_replay_commands);
+    if (!command)
+        return FALSE;
+
+    switch (command->state) {
+    case MILTER_SERVER_CONTEXT_STATE_CONNECT:
+        no_step = MILTER_STEP_NO_CONNECT;
+        break;
+    case MILTER_SERVER_CONTEXT_STATE_HELO:
+        no_step = MILTER_STEP_NO_HELO;
+        break;
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
+        no_step = MILTER_STEP_NO_ENVELOPE_FROM;
+        break;
+    default:
+        no_step = MILTER_STEP_NO_ENVELOPE_RECIPIENT;
+        break;
+    }
+    /* A skipped step emits "continue" by itself. */
+    skip = milter_server_context_is_enable_step(context, no_step);
+
+    if (milter_need_debug_log()) {
+        gchar *state_name;
+
+        state_name =
+            milter_utils_get_enum_nick_name(MILTER_TYPE_SERVER_CONTEXT_STATE,
+                                            command->state);
+        milter_debug("[%u] [server][replay][%s] <%s>: %s",
+                     milter_agent_get_tag(MILTER_AGENT(context)),
+                     state_name,
+                     command->value,
+                     NULL_SAFE_NAME(priv->name));
+        g_free(state_name);
+    }
+
+    switch (command->state) {
+    case MILTER_SERVER_CONTEXT_STATE_CONNECT:
+        success = milter_server_context_connect(context,
+                                                command->value,
+                                                command->address,
+                                                command->address_length);
+        break;
+    case MILTER_SERVER_CONTEXT_STATE_HELO:
+        success = milter_server_context_helo(context, command->value);
+        break;
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
+        success = milter_server_context_envelope_from(context, command->value);
+        break;
+    default:
+        success = milter_server_context_envelope_recipient(context,
+                                                           command->value);
+        break;
+    }
+
+    if (success && !skip &&
+        !milter_server_context_need_reply(context, command->state))
+        g_signal_emit_by_name(context, "continue");
+
+    replay_command_free(command);
+
+    return success;
+}
+
 gboolean
 milter_server_context_get_skip_body (MilterServerContext *context)
 {
@@ -156,6 +156,27 @@ typedef enum
     MILTER_SERVER_CONTEXT_STATE_ABORT
 } MilterServerContextState;
 
+/**
+ * MilterServerContextTimeoutType:
+ * @MILTER_SERVER_CONTEXT_TIMEOUT_NONE: No timeout.
+ * @MILTER_SERVER_CONTEXT_TIMEOUT_CONNECTION: Connection timeout.
+ * @MILTER_SERVER_CONTEXT_TIMEOUT_WRITING: Writing timeout.
+ * @MILTER_SERVER_CONTEXT_TIMEOUT_READING: Reading timeout.
+ * @MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE:
+ * End-of-message timeout.
+ *
+ * These identify the timeout that is watched by
+ * %MilterServerContext.
+ */
+typedef enum
+{
+    MILTER_SERVER_CONTEXT_TIMEOUT_NONE,
+    MILTER_SERVER_CONTEXT_TIMEOUT_CONNECTION,
+    MILTER_SERVER_CONTEXT_TIMEOUT_WRITING,
+    MILTER_SERVER_CONTEXT_TIMEOUT_READING,
+    MILTER_SERVER_CONTEXT_TIMEOUT_END_OF_MESSAGE
+} MilterServerContextTimeoutType;
+
 typedef struct _MilterServerContext         MilterServerContext;
 typedef struct _MilterServerContextClass    MilterServerContextClass;
 
@@ -208,6 +229,10 @@ struct _MilterServerContextClass
 
     void (*state_transited)     (MilterServerContext *context,
                                  MilterServerContextState state);
+
+    void (*latency_observed)    (MilterServerContext *context,
+                                 MilterServerContextTimeoutType type,
+                                 gdouble elapsed);
 };
 
 GQuark               milter_server_context_error_quark (void);
@@ -281,6 +306,32 @@ void                 milter_server_context_set_end_of_message_timeout
                                                        (MilterServerContext *context,
                                                         gdouble timeout);
 
+/**
+ * milter_server_context_set_deadline:
+ * @context: a %MilterServerContext.
+ * @deadline: the deadline by seconds from now. 0 means
+ *            no deadline. (default is 0)
+ *
+ * Sets the deadline by seconds from now. Connection,
+ * writing, reading and end-of-message timeouts are
+ * shortened so that they don't exceed the deadline.
+ */
+void                 milter_server_context_set_deadline
+                                                       (MilterServerContext *context,
+                                                        gdouble deadline);
+
+/**
+ * milter_server_context_get_deadline:
+ * @context: a %MilterServerContext.
+ *
+ * Gets the deadline by seconds that is set by
+ * milter_server_context_set_deadline().
+ *
+ * Returns: the deadline by seconds. 0 means no deadline.
+ */
+gdouble              milter_server_context_get_deadline
+                                                       (MilterServerContext *context);
+
 /**
  * milter_server_context_set_connection_spec:
  * @context: a %MilterServerContext.
@@ -731,6 +782,70 @@ gboolean             milter_server_context_need_reply (MilterServerContext *cont
 gboolean             milter_server_context_has_accepted_recipient
                                                       (MilterServerContext *context);
 
+/**
+ * milter_server_context_set_replay_recording:
+ * @context: a %MilterServerContext.
+ * @recording: %TRUE if @context records commands to be
+ *             replayed.
+ *
+ * Sets whether @context records the connect, helo,
+ * envelope-from and envelope-recipient commands for
+ * milter_server_context_prepare_replay(). The recorded
+ * envelope-from and envelope-recipient commands are dropped
+ * when the data command is sent. Setting %FALSE drops all
+ * recorded commands. The default is %FALSE.
+ */
+void                 milter_server_context_set_replay_recording
+                                                      (MilterServerContext *context,
+                                                       gboolean recording);
+
+/**
+ * milter_server_context_get_replay_recording:
+ * @context: a %MilterServerContext.
+ *
+ * Returns: %TRUE if @context records commands to be
+ * replayed, %FALSE otherwise.
+ */
+gboolean             milter_server_context_get_replay_recording
+                                                      (MilterServerContext *context);
+
+/**
+ * milter_server_context_prepare_replay:
+ * @context: a %MilterServerContext.
+ * @source: a %MilterServerContext to be replayed.
+ *
+ * Prepares to replay the connect, helo, envelope-from and
+ * envelope-recipient commands sent by @source on @context.
+ * Macros are copied from @source. @context should be
+ * negotiated before replaying.
+ */
+void                 milter_server_context_prepare_replay
+                                                      (MilterServerContext *context,
+                                                       MilterServerContext *source);
+
+/**
+ * milter_server_context_get_n_replay_commands:
+ * @context: a %MilterServerContext.
+ *
+ * Returns: the number of commands that aren't replayed yet.
+ */
+guint                milter_server_context_get_n_replay_commands
+                                                      (MilterServerContext *context);
+
+/**
+ * milter_server_context_replay_next:
+ * @context: a %MilterServerContext.
+ *
+ * Sends the next command prepared by
+ * milter_server_context_prepare_replay(). The reply is
+ * notified by the usual signals. "continue" is emitted
+ * for a command that doesn't need a reply.
+ *
+ * Returns: %TRUE if a command is sent, %FALSE otherwise.
+ */
+gboolean             milter_server_context_replay_next
+                                                      (MilterServerContext *context);
+
 G_END_DECLS
 
 #endif /* __MILTER_SERVER_CONTEXT_H__ */
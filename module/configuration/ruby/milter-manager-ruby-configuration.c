@@ -518,14 +518,22 @@ real_maintain (MilterManagerConfiguration *_configuration, GError **error)
     MilterManagerRubyConfiguration *configuration;
     GError *local_error = NULL;
     gboolean success = TRUE;
+    GTimer *timer;
+    gdouble gc_elapsed;
 
+    timer = g_timer_new();
     rb_gc_start();
+    gc_elapsed = g_timer_elapsed(timer, NULL);
 
     configuration = MILTER_MANAGER_RUBY_CONFIGURATION(_configuration);
     rb_funcall_protect(&local_error,
                        GOBJ2RVAL(configuration),
                        rb_intern("maintained"),
                        0);
+    milter_statistics("[ruby-configuration][maintain] gc=%g hooks=%g",
+                      gc_elapsed,
+                      g_timer_elapsed(timer, NULL) - gc_elapsed);
+    g_timer_destroy(timer);
     if (local_error) {
         success = FALSE;
         if (!error) {
@@ -69,6 +69,11 @@ void test_n_workers (void);
 void test_custom_fork (void);
 void test_default_packet_buffer_size (void);
 void test_worker_id (void);
+void test_reuse_port (void);
+void test_pin_workers (void);
+void test_worker_n_accepts (void);
+void test_n_io_threads (void);
+void test_io_thread_n_sessions (void);
 void test_max_pending_finished_sessions (void);
 
 static MilterEventLoop *loop;
@@ -1091,6 +1096,44 @@ test_worker_id (void)
     cut_assert_equal_uint(0, milter_client_get_worker_id(client));
 }
 
+void
+test_reuse_port (void)
+{
+    cut_assert_false(milter_client_is_reuse_port(client));
+    milter_client_set_reuse_port(client, TRUE);
+    cut_assert_true(milter_client_is_reuse_port(client));
+}
+
+void
+test_pin_workers (void)
+{
+    cut_assert_false(milter_client_is_pin_workers(client));
+    milter_client_set_pin_workers(client, TRUE);
+    cut_assert_true(milter_client_is_pin_workers(client));
+}
+
+void
+test_worker_n_accepts (void)
+{
+    cut_assert_equal_uint(0, milter_client_get_worker_n_accepts(client, 0));
+    cut_assert_equal_uint(0, milter_client_get_worker_n_accepts(client, 1));
+}
+
+void
+test_n_io_threads (void)
+{
+    cut_assert_equal_uint(0, milter_client_get_n_io_threads(client));
+    milter_client_set_n_io_threads(client, 4);
+    cut_assert_equal_uint(4, milter_client_get_n_io_threads(client));
+}
+
+void
+test_io_thread_n_sessions (void)
+{
+    cut_assert_equal_uint(0, milter_client_get_io_thread_n_sessions(client, 0));
+    cut_assert_equal_uint(0, milter_client_get_io_thread_n_sessions(client, 1));
+}
+
 void
 test_max_pending_finished_sessions (void)
 {
@@ -0,0 +1,161 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter/client.h>
+
+#include <gcutter.h>
+
+void test_initial_limit (void);
+void test_initial_limit_without_max (void);
+void test_acceptable (void);
+void test_increase (void);
+void test_increase_unused (void);
+void test_increase_max (void);
+void test_decrease_by_latency (void);
+void test_decrease_once_in_interval (void);
+void test_decrease_by_lag (void);
+void test_set_max_limit (void);
+
+static MilterClientConcurrencyLimiter *limiter;
+
+void
+cut_setup (void)
+{
+    limiter = milter_client_concurrency_limiter_new(10);
+}
+
+void
+cut_teardown (void)
+{
+    if (limiter)
+        g_object_unref(limiter);
+}
+
+static void
+record_latencies (gdouble latency, guint n_processing_sessions, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        milter_client_concurrency_limiter_record_latency(limiter,
+                                                         latency,
+                                                         n_processing_sessions);
+    }
+}
+
+void
+test_initial_limit (void)
+{
+    cut_assert_equal_uint(10,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_initial_limit_without_max (void)
+{
+    g_object_unref(limiter);
+    limiter = milter_client_concurrency_limiter_new(0);
+    cut_assert_equal_uint(
+        MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_INITIAL_LIMIT,
+        milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_acceptable (void)
+{
+    cut_assert_true(milter_client_concurrency_limiter_is_acceptable(limiter, 9));
+    cut_assert_false(milter_client_concurrency_limiter_is_acceptable(limiter, 10));
+}
+
+void
+test_increase (void)
+{
+    g_object_unref(limiter);
+    limiter = milter_client_concurrency_limiter_new(0);
+
+    record_latencies(1.0, 100, 110);
+    cut_assert_equal_uint(101,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_increase_unused (void)
+{
+    g_object_unref(limiter);
+    limiter = milter_client_concurrency_limiter_new(0);
+
+    record_latencies(1.0, 1, 1000);
+    cut_assert_equal_uint(
+        MILTER_CLIENT_CONCURRENCY_LIMITER_DEFAULT_INITIAL_LIMIT,
+        milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_increase_max (void)
+{
+    record_latencies(1.0, 10, 1000);
+    cut_assert_equal_uint(10,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_decrease_by_latency (void)
+{
+    record_latencies(1.0, 1, 20);
+    record_latencies(10.0, 1, 1);
+    cut_assert_equal_uint(9,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+    cut_assert_equal_double(2.8, 0.01,
+                            milter_client_concurrency_limiter_get_latency(limiter));
+    cut_assert_equal_double(1.09, 0.01,
+                            milter_client_concurrency_limiter_get_baseline_latency(limiter));
+}
+
+void
+test_decrease_once_in_interval (void)
+{
+    record_latencies(1.0, 1, 20);
+    record_latencies(10.0, 1, 5);
+    cut_assert_equal_uint(9,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+}
+
+void
+test_decrease_by_lag (void)
+{
+    milter_client_concurrency_limiter_record_lag(limiter, 0.5);
+    cut_assert_equal_uint(9,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+    cut_assert_equal_double(0.5, 0.01,
+                            milter_client_concurrency_limiter_get_lag(limiter));
+}
+
+void
+test_set_max_limit (void)
+{
+    milter_client_concurrency_limiter_set_max_limit(limiter, 5);
+    cut_assert_equal_uint(5,
+                          milter_client_concurrency_limiter_get_limit(limiter));
+    cut_assert_equal_uint(5,
+                          milter_client_concurrency_limiter_get_max_limit(limiter));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -45,6 +45,7 @@ void test_encode_data (void);
 void test_encode_header (void);
 void test_encode_end_of_header (void);
 void test_encode_body (void);
+void test_encode_body_max_data_size (void);
 void test_encode_end_of_message (void);
 void test_encode_end_of_message_with_data (void);
 void test_encode_abort (void);
@@ -555,6 +556,31 @@ test_encode_body (void)
     cut_assert_equal_uint(sizeof(body), packed_size);
 }
 
+void
+test_encode_body_max_data_size (void)
+{
+    const gchar *body;
+    gsize body_size = MILTER_CHUNK_SIZE + 1;
+    const gchar *actual;
+    gsize actual_size = 0, packed_size;
+
+    body = cut_take_string(g_strnfill(body_size, 'X'));
+
+    milter_command_encoder_encode_body(encoder, &actual, &actual_size,
+                                       body, body_size, &packed_size);
+    cut_assert_equal_uint(MILTER_CHUNK_SIZE, packed_size);
+
+    milter_encoder_set_max_data_size(MILTER_ENCODER(encoder),
+                                     MILTER_MAX_DATA_SIZE_256K);
+    g_string_append(expected, "B");
+    g_string_append_len(expected, body, body_size);
+    pack(expected);
+    milter_command_encoder_encode_body(encoder, &actual, &actual_size,
+                                       body, body_size, &packed_size);
+    cut_assert_equal_memory(expected->str, expected->len, actual, actual_size);
+    cut_assert_equal_uint(body_size, packed_size);
+}
+
 void
 test_encode_end_of_message (void)
 {
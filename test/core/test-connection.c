@@ -45,6 +45,8 @@ void test_listen (void);
 void test_listen_exist_socket (void);
 void test_listen_remove_failure (void);
 void test_listen_nonexistent_path (void);
+void test_listen_reuse_port (void);
+void test_listen_reuse_port_unix (void);
 
 static struct sockaddr *actual_address;
 static socklen_t actual_address_size;
@@ -610,6 +612,53 @@ test_listen_nonexistent_path (void)
     cut_assert_equal_int(0, address_size);
 }
 
+void
+test_listen_reuse_port (void)
+{
+    const gchar *spec = "inet:9999@127.0.0.1";
+    GIOChannel *channel1, *channel2;
+    GError *error = NULL;
+
+    if (!milter_connection_is_reuse_port_available(spec))
+        cut_omit("SO_REUSEPORT isn't available.");
+
+    channel1 = milter_connection_listen_reuse_port(spec, 5,
+                                                   NULL, NULL, &error);
+    gcut_assert_error(error);
+    cut_assert_not_null(channel1);
+
+    channel2 = milter_connection_listen_reuse_port(spec, 5,
+                                                   &actual_address,
+                                                   &actual_address_size,
+                                                   &error);
+    g_io_channel_unref(channel1);
+    gcut_assert_error(error);
+    cut_assert_not_null(channel2);
+    g_io_channel_unref(channel2);
+
+    cut_assert_equal_uint(AF_INET, actual_address->sa_family);
+}
+
+void
+test_listen_reuse_port_unix (void)
+{
+    const gchar *spec;
+
+    spec = cut_take_printf("unix:%s/milter.sock", tmp_dir);
+    cut_assert_false(milter_connection_is_reuse_port_available(spec));
+
+    expected_error = g_error_new(MILTER_CONNECTION_ERROR,
+                                 MILTER_CONNECTION_ERROR_SET_SOCKET_OPTION_FAILURE,
+                                 "SO_REUSEPORT isn't available: <%s>",
+                                 spec);
+    cut_assert_null(milter_connection_listen_reuse_port(spec, 5,
+                                                        &actual_address,
+                                                        &actual_address_size,
+                                                        &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+    cut_assert_null(actual_address);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
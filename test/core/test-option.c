@@ -18,6 +18,7 @@
  */
 
 #include <milter/core/milter-option.h>
+#include <milter/core/milter-protocol.h>
 #include <milter/core/milter-enum-types.h>
 
 #include <gcutter.h>
@@ -30,10 +31,12 @@ void test_version (void);
 void test_action (void);
 void test_step (void);
 void test_get_step_convenience (void);
+void test_get_max_data_size (void);
 void test_combine (void);
 void test_combine_older_version (void);
 void test_combine_newer_version (void);
 void test_merge (void);
+void test_merge_max_data_size (void);
 void test_merge_older_version (void);
 void test_merge_newer_version (void);
 void test_inspect (void);
@@ -260,6 +263,22 @@ test_get_step_convenience (void)
                             milter_option_get_step_yes(option));
 }
 
+void
+test_get_max_data_size (void)
+{
+    option = milter_option_new_empty();
+    cut_assert_equal_uint(MILTER_CHUNK_SIZE,
+                          milter_option_get_max_data_size(option));
+
+    milter_option_add_step(option, MILTER_STEP_MAX_DATA_SIZE_256K);
+    cut_assert_equal_uint(MILTER_MAX_DATA_SIZE_256K,
+                          milter_option_get_max_data_size(option));
+
+    milter_option_add_step(option, MILTER_STEP_MAX_DATA_SIZE_1M);
+    cut_assert_equal_uint(MILTER_MAX_DATA_SIZE_1M,
+                          milter_option_get_max_data_size(option));
+}
+
 void
 test_combine (void)
 {
@@ -384,6 +403,24 @@ test_merge (void)
                             milter_option_get_step(option));
 }
 
+void
+test_merge_max_data_size (void)
+{
+    option = milter_option_new(6,
+                               MILTER_ACTION_NONE,
+                               MILTER_STEP_NO_HELO |
+                               MILTER_STEP_MAX_DATA_SIZE_256K);
+    copied_option = milter_option_new(6,
+                                      MILTER_ACTION_NONE,
+                                      MILTER_STEP_MAX_DATA_SIZE_1M);
+
+    cut_assert_true(milter_option_merge(option, copied_option));
+    gcut_assert_equal_flags(MILTER_TYPE_STEP_FLAGS,
+                            MILTER_STEP_MAX_DATA_SIZE_256K |
+                            MILTER_STEP_MAX_DATA_SIZE_1M,
+                            milter_option_get_step(option));
+}
+
 void
 test_merge_older_version (void)
 {
@@ -49,6 +49,8 @@ void test_append_index (void);
 void test_xml_append_text_element (void);
 void test_xml_append_boolean_element (void);
 void test_xml_append_enum_element (void);
+void test_moving_average (void);
+void test_latency_trend (void);
 
 static GIOCondition io_condition;
 static const gchar *expected_inspected_io_condition;
@@ -678,6 +680,35 @@ test_xml_append_enum_element (void)
     cut_assert_equal_string("  <NAME>continue</NAME>\n", actual_string->str);
 }
 
+void
+test_moving_average (void)
+{
+    cut_assert_equal_double(2.0, 0.0,
+                            milter_utils_moving_average(10.0, 2.0, 0.5, 0));
+    cut_assert_equal_double(6.0, 0.0,
+                            milter_utils_moving_average(10.0, 2.0, 0.5, 1));
+}
+
+void
+test_latency_trend (void)
+{
+    MilterUtilsLatencyTrend trend;
+    guint i;
+
+    milter_utils_latency_trend_init(&trend);
+    milter_utils_latency_trend_add(&trend, 1.0);
+    cut_assert_equal_double(1.0, 0.0, trend.latency);
+    cut_assert_equal_double(1.0, 0.0, trend.baseline_latency);
+    cut_assert_false(milter_utils_latency_trend_is_warmed_up(&trend));
+
+    for (i = 1; i < 10; i++) {
+        milter_utils_latency_trend_add(&trend, 2.0);
+    }
+    cut_assert_true(milter_utils_latency_trend_is_warmed_up(&trend));
+    cut_assert_operator_double(trend.baseline_latency, <, trend.latency);
+    cut_assert_operator_double(trend.latency, <, 2.0);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
@@ -95,6 +95,12 @@ class MilterTestClient
         @wait_second = second
       end
 
+      opts.on("--reply-delay=SECOND", Float,
+              "Wait in SECOND before each reply",
+              "(#{@reply_delay})") do |second|
+        @reply_delay = second
+      end
+
       opts.on("--action=ACTION",
               "Do ACTION when condition is matched",
               "(#{@current_action})") do |action|
@@ -264,6 +270,7 @@ class MilterTestClient
     @print_status = false
     @timeout = 3
     @wait_second = 0
+    @reply_delay = 0
     @debug = false
     @current_action = "reject"
     @end_of_message_action = nil
@@ -305,6 +312,7 @@ class MilterTestClient
       next_state = :abort
       sleep(@wait_second)
     elsif need_reply(next_state)
+      sleep(@reply_delay) if @reply_delay > 0
       packet, packed_size = @encoder.send("encode_#{encode_type}", *args)
       while packet
         written_size = @socket.write(packet)
@@ -18,6 +18,8 @@
  */
 
 #include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include <milter/manager/milter-manager-applicable-condition.h>
 
@@ -30,15 +32,21 @@ void test_name (void);
 void test_description (void);
 void test_data (void);
 void test_merge (void);
+void test_merge_rules (void);
+void test_attach_rules (void);
 
 static MilterManagerApplicableCondition *condition;
 static MilterManagerApplicableCondition *merged_condition;
+static MilterManagerConditionRule *rule;
+static MilterManagerChild *child;
 
 void
 setup (void)
 {
     condition = NULL;
     merged_condition = NULL;
+    rule = NULL;
+    child = NULL;
 }
 
 void
@@ -48,6 +56,10 @@ teardown (void)
         g_object_unref(condition);
     if (merged_condition)
         g_object_unref(merged_condition);
+    if (rule)
+        g_object_unref(rule);
+    if (child)
+        g_object_unref(child);
 }
 
 void
@@ -162,6 +174,74 @@ test_merge (void)
         milter_manager_applicable_condition_get_data(merged_condition));
 }
 
+void
+test_merge_rules (void)
+{
+    condition = milter_manager_applicable_condition_new("S25R");
+    merged_condition = milter_manager_applicable_condition_new("Merged");
+    rule = milter_manager_condition_rule_new(
+        MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+        MILTER_MANAGER_CONDITION_ACTION_STOP);
+
+    milter_manager_applicable_condition_add_rule(condition, rule);
+    milter_manager_applicable_condition_merge(merged_condition, condition);
+    cut_assert_equal_uint(
+        1,
+        g_list_length((GList *)milter_manager_applicable_condition_get_rules(
+                          merged_condition)));
+
+    milter_manager_applicable_condition_clear_rules(condition);
+    milter_manager_applicable_condition_merge(merged_condition, condition);
+    cut_assert_equal_uint(
+        1,
+        g_list_length((GList *)milter_manager_applicable_condition_get_rules(
+                          merged_condition)));
+}
+
+static gboolean
+stop_on_connect (const gchar *host, const gchar *ip_address)
+{
+    struct sockaddr_in address;
+    gboolean stop = FALSE;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, ip_address, &(address.sin_addr));
+    g_signal_emit_by_name(child, "stop-on-connect",
+                          host, &address, sizeof(address), &stop);
+
+    return stop;
+}
+
+void
+test_attach_rules (void)
+{
+    MilterManagerConditionRule *apply_rule;
+
+    condition = milter_manager_applicable_condition_new("S25R");
+    child = milter_manager_child_new("child-milter");
+
+    rule = milter_manager_condition_rule_new(
+        MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+        MILTER_MANAGER_CONDITION_ACTION_STOP);
+    milter_manager_condition_rule_add_domain(rule, "example.com");
+    milter_manager_applicable_condition_add_rule(condition, rule);
+
+    apply_rule = milter_manager_condition_rule_new(
+        MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+        MILTER_MANAGER_CONDITION_ACTION_APPLY);
+    milter_manager_condition_rule_add_address(apply_rule, "192.168.0.0/16",
+                                              NULL);
+    milter_manager_applicable_condition_add_rule(condition, apply_rule);
+    g_object_unref(apply_rule);
+
+    milter_manager_applicable_condition_attach_to(condition, child, NULL, NULL);
+
+    cut_assert_true(stop_on_connect("mx.example.com", "192.168.1.1"));
+    cut_assert_false(stop_on_connect("mx.example.org", "192.168.1.1"));
+    cut_assert_false(stop_on_connect("mx.example.org", "10.0.0.1"));
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
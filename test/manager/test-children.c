@@ -45,6 +45,8 @@ void test_connect (void);
 void test_connect_with_macro (void);
 void test_connect_stop (void);
 void test_connect_half_stop (void);
+void test_circuit_breaker_stopped_before_command (void);
+void test_circuit_breaker_slow_session (void);
 void test_connect_no_reply (void);
 void test_helo (void);
 void test_helo_no_reply (void);
@@ -52,6 +54,7 @@ void test_envelope_from (void);
 void test_envelope_from_no_reply (void);
 void test_envelope_recipient (void);
 void test_envelope_recipient_no_reply (void);
+void test_hedge_after_rejected_recipient (void);
 void test_data (void);
 void test_data_no_reply (void);
 void test_header (void);
@@ -63,11 +66,22 @@ void test_end_of_header_no_reply (void);
 void test_body (void);
 void test_body_with_protocol_version2 (void);
 void test_body_no_reply (void);
+void test_body_spool_skip (void);
+void test_body_cache_miss (void);
+void test_body_cache_hit (void);
+void test_body_cache_modified (void);
+void test_body_cache_reject (void);
+void test_body_cache_temporary_failure (void);
+void test_body_spool (void);
+void test_body_first_child_accept (void);
+void test_body_max_data_size (void);
 void data_important_status (void);
 void test_important_status (gconstpointer data);
 void data_not_important_status (void);
 void test_not_important_status (gconstpointer data);
 void test_reading_timeout (void);
+void test_session_deadline (void);
+void test_session_deadline_per_message (void);
 void test_connection_timeout (void);
 void test_end_of_message_timeout (void);
 void test_writing_timeout (void);
@@ -83,6 +97,8 @@ static MilterManagerChildren *children;
 static MilterOption *option;
 static MilterStepFlags step;
 static MilterManagerProcessLauncher *launcher;
+static MilterManagerVerdictCache *body_cache;
+static MilterManagerCircuitBreaker *circuit_breaker;
 
 static GError *actual_error;
 static GError *expected_error;
@@ -400,6 +416,8 @@ cut_setup (void)
     setup_signals(children);
 
     launcher = NULL;
+    body_cache = NULL;
+    circuit_breaker = NULL;
     option = NULL;
     step = MILTER_STEP_NONE;
 
@@ -479,6 +497,12 @@ cut_teardown (void)
     if (launcher)
         g_object_unref(launcher);
 
+    if (body_cache)
+        g_object_unref(body_cache);
+
+    if (circuit_breaker)
+        g_object_unref(circuit_breaker);
+
     if (actual_error)
         g_error_free(actual_error);
     if (expected_error)
@@ -626,6 +650,11 @@ add_child (const gchar *name, const gchar *connection_spec)
     cut_assert_not_null(egg);
 
     child = milter_manager_egg_hatch(egg);
+    /* body_cache and circuit_breaker are used by the first child. */
+    if (body_cache && milter_manager_children_length(children) == 0)
+        g_object_set(child, "body-cache", body_cache, NULL);
+    if (circuit_breaker && milter_manager_children_length(children) == 0)
+        g_object_set(child, "circuit-breaker", circuit_breaker, NULL);
     milter_manager_children_add_child(children, child);
     g_object_unref(egg);
     g_object_unref(child);
@@ -1339,6 +1368,39 @@ test_connect_half_stop (void)
     cut_assert_true(have_quitted_context(child_list));
 }
 
+static void
+setup_circuit_breaker (gdouble slow_time)
+{
+    circuit_breaker = milter_manager_circuit_breaker_new("milter@10026");
+    milter_manager_circuit_breaker_set_failure_threshold(circuit_breaker, 2);
+    milter_manager_circuit_breaker_set_slow_time(circuit_breaker, slow_time);
+    milter_manager_circuit_breaker_record_failure(circuit_breaker);
+}
+
+void
+test_circuit_breaker_stopped_before_command (void)
+{
+    setup_circuit_breaker(0.0);
+    cut_trace(test_connect_half_stop());
+
+    cut_assert_equal_uint(
+        1, milter_manager_circuit_breaker_get_n_failures(circuit_breaker));
+}
+
+void
+test_circuit_breaker_slow_session (void)
+{
+    setup_circuit_breaker(0.5);
+    arguments_append(arguments1, "--reply-delay", "0.2", NULL);
+    cut_trace(test_envelope_from());
+
+    milter_manager_children_quit(children);
+    wait_finished();
+
+    cut_assert_equal_uint(
+        0, milter_manager_circuit_breaker_get_n_failures(circuit_breaker));
+}
+
 void
 test_connect_no_reply (void)
 {
@@ -1464,6 +1526,80 @@ test_envelope_recipient_no_reply (void)
     cut_assert_false(milter_manager_children_is_waiting_reply(children));
 }
 
+void
+test_hedge_after_rejected_recipient (void)
+{
+    MilterManagerEgg *egg;
+    MilterManagerChild *child;
+    struct sockaddr_in address;
+    GError *error = NULL;
+
+    option = milter_option_new(6,
+                               MILTER_ACTION_ADD_HEADERS |
+                               MILTER_ACTION_CHANGE_BODY,
+                               step);
+
+    arguments_append(arguments1,
+                     "--action", "reject",
+                     "--envelope-recipient", "rejected@example.com",
+                     "--action", "no-response",
+                     "--envelope-recipient", "slow@example.com",
+                     NULL);
+    arguments_append(arguments2,
+                     "--action", "reject",
+                     "--envelope-recipient", "rejected@example.com",
+                     NULL);
+    start_client(10026, arguments1);
+    start_client(10027, arguments2);
+
+    egg = egg_new("milter@10026", "inet:10026@localhost");
+    cut_assert_not_null(egg);
+    gcut_take_object(G_OBJECT(egg));
+    milter_manager_egg_add_replica_connection_spec(egg,
+                                                   "inet:10026@localhost",
+                                                   &error);
+    gcut_assert_error(error);
+    milter_manager_egg_add_replica_connection_spec(egg,
+                                                   "inet:10027@localhost",
+                                                   &error);
+    gcut_assert_error(error);
+    milter_manager_configuration_add_egg(config, egg);
+
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    gcut_take_object(G_OBJECT(child));
+    cut_assert_equal_int(0, milter_manager_child_get_replica_index(child));
+    g_object_set(child, "hedge-delay", 0.05, NULL);
+    milter_manager_children_add_child(children, child);
+
+    milter_manager_children_negotiate(children, option, NULL);
+    wait_reply(1, n_negotiate_reply_emitted);
+
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, "192.168.123.123", &(address.sin_addr));
+    milter_manager_children_connect(children,
+                                    "mx.local.net",
+                                    (struct sockaddr *)(&address),
+                                    sizeof(address));
+    wait_reply(1, n_continue_emitted);
+
+    milter_manager_children_helo(children, "delian");
+    wait_reply(2, n_continue_emitted);
+
+    milter_manager_children_envelope_from(children, "example@example.com");
+    wait_reply(3, n_continue_emitted);
+
+    milter_manager_children_envelope_recipient(children,
+                                               "rejected@example.com");
+    wait_reply(1, n_reject_emitted);
+
+    /* The standby must not replay the rejected recipient.
+     * It would be rejected again and the hedge abandoned. */
+    milter_manager_children_envelope_recipient(children, "slow@example.com");
+    wait_reply(4, n_continue_emitted);
+}
+
 void
 test_data (void)
 {
@@ -1628,6 +1764,224 @@ test_body_no_reply (void)
     cut_assert_false(milter_manager_children_is_waiting_reply(children));
 }
 
+void
+test_body_spool_skip (void)
+{
+    const gchar chunk[] = "message body";
+
+    step |= MILTER_STEP_NO_BODY;
+    arguments_append(arguments2,
+                     "--negotiate-flags", "no-body",
+                     NULL);
+    body_cache = milter_manager_verdict_cache_new("body", 16);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(8, n_continue_emitted);
+
+    cut_assert_equal_uint(0,
+                          milter_manager_children_get_spooled_body_size(children));
+    cut_assert_equal_string(
+        cut_take_string(g_compute_checksum_for_string(G_CHECKSUM_SHA256,
+                                                      chunk, -1)),
+        cut_take_string(milter_manager_children_get_body_digest(children)));
+}
+
+/* The message has no header that is a part of the key. */
+static const gchar *
+body_cache_key (const gchar *body)
+{
+    const gchar headers[] =
+        "Content-Type\n\n"
+        "Content-Transfer-Encoding\n\n"
+        "Subject\n\n";
+
+    return cut_take_printf(
+        "%s:%s",
+        cut_take_string(g_compute_checksum_for_string(G_CHECKSUM_SHA256,
+                                                      body, -1)),
+        cut_take_string(g_compute_checksum_for_string(G_CHECKSUM_SHA256,
+                                                      headers, -1)));
+}
+
+void
+test_body_cache_miss (void)
+{
+    const gchar chunk[] = "message body";
+
+    body_cache = milter_manager_verdict_cache_new("body", 16);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(8, n_continue_emitted);
+    milter_manager_children_end_of_message(children, NULL, 0);
+    wait_reply(9, n_continue_emitted);
+
+    cut_assert_equal_uint(0, milter_manager_verdict_cache_get_n_hits(body_cache));
+    cut_assert_equal_uint(1,
+                          milter_manager_verdict_cache_get_n_misses(body_cache));
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_CONTINUE,
+                           milter_manager_verdict_cache_lookup_key(
+                               body_cache, body_cache_key(chunk)));
+}
+
+void
+test_body_cache_hit (void)
+{
+    const gchar chunk[] = "message body";
+    MilterManagerTestClient *client1, *client2;
+
+    body_cache = milter_manager_verdict_cache_new("body", 16);
+    milter_manager_verdict_cache_store_key(body_cache, body_cache_key(chunk),
+                                           MILTER_STATUS_CONTINUE);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(8, n_continue_emitted);
+    milter_manager_children_end_of_message(children, NULL, 0);
+    wait_reply(9, n_continue_emitted);
+    milter_test_pump_all_events(loop);
+
+    cut_assert_equal_uint(1, milter_manager_verdict_cache_get_n_hits(body_cache));
+    client1 = g_list_nth_data(test_clients, 0);
+    client2 = g_list_nth_data(test_clients, 1);
+    cut_assert_equal_uint(
+        0, milter_manager_test_client_get_n_end_of_message_received(client1));
+    cut_assert_equal_uint(
+        1, milter_manager_test_client_get_n_end_of_message_received(client2));
+}
+
+void
+test_body_cache_modified (void)
+{
+    const gchar chunk[] = "message body";
+
+    arguments_append(arguments1,
+                     "--add-header", "X-Added:value",
+                     NULL);
+    body_cache = milter_manager_verdict_cache_new("body", 16);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(8, n_continue_emitted);
+    milter_manager_children_end_of_message(children, NULL, 0);
+    wait_reply(9, n_continue_emitted);
+    cut_assert_equal_uint(1, n_add_header_emitted);
+
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           milter_manager_verdict_cache_lookup_key(
+                               body_cache, body_cache_key(chunk)));
+}
+
+#define do_body_cache_replay(status, n_emitted)                     cut_trace_with_info_expression(                                     do_body_cache_replay_helper(status, &(n_emitted)),              do_body_cache_replay(status, n_emitted))
+
+static void
+do_body_cache_replay_helper (MilterStatus status, guint *n_emitted)
+{
+    const gchar chunk[] = "message body";
+    MilterManagerTestClient *client1;
+
+    body_cache = milter_manager_verdict_cache_new("body", 16);
+    milter_manager_verdict_cache_store_key(body_cache, body_cache_key(chunk),
+                                           status);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, chunk, strlen(chunk));
+    wait_reply(8, n_continue_emitted);
+    milter_manager_children_end_of_message(children, NULL, 0);
+    wait_reply(1, *n_emitted);
+    milter_test_pump_all_events(loop);
+
+    cut_assert_equal_uint(1, milter_manager_verdict_cache_get_n_hits(body_cache));
+    client1 = g_list_nth_data(test_clients, 0);
+    cut_assert_equal_uint(
+        0, milter_manager_test_client_get_n_end_of_message_received(client1));
+}
+
+void
+test_body_cache_reject (void)
+{
+    do_body_cache_replay(MILTER_STATUS_REJECT, n_reject_emitted);
+}
+
+void
+test_body_cache_temporary_failure (void)
+{
+    do_body_cache_replay(MILTER_STATUS_TEMPORARY_FAILURE,
+                         n_temporary_failure_emitted);
+}
+
+void
+test_body_spool (void)
+{
+    const gchar chunk[] = "message body";
+
+    cut_trace(test_body());
+
+    cut_assert_equal_uint(strlen(chunk),
+                          milter_manager_children_get_spooled_body_size(children));
+}
+
+void
+test_body_first_child_accept (void)
+{
+    const gchar first_chunk[] = "first chunk";
+    const gchar second_chunk[] = "second chunk";
+    MilterManagerTestClient *client2;
+
+    arguments_append(arguments1,
+                     "--action", "accept",
+                     "--body", first_chunk,
+                     NULL);
+    cut_trace(test_end_of_header());
+
+    milter_manager_children_body(children, first_chunk, strlen(first_chunk));
+    wait_reply(8, n_continue_emitted);
+    cut_assert_equal_uint(strlen(first_chunk),
+                          milter_manager_children_get_spooled_body_size(children));
+
+    /* No child is left after the second child. */
+    milter_manager_children_body(children, second_chunk, strlen(second_chunk));
+    wait_reply(9, n_continue_emitted);
+    cut_assert_equal_uint(strlen(first_chunk),
+                          milter_manager_children_get_spooled_body_size(children));
+
+    milter_test_pump_all_events(loop);
+    client2 = g_list_nth_data(test_clients, 1);
+    cut_assert_equal_string(cut_take_printf("%s%s", first_chunk, second_chunk),
+                            milter_manager_test_client_get_body_chunk(client2));
+}
+
+void
+test_body_max_data_size (void)
+{
+    const gchar *chunk;
+    gsize chunk_size = MILTER_CHUNK_SIZE + 1;
+    MilterManagerTestClient *client1, *client2;
+
+    arguments_append(arguments2,
+                     "--negotiate-flags", "max-data-size-256k",
+                     NULL);
+    cut_trace(test_end_of_header());
+
+    chunk = cut_take_string(g_strnfill(chunk_size, 'X'));
+    milter_manager_children_body(children, chunk, chunk_size);
+    wait_reply(8, n_continue_emitted);
+
+    milter_manager_children_end_of_message(children, NULL, 0);
+    wait_reply(9, n_continue_emitted);
+    milter_test_pump_all_events(loop);
+
+    client1 = g_list_nth_data(test_clients, 0);
+    client2 = g_list_nth_data(test_clients, 1);
+    cut_assert_equal_uint(2,
+                          milter_manager_test_client_get_n_body_received(client1));
+    cut_assert_equal_uint(1,
+                          milter_manager_test_client_get_n_body_received(client2));
+}
+
 #define is_important_status(children, state, next_status)                    \
     milter_manager_children_is_important_status(children, state, next_status)
 
@@ -2097,6 +2451,111 @@ test_reading_timeout (void)
         error_message->str);
 }
 
+void
+test_session_deadline (void)
+{
+    struct sockaddr_in address;
+    const gchar host_name[] = "mx.local.net";
+    const gchar ip_address[] = "192.168.123.123";
+    MilterManagerChild *child;
+
+    arguments_append(arguments2,
+                     "--action", "no_response",
+                     "--connect-host", host_name,
+                     "--wait-second", "10",
+                     NULL);
+    option = milter_option_new(6,
+                               MILTER_ACTION_ADD_HEADERS |
+                               MILTER_ACTION_CHANGE_BODY,
+                               step);
+    start_client(10026, arguments1);
+    start_client(10027, arguments2);
+
+    /* The session starts after the clients are ready. */
+    g_object_unref(children);
+    children = milter_manager_children_new(config, loop);
+    setup_signals(children);
+    milter_manager_configuration_set_session_deadline(config, 0.3);
+
+    add_child("milter@10026", "inet:10026@localhost");
+    add_child("milter@10027", "inet:10027@localhost");
+    milter_manager_children_negotiate(children, option, NULL);
+    wait_reply(1, n_negotiate_reply_emitted);
+
+    child = milter_manager_children_get_children(children)->next->data;
+    connect_timeout_signal(child, NULL);
+
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, ip_address, &(address.sin_addr));
+
+    /* The reading timeout is 10 seconds but the rest of the
+     * session deadline is used. */
+    milter_manager_children_connect(children,
+                                    host_name,
+                                    (struct sockaddr *)(&address),
+                                    sizeof(address));
+    wait_reply(1, n_continue_emitted);
+    cut_assert_equal_uint(1, n_reading_timeout_emitted);
+}
+
+void
+test_session_deadline_per_message (void)
+{
+    struct sockaddr_in address;
+    const gchar host_name[] = "mx.local.net";
+    const gchar ip_address[] = "192.168.123.123";
+    const gchar from[] = "example@example.com";
+    const gchar recipient[] = "example@example.com";
+
+    arguments_append(arguments1, "--reply-delay", "0.2", NULL);
+    arguments_append(arguments2, "--reply-delay", "0.2", NULL);
+    option = milter_option_new(6,
+                               MILTER_ACTION_ADD_HEADERS |
+                               MILTER_ACTION_CHANGE_BODY,
+                               step);
+    start_client(10026, arguments1);
+    start_client(10027, arguments2);
+
+    g_object_unref(children);
+    children = milter_manager_children_new(config, loop);
+    setup_signals(children);
+    milter_manager_configuration_set_session_deadline(config, 0.7);
+
+    add_child("milter@10026", "inet:10026@localhost");
+    add_child("milter@10027", "inet:10027@localhost");
+    milter_manager_children_negotiate(children, option, NULL);
+    wait_reply(1, n_negotiate_reply_emitted);
+    g_list_foreach(milter_manager_children_get_children(children),
+                   connect_timeout_signal, NULL);
+
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, ip_address, &(address.sin_addr));
+    milter_manager_children_connect(children,
+                                    host_name,
+                                    (struct sockaddr *)(&address),
+                                    sizeof(address));
+    wait_reply(1, n_continue_emitted);
+    milter_manager_children_helo(children, "delian");
+    wait_reply(2, n_continue_emitted);
+
+    /* Each message has its own deadline. The whole session
+     * takes more than the deadline. */
+    milter_manager_children_envelope_from(children, from);
+    wait_reply(3, n_continue_emitted);
+    milter_manager_children_envelope_recipient(children, recipient);
+    wait_reply(4, n_continue_emitted);
+    milter_manager_children_abort(children);
+
+    milter_manager_children_envelope_from(children, from);
+    wait_reply(5, n_continue_emitted);
+    milter_manager_children_envelope_recipient(children, recipient);
+    wait_reply(6, n_continue_emitted);
+
+    cut_assert_equal_uint(0, n_reading_timeout_emitted);
+}
+
 void
 test_end_of_message_with_protocol_version2 (void)
 {
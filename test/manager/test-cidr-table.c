@@ -0,0 +1,267 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-cidr-table.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_first_match_ipv4 (void);
+void test_network_match_ipv4 (void);
+void test_all_match_ipv4 (void);
+void test_first_match_ipv6 (void);
+void test_all_match_ipv6 (void);
+void test_family (void);
+void test_invalid_address (void);
+void test_invalid_prefix_length (void);
+void test_lookup_address (void);
+void test_lookup_ipv4_mapped_address (void);
+void test_lookup_ipv4_mapped_address_ipv6_network (void);
+void test_many_entries (void);
+
+static MilterManagerCIDRTable *table;
+static GError *expected_error;
+static GError *actual_error;
+
+void
+cut_setup (void)
+{
+    table = milter_manager_cidr_table_new();
+    expected_error = NULL;
+    actual_error = NULL;
+}
+
+void
+cut_teardown (void)
+{
+    if (table)
+        g_object_unref(table);
+    if (expected_error)
+        g_error_free(expected_error);
+    if (actual_error)
+        g_error_free(actual_error);
+}
+
+static void
+add (const gchar *network, const gchar *action)
+{
+    gcut_assert_error(actual_error);
+    milter_manager_cidr_table_add(table, network, action, &actual_error);
+    gcut_assert_error(actual_error);
+}
+
+void
+test_empty (void)
+{
+    cut_assert_equal_uint(0, milter_manager_cidr_table_get_n_entries(table));
+    cut_assert_null(milter_manager_cidr_table_lookup(table, "127.0.0.1"));
+}
+
+void
+test_first_match_ipv4 (void)
+{
+    cut_trace(add("192.168.1.1", "OK"));
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+
+    cut_assert_equal_string("OK",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "192.168.1.1"));
+}
+
+void
+test_network_match_ipv4 (void)
+{
+    cut_trace(add("192.168.1.1", "OK"));
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "192.168.1.29"));
+    cut_assert_null(milter_manager_cidr_table_lookup(table, "192.168.2.1"));
+}
+
+void
+test_all_match_ipv4 (void)
+{
+    cut_trace(add("0.0.0.0/0", "OK"));
+    cut_trace(add("192.168.1.1", "REJECT"));
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+
+    cut_assert_equal_string("OK",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "192.168.1.1"));
+}
+
+void
+test_first_match_ipv6 (void)
+{
+    cut_trace(add("2001:2f8:c2:201::fff0", "OK"));
+    cut_trace(add("2001:2f8:c2:201::0/64", "REJECT"));
+
+    cut_assert_equal_string("OK",
+                            milter_manager_cidr_table_lookup(
+                                table, "2001:2f8:c2:201::fff0"));
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup(
+                                table, "2001:2f8:c2:201::1"));
+}
+
+void
+test_all_match_ipv6 (void)
+{
+    cut_trace(add("::/0", "OK"));
+    cut_trace(add("2001:2f8:c2:201::fff0", "REJECT"));
+
+    cut_assert_equal_string("OK",
+                            milter_manager_cidr_table_lookup(
+                                table, "2001:2f8:c2:201::fff0"));
+}
+
+void
+test_family (void)
+{
+    cut_trace(add("0.0.0.0/0", "IPv4"));
+
+    cut_assert_null(milter_manager_cidr_table_lookup(table, "::1"));
+    cut_assert_null(milter_manager_cidr_table_lookup(table, "localhost"));
+}
+
+void
+test_invalid_address (void)
+{
+    expected_error = g_error_new(MILTER_MANAGER_CIDR_TABLE_ERROR,
+                                 MILTER_MANAGER_CIDR_TABLE_ERROR_INVALID_ADDRESS,
+                                 "invalid address: <192.168.1>");
+    cut_assert_false(milter_manager_cidr_table_add(table, "192.168.1", "OK",
+                                                   &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+    cut_assert_equal_uint(0, milter_manager_cidr_table_get_n_entries(table));
+}
+
+void
+test_invalid_prefix_length (void)
+{
+    expected_error = g_error_new(MILTER_MANAGER_CIDR_TABLE_ERROR,
+                                 MILTER_MANAGER_CIDR_TABLE_ERROR_INVALID_ADDRESS,
+                                 "invalid prefix length: <192.168.1.0/33>");
+    cut_assert_false(milter_manager_cidr_table_add(table, "192.168.1.0/33",
+                                                   "OK", &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+    cut_assert_equal_uint(0, milter_manager_cidr_table_get_n_entries(table));
+}
+
+void
+test_lookup_address (void)
+{
+    struct sockaddr_in address;
+
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(2929);
+    inet_pton(AF_INET, "192.168.1.29", &(address.sin_addr));
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup_address(
+                                table,
+                                (struct sockaddr *)&address,
+                                sizeof(address)));
+}
+
+void
+test_lookup_ipv4_mapped_address (void)
+{
+    struct sockaddr_in6 address;
+
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup(
+                                table, "::ffff:192.168.1.29"));
+
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    address.sin6_port = htons(2929);
+    inet_pton(AF_INET6, "::ffff:192.168.1.29", &(address.sin6_addr));
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup_address(
+                                table,
+                                (struct sockaddr *)&address,
+                                sizeof(address)));
+
+    inet_pton(AF_INET6, "::ffff:192.168.2.29", &(address.sin6_addr));
+    cut_assert_null(milter_manager_cidr_table_lookup_address(
+                        table,
+                        (struct sockaddr *)&address,
+                        sizeof(address)));
+}
+
+void
+test_lookup_ipv4_mapped_address_ipv6_network (void)
+{
+    cut_trace(add("::ffff:0:0/96", "IPv4-mapped"));
+    cut_trace(add("192.168.1.0/24", "REJECT"));
+    cut_trace(add("::/0", "IPv6"));
+
+    cut_assert_equal_string("IPv4-mapped",
+                            milter_manager_cidr_table_lookup(
+                                table, "::ffff:192.168.1.29"));
+    cut_assert_equal_string("REJECT",
+                            milter_manager_cidr_table_lookup(
+                                table, "192.168.1.29"));
+    cut_assert_equal_string("IPv6",
+                            milter_manager_cidr_table_lookup(
+                                table, "2001:db8::1"));
+}
+
+void
+test_many_entries (void)
+{
+    guint i;
+
+    for (i = 0; i < 256 * 64; i++) {
+        gchar *network, *action;
+
+        network = g_strdup_printf("10.%u.%u.0/24", i / 256, i % 256);
+        action = g_strdup_printf("network %u", i);
+        cut_trace(add(network, action));
+        g_free(network);
+        g_free(action);
+    }
+    cut_trace(add("10.0.0.0/8", "fallback"));
+
+    cut_assert_equal_string("network 0",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "10.0.0.1"));
+    cut_assert_equal_string("network 16383",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "10.63.255.1"));
+    cut_assert_equal_string("fallback",
+                            milter_manager_cidr_table_lookup(table,
+                                                             "10.64.0.1"));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,161 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-circuit-breaker.h>
+#include <milter/manager/milter-manager-enum-types.h>
+
+#include <gcutter.h>
+
+void test_disabled (void);
+void test_open (void);
+void test_success_resets_failures (void);
+void test_half_open (void);
+void test_half_open_success (void);
+void test_half_open_failure (void);
+void test_slow (void);
+
+static MilterManagerCircuitBreaker *breaker;
+
+void
+cut_setup (void)
+{
+    breaker = milter_manager_circuit_breaker_new("milter@10026");
+    milter_manager_circuit_breaker_set_failure_threshold(breaker, 3);
+    milter_manager_circuit_breaker_set_open_time(breaker, 60);
+}
+
+void
+cut_teardown (void)
+{
+    if (breaker)
+        g_object_unref(breaker);
+}
+
+#define cut_assert_equal_state(expected, actual)                        \
+    gcut_assert_equal_enum(MILTER_TYPE_MANAGER_CIRCUIT_BREAKER_STATE,   \
+                           expected, actual)
+
+static void
+record_failures (guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        milter_manager_circuit_breaker_record_failure(breaker);
+    }
+}
+
+void
+test_disabled (void)
+{
+    milter_manager_circuit_breaker_set_failure_threshold(breaker, 0);
+    record_failures(10);
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED,
+                           milter_manager_circuit_breaker_get_state(breaker));
+}
+
+void
+test_open (void)
+{
+    record_failures(2);
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED,
+                           milter_manager_circuit_breaker_get_state(breaker));
+
+    record_failures(1);
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN,
+                           milter_manager_circuit_breaker_get_state(breaker));
+    cut_assert_false(milter_manager_circuit_breaker_try(breaker));
+}
+
+void
+test_success_resets_failures (void)
+{
+    record_failures(2);
+    milter_manager_circuit_breaker_record_success(breaker, 0.1);
+    cut_assert_equal_uint(0,
+                          milter_manager_circuit_breaker_get_n_failures(breaker));
+
+    record_failures(2);
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED,
+                           milter_manager_circuit_breaker_get_state(breaker));
+}
+
+void
+test_half_open (void)
+{
+    milter_manager_circuit_breaker_set_open_time(breaker, 0);
+    record_failures(3);
+
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_HALF_OPEN,
+                           milter_manager_circuit_breaker_get_state(breaker));
+
+    milter_manager_circuit_breaker_set_open_time(breaker, 60);
+    cut_assert_false(milter_manager_circuit_breaker_try(breaker));
+}
+
+void
+test_half_open_success (void)
+{
+    milter_manager_circuit_breaker_set_open_time(breaker, 0);
+    record_failures(3);
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+
+    milter_manager_circuit_breaker_record_success(breaker, 0.1);
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_CLOSED,
+                           milter_manager_circuit_breaker_get_state(breaker));
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+}
+
+void
+test_half_open_failure (void)
+{
+    milter_manager_circuit_breaker_set_open_time(breaker, 0);
+    record_failures(3);
+    cut_assert_true(milter_manager_circuit_breaker_try(breaker));
+
+    milter_manager_circuit_breaker_set_open_time(breaker, 60);
+    record_failures(1);
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN,
+                           milter_manager_circuit_breaker_get_state(breaker));
+    cut_assert_false(milter_manager_circuit_breaker_try(breaker));
+}
+
+void
+test_slow (void)
+{
+    milter_manager_circuit_breaker_set_slow_time(breaker, 5);
+
+    milter_manager_circuit_breaker_record_success(breaker, 4.9);
+    cut_assert_equal_uint(0,
+                          milter_manager_circuit_breaker_get_n_failures(breaker));
+
+    milter_manager_circuit_breaker_record_success(breaker, 5.0);
+    milter_manager_circuit_breaker_record_success(breaker, 10.0);
+    milter_manager_circuit_breaker_record_success(breaker, 7.0);
+    cut_assert_equal_state(MILTER_MANAGER_CIRCUIT_BREAKER_STATE_OPEN,
+                           milter_manager_circuit_breaker_get_state(breaker));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,306 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-condition-rule.h>
+#include <milter/server.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_address_ipv4 (void);
+void test_address_ipv6 (void);
+void test_address_ipv4_mapped (void);
+void test_address_ipv4_mapped_ipv6_network (void);
+void test_address_invalid (void);
+void test_address_invalid_prefix_length (void);
+void test_domain (void);
+void test_domain_sub_domain_only (void);
+void test_domain_envelope (void);
+void test_regex (void);
+void test_regex_invalid (void);
+void test_macro (void);
+void test_all_sets (void);
+
+static MilterManagerConditionRule *rule;
+static MilterServerContext *agent;
+static GError *expected_error;
+static GError *actual_error;
+
+void
+cut_setup (void)
+{
+    rule = milter_manager_condition_rule_new(
+        MILTER_MANAGER_CONDITION_STAGE_CONNECT,
+        MILTER_MANAGER_CONDITION_ACTION_STOP);
+    agent = NULL;
+    expected_error = NULL;
+    actual_error = NULL;
+}
+
+void
+cut_teardown (void)
+{
+    if (rule)
+        g_object_unref(rule);
+    if (agent)
+        g_object_unref(agent);
+    if (expected_error)
+        g_error_free(expected_error);
+    if (actual_error)
+        g_error_free(actual_error);
+}
+
+static void
+reset_rule (MilterManagerConditionStage stage)
+{
+    g_object_unref(rule);
+    rule = milter_manager_condition_rule_new(
+        stage, MILTER_MANAGER_CONDITION_ACTION_STOP);
+}
+
+static gboolean
+match_ipv4 (const gchar *ip_address)
+{
+    struct sockaddr_in address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, ip_address, &(address.sin_addr));
+    return milter_manager_condition_rule_match(rule, NULL, NULL,
+                                               (struct sockaddr *)&address,
+                                               sizeof(address));
+}
+
+static gboolean
+match_ipv6 (const gchar *ip_address)
+{
+    struct sockaddr_in6 address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, ip_address, &(address.sin6_addr));
+    return milter_manager_condition_rule_match(rule, NULL, NULL,
+                                               (struct sockaddr *)&address,
+                                               sizeof(address));
+}
+
+static gboolean
+match_subject (const gchar *subject)
+{
+    return milter_manager_condition_rule_match(rule, NULL, subject, NULL, 0);
+}
+
+void
+test_empty (void)
+{
+    cut_assert_true(match_subject("mx.example.com"));
+    cut_assert_true(match_ipv4("192.168.1.1"));
+}
+
+void
+test_address_ipv4 (void)
+{
+    cut_assert_true(milter_manager_condition_rule_add_address(rule,
+                                                              "192.168.0.0/16",
+                                                              NULL));
+    cut_assert_true(milter_manager_condition_rule_add_address(rule,
+                                                              "10.0.0.1",
+                                                              NULL));
+
+    cut_assert_true(match_ipv4("192.168.1.1"));
+    cut_assert_false(match_ipv4("192.169.1.1"));
+    cut_assert_true(match_ipv4("10.0.0.1"));
+    cut_assert_false(match_ipv4("10.0.0.2"));
+    cut_assert_false(match_ipv6("::1"));
+    cut_assert_false(match_subject("192.168.1.1"));
+}
+
+void
+test_address_ipv6 (void)
+{
+    cut_assert_true(milter_manager_condition_rule_add_address(rule,
+                                                              "2001:db8::/32",
+                                                              NULL));
+
+    cut_assert_true(match_ipv6("2001:db8::1"));
+    cut_assert_false(match_ipv6("2001:db9::1"));
+    cut_assert_false(match_ipv4("192.168.1.1"));
+}
+
+void
+test_address_ipv4_mapped (void)
+{
+    cut_assert_true(milter_manager_condition_rule_add_address(rule,
+                                                              "192.168.0.0/16",
+                                                              NULL));
+
+    cut_assert_true(match_ipv6("::ffff:192.168.1.1"));
+    cut_assert_false(match_ipv6("::ffff:10.0.0.1"));
+}
+
+void
+test_address_ipv4_mapped_ipv6_network (void)
+{
+    cut_assert_true(milter_manager_condition_rule_add_address(rule,
+                                                              "::/0",
+                                                              NULL));
+
+    cut_assert_true(match_ipv6("::ffff:10.0.0.1"));
+    cut_assert_true(match_ipv6("2001:db8::1"));
+    cut_assert_false(match_ipv4("10.0.0.1"));
+}
+
+void
+test_address_invalid (void)
+{
+    expected_error = g_error_new(MILTER_MANAGER_CONDITION_RULE_ERROR,
+                                 MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_ADDRESS,
+                                 "invalid address: <192.168.0/16>");
+    cut_assert_false(milter_manager_condition_rule_add_address(rule,
+                                                               "192.168.0/16",
+                                                               &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+}
+
+void
+test_address_invalid_prefix_length (void)
+{
+    expected_error = g_error_new(MILTER_MANAGER_CONDITION_RULE_ERROR,
+                                 MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_ADDRESS,
+                                 "invalid prefix length: <192.168.0.0/33>");
+    cut_assert_false(milter_manager_condition_rule_add_address(rule,
+                                                               "192.168.0.0/33",
+                                                               &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+}
+
+void
+test_domain (void)
+{
+    milter_manager_condition_rule_add_domain(rule, "example.com");
+
+    cut_assert_true(match_subject("example.com"));
+    cut_assert_true(match_subject("mx.Example.COM."));
+    cut_assert_true(match_subject("a.b.example.com"));
+    cut_assert_false(match_subject("example.org"));
+    cut_assert_false(match_subject("badexample.com"));
+    cut_assert_false(match_subject("com"));
+}
+
+void
+test_domain_sub_domain_only (void)
+{
+    milter_manager_condition_rule_add_domain(rule, ".example.com");
+
+    cut_assert_false(match_subject("example.com"));
+    cut_assert_true(match_subject("mx.example.com"));
+}
+
+void
+test_domain_envelope (void)
+{
+    reset_rule(MILTER_MANAGER_CONDITION_STAGE_ENVELOPE_FROM);
+    milter_manager_condition_rule_add_domain(rule, "example.com");
+
+    cut_assert_true(match_subject("<user@example.com>"));
+    cut_assert_true(match_subject("user@sub.example.com"));
+    cut_assert_false(match_subject("<example.com@example.org>"));
+    cut_assert_false(match_subject("<>"));
+}
+
+void
+test_regex (void)
+{
+    cut_assert_true(milter_manager_condition_rule_add_regex(rule,
+                                                            "\\A\\[.+\\]\\z",
+                                                            NULL));
+    cut_assert_true(milter_manager_condition_rule_add_regex(rule,
+                                                            "(?i)\\Adhcp",
+                                                            NULL));
+
+    cut_assert_true(match_subject("[192.168.1.1]"));
+    cut_assert_true(match_subject("DHCP-1.example.com"));
+    cut_assert_false(match_subject("mx.dhcp.example.com"));
+}
+
+void
+test_regex_invalid (void)
+{
+    cut_assert_false(milter_manager_condition_rule_add_regex(rule, "(",
+                                                             &actual_error));
+    cut_assert_not_null(actual_error);
+    cut_assert_equal_int(MILTER_MANAGER_CONDITION_RULE_ERROR_INVALID_REGEX,
+                         actual_error->code);
+
+    cut_assert_true(match_subject("anything"));
+}
+
+void
+test_macro (void)
+{
+    agent = milter_server_context_new();
+    milter_protocol_agent_set_macro_context(MILTER_PROTOCOL_AGENT(agent),
+                                            MILTER_COMMAND_CONNECT);
+    milter_protocol_agent_set_macro(MILTER_PROTOCOL_AGENT(agent),
+                                    MILTER_COMMAND_CONNECT,
+                                    "daemon_name", "submission");
+    milter_manager_condition_rule_add_macro(rule, "{daemon_name}", "submission");
+
+    cut_assert_true(milter_manager_condition_rule_match(
+                        rule, MILTER_PROTOCOL_AGENT(agent), NULL, NULL, 0));
+    cut_assert_false(milter_manager_condition_rule_match(rule, NULL,
+                                                         NULL, NULL, 0));
+
+    milter_protocol_agent_set_macro(MILTER_PROTOCOL_AGENT(agent),
+                                    MILTER_COMMAND_CONNECT,
+                                    "daemon_name", "smtp");
+    cut_assert_false(milter_manager_condition_rule_match(
+                         rule, MILTER_PROTOCOL_AGENT(agent), NULL, NULL, 0));
+}
+
+void
+test_all_sets (void)
+{
+    struct sockaddr_in address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.1.1", &(address.sin_addr));
+
+    milter_manager_condition_rule_add_address(rule, "0.0.0.0/0", NULL);
+    milter_manager_condition_rule_add_regex(rule, "\\A\\[.+\\]\\z", NULL);
+
+    cut_assert_true(milter_manager_condition_rule_match(
+                        rule, NULL, "[192.168.1.1]",
+                        (struct sockaddr *)&address, sizeof(address)));
+    cut_assert_false(milter_manager_condition_rule_match(
+                         rule, NULL, "mx.example.com",
+                         (struct sockaddr *)&address, sizeof(address)));
+    cut_assert_false(milter_manager_condition_rule_match(
+                         rule, NULL, "[192.168.1.1]", NULL, 0));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -61,6 +61,17 @@ void test_syslog_facility (void);
 void test_chunk_size (void);
 void test_chunk_size_over (void);
 void test_max_pending_finished_sessions (void);
+void test_session_deadline (void);
+void test_adaptive_max_connections (void);
+void test_load_shedding (void);
+void test_reuse_port (void);
+void test_pin_workers (void);
+void test_n_io_threads (void);
+void test_mirror_buffer_size (void);
+void test_setup_mirror_children (void);
+void test_thread_safe (void);
+void test_copy (void);
+void test_share_runtime_state (void);
 void test_egg (void);
 void test_find_egg (void);
 void test_remove_egg (void);
@@ -75,6 +86,7 @@ void test_to_xml_full (void);
 void test_to_xml_signal (void);
 
 static MilterManagerConfiguration *config;
+static MilterManagerConfiguration *copied_config;
 static MilterEventLoop *loop;
 static MilterManagerEgg *egg;
 static MilterManagerEgg *another_egg;
@@ -96,6 +108,7 @@ void
 cut_setup (void)
 {
     config = milter_manager_configuration_new(NULL);
+    copied_config = NULL;
     loop = milter_test_event_loop_new();
 
     egg = NULL;
@@ -125,6 +138,8 @@ cut_teardown (void)
 {
     if (config)
         g_object_unref(config);
+    if (copied_config)
+        g_object_unref(copied_config);
     if (loop)
         g_object_unref(loop);
     if (egg)
@@ -614,7 +629,7 @@ void
 test_chunk_size (void)
 {
     cut_assert_equal_uint(
-        MILTER_CHUNK_SIZE,
+        MILTER_MAX_DATA_SIZE_1M,
         milter_manager_configuration_get_chunk_size(config));
     milter_manager_configuration_set_chunk_size(config, 29);
     cut_assert_equal_uint(
@@ -625,9 +640,10 @@ test_chunk_size (void)
 void
 test_chunk_size_over (void)
 {
-    milter_manager_configuration_set_chunk_size(config, MILTER_CHUNK_SIZE + 1);
+    milter_manager_configuration_set_chunk_size(config,
+                                                MILTER_MAX_DATA_SIZE_1M + 1);
     cut_assert_equal_uint(
-        MILTER_CHUNK_SIZE,
+        MILTER_MAX_DATA_SIZE_1M,
         milter_manager_configuration_get_chunk_size(config));
 }
 
@@ -643,6 +659,113 @@ test_max_pending_finished_sessions (void)
         milter_manager_configuration_get_max_pending_finished_sessions(config));
 }
 
+void
+test_session_deadline (void)
+{
+    cut_assert_equal_double(
+        0, 0.001,
+        milter_manager_configuration_get_session_deadline(config));
+    milter_manager_configuration_set_session_deadline(config, 240);
+    cut_assert_equal_double(
+        240, 0.001,
+        milter_manager_configuration_get_session_deadline(config));
+}
+
+void
+test_adaptive_max_connections (void)
+{
+    cut_assert_false(
+        milter_manager_configuration_is_adaptive_max_connections(config));
+    milter_manager_configuration_set_adaptive_max_connections(config, TRUE);
+    cut_assert_true(
+        milter_manager_configuration_is_adaptive_max_connections(config));
+}
+
+void
+test_load_shedding (void)
+{
+    cut_assert_false(milter_manager_configuration_is_load_shedding(config));
+    cut_assert_null(milter_manager_configuration_get_stress_detector(config));
+    milter_manager_configuration_set_load_shedding(config, TRUE);
+    cut_assert_true(milter_manager_configuration_is_load_shedding(config));
+    cut_assert_not_null(
+        milter_manager_configuration_get_stress_detector(config));
+}
+
+void
+test_reuse_port (void)
+{
+    cut_assert_false(milter_manager_configuration_is_reuse_port(config));
+    milter_manager_configuration_set_reuse_port(config, TRUE);
+    cut_assert_true(milter_manager_configuration_is_reuse_port(config));
+}
+
+void
+test_pin_workers (void)
+{
+    cut_assert_false(milter_manager_configuration_is_pin_workers(config));
+    milter_manager_configuration_set_pin_workers(config, TRUE);
+    cut_assert_true(milter_manager_configuration_is_pin_workers(config));
+}
+
+void
+test_n_io_threads (void)
+{
+    cut_assert_equal_uint(0,
+                          milter_manager_configuration_get_n_io_threads(config));
+    milter_manager_configuration_set_n_io_threads(config, 4);
+    cut_assert_equal_uint(4,
+                          milter_manager_configuration_get_n_io_threads(config));
+}
+
+void
+test_mirror_buffer_size (void)
+{
+    cut_assert_equal_uint(
+        0,
+        milter_manager_configuration_get_mirror_buffer_size(config));
+    milter_manager_configuration_set_mirror_buffer_size(config, 1048576);
+    cut_assert_equal_uint(
+        1048576,
+        milter_manager_configuration_get_mirror_buffer_size(config));
+}
+
+void
+test_setup_mirror_children (void)
+{
+    MilterManagerEgg *evaluation_egg;
+    MilterManagerChildren *mirror_children;
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, "inet:2929@localhost", &error);
+    gcut_assert_error(error);
+    milter_manager_configuration_add_egg(config, egg);
+
+    evaluation_egg = milter_manager_egg_new("evaluation-milter");
+    milter_manager_egg_set_connection_spec(evaluation_egg,
+                                           "inet:29292@localhost", &error);
+    gcut_assert_error(error);
+    milter_manager_egg_set_evaluation_mode(evaluation_egg, TRUE);
+    milter_manager_configuration_add_egg(config, evaluation_egg);
+    g_object_unref(evaluation_egg);
+
+    milter_manager_configuration_set_mirror_buffer_size(config, 1048576);
+
+    if (actual_children)
+        g_object_unref(actual_children);
+    actual_children = milter_manager_children_new(config, loop);
+    milter_manager_configuration_setup_children(config, actual_children, NULL);
+    cut_assert_equal_uint(1, milter_manager_children_length(actual_children));
+
+    mirror_children = milter_manager_children_new(config, loop);
+    gcut_take_object(G_OBJECT(mirror_children));
+    milter_manager_configuration_setup_mirror_children(config,
+                                                       mirror_children,
+                                                       NULL);
+    cut_assert_equal_uint(1, milter_manager_children_length(mirror_children));
+}
+
 static void
 milter_assert_default_configuration_helper (MilterManagerConfiguration *config)
 {
@@ -735,13 +858,30 @@ milter_assert_default_configuration_helper (MilterManagerConfiguration *config)
         milter_manager_configuration_get_syslog_facility(config));
 
     cut_assert_equal_uint(
-        MILTER_CHUNK_SIZE,
+        MILTER_MAX_DATA_SIZE_1M,
         milter_manager_configuration_get_chunk_size(config));
 
     cut_assert_equal_uint(
         0,
         milter_manager_configuration_get_max_pending_finished_sessions(config));
 
+    cut_assert_equal_double(
+        0, 0.001,
+        milter_manager_configuration_get_session_deadline(config));
+
+    cut_assert_false(
+        milter_manager_configuration_is_adaptive_max_connections(config));
+
+    cut_assert_false(milter_manager_configuration_is_load_shedding(config));
+
+    cut_assert_false(milter_manager_configuration_is_reuse_port(config));
+    cut_assert_false(milter_manager_configuration_is_pin_workers(config));
+    cut_assert_equal_uint(0,
+                          milter_manager_configuration_get_n_io_threads(config));
+    cut_assert_equal_uint(
+        0,
+        milter_manager_configuration_get_mirror_buffer_size(config));
+
     if (expected_children)
         g_object_unref(expected_children);
     expected_children = milter_manager_children_new(config, loop);
@@ -936,6 +1076,83 @@ cb_connected (MilterManagerConfiguration *configuration,
     return TRUE;
 }
 
+void
+test_thread_safe (void)
+{
+    cut_assert_true(milter_manager_configuration_is_thread_safe(config));
+
+    milter_manager_configuration_set_privilege_mode(config, TRUE);
+    cut_assert_false(milter_manager_configuration_is_thread_safe(config));
+    milter_manager_configuration_set_privilege_mode(config, FALSE);
+
+    g_signal_connect(config, "connected", G_CALLBACK(cb_connected), NULL);
+    cut_assert_false(milter_manager_configuration_is_thread_safe(config));
+}
+
+void
+test_copy (void)
+{
+    MilterManagerEgg *copied_egg;
+    const GList *copied_conditions;
+    GError *error = NULL;
+
+    milter_manager_configuration_set_max_connections(config, 29);
+    condition = milter_manager_applicable_condition_new("S25R");
+    milter_manager_configuration_add_applicable_condition(config, condition);
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, "inet:2929@localhost", &error);
+    gcut_assert_error(error);
+    milter_manager_egg_add_applicable_condition(egg, condition);
+    milter_manager_configuration_add_egg(config, egg);
+
+    copied_config = milter_manager_configuration_copy(config, &error);
+    gcut_assert_error(error);
+
+    cut_assert_equal_uint(
+        29,
+        milter_manager_configuration_get_max_connections(copied_config));
+
+    copied_egg = milter_manager_configuration_find_egg(copied_config,
+                                                       "child-milter");
+    cut_assert_not_null(copied_egg);
+    cut_assert_true(copied_egg != egg);
+    cut_assert_equal_string("inet:2929@localhost",
+                            milter_manager_egg_get_connection_spec(copied_egg));
+
+    copied_conditions =
+        milter_manager_egg_get_applicable_conditions(copied_egg);
+    cut_assert_equal_uint(1, g_list_length((GList *)copied_conditions));
+    cut_assert_true(copied_conditions->data != condition);
+    cut_assert_true(copied_conditions->data ==
+                    milter_manager_configuration_find_applicable_condition(
+                        copied_config, "S25R"));
+}
+
+void
+test_share_runtime_state (void)
+{
+    MilterManagerEgg *copied_egg;
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_circuit_breaker_threshold(egg, 3);
+    milter_manager_egg_set_max_concurrent_sessions(egg, 2);
+    milter_manager_configuration_add_egg(config, egg);
+
+    copied_config = milter_manager_configuration_copy(config, &error);
+    gcut_assert_error(error);
+    milter_manager_configuration_share_runtime_state(copied_config, config);
+
+    copied_egg = milter_manager_configuration_find_egg(copied_config,
+                                                       "child-milter");
+    cut_assert_not_null(milter_manager_egg_get_circuit_breaker(egg));
+    cut_assert_true(milter_manager_egg_get_circuit_breaker(copied_egg) ==
+                    milter_manager_egg_get_circuit_breaker(egg));
+    cut_assert_not_null(milter_manager_egg_get_session_limiter(egg));
+    cut_assert_true(milter_manager_egg_get_session_limiter(copied_egg) ==
+                    milter_manager_egg_get_session_limiter(egg));
+}
+
 void
 test_clear (void)
 {
@@ -966,6 +1183,13 @@ test_clear (void)
     test_syslog_facility();
     test_chunk_size();
     test_max_pending_finished_sessions();
+    test_session_deadline();
+    test_adaptive_max_connections();
+    test_load_shedding();
+    test_reuse_port();
+    test_pin_workers();
+    test_n_io_threads();
+    test_mirror_buffer_size();
 
     handler_id = g_signal_connect(config, "connected",
                                   G_CALLBACK(cb_connected), NULL);
@@ -0,0 +1,270 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-connection-table.h>
+
+#include <gcutter.h>
+
+void test_load_proc_net_tcp (void);
+void test_load_proc_net_tcp_close_wait (void);
+void test_load_proc_net_tcp_listen (void);
+void test_load_proc_net_tcp6 (void);
+void test_load_proc_net_tcp6_v4_mapped (void);
+void test_load_proc_net_tcp_invalid_format (void);
+void test_load_proc_net_tcp_nonexistent (void);
+void test_lookup_invalid_address (void);
+void test_clear (void);
+
+static MilterManagerConnectionTable *table;
+static gchar *tmp_dir;
+static gchar *proc_net_tcp_path;
+static GString *proc_net_tcp;
+
+void
+cut_setup (void)
+{
+    table = milter_manager_connection_table_new();
+
+    tmp_dir = g_build_filename(milter_test_get_base_dir(),
+                               "tmp",
+                               NULL);
+    cut_remove_path(tmp_dir, NULL);
+    if (g_mkdir_with_parents(tmp_dir, 0700) == -1)
+        cut_assert_errno();
+    proc_net_tcp_path = g_build_filename(tmp_dir, "tcp", NULL);
+
+    proc_net_tcp = g_string_new("  sl  local_address rem_address   st "
+                                "tx_queue rx_queue tr tm->when retrnsmt   "
+                                "uid  timeout inode\n");
+}
+
+void
+cut_teardown (void)
+{
+    if (table)
+        g_object_unref(table);
+
+    if (proc_net_tcp)
+        g_string_free(proc_net_tcp, TRUE);
+    if (proc_net_tcp_path)
+        g_free(proc_net_tcp_path);
+
+    if (tmp_dir) {
+        cut_remove_path(tmp_dir, NULL);
+        g_free(tmp_dir);
+    }
+}
+
+/* Formats an address as /proc/net/tcp{,6}: 32bit words in host byte order. */
+static void
+append_hex_address (gint family, const gchar *address)
+{
+    guint8 binary_address[16];
+    gsize i, n_words;
+
+    cut_assert_equal_int(1, inet_pton(family, address, binary_address));
+    n_words = (family == AF_INET) ? 1 : 4;
+    for (i = 0; i < n_words; i++) {
+        guint32 word;
+
+        memcpy(&word, binary_address + i * 4, 4);
+        g_string_append_printf(proc_net_tcp, "%08X", word);
+    }
+}
+
+static void
+append_connection (gint family,
+                   const gchar *local_address, guint local_port,
+                   const gchar *foreign_address, guint foreign_port,
+                   guint state)
+{
+    g_string_append(proc_net_tcp, "   0: ");
+    append_hex_address(family, local_address);
+    g_string_append_printf(proc_net_tcp, ":%04X ", local_port);
+    append_hex_address(family, foreign_address);
+    g_string_append_printf(proc_net_tcp, ":%04X ", foreign_port);
+    g_string_append_printf(proc_net_tcp,
+                           "%02X 00000000:00000000 00:00000000 00000000"
+                           "     0        0 12345 1 0000000000000000 "
+                           "20 4 30 10 -1\n",
+                           state);
+}
+
+static void
+load (gint family)
+{
+    GError *error = NULL;
+
+    g_file_set_contents(proc_net_tcp_path,
+                        proc_net_tcp->str, proc_net_tcp->len,
+                        &error);
+    gcut_assert_error(error);
+
+    milter_manager_connection_table_load_proc_net_tcp(table,
+                                                      proc_net_tcp_path,
+                                                      family,
+                                                      &error);
+    gcut_assert_error(error);
+}
+
+void
+test_load_proc_net_tcp (void)
+{
+    const MilterManagerConnectionInfo *info;
+
+    append_connection(AF_INET, "192.168.1.2", 25, "192.168.1.100", 50001, 1);
+    append_connection(AF_INET, "192.168.1.2", 25, "192.168.1.101", 50002, 1);
+    cut_trace(load(AF_INET));
+
+    cut_assert_equal_uint(2, milter_manager_connection_table_size(table));
+
+    info = milter_manager_connection_table_lookup(table,
+                                                  "192.168.1.100", 50001);
+    cut_assert_not_null(info);
+    cut_assert_equal_int(AF_INET, info->family);
+    cut_assert_equal_string("192.168.1.2", info->local_address);
+    cut_assert_equal_uint(25, info->local_port);
+    cut_assert_equal_string("192.168.1.100", info->foreign_address);
+    cut_assert_equal_uint(50001, info->foreign_port);
+    cut_assert_equal_string("ESTABLISHED", info->state);
+
+    cut_assert_null(milter_manager_connection_table_lookup(table,
+                                                           "192.168.1.100",
+                                                           50002));
+}
+
+void
+test_load_proc_net_tcp_close_wait (void)
+{
+    const MilterManagerConnectionInfo *info;
+
+    append_connection(AF_INET, "127.0.0.1", 25, "127.0.0.1", 41234, 8);
+    cut_trace(load(AF_INET));
+
+    info = milter_manager_connection_table_lookup(table, "127.0.0.1", 41234);
+    cut_assert_not_null(info);
+    cut_assert_equal_string("CLOSE_WAIT", info->state);
+}
+
+void
+test_load_proc_net_tcp_listen (void)
+{
+    append_connection(AF_INET, "0.0.0.0", 25, "0.0.0.0", 0, 10);
+    append_connection(AF_INET, "127.0.0.1", 25, "127.0.0.1", 41234, 1);
+    cut_trace(load(AF_INET));
+
+    cut_assert_equal_uint(1, milter_manager_connection_table_size(table));
+}
+
+void
+test_load_proc_net_tcp6 (void)
+{
+    const MilterManagerConnectionInfo *info;
+
+    append_connection(AF_INET6, "2001:db8::1", 25, "2001:db8::2", 41234, 1);
+    cut_trace(load(AF_INET6));
+
+    info = milter_manager_connection_table_lookup(table,
+                                                  "2001:0db8:0:0::2", 41234);
+    cut_assert_not_null(info);
+    cut_assert_equal_int(AF_INET6, info->family);
+    cut_assert_equal_string("2001:db8::1", info->local_address);
+    cut_assert_equal_string("2001:db8::2", info->foreign_address);
+}
+
+void
+test_load_proc_net_tcp6_v4_mapped (void)
+{
+    const MilterManagerConnectionInfo *info;
+
+    append_connection(AF_INET6,
+                      "::ffff:192.168.1.2", 25,
+                      "::ffff:192.168.1.100", 50001,
+                      1);
+    cut_trace(load(AF_INET6));
+
+    info = milter_manager_connection_table_lookup(table,
+                                                  "192.168.1.100", 50001);
+    cut_assert_not_null(info);
+    cut_assert_equal_string("192.168.1.2", info->local_address);
+}
+
+void
+test_load_proc_net_tcp_invalid_format (void)
+{
+    GError *error = NULL;
+
+    g_string_append(proc_net_tcp, "   0: XYZ\n");
+    g_file_set_contents(proc_net_tcp_path,
+                        proc_net_tcp->str, proc_net_tcp->len,
+                        &error);
+    gcut_assert_error(error);
+
+    cut_assert_false(milter_manager_connection_table_load_proc_net_tcp(
+                         table, proc_net_tcp_path, AF_INET, &error));
+    cut_assert_true(g_error_matches(error,
+                                    MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                                    MILTER_MANAGER_CONNECTION_TABLE_ERROR_INVALID_FORMAT));
+    g_error_free(error);
+}
+
+void
+test_load_proc_net_tcp_nonexistent (void)
+{
+    GError *error = NULL;
+
+    cut_assert_false(milter_manager_connection_table_load_proc_net_tcp(
+                         table, proc_net_tcp_path, AF_INET, &error));
+    cut_assert_true(g_error_matches(error,
+                                    MILTER_MANAGER_CONNECTION_TABLE_ERROR,
+                                    MILTER_MANAGER_CONNECTION_TABLE_ERROR_IO));
+    g_error_free(error);
+}
+
+void
+test_lookup_invalid_address (void)
+{
+    append_connection(AF_INET, "127.0.0.1", 25, "127.0.0.1", 41234, 1);
+    cut_trace(load(AF_INET));
+
+    cut_assert_null(milter_manager_connection_table_lookup(table,
+                                                           "localhost",
+                                                           41234));
+}
+
+void
+test_clear (void)
+{
+    append_connection(AF_INET, "127.0.0.1", 25, "127.0.0.1", 41234, 1);
+    cut_trace(load(AF_INET));
+
+    cut_assert_equal_uint(1, milter_manager_connection_table_size(table));
+    milter_manager_connection_table_clear(table);
+    cut_assert_equal_uint(0, milter_manager_connection_table_size(table));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
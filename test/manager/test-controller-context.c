@@ -36,6 +36,7 @@
 void test_set_configuration (void);
 void test_set_configuration_failed (void);
 void test_reload (void);
+void test_reload_keep_runtime_state (void);
 
 static MilterEventLoop *loop;
 
@@ -272,14 +273,15 @@ test_set_configuration_failed (void)
 void
 test_reload (void)
 {
-    MilterManagerConfiguration *config;
+    MilterManagerConfiguration *config, *old_config;
     const gchar *packet;
     gsize packet_size;
     GString *output;
     GError *error = NULL;
 
-    config = milter_manager_get_configuration(manager);
-    cut_assert_false(milter_manager_configuration_is_privilege_mode(config));
+    old_config = milter_manager_get_configuration(manager);
+    gcut_take_object(G_OBJECT(g_object_ref(old_config)));
+    cut_assert_false(milter_manager_configuration_is_privilege_mode(old_config));
     g_file_set_contents(custom_config_path,
                         "<?xml version='1.0' encoding='utf-8'?>\n"
                         "<configuration>\n"
@@ -295,7 +297,10 @@ test_reload (void)
                                                          &packet, &packet_size);
     cut_trace(write_packet(packet, packet_size));
     pump_all_events();
+    config = milter_manager_get_configuration(manager);
+    cut_assert_true(old_config != config);
     cut_assert_true(milter_manager_configuration_is_privilege_mode(config));
+    cut_assert_false(milter_manager_configuration_is_privilege_mode(old_config));
 
     milter_manager_control_reply_encoder_encode_success(reply_encoder,
                                                         &packet, &packet_size);
@@ -304,6 +309,77 @@ test_reload (void)
                             output->str, output->len);
 }
 
+static MilterManagerEgg *
+reload_and_find_egg (const gchar *name)
+{
+    MilterManagerConfiguration *config;
+    const gchar *packet;
+    gsize packet_size;
+
+    milter_manager_control_command_encoder_encode_reload(command_encoder,
+                                                         &packet, &packet_size);
+    cut_trace(write_packet(packet, packet_size));
+    pump_all_events();
+
+    config = milter_manager_get_configuration(manager);
+    return milter_manager_configuration_find_egg(config, name);
+}
+
+void
+test_reload_keep_runtime_state (void)
+{
+    MilterManagerEgg *egg, *reloaded_egg;
+    MilterManagerChild *child;
+    MilterManagerCircuitBreaker *circuit_breaker;
+    MilterManagerSessionLimiter *session_limiter;
+    GError *error = NULL;
+
+    g_file_set_contents(custom_config_path,
+                        "<?xml version='1.0' encoding='utf-8'?>\n"
+                        "<configuration>\n"
+                        "  <milters>\n"
+                        "    <milter>\n"
+                        "      <name>milter@10026</name>\n"
+                        "      <connection-spec>inet:10026@localhost"
+                        "</connection-spec>\n"
+                        "      <circuit-breaker-threshold>3"
+                        "</circuit-breaker-threshold>\n"
+                        "      <max-concurrent-sessions>2"
+                        "</max-concurrent-sessions>\n"
+                        "      <verdict-cache-size>10"
+                        "</verdict-cache-size>\n"
+                        "    </milter>\n"
+                        "  </milters>\n"
+                        "</configuration>",
+                        -1,
+                        &error);
+    gcut_assert_error(error);
+
+    egg = reload_and_find_egg("milter@10026");
+    cut_assert_not_null(egg);
+    gcut_take_object(G_OBJECT(g_object_ref(egg)));
+    child = milter_manager_egg_hatch(egg);
+    gcut_take_object(G_OBJECT(child));
+    circuit_breaker = milter_manager_egg_get_circuit_breaker(egg);
+    milter_manager_circuit_breaker_record_failure(circuit_breaker);
+    session_limiter = milter_manager_egg_get_session_limiter(egg);
+    cut_assert_true(milter_manager_session_limiter_acquire(session_limiter));
+
+    reloaded_egg = reload_and_find_egg("milter@10026");
+    cut_assert_not_null(reloaded_egg);
+    cut_assert_true(egg != reloaded_egg);
+    cut_assert_true(milter_manager_egg_get_circuit_breaker(reloaded_egg) ==
+                    circuit_breaker);
+    cut_assert_equal_uint(
+        1, milter_manager_circuit_breaker_get_n_failures(circuit_breaker));
+    cut_assert_true(milter_manager_egg_get_session_limiter(reloaded_egg) ==
+                    session_limiter);
+    cut_assert_equal_uint(
+        1, milter_manager_session_limiter_get_n_sessions(session_limiter));
+    cut_assert_true(milter_manager_egg_get_verdict_cache(reloaded_egg) ==
+                    milter_manager_egg_get_verdict_cache(egg));
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
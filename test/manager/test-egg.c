@@ -46,10 +46,16 @@ void test_connection_timeout (void);
 void test_writing_timeout (void);
 void test_reading_timeout (void);
 void test_end_of_message_timeout (void);
+void test_adaptive_timeout_multiplier (void);
+void test_adaptive_timeout_min_samples (void);
+void test_adaptive_timeout_floor (void);
+void test_adaptive_timeout_ceiling (void);
+void test_adaptive_timeout_no_ceiling (void);
 void test_user_name (void);
 void test_command (void);
 void test_command_options (void);
 void test_fallback_status (void);
+void test_priority (void);
 void test_evaluation_mode (void);
 void test_merge (void);
 void test_applicable_condition (void);
@@ -317,6 +323,111 @@ test_end_of_message_timeout (void)
                             milter_manager_egg_get_end_of_message_timeout(egg));
 }
 
+void
+test_adaptive_timeout_multiplier (void)
+{
+    egg = milter_manager_egg_new("child-milter");
+
+    cut_assert_equal_double(0.0, 0.0,
+                            milter_manager_egg_get_adaptive_timeout_multiplier(egg));
+    milter_manager_egg_set_adaptive_timeout_multiplier(egg, 3.0);
+    cut_assert_equal_double(3.0, 0.0,
+                            milter_manager_egg_get_adaptive_timeout_multiplier(egg));
+    milter_manager_egg_set_adaptive_timeout_multiplier(egg, 0.5);
+    cut_assert_equal_double(1.0, 0.0,
+                            milter_manager_egg_get_adaptive_timeout_multiplier(egg));
+    milter_manager_egg_set_adaptive_timeout_multiplier(egg, 0.0);
+    cut_assert_equal_double(0.0, 0.0,
+                            milter_manager_egg_get_adaptive_timeout_multiplier(egg));
+
+    g_object_set(egg, "adaptive-timeout-multiplier", 0.1, NULL);
+    cut_assert_equal_double(1.0, 0.0,
+                            milter_manager_egg_get_adaptive_timeout_multiplier(egg));
+}
+
+static void
+setup_adaptive_timeout_egg (gdouble multiplier)
+{
+    GError *error = NULL;
+
+    egg = milter_manager_egg_new("child-milter");
+    milter_manager_egg_set_connection_spec(egg, "inet:9999@127.0.0.1", &error);
+    gcut_assert_error(error);
+    milter_manager_egg_set_reading_timeout(egg, 100);
+    milter_manager_egg_set_adaptive_timeout_multiplier(egg, multiplier);
+}
+
+static void
+observe_reading_latency (guint n, gdouble elapsed)
+{
+    guint i;
+
+    if (child)
+        g_object_unref(child);
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    for (i = 0; i < n; i++) {
+        g_signal_emit_by_name(child, "latency-observed",
+                              MILTER_SERVER_CONTEXT_TIMEOUT_READING, elapsed);
+    }
+}
+
+static gdouble
+hatch_reading_timeout (void)
+{
+    gdouble reading_timeout = 0;
+
+    if (child)
+        g_object_unref(child);
+    child = milter_manager_egg_hatch(egg);
+    cut_assert_not_null(child);
+    g_object_get(child, "reading-timeout", &reading_timeout, NULL);
+
+    return reading_timeout;
+}
+
+void
+test_adaptive_timeout_min_samples (void)
+{
+    setup_adaptive_timeout_egg(3.0);
+
+    observe_reading_latency(99, 2.0);
+    cut_assert_equal_double(100, 0.0, hatch_reading_timeout());
+
+    observe_reading_latency(1, 2.0);
+    cut_assert_equal_double(6.0, 0.2, hatch_reading_timeout());
+}
+
+void
+test_adaptive_timeout_floor (void)
+{
+    setup_adaptive_timeout_egg(3.0);
+    milter_manager_egg_set_adaptive_timeout_floor(egg, 10.0);
+
+    observe_reading_latency(100, 2.0);
+    cut_assert_equal_double(10.0, 0.0, hatch_reading_timeout());
+}
+
+void
+test_adaptive_timeout_ceiling (void)
+{
+    setup_adaptive_timeout_egg(3.0);
+    milter_manager_egg_set_adaptive_timeout_ceiling(egg, 5.0);
+
+    observe_reading_latency(100, 2.0);
+    cut_assert_equal_double(5.0, 0.0, hatch_reading_timeout());
+}
+
+void
+test_adaptive_timeout_no_ceiling (void)
+{
+    setup_adaptive_timeout_egg(3.0);
+    milter_manager_egg_set_adaptive_timeout_ceiling(egg, 0.0);
+
+    observe_reading_latency(100, 50.0);
+    cut_assert_equal_double(100, 0.0, hatch_reading_timeout());
+}
+
 void
 test_user_name (void)
 {
@@ -368,6 +479,20 @@ test_fallback_status (void)
                            milter_manager_egg_get_fallback_status(egg));
 }
 
+void
+test_priority (void)
+{
+    egg = milter_manager_egg_new("child-milter");
+    gcut_assert_equal_enum(MILTER_TYPE_MANAGER_EGG_PRIORITY,
+                           MILTER_MANAGER_EGG_PRIORITY_ESSENTIAL,
+                           milter_manager_egg_get_priority(egg));
+
+    milter_manager_egg_set_priority(egg, MILTER_MANAGER_EGG_PRIORITY_OPTIONAL);
+    gcut_assert_equal_enum(MILTER_TYPE_MANAGER_EGG_PRIORITY,
+                           MILTER_MANAGER_EGG_PRIORITY_OPTIONAL,
+                           milter_manager_egg_get_priority(egg));
+}
+
 void
 test_evaluation_mode (void)
 {
@@ -0,0 +1,120 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-latency-histogram.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_percentile (void);
+void test_out_of_range (void);
+void test_aging (void);
+void test_clear (void);
+
+static MilterManagerLatencyHistogram *histogram;
+
+void
+cut_setup (void)
+{
+    histogram = milter_manager_latency_histogram_new(1000);
+}
+
+void
+cut_teardown (void)
+{
+    if (histogram)
+        milter_manager_latency_histogram_unref(histogram);
+}
+
+void
+test_empty (void)
+{
+    cut_assert_equal_uint(0,
+                          milter_manager_latency_histogram_get_n_samples(histogram));
+    cut_assert_equal_double(0.0, 0.0,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            99.9));
+}
+
+void
+test_percentile (void)
+{
+    guint i;
+
+    for (i = 1; i <= 1000; i++) {
+        milter_manager_latency_histogram_add(histogram, i / 1000.0);
+    }
+    cut_assert_equal_uint(1000,
+                          milter_manager_latency_histogram_get_n_samples(histogram));
+    cut_assert_equal_double(0.5, 0.5 * 0.02,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            50));
+    cut_assert_equal_double(0.999, 0.999 * 0.02,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            99.9));
+    cut_assert_equal_double(1.0, 1.0 * 0.02,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            100));
+}
+
+void
+test_out_of_range (void)
+{
+    milter_manager_latency_histogram_add(histogram, 0.0);
+    cut_assert_equal_double(0.001, 0.0001,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            100));
+
+    milter_manager_latency_histogram_add(histogram, 100000.0);
+    cut_assert_equal_double(1000.0, 1000.0 * 0.02,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            100));
+}
+
+void
+test_aging (void)
+{
+    guint i;
+
+    for (i = 0; i < 1000; i++) {
+        milter_manager_latency_histogram_add(histogram, 10.0);
+    }
+    for (i = 0; i < 1000; i++) {
+        milter_manager_latency_histogram_add(histogram, 0.1);
+    }
+    cut_assert_operator_uint(1000, >=,
+                             milter_manager_latency_histogram_get_n_samples(histogram));
+    cut_assert_equal_double(0.1, 0.1 * 0.02,
+                            milter_manager_latency_histogram_get_percentile(histogram,
+                                                                            50));
+}
+
+void
+test_clear (void)
+{
+    milter_manager_latency_histogram_add(histogram, 1.0);
+    milter_manager_latency_histogram_clear(histogram);
+    cut_assert_equal_uint(0,
+                          milter_manager_latency_histogram_get_n_samples(histogram));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -38,6 +38,8 @@ void data_large_body (void);
 void test_large_body (gconstpointer data);
 
 void test_configuration (void);
+void test_connection_check_disconnected (void);
+void test_connection_check_connected (void);
 
 static gchar *scenario_dir;
 static MilterManagerTestScenario *main_scenario;
@@ -68,6 +70,9 @@ static gint n_unknown_responses;
 
 static MilterStatus response_status;
 
+static gboolean connected;
+static guint n_connection_check_emitted;
+
 void
 cut_startup (void)
 {
@@ -308,6 +313,9 @@ cut_setup (void)
 
     finished = FALSE;
 
+    connected = TRUE;
+    n_connection_check_emitted = 0;
+
     n_negotiate_responses = 0;
     n_connect_responses = 0;
     n_helo_responses = 0;
@@ -1693,6 +1701,8 @@ data_scenario_envelope_recipient (void)
         "envelope-recipient - reply-code 5xx - evaluation",
         g_strdup("envelope-recipient-reply-code-5xx-evaluation.txt"),
         g_free,
+        "envelope-recipient - reject - mirror",
+        g_strdup("mirror-envelope-recipient-reject.txt"), g_free,
         NULL);
 }
 
@@ -1705,6 +1715,8 @@ data_scenario_data (void)
                  g_strdup("data-close-without-reply.txt"), g_free,
                  "data - reply code reject",
                  g_strdup("data-reply-code-reject.txt"), g_free,
+                 "data - reject - mirror",
+                 g_strdup("mirror-data-reject.txt"), g_free,
                  NULL);
 }
 
@@ -1895,6 +1907,78 @@ test_configuration (void)
                              milter_manager_leader_get_configuration(leader));
 }
 
+static gboolean
+cb_connection_check (MilterManagerLeader *leader, gpointer user_data)
+{
+    n_connection_check_emitted++;
+    return connected;
+}
+
+#define wait_connection_check()                    \
+    cut_trace_with_info_expression(                \
+        wait_connection_check_helper(),            \
+        wait_connection_check())
+
+static void
+wait_connection_check_helper (void)
+{
+    gboolean timeout_emitted = FALSE;
+    guint timeout_emitted_id;
+
+    timeout_emitted_id =
+        milter_event_loop_add_timeout(loop, 3,
+                                      cb_timeout_emitted, &timeout_emitted);
+    while (!timeout_emitted && n_connection_check_emitted == 0) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, timeout_emitted_id);
+
+    cut_assert_false(timeout_emitted);
+}
+
+static void
+envelope_from_to_no_response_child (void)
+{
+    const gchar from[] = "kou+sender@example.com";
+    MilterStatus status;
+
+    cut_trace(test_scenario("connection-check.txt"));
+
+    milter_manager_configuration_set_connection_check_interval(config, 1);
+    g_signal_connect(leader, "connection-check",
+                     G_CALLBACK(cb_connection_check), NULL);
+
+    milter_server_context_envelope_from(MILTER_SERVER_CONTEXT(server), from);
+    status = milter_manager_leader_envelope_from(leader, from);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS, MILTER_STATUS_PROGRESS, status);
+}
+
+void
+test_connection_check_disconnected (void)
+{
+    connected = FALSE;
+    cut_trace(envelope_from_to_no_response_child());
+
+    cut_trace(assert_have_response_helper("envelope-from-response"));
+    cut_assert_equal_uint(1, n_connection_check_emitted);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_TEMPORARY_FAILURE,
+                           response_status);
+}
+
+void
+test_connection_check_connected (void)
+{
+    connected = TRUE;
+    cut_trace(envelope_from_to_no_response_child());
+
+    wait_connection_check();
+    cut_assert_equal_uint(0, n_envelope_from_responses);
+    cut_assert_true(milter_manager_children_is_waiting_reply(
+                        milter_manager_leader_get_children(leader)));
+    cut_assert_false(finished);
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
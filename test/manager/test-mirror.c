@@ -0,0 +1,170 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-mirror.h>
+#include <milter/manager/milter-manager-configuration.h>
+
+#include <gcutter.h>
+
+void test_pending (void);
+void test_drop (void);
+void test_quit (void);
+void test_abort (void);
+void test_abort_waiting_reply (void);
+
+static MilterEventLoop *loop;
+static MilterManagerConfiguration *config;
+static MilterManagerChildren *children;
+static MilterManagerMirror *mirror;
+static MilterOption *option;
+
+void
+cut_setup (void)
+{
+    loop = milter_test_event_loop_new();
+    config = milter_manager_configuration_new(NULL);
+    children = milter_manager_children_new(config, loop);
+    mirror = milter_manager_mirror_new(children, loop, 1024);
+    option = milter_option_new(2, MILTER_ACTION_NONE, MILTER_STEP_NONE);
+}
+
+void
+cut_teardown (void)
+{
+    if (mirror) {
+        milter_manager_mirror_quit(mirror);
+        g_object_unref(mirror);
+    }
+    if (option)
+        g_object_unref(option);
+    if (children)
+        g_object_unref(children);
+    if (config)
+        g_object_unref(config);
+    if (loop)
+        g_object_unref(loop);
+}
+
+void
+test_pending (void)
+{
+    milter_manager_mirror_negotiate(mirror, option, NULL);
+    cut_assert_equal_uint(0,
+                          milter_manager_mirror_get_n_pending_commands(mirror));
+
+    milter_manager_mirror_helo(mirror, "delian");
+    cut_assert_equal_uint(1,
+                          milter_manager_mirror_get_n_pending_commands(mirror));
+    cut_assert_operator_uint(0, <,
+                             milter_manager_mirror_get_buffer_size(mirror));
+    cut_assert_false(milter_manager_mirror_is_dropped(mirror));
+}
+
+void
+test_drop (void)
+{
+    gchar *value;
+
+    milter_manager_mirror_negotiate(mirror, option, NULL);
+    milter_manager_mirror_header(mirror, "From", "kou@example.com");
+    cut_assert_false(milter_manager_mirror_is_dropped(mirror));
+
+    value = g_strnfill(2048, 'X');
+    cut_take_string(value);
+    milter_manager_mirror_header(mirror, "X-Large", value);
+    cut_assert_true(milter_manager_mirror_is_dropped(mirror));
+    cut_assert_equal_uint(0,
+                          milter_manager_mirror_get_n_pending_commands(mirror));
+    cut_assert_equal_uint(0, milter_manager_mirror_get_buffer_size(mirror));
+
+    milter_manager_mirror_helo(mirror, "delian");
+    cut_assert_equal_uint(0,
+                          milter_manager_mirror_get_n_pending_commands(mirror));
+}
+
+static void
+cb_weak_notify (gpointer data, GObject *where_the_object_was)
+{
+    gboolean *disposed = data;
+
+    *disposed = TRUE;
+}
+
+void
+test_quit (void)
+{
+    MilterManagerMirror *finishing_mirror;
+    gboolean disposed = FALSE;
+
+    finishing_mirror = mirror;
+    mirror = NULL;
+    g_object_weak_ref(G_OBJECT(finishing_mirror), cb_weak_notify, &disposed);
+
+    g_object_unref(finishing_mirror);
+    cut_assert_false(disposed);
+
+    milter_manager_mirror_quit(finishing_mirror);
+    cut_assert_true(disposed);
+}
+
+void
+test_abort (void)
+{
+    MilterManagerMirror *finishing_mirror;
+    gboolean disposed = FALSE;
+
+    finishing_mirror = mirror;
+    mirror = NULL;
+    g_object_weak_ref(G_OBJECT(finishing_mirror), cb_weak_notify, &disposed);
+
+    g_object_unref(finishing_mirror);
+    milter_manager_mirror_abort(finishing_mirror);
+    cut_assert_false(disposed);
+
+    milter_manager_mirror_quit(finishing_mirror);
+    cut_assert_true(disposed);
+}
+
+void
+test_abort_waiting_reply (void)
+{
+    MilterManagerMirror *finishing_mirror;
+    gboolean disposed = FALSE;
+
+    finishing_mirror = mirror;
+    mirror = NULL;
+    g_object_weak_ref(G_OBJECT(finishing_mirror), cb_weak_notify, &disposed);
+
+    milter_manager_mirror_negotiate(finishing_mirror, option, NULL);
+    g_object_unref(finishing_mirror);
+    milter_manager_mirror_abort(finishing_mirror);
+    milter_manager_mirror_quit(finishing_mirror);
+    cut_assert_equal_uint(
+        2, milter_manager_mirror_get_n_pending_commands(finishing_mirror));
+    cut_assert_false(disposed);
+
+    milter_finished_emittable_emit(MILTER_FINISHED_EMITTABLE(children));
+    milter_test_pump_all_events(loop);
+    cut_assert_true(disposed);
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
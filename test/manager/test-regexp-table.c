@@ -0,0 +1,233 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-regexp-table.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_first_match (void);
+void test_negative (void);
+void test_expand (void);
+void test_condition (void);
+void test_condition_negative (void);
+void test_pop_condition_unmatched (void);
+void test_invalid_regex (void);
+void test_back_reference (void);
+void test_many_entries (void);
+void test_add_after_lookup (void);
+
+static MilterManagerRegexpTable *table;
+static GError *expected_error;
+static GError *actual_error;
+
+void
+cut_setup (void)
+{
+    table = milter_manager_regexp_table_new();
+    expected_error = NULL;
+    actual_error = NULL;
+}
+
+void
+cut_teardown (void)
+{
+    if (table)
+        g_object_unref(table);
+    if (expected_error)
+        g_error_free(expected_error);
+    if (actual_error)
+        g_error_free(actual_error);
+}
+
+static void
+add (const gchar *pattern, gboolean negative, const gchar *action)
+{
+    gcut_assert_error(actual_error);
+    milter_manager_regexp_table_add(table, pattern, negative, action,
+                                    &actual_error);
+    gcut_assert_error(actual_error);
+}
+
+static void
+push_condition (const gchar *pattern, gboolean negative)
+{
+    gcut_assert_error(actual_error);
+    milter_manager_regexp_table_push_condition(table, pattern, negative,
+                                               &actual_error);
+    gcut_assert_error(actual_error);
+}
+
+static void
+pop_condition (void)
+{
+    gcut_assert_error(actual_error);
+    milter_manager_regexp_table_pop_condition(table, &actual_error);
+    gcut_assert_error(actual_error);
+}
+
+static const gchar *
+lookup (const gchar *text)
+{
+    gchar *action;
+
+    action = milter_manager_regexp_table_lookup(table, text);
+    if (!action)
+        return NULL;
+    return cut_take_string(action);
+}
+
+void
+test_empty (void)
+{
+    cut_assert_equal_uint(0, milter_manager_regexp_table_get_n_entries(table));
+    cut_assert_null(lookup("sender@example.com"));
+}
+
+void
+test_first_match (void)
+{
+    cut_trace(add("(?i)example\\.com$", FALSE, "REJECT"));
+    cut_trace(add("(?i)^user@", FALSE, "OK"));
+
+    cut_assert_equal_string("REJECT", lookup("user@example.com"));
+    cut_assert_equal_string("OK", lookup("user@example.net"));
+    cut_assert_null(lookup("nobody@example.net"));
+}
+
+void
+test_negative (void)
+{
+    cut_trace(add("^owner-", TRUE, "OK"));
+    cut_trace(add("[%!@].*[%!@]", FALSE, "REJECT"));
+
+    cut_assert_equal_string("OK", lookup("%xxx%"));
+    cut_assert_equal_string("REJECT", lookup("owner-%xxx%"));
+}
+
+void
+test_expand (void)
+{
+    cut_trace(add("^(.*)-outgoing\\+(.*)@(.*)$", FALSE,
+                  "550 Use ${1}+$(2)@$3 $$ instead"));
+
+    cut_assert_equal_string("550 Use user+ml@example.com $ instead",
+                            lookup("user-outgoing+ml@example.com"));
+}
+
+void
+test_condition (void)
+{
+    cut_trace(push_condition("^owner", FALSE));
+    cut_trace(add("@(.*)$", FALSE, "OK $1"));
+    cut_trace(pop_condition());
+    cut_trace(add("@example\\.com$", FALSE, "REJECT"));
+
+    cut_assert_equal_string("OK example.com", lookup("owner@example.com"));
+    cut_assert_equal_string("REJECT", lookup("user@example.com"));
+    cut_assert_null(lookup("user@example.net"));
+}
+
+void
+test_condition_negative (void)
+{
+    cut_trace(push_condition("^owner-", TRUE));
+    cut_trace(add("^(.*)-outgoing@(.*)$", FALSE, "550 Use ${1}@${2} instead"));
+    cut_trace(pop_condition());
+
+    cut_assert_equal_string("550 Use user@example.com instead",
+                            lookup("user-outgoing@example.com"));
+    cut_assert_null(lookup("owner-outgoing@example.com"));
+}
+
+void
+test_pop_condition_unmatched (void)
+{
+    expected_error = g_error_new(MILTER_MANAGER_REGEXP_TABLE_ERROR,
+                                 MILTER_MANAGER_REGEXP_TABLE_ERROR_UNMATCHED_ENDIF,
+                                 "endif isn't matched");
+    cut_assert_false(milter_manager_regexp_table_pop_condition(table,
+                                                               &actual_error));
+    gcut_assert_equal_error(expected_error, actual_error);
+}
+
+void
+test_invalid_regex (void)
+{
+    cut_assert_false(milter_manager_regexp_table_add(table, "left-(paren only",
+                                                     FALSE, "REJECT",
+                                                     &actual_error));
+    cut_assert_not_null(actual_error);
+    cut_assert_equal_int(MILTER_MANAGER_REGEXP_TABLE_ERROR_INVALID_REGEX,
+                         actual_error->code);
+
+    cut_assert_equal_uint(0, milter_manager_regexp_table_get_n_entries(table));
+    cut_assert_null(lookup("left-(paren only"));
+}
+
+void
+test_back_reference (void)
+{
+    cut_trace(add("^a", FALSE, "A"));
+    cut_trace(add("(.)\\1", FALSE, "DOUBLE $1"));
+    cut_trace(add("x", FALSE, "X"));
+
+    cut_assert_equal_string("A", lookup("abb"));
+    cut_assert_equal_string("DOUBLE b", lookup("xbb"));
+    cut_assert_equal_string("X", lookup("xb"));
+}
+
+void
+test_many_entries (void)
+{
+    guint i;
+
+    for (i = 0; i < 1000; i++) {
+        gchar *pattern, *action;
+
+        pattern = g_strdup_printf("^user%u@", i);
+        action = g_strdup_printf("user %u", i);
+        cut_trace(add(pattern, FALSE, action));
+        g_free(pattern);
+        g_free(action);
+    }
+    milter_manager_regexp_table_compile(table);
+
+    cut_assert_equal_uint(1000,
+                          milter_manager_regexp_table_get_n_entries(table));
+    cut_assert_equal_string("user 0", lookup("user0@example.com"));
+    cut_assert_equal_string("user 128", lookup("user128@example.com"));
+    cut_assert_equal_string("user 999", lookup("user999@example.com"));
+    cut_assert_null(lookup("user1000@example.com"));
+}
+
+void
+test_add_after_lookup (void)
+{
+    cut_trace(add("^user@", FALSE, "OK"));
+    cut_assert_null(lookup("owner@example.com"));
+
+    cut_trace(add("^owner@", FALSE, "REJECT"));
+    cut_assert_equal_string("REJECT", lookup("owner@example.com"));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,144 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-replica-set.h>
+
+#include <gcutter.h>
+
+void test_empty (void);
+void test_round_robin (void);
+void test_least_outstanding (void);
+void test_latency (void);
+void test_skip_down_replica (void);
+void test_all_down (void);
+void test_select_next (void);
+
+static MilterManagerReplicaSet *set;
+
+void
+cut_setup (void)
+{
+    set = milter_manager_replica_set_new("milter");
+    milter_manager_replica_set_add(set, "inet:10026@192.168.1.1");
+    milter_manager_replica_set_add(set, "inet:10026@192.168.1.2");
+    milter_manager_replica_set_add(set, "inet:10026@192.168.1.3");
+}
+
+void
+cut_teardown (void)
+{
+    if (set)
+        g_object_unref(set);
+}
+
+void
+test_empty (void)
+{
+    g_object_unref(set);
+    set = milter_manager_replica_set_new("milter");
+    cut_assert_equal_int(-1, milter_manager_replica_set_select(set));
+}
+
+void
+test_round_robin (void)
+{
+    cut_assert_equal_int(0, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(1, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(2, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(0, milter_manager_replica_set_select(set));
+    cut_assert_equal_string("inet:10026@192.168.1.2",
+                            milter_manager_replica_set_get_connection_spec(set, 1));
+}
+
+void
+test_least_outstanding (void)
+{
+    milter_manager_replica_set_set_policy(
+        set, MILTER_MANAGER_REPLICA_POLICY_LEAST_OUTSTANDING);
+    milter_manager_replica_set_begin(set, 0);
+    milter_manager_replica_set_begin(set, 0);
+    milter_manager_replica_set_begin(set, 1);
+    milter_manager_replica_set_begin(set, 2);
+
+    cut_assert_equal_int(1, milter_manager_replica_set_select(set));
+    milter_manager_replica_set_end(set, 2);
+    cut_assert_equal_int(2, milter_manager_replica_set_select(set));
+    cut_assert_equal_uint(2,
+                          milter_manager_replica_set_get_n_outstanding(set, 0));
+}
+
+void
+test_latency (void)
+{
+    milter_manager_replica_set_set_policy(set,
+                                          MILTER_MANAGER_REPLICA_POLICY_LATENCY);
+    milter_manager_replica_set_record_success(set, 0, 0.5);
+    milter_manager_replica_set_record_success(set, 1, 0.1);
+    milter_manager_replica_set_record_success(set, 2, 0.3);
+    cut_assert_equal_int(1, milter_manager_replica_set_select(set));
+
+    milter_manager_replica_set_begin(set, 1);
+    milter_manager_replica_set_begin(set, 1);
+    milter_manager_replica_set_begin(set, 1);
+    cut_assert_equal_int(2, milter_manager_replica_set_select(set));
+
+    milter_manager_replica_set_record_success(set, 0, 0.1);
+    cut_assert_equal_double(0.38, 0.0001,
+                            milter_manager_replica_set_get_latency(set, 0));
+}
+
+void
+test_skip_down_replica (void)
+{
+    milter_manager_replica_set_record_failure(set, 1);
+    cut_assert_false(milter_manager_replica_set_is_healthy(set, 1));
+
+    cut_assert_equal_int(0, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(2, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(0, milter_manager_replica_set_select(set));
+
+    milter_manager_replica_set_record_success(set, 1, 0.1);
+    cut_assert_true(milter_manager_replica_set_is_healthy(set, 1));
+}
+
+void
+test_all_down (void)
+{
+    milter_manager_replica_set_record_failure(set, 0);
+    milter_manager_replica_set_record_failure(set, 1);
+    milter_manager_replica_set_record_failure(set, 2);
+
+    cut_assert_equal_int(0, milter_manager_replica_set_select(set));
+    cut_assert_equal_int(1, milter_manager_replica_set_select(set));
+}
+
+void
+test_select_next (void)
+{
+    cut_assert_equal_int(1, milter_manager_replica_set_select_next(set, 0));
+    milter_manager_replica_set_record_failure(set, 0);
+    cut_assert_equal_int(2, milter_manager_replica_set_select_next(set, 1));
+    milter_manager_replica_set_record_failure(set, 2);
+    cut_assert_equal_int(1, milter_manager_replica_set_select_next(set, 2));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
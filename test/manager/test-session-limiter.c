@@ -0,0 +1,335 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-session-limiter.h>
+
+#include <gcutter.h>
+
+void test_no_limit (void);
+void test_limit (void);
+void test_wait (void);
+void test_wait_full (void);
+void test_cancel (void);
+void test_raise_limit (void);
+void test_wait_in_other_thread (void);
+void test_cancel_woken_waiter (void);
+void test_shared_by_processes (void);
+void test_reclaim_dead_process (void);
+void test_lock_dead_owner (void);
+
+static MilterManagerSessionLimiter *limiter;
+static MilterEventLoop *loop;
+static GList *ready_data;
+
+void
+cut_setup (void)
+{
+    limiter = milter_manager_session_limiter_new("milter@10026");
+    loop = NULL;
+    ready_data = NULL;
+}
+
+void
+cut_teardown (void)
+{
+    if (limiter)
+        g_object_unref(limiter);
+    if (loop)
+        g_object_unref(loop);
+    if (ready_data)
+        g_list_free(ready_data);
+}
+
+static void
+cb_ready (gpointer user_data)
+{
+    ready_data = g_list_append(ready_data, user_data);
+}
+
+void
+test_no_limit (void)
+{
+    guint i;
+
+    for (i = 0; i < 100; i++) {
+        cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    }
+    cut_assert_equal_uint(100,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+void
+test_limit (void)
+{
+    milter_manager_session_limiter_set_max_sessions(limiter, 2);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    cut_assert_false(milter_manager_session_limiter_acquire(limiter));
+
+    milter_manager_session_limiter_release(limiter);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+}
+
+void
+test_wait (void)
+{
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 2);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+
+    cut_assert_operator_uint(0, <,
+                             milter_manager_session_limiter_wait(limiter,
+                                                                 cb_ready,
+                                                                 "first"));
+    cut_assert_operator_uint(0, <,
+                             milter_manager_session_limiter_wait(limiter,
+                                                                 cb_ready,
+                                                                 "second"));
+    cut_assert_equal_uint(2,
+                          milter_manager_session_limiter_get_n_waiting_sessions(limiter));
+    cut_assert_false(milter_manager_session_limiter_acquire(limiter));
+
+    milter_manager_session_limiter_release(limiter);
+    cut_assert_equal_uint(1, g_list_length(ready_data));
+    cut_assert_equal_string("first", ready_data->data);
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_waiting_sessions(limiter));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_waited_sessions(limiter));
+}
+
+void
+test_wait_full (void)
+{
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 1);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+
+    cut_assert_operator_uint(0, <,
+                             milter_manager_session_limiter_wait(limiter,
+                                                                 cb_ready,
+                                                                 "first"));
+    cut_assert_equal_uint(0,
+                          milter_manager_session_limiter_wait(limiter,
+                                                              cb_ready,
+                                                              "second"));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_rejected_sessions(limiter));
+}
+
+void
+test_cancel (void)
+{
+    guint wait_id;
+
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 1);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+
+    wait_id = milter_manager_session_limiter_wait(limiter, cb_ready, "first");
+    milter_manager_session_limiter_cancel(limiter, wait_id);
+    cut_assert_equal_uint(0,
+                          milter_manager_session_limiter_get_n_waiting_sessions(limiter));
+
+    milter_manager_session_limiter_release(limiter);
+    cut_assert_equal_uint(0, g_list_length(ready_data));
+    cut_assert_equal_uint(0,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+void
+test_raise_limit (void)
+{
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 2);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    milter_manager_session_limiter_wait(limiter, cb_ready, "first");
+    milter_manager_session_limiter_wait(limiter, cb_ready, "second");
+
+    milter_manager_session_limiter_set_max_sessions(limiter, 0);
+    cut_assert_equal_uint(2, g_list_length(ready_data));
+    cut_assert_equal_uint(3,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+static gpointer
+release_in_thread (gpointer user_data)
+{
+    milter_manager_session_limiter_release(user_data);
+    return NULL;
+}
+
+static void
+release_in_other_thread (void)
+{
+    GThread *thread;
+    GError *error = NULL;
+
+    thread = g_thread_try_new("release-thread", release_in_thread, limiter,
+                              &error);
+    gcut_assert_error(error);
+    g_thread_join(thread);
+}
+
+void
+test_wait_in_other_thread (void)
+{
+    loop = milter_test_event_loop_new();
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 1);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    cut_assert_operator_uint(0, <,
+                             milter_manager_session_limiter_wait_full(limiter,
+                                                                      loop,
+                                                                      cb_ready,
+                                                                      "first"));
+
+    release_in_other_thread();
+    cut_assert_equal_uint(0, g_list_length(ready_data));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+
+    while (!ready_data) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    cut_assert_equal_string("first", ready_data->data);
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+void
+test_cancel_woken_waiter (void)
+{
+    guint wait_id;
+
+    loop = milter_test_event_loop_new();
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    milter_manager_session_limiter_set_max_waiting_sessions(limiter, 2);
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    wait_id = milter_manager_session_limiter_wait_full(limiter, loop,
+                                                       cb_ready, "first");
+    milter_manager_session_limiter_wait(limiter, cb_ready, "second");
+
+    release_in_other_thread();
+    milter_manager_session_limiter_cancel(limiter, wait_id);
+    cut_assert_equal_uint(1, g_list_length(ready_data));
+    cut_assert_equal_string("second", ready_data->data);
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+
+    while (milter_event_loop_iterate(loop, FALSE)) {
+    }
+    cut_assert_equal_uint(1, g_list_length(ready_data));
+}
+
+void
+test_shared_by_processes (void)
+{
+    int to_child[2], from_child[2];
+    pid_t pid;
+    int status;
+    gchar byte = '\0';
+
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+    cut_assert_equal_int(0, pipe(to_child));
+    cut_assert_equal_int(0, pipe(from_child));
+
+    pid = fork();
+    if (pid == 0) {
+        gboolean acquired;
+
+        acquired = milter_manager_session_limiter_acquire(limiter);
+        if (write(from_child[1], &byte, 1) != 1 ||
+            read(to_child[0], &byte, 1) != 1)
+            _exit(EXIT_FAILURE);
+        milter_manager_session_limiter_release(limiter);
+        _exit(acquired ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    cut_assert_operator_int(0, <, pid);
+    close(to_child[0]);
+    close(from_child[1]);
+
+    cut_assert_equal_int(1, read(from_child[0], &byte, 1));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+    cut_assert_false(milter_manager_session_limiter_acquire(limiter));
+
+    cut_assert_equal_int(1, write(to_child[1], &byte, 1));
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+    close(to_child[1]);
+    close(from_child[0]);
+    cut_assert_true(WIFEXITED(status));
+    cut_assert_equal_int(EXIT_SUCCESS, WEXITSTATUS(status));
+
+    cut_assert_equal_uint(0,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+}
+
+void
+test_reclaim_dead_process (void)
+{
+    pid_t pid;
+    int status;
+
+    milter_manager_session_limiter_set_max_sessions(limiter, 1);
+
+    pid = fork();
+    if (pid == 0) {
+        milter_manager_session_limiter_acquire(limiter);
+        _exit(EXIT_SUCCESS);
+    }
+    cut_assert_operator_int(0, <, pid);
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+void
+test_lock_dead_owner (void)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid == 0) {
+        milter_manager_session_limiter_lock(limiter);
+        _exit(EXIT_SUCCESS);
+    }
+    cut_assert_operator_int(0, <, pid);
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+
+    cut_assert_true(milter_manager_session_limiter_acquire(limiter));
+    cut_assert_equal_uint(1,
+                          milter_manager_session_limiter_get_n_sessions(limiter));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
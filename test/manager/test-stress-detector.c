@@ -0,0 +1,213 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-stress-detector.h>
+
+#include <gcutter.h>
+
+void test_no_pressure (void);
+void test_lag (void);
+void test_cpu_usage (void);
+void test_loops_lag (void);
+void test_loops_cpu_usage (void);
+void test_latency (void);
+void test_latency_warm_up (void);
+void test_hysteresis (void);
+void test_max_shedding_ratio (void);
+void test_skip_optional (void);
+
+static MilterManagerStressDetector *detector;
+
+void
+cut_setup (void)
+{
+    detector = milter_manager_stress_detector_new();
+}
+
+void
+cut_teardown (void)
+{
+    if (detector)
+        g_object_unref(detector);
+}
+
+static void
+record_latencies (gdouble latency, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++) {
+        milter_manager_stress_detector_record_latency(detector, latency);
+    }
+}
+
+static guint
+count_skips (guint n)
+{
+    guint i, n_skips = 0;
+
+    for (i = 0; i < n; i++) {
+        if (milter_manager_stress_detector_should_skip_optional(detector))
+            n_skips++;
+    }
+
+    return n_skips;
+}
+
+void
+test_no_pressure (void)
+{
+    milter_manager_stress_detector_update(detector, 0.0, 0.0);
+    cut_assert_equal_double(0.0, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.0, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+    cut_assert_equal_uint(0, count_skips(100));
+}
+
+void
+test_lag (void)
+{
+    milter_manager_stress_detector_update(detector, 0.2, 0.0);
+    cut_assert_equal_double(2.0, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_cpu_usage (void)
+{
+    milter_manager_stress_detector_update(detector, 0.0, 0.45);
+    cut_assert_equal_double(0.5, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.0, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+
+    milter_manager_stress_detector_update(detector, 0.0, 0.9);
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_loops_lag (void)
+{
+    gdouble lags[] = {0.0, 0.2, 0.05};
+
+    milter_manager_stress_detector_update_loops(detector,
+                                                lags, G_N_ELEMENTS(lags),
+                                                0.0);
+    cut_assert_equal_double(2.0, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_loops_cpu_usage (void)
+{
+    gdouble lags[] = {0.0, 0.0, 0.0, 0.0};
+
+    milter_manager_stress_detector_update_loops(detector,
+                                                lags, G_N_ELEMENTS(lags),
+                                                1.8);
+    cut_assert_equal_double(0.5, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.0, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+
+    milter_manager_stress_detector_update_loops(detector,
+                                                lags, G_N_ELEMENTS(lags),
+                                                3.6);
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_latency (void)
+{
+    record_latencies(1.0, 20);
+    record_latencies(10.0, 1);
+    cut_assert_equal_double(2.8, 0.01,
+                            milter_manager_stress_detector_get_latency(detector));
+    cut_assert_equal_double(1.09, 0.01,
+                            milter_manager_stress_detector_get_baseline_latency(detector));
+
+    milter_manager_stress_detector_update(detector, 0.0, 0.0);
+    cut_assert_equal_double(1.28, 0.01,
+                            milter_manager_stress_detector_get_pressure(detector));
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_latency_warm_up (void)
+{
+    record_latencies(1.0, 1);
+    record_latencies(10.0, 2);
+
+    milter_manager_stress_detector_update(detector, 0.0, 0.0);
+    cut_assert_equal_double(0.0, 0.001,
+                            milter_manager_stress_detector_get_pressure(detector));
+}
+
+void
+test_hysteresis (void)
+{
+    milter_manager_stress_detector_update(detector, 0.2, 0.0);
+    milter_manager_stress_detector_update(detector, 0.2, 0.0);
+    cut_assert_equal_double(0.5, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+
+    milter_manager_stress_detector_update(detector, 0.07, 0.0);
+    cut_assert_equal_double(0.5, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+
+    milter_manager_stress_detector_update(detector, 0.01, 0.0);
+    cut_assert_equal_double(0.25, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+}
+
+void
+test_max_shedding_ratio (void)
+{
+    guint i;
+
+    for (i = 0; i < 10; i++) {
+        milter_manager_stress_detector_update(detector, 1.0, 0.0);
+    }
+    cut_assert_equal_double(1.0, 0.001,
+                            milter_manager_stress_detector_get_shedding_ratio(detector));
+    cut_assert_equal_uint(100, count_skips(100));
+}
+
+void
+test_skip_optional (void)
+{
+    milter_manager_stress_detector_update(detector, 0.2, 0.0);
+    cut_assert_equal_uint(25, count_skips(100));
+
+    milter_manager_stress_detector_update(detector, 0.2, 0.0);
+    cut_assert_equal_uint(50, count_skips(100));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
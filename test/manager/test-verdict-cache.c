@@ -0,0 +1,279 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This library is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/wait.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter-test-utils.h>
+#include <milter/manager/milter-manager-verdict-cache.h>
+
+#include <gcutter.h>
+
+void test_miss (void);
+void test_hit (void);
+void test_helo (void);
+void test_port (void);
+void test_expire (void);
+void test_unix (void);
+void test_evict (void);
+void test_clear (void);
+void test_shared (void);
+void test_lock_live_owner (void);
+void test_lock_dead_owner (void);
+void test_key (void);
+void test_key_too_long (void);
+
+static MilterManagerVerdictCache *cache;
+static struct sockaddr_in address;
+
+static void
+set_address (struct sockaddr_in *inet_address,
+             const gchar *ip_address,
+             guint16 port)
+{
+    memset(inet_address, 0, sizeof(*inet_address));
+    inet_address->sin_family = AF_INET;
+    inet_address->sin_port = g_htons(port);
+    inet_pton(AF_INET, ip_address, &(inet_address->sin_addr));
+}
+
+void
+cut_setup (void)
+{
+    cache = milter_manager_verdict_cache_new("milter", 16);
+    set_address(&address, "192.168.1.1", 50443);
+}
+
+void
+cut_teardown (void)
+{
+    if (cache)
+        g_object_unref(cache);
+}
+
+#define lookup(helo)                                            \
+    milter_manager_verdict_cache_lookup(cache,                  \
+                                        (struct sockaddr *)&address, \
+                                        sizeof(address),        \
+                                        helo)
+
+#define store(helo, status)                                     \
+    milter_manager_verdict_cache_store(cache,                   \
+                                       (struct sockaddr *)&address, \
+                                       sizeof(address),         \
+                                       helo,                    \
+                                       status)
+
+void
+test_miss (void)
+{
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+    cut_assert_equal_uint(0, milter_manager_verdict_cache_get_n_hits(cache));
+    cut_assert_equal_uint(1, milter_manager_verdict_cache_get_n_misses(cache));
+}
+
+void
+test_hit (void)
+{
+    store(NULL, MILTER_STATUS_REJECT);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_REJECT,
+                           lookup(NULL));
+    cut_assert_equal_uint(1, milter_manager_verdict_cache_get_n_hits(cache));
+    cut_assert_equal_uint(0, milter_manager_verdict_cache_get_n_misses(cache));
+}
+
+void
+test_helo (void)
+{
+    store("mx.example.com", MILTER_STATUS_TEMPORARY_FAILURE);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup("mx.example.org"));
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_TEMPORARY_FAILURE,
+                           lookup("mx.example.com"));
+}
+
+void
+test_port (void)
+{
+    store(NULL, MILTER_STATUS_ACCEPT);
+    set_address(&address, "192.168.1.1", 50444);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_ACCEPT,
+                           lookup(NULL));
+}
+
+void
+test_expire (void)
+{
+    milter_manager_verdict_cache_set_ttl(cache, 0.01);
+    store(NULL, MILTER_STATUS_REJECT);
+    g_usleep(20 * 1000);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+}
+
+void
+test_unix (void)
+{
+    struct sockaddr_un unix_address;
+
+    memset(&unix_address, 0, sizeof(unix_address));
+    unix_address.sun_family = AF_UNIX;
+    strcpy(unix_address.sun_path, "/tmp/milter.sock");
+    milter_manager_verdict_cache_store(cache,
+                                       (struct sockaddr *)&unix_address,
+                                       sizeof(unix_address),
+                                       NULL,
+                                       MILTER_STATUS_REJECT);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           milter_manager_verdict_cache_lookup(
+                               cache,
+                               (struct sockaddr *)&unix_address,
+                               sizeof(unix_address),
+                               NULL));
+}
+
+void
+test_evict (void)
+{
+    g_object_unref(cache);
+    cache = milter_manager_verdict_cache_new("milter", 1);
+
+    store(NULL, MILTER_STATUS_REJECT);
+    set_address(&address, "192.168.1.2", 50443);
+    store(NULL, MILTER_STATUS_DISCARD);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_DISCARD,
+                           lookup(NULL));
+
+    set_address(&address, "192.168.1.1", 50443);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+}
+
+void
+test_clear (void)
+{
+    store(NULL, MILTER_STATUS_REJECT);
+    milter_manager_verdict_cache_clear(cache);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+}
+
+void
+test_shared (void)
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid == 0) {
+        store(NULL, MILTER_STATUS_REJECT);
+        _exit(EXIT_SUCCESS);
+    }
+    cut_assert_operator_int(0, <, pid);
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_REJECT,
+                           lookup(NULL));
+}
+
+void
+test_lock_live_owner (void)
+{
+    cut_assert_true(milter_manager_verdict_cache_lock(cache));
+    store(NULL, MILTER_STATUS_REJECT);
+    milter_manager_verdict_cache_unlock(cache);
+
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+}
+
+void
+test_lock_dead_owner (void)
+{
+    pid_t pid;
+    int status;
+
+    store(NULL, MILTER_STATUS_REJECT);
+
+    pid = fork();
+    if (pid == 0) {
+        milter_manager_verdict_cache_lock(cache);
+        _exit(EXIT_SUCCESS);
+    }
+    cut_assert_operator_int(0, <, pid);
+    cut_assert_equal_int(pid, waitpid(pid, &status, 0));
+
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           lookup(NULL));
+    store(NULL, MILTER_STATUS_TEMPORARY_FAILURE);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_TEMPORARY_FAILURE,
+                           lookup(NULL));
+}
+
+void
+test_key (void)
+{
+    milter_manager_verdict_cache_store_key(cache, "0123abcd:ef",
+                                           MILTER_STATUS_DISCARD);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           milter_manager_verdict_cache_lookup_key(
+                               cache, "0123abcd:00"));
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_DISCARD,
+                           milter_manager_verdict_cache_lookup_key(
+                               cache, "0123abcd:ef"));
+}
+
+void
+test_key_too_long (void)
+{
+    gchar *key;
+
+    key = g_strnfill(256, 'a');
+    cut_take_string(key);
+    milter_manager_verdict_cache_store_key(cache, key, MILTER_STATUS_REJECT);
+    gcut_assert_equal_enum(MILTER_TYPE_STATUS,
+                           MILTER_STATUS_NOT_CHANGE,
+                           milter_manager_verdict_cache_lookup_key(cache, key));
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -35,7 +35,9 @@
 void test_establish_connection (void);
 void test_establish_connection_failure (void);
 void test_negotiate (void);
+void test_negotiate_max_data_size (void);
 void test_connect (void);
+void test_connect_deadline (void);
 void test_helo (void);
 void test_envelope_from (void);
 void test_envelope_recipient (void);
@@ -51,6 +53,10 @@ void test_macro (void);
 void test_macros_hash_table (void);
 void data_has_accepted_recipient (void);
 void test_has_accepted_recipient (gconstpointer data);
+void test_prepare_replay (void);
+void test_prepare_replay_unaccepted_recipient (void);
+void test_prepare_replay_not_recording (void);
+void test_prepare_replay_after_data (void);
 
 static MilterEventLoop *loop;
 
@@ -67,6 +73,7 @@ static gboolean command_received;
 static gboolean reply_received;
 static gboolean ready_received;
 static gboolean connection_timeout_received;
+static gboolean reading_timeout_received;
 
 static MilterMessageResult *message_result;
 
@@ -163,6 +170,9 @@ cb_command_received (MilterDecoder *decoder, gpointer user_data)
     case MILTER_STATUS_ACCEPT:
         send_accept();
         break;
+    case MILTER_STATUS_PROGRESS:
+        /* Still processing. No reply. */
+        break;
     default:
         send_continue();
         break;
@@ -181,6 +191,12 @@ cb_ready_received (MilterServerContext *context, gpointer user_data)
     ready_received = TRUE;
 }
 
+static void
+cb_reading_timeout_received (MilterServerContext *context, gpointer user_data)
+{
+    reading_timeout_received = TRUE;
+}
+
 static void
 cb_error_received (MilterServerContext *context, GError *error,
                    gpointer user_data)
@@ -219,6 +235,7 @@ setup_server_context_signals (MilterServerContext *context)
     g_signal_connect(context, #name, G_CALLBACK(cb_ ## name ## _received), NULL)
 
     CONNECT(ready);
+    CONNECT(reading_timeout);
     CONNECT(error);
 
 #undef CONNECT
@@ -287,6 +304,7 @@ cut_setup (void)
     reply_status = MILTER_STATUS_CONTINUE;
     ready_received = FALSE;
     connection_timeout_received = FALSE;
+    reading_timeout_received = FALSE;
 
     message_result = NULL;
 }
@@ -350,6 +368,22 @@ wait_ready (void)
     cut_assert_true(timeout_waiting, cut_message("timeout"));
 }
 
+static void
+wait_reading_timeout (void)
+{
+    gboolean timeout_waiting = TRUE;
+    guint timeout_waiting_id;
+
+    timeout_waiting_id = milter_event_loop_add_timeout(loop, 1,
+                                                       cb_timeout_waiting,
+                                                       &timeout_waiting);
+    while (timeout_waiting && !reading_timeout_received) {
+        milter_event_loop_iterate(loop, TRUE);
+    }
+    milter_event_loop_remove(loop, timeout_waiting_id);
+    cut_assert_true(timeout_waiting, cut_message("timeout"));
+}
+
 static void
 wait_error (void)
 {
@@ -448,6 +482,22 @@ test_negotiate (void)
                            milter_server_context_get_status(context));
 }
 
+void
+test_negotiate_max_data_size (void)
+{
+    MilterEncoder *context_encoder;
+
+    context_encoder = milter_agent_get_encoder(MILTER_AGENT(context));
+    cut_assert_equal_uint(MILTER_CHUNK_SIZE,
+                          milter_encoder_get_max_data_size(context_encoder));
+
+    milter_option_add_step(option, MILTER_STEP_MAX_DATA_SIZE_256K);
+    cut_trace(test_negotiate());
+
+    cut_assert_equal_uint(MILTER_MAX_DATA_SIZE_256K,
+                          milter_encoder_get_max_data_size(context_encoder));
+}
+
 void
 test_connect (void)
 {
@@ -479,6 +529,32 @@ test_connect (void)
                            milter_server_context_get_status(context));
 }
 
+void
+test_connect_deadline (void)
+{
+    struct sockaddr_in address;
+    const gchar host_name[] = "mx.example.com";
+    const gchar ip_address[] = "192.168.123.123";
+
+    cut_trace(test_negotiate());
+
+    milter_server_context_set_reading_timeout(context,
+                                              MILTER_SERVER_CONTEXT_DEFAULT_READING_TIMEOUT);
+    milter_server_context_set_deadline(context, 0.1);
+    reply_status = MILTER_STATUS_PROGRESS;
+    reply_received = FALSE;
+
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, ip_address, &(address.sin_addr));
+
+    milter_server_context_connect(context, host_name,
+                                  (struct sockaddr *)&address,
+                                  sizeof(address));
+    wait_reading_timeout();
+    cut_assert_false(reply_received);
+}
+
 void
 test_helo (void)
 {
@@ -874,6 +950,77 @@ test_has_accepted_recipient (gconstpointer data)
     }
 }
 
+void
+test_prepare_replay (void)
+{
+    MilterServerContext *replay_context;
+
+    milter_server_context_set_replay_recording(context, TRUE);
+    cut_trace(test_envelope_recipient_again());
+
+    replay_context = milter_server_context_new();
+    gcut_take_object(G_OBJECT(replay_context));
+    cut_assert_equal_uint(
+        0, milter_server_context_get_n_replay_commands(replay_context));
+
+    milter_server_context_prepare_replay(replay_context, context);
+    cut_assert_equal_uint(
+        5, milter_server_context_get_n_replay_commands(replay_context));
+}
+
+void
+test_prepare_replay_unaccepted_recipient (void)
+{
+    MilterServerContext *replay_context;
+
+    milter_server_context_set_replay_recording(context, TRUE);
+    cut_trace(test_envelope_recipient_reject());
+
+    milter_server_context_envelope_recipient(
+        context, "receiver-temporary-failure@example.com");
+    reply_status = MILTER_STATUS_TEMPORARY_FAILURE;
+    wait_for_receiving_command();
+    wait_for_receiving_reply();
+
+    replay_context = milter_server_context_new();
+    gcut_take_object(G_OBJECT(replay_context));
+    milter_server_context_prepare_replay(replay_context, context);
+    cut_assert_equal_uint(
+        4, milter_server_context_get_n_replay_commands(replay_context));
+}
+
+void
+test_prepare_replay_not_recording (void)
+{
+    MilterServerContext *replay_context;
+
+    cut_assert_false(milter_server_context_get_replay_recording(context));
+    cut_trace(test_envelope_recipient_again());
+
+    replay_context = milter_server_context_new();
+    gcut_take_object(G_OBJECT(replay_context));
+    milter_server_context_prepare_replay(replay_context, context);
+    cut_assert_equal_uint(
+        0, milter_server_context_get_n_replay_commands(replay_context));
+}
+
+void
+test_prepare_replay_after_data (void)
+{
+    MilterServerContext *replay_context;
+
+    milter_server_context_set_replay_recording(context, TRUE);
+    cut_trace(test_envelope_recipient_again());
+
+    milter_server_context_data(context);
+
+    replay_context = milter_server_context_new();
+    gcut_take_object(G_OBJECT(replay_context));
+    milter_server_context_prepare_replay(replay_context, context);
+    cut_assert_equal_uint(
+        2, milter_server_context_get_n_replay_commands(replay_context));
+}
+
 /*
 vi:ts=4:nowrap:ai:expandtab:sw=4
 */
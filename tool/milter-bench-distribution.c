@@ -0,0 +1,166 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib/gi18n.h>
+
+#include "milter-bench-distribution.h"
+
+static gboolean
+parse_number (const gchar *string, gdouble *number)
+{
+    gchar *end = NULL;
+
+    *number = g_ascii_strtod(string, &end);
+    return end != string && end && end[0] == '\0';
+}
+
+static gboolean
+parse_pair (const gchar *string, gdouble *first, gdouble *second)
+{
+    gchar **values;
+    gboolean success;
+
+    values = g_strsplit(string, ",", 2);
+    success = (values[0] && values[1] &&
+               parse_number(values[0], first) &&
+               parse_number(values[1], second));
+    g_strfreev(values);
+
+    return success;
+}
+
+gboolean
+milter_bench_distribution_parse (MilterBenchDistribution *distribution,
+                                 const gchar *spec,
+                                 GError **error)
+{
+    gboolean success = FALSE;
+
+    distribution->first = 0.0;
+    distribution->second = 0.0;
+
+    if (g_str_has_prefix(spec, "fixed:")) {
+        distribution->type = MILTER_BENCH_DISTRIBUTION_FIXED;
+        success = parse_number(spec + strlen("fixed:"), &distribution->first);
+    } else if (g_str_has_prefix(spec, "uniform:")) {
+        distribution->type = MILTER_BENCH_DISTRIBUTION_UNIFORM;
+        success = parse_pair(spec + strlen("uniform:"),
+                             &distribution->first, &distribution->second);
+        if (success && distribution->first > distribution->second)
+            success = FALSE;
+    } else if (g_str_has_prefix(spec, "lognormal:")) {
+        distribution->type = MILTER_BENCH_DISTRIBUTION_LOGNORMAL;
+        success = parse_pair(spec + strlen("lognormal:"),
+                             &distribution->first, &distribution->second);
+        if (success && distribution->first <= 0.0)
+            success = FALSE;
+    } else {
+        distribution->type = MILTER_BENCH_DISTRIBUTION_FIXED;
+        success = parse_number(spec, &distribution->first);
+    }
+
+    if (success && (distribution->first < 0.0 || distribution->second < 0.0))
+        success = FALSE;
+
+    if (!success) {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("invalid distribution: <%s>: "
+                      "available: VALUE, fixed:VALUE, uniform:MIN,MAX, "
+                      "lognormal:MEDIAN,SIGMA"),
+                    spec);
+    }
+
+    return success;
+}
+
+static gdouble
+sample_standard_normal (GRand *rand)
+{
+    gdouble u1, u2;
+
+    /* Box-Muller transform */
+    do {
+        u1 = g_rand_double(rand);
+    } while (u1 <= 0.0);
+    u2 = g_rand_double(rand);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * G_PI * u2);
+}
+
+gdouble
+milter_bench_distribution_sample (MilterBenchDistribution *distribution,
+                                  GRand *rand)
+{
+    switch (distribution->type) {
+    case MILTER_BENCH_DISTRIBUTION_FIXED:
+        return distribution->first;
+        break;
+    case MILTER_BENCH_DISTRIBUTION_UNIFORM:
+        if (distribution->first == distribution->second)
+            return distribution->first;
+        return g_rand_double_range(rand,
+                                   distribution->first,
+                                   distribution->second);
+        break;
+    case MILTER_BENCH_DISTRIBUTION_LOGNORMAL:
+        return distribution->first *
+            exp(distribution->second * sample_standard_normal(rand));
+        break;
+    default:
+        break;
+    }
+
+    return 0.0;
+}
+
+gchar *
+milter_bench_distribution_inspect (MilterBenchDistribution *distribution)
+{
+    switch (distribution->type) {
+    case MILTER_BENCH_DISTRIBUTION_FIXED:
+        return g_strdup_printf("fixed:%g", distribution->first);
+        break;
+    case MILTER_BENCH_DISTRIBUTION_UNIFORM:
+        return g_strdup_printf("uniform:%g,%g",
+                               distribution->first, distribution->second);
+        break;
+    case MILTER_BENCH_DISTRIBUTION_LOGNORMAL:
+        return g_strdup_printf("lognormal:%g,%g",
+                               distribution->first, distribution->second);
+        break;
+    default:
+        break;
+    }
+
+    return g_strdup("unknown");
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
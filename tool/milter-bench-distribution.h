@@ -0,0 +1,63 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __MILTER_BENCH_DISTRIBUTION_H__
+#define __MILTER_BENCH_DISTRIBUTION_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    MILTER_BENCH_DISTRIBUTION_FIXED,
+    MILTER_BENCH_DISTRIBUTION_UNIFORM,
+    MILTER_BENCH_DISTRIBUTION_LOGNORMAL
+} MilterBenchDistributionType;
+
+/*
+ * FIXED:     first is the value.
+ * UNIFORM:   [first, second].
+ * LOGNORMAL: first is the median and second is sigma.
+ */
+typedef struct _MilterBenchDistribution
+{
+    MilterBenchDistributionType type;
+    gdouble first;
+    gdouble second;
+} MilterBenchDistribution;
+
+/*
+ * Parses "VALUE", "fixed:VALUE", "uniform:MIN,MAX" or
+ * "lognormal:MEDIAN,SIGMA".
+ */
+gboolean milter_bench_distribution_parse  (MilterBenchDistribution *distribution,
+                                           const gchar             *spec,
+                                           GError                 **error);
+gdouble  milter_bench_distribution_sample (MilterBenchDistribution *distribution,
+                                           GRand                   *rand);
+gchar   *milter_bench_distribution_inspect(MilterBenchDistribution *distribution);
+
+G_END_DECLS
+
+#endif /* __MILTER_BENCH_DISTRIBUTION_H__ */
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
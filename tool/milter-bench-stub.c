@@ -0,0 +1,654 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_LOCALE_H
+#  include <locale.h>
+#endif
+
+#include <milter/client.h>
+
+#include "milter-bench-distribution.h"
+
+/*
+ * A stub milter for benchmarking. Each stage is replied
+ * after a delay sampled from a configured distribution
+ * without blocking the event loop, so a single process can
+ * serve many concurrent connections.
+ */
+
+typedef enum
+{
+    STAGE_CONNECT,
+    STAGE_HELO,
+    STAGE_ENVELOPE_FROM,
+    STAGE_ENVELOPE_RECIPIENT,
+    STAGE_DATA,
+    STAGE_UNKNOWN,
+    STAGE_HEADER,
+    STAGE_END_OF_HEADER,
+    STAGE_BODY,
+    STAGE_END_OF_MESSAGE,
+    N_STAGES
+} Stage;
+
+static const gchar *stage_names[N_STAGES] = {
+    "connect",
+    "helo",
+    "envelope-from",
+    "envelope-recipient",
+    "data",
+    "unknown",
+    "header",
+    "end-of-header",
+    "body",
+    "end-of-message"
+};
+
+typedef struct _StubContext
+{
+    MilterClientContext *context;
+    MilterEventLoop *loop;
+    guint reply_id;
+    Stage stage;
+    MilterStatus status;
+} StubContext;
+
+static MilterClient *client = NULL;
+static GRand *random_generator = NULL;
+static MilterBenchDistribution *latencies[N_STAGES];
+static Stage verdict_stage = STAGE_END_OF_MESSAGE;
+static gdouble reject_rate = 0.0;
+static gdouble temporary_failure_rate = 0.0;
+static gdouble modify_rate = 1.0;
+static MilterHeaders *added_headers = NULL;
+static MilterHeaders *changed_headers = NULL;
+static gchar **added_recipients = NULL;
+static gint replaced_body_size = -1;
+static gint seed = 0;
+static gboolean report = FALSE;
+
+static guint n_sessions = 0;
+static guint n_rejected = 0;
+static guint n_temporary_failed = 0;
+static guint n_modified = 0;
+
+static gboolean
+parse_stage (const gchar *name, Stage *stage, GError **error)
+{
+    gint i;
+
+    for (i = 0; i < N_STAGES; i++) {
+        if (g_str_equal(name, stage_names[i])) {
+            *stage = i;
+            return TRUE;
+        }
+    }
+
+    g_set_error(error,
+                G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                _("invalid stage: <%s>"), name);
+    return FALSE;
+}
+
+static gboolean
+parse_latency_arg (const gchar *option_name,
+                   const gchar *value,
+                   gpointer data,
+                   GError **error)
+{
+    MilterBenchDistribution distribution;
+    const gchar *equal;
+    gint i;
+
+    equal = strchr(value, '=');
+    if (equal) {
+        gchar *name;
+        Stage stage;
+        gboolean success;
+
+        if (!milter_bench_distribution_parse(&distribution, equal + 1, error))
+            return FALSE;
+        name = g_strndup(value, equal - value);
+        success = parse_stage(name, &stage, error);
+        g_free(name);
+        if (!success)
+            return FALSE;
+        g_free(latencies[stage]);
+        latencies[stage] = g_memdup(&distribution, sizeof(distribution));
+    } else {
+        if (!milter_bench_distribution_parse(&distribution, value, error))
+            return FALSE;
+        for (i = 0; i < N_STAGES; i++) {
+            g_free(latencies[i]);
+            latencies[i] = g_memdup(&distribution, sizeof(distribution));
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+parse_verdict_stage_arg (const gchar *option_name,
+                         const gchar *value,
+                         gpointer data,
+                         GError **error)
+{
+    return parse_stage(value, &verdict_stage, error);
+}
+
+static gboolean
+parse_header (MilterHeaders *headers, const gchar *value, GError **error)
+{
+    gchar **name_and_value;
+    gboolean success;
+
+    name_and_value = g_strsplit(value, ":", 2);
+    success = name_and_value[0] && name_and_value[1];
+    if (success) {
+        milter_headers_append_header(headers,
+                                     name_and_value[0],
+                                     name_and_value[1]);
+    } else {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("invalid header: <%s>: NAME:VALUE is expected"), value);
+    }
+    g_strfreev(name_and_value);
+
+    return success;
+}
+
+static gboolean
+parse_add_header_arg (const gchar *option_name,
+                      const gchar *value,
+                      gpointer data,
+                      GError **error)
+{
+    return parse_header(added_headers, value, error);
+}
+
+static gboolean
+parse_change_header_arg (const gchar *option_name,
+                         const gchar *value,
+                         gpointer data,
+                         GError **error)
+{
+    return parse_header(changed_headers, value, error);
+}
+
+static gboolean
+print_version (const gchar *option_name,
+               const gchar *value,
+               gpointer data,
+               GError **error)
+{
+    g_print("%s\n", VERSION);
+    exit(EXIT_SUCCESS);
+    return TRUE;
+}
+
+static const GOptionEntry option_entries[] =
+{
+    {"latency", 0, 0, G_OPTION_ARG_CALLBACK, parse_latency_arg,
+     N_("Reply after DISTRIBUTION seconds. "
+        "DISTRIBUTION is applied to STAGE when STAGE= is given, "
+        "all stages otherwise. "
+        "(fixed:SECONDS|uniform:MIN,MAX|lognormal:MEDIAN,SIGMA)"),
+     "[STAGE=]DISTRIBUTION"},
+    {"verdict-stage", 0, 0, G_OPTION_ARG_CALLBACK, parse_verdict_stage_arg,
+     N_("Reject or temporary fail on STAGE. (end-of-message)"), "STAGE"},
+    {"reject-rate", 0, 0, G_OPTION_ARG_DOUBLE, &reject_rate,
+     N_("Reject RATE (0.0-1.0) of messages on the verdict stage."), "RATE"},
+    {"temporary-failure-rate", 0, 0, G_OPTION_ARG_DOUBLE,
+     &temporary_failure_rate,
+     N_("Temporary fail RATE (0.0-1.0) of messages on the verdict stage."),
+     "RATE"},
+    {"modify-rate", 0, 0, G_OPTION_ARG_DOUBLE, &modify_rate,
+     N_("Apply modifications to RATE (0.0-1.0) of accepted messages "
+        "on end-of-message. (1.0)"),
+     "RATE"},
+    {"add-header", 0, 0, G_OPTION_ARG_CALLBACK, parse_add_header_arg,
+     N_("Add a header on end-of-message. "
+        "To add N headers, use --add-header option N times."),
+     "NAME:VALUE"},
+    {"change-header", 0, 0, G_OPTION_ARG_CALLBACK, parse_change_header_arg,
+     N_("Change the first header named NAME on end-of-message. "
+        "To change N headers, use --change-header option N times."),
+     "NAME:VALUE"},
+    {"add-recipient", 0, 0, G_OPTION_ARG_STRING_ARRAY, &added_recipients,
+     N_("Add a recipient on end-of-message. "
+        "To add N recipients, use --add-recipient option N times."),
+     "RECIPIENT"},
+    {"replace-body", 0, 0, G_OPTION_ARG_INT, &replaced_body_size,
+     N_("Replace body with SIZE bytes body on end-of-message."), "SIZE"},
+    {"seed", 0, 0, G_OPTION_ARG_INT, &seed,
+     N_("Use SEED as random seed"), "SEED"},
+    {"report", 0, 0, G_OPTION_ARG_NONE, &report,
+     N_("Report the number of processed sessions on exit"), NULL},
+    {"version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, print_version,
+     N_("Show version"), NULL},
+    {NULL}
+};
+
+static void
+modify (MilterClientContext *context)
+{
+    const GList *node;
+    gint i;
+    gboolean modified = FALSE;
+
+    if (g_rand_double(random_generator) >= modify_rate)
+        return;
+
+    for (node = milter_headers_get_list(added_headers);
+         node;
+         node = g_list_next(node)) {
+        MilterHeader *header = node->data;
+        milter_client_context_add_header(context,
+                                         header->name, header->value,
+                                         NULL);
+        modified = TRUE;
+    }
+
+    for (node = milter_headers_get_list(changed_headers);
+         node;
+         node = g_list_next(node)) {
+        MilterHeader *header = node->data;
+        milter_client_context_change_header(context,
+                                            header->name, 1, header->value,
+                                            NULL);
+        modified = TRUE;
+    }
+
+    for (i = 0; added_recipients && added_recipients[i]; i++) {
+        milter_client_context_add_recipient(context,
+                                            added_recipients[i], NULL,
+                                            NULL);
+        modified = TRUE;
+    }
+
+    if (replaced_body_size >= 0) {
+        gchar *body;
+
+        body = g_malloc(replaced_body_size + 1);
+        memset(body, 'x', replaced_body_size);
+        body[replaced_body_size] = '\0';
+        milter_client_context_replace_body(context,
+                                           body, replaced_body_size,
+                                           NULL);
+        g_free(body);
+        modified = TRUE;
+    }
+
+    if (modified)
+        n_modified++;
+}
+
+static MilterStatus
+decide_status (Stage stage)
+{
+    gdouble value;
+
+    if (stage != verdict_stage)
+        return MILTER_STATUS_CONTINUE;
+
+    value = g_rand_double(random_generator);
+    if (value < reject_rate) {
+        n_rejected++;
+        return MILTER_STATUS_REJECT;
+    }
+    if (value < reject_rate + temporary_failure_rate) {
+        n_temporary_failed++;
+        return MILTER_STATUS_TEMPORARY_FAILURE;
+    }
+
+    return MILTER_STATUS_CONTINUE;
+}
+
+static void
+apply_reply (StubContext *stub, Stage stage, MilterStatus status)
+{
+    if (stage == STAGE_END_OF_MESSAGE && status == MILTER_STATUS_CONTINUE)
+        modify(stub->context);
+}
+
+static gboolean
+cb_reply (gpointer user_data)
+{
+    StubContext *stub = user_data;
+    gchar *signal_name;
+
+    stub->reply_id = 0;
+    apply_reply(stub, stub->stage, stub->status);
+    signal_name = g_strdup_printf("%s-response", stage_names[stub->stage]);
+    g_signal_emit_by_name(stub->context, signal_name, stub->status);
+    g_free(signal_name);
+
+    return FALSE;
+}
+
+static void
+cancel_reply (StubContext *stub)
+{
+    if (stub->reply_id == 0)
+        return;
+
+    milter_event_loop_remove(stub->loop, stub->reply_id);
+    stub->reply_id = 0;
+}
+
+static void
+stub_context_free (gpointer data)
+{
+    StubContext *stub = data;
+
+    cancel_reply(stub);
+    g_free(stub);
+}
+
+static MilterStatus
+respond (MilterClientContext *context, Stage stage)
+{
+    StubContext *stub;
+    MilterStatus status;
+    gdouble latency = 0.0;
+
+    stub = milter_client_context_get_private_data(context);
+    status = decide_status(stage);
+    if (latencies[stage])
+        latency = milter_bench_distribution_sample(latencies[stage], random_generator);
+
+    if (latency <= 0.0) {
+        apply_reply(stub, stage, status);
+        return status;
+    }
+
+    cancel_reply(stub);
+    stub->stage = stage;
+    stub->status = status;
+    stub->reply_id = milter_event_loop_add_timeout(stub->loop,
+                                                   latency,
+                                                   cb_reply,
+                                                   stub);
+    return MILTER_STATUS_PROGRESS;
+}
+
+static MilterStatus
+cb_negotiate (MilterClientContext *context, MilterOption *option,
+              gpointer user_data)
+{
+    milter_option_remove_step(option,
+                              MILTER_STEP_ENVELOPE_RECIPIENT_REJECTED |
+                              MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE |
+                              MILTER_STEP_NO_MASK);
+    return MILTER_STATUS_CONTINUE;
+}
+
+static MilterStatus
+cb_connect (MilterClientContext *context, const gchar *host_name,
+            const struct sockaddr *address, socklen_t address_length,
+            gpointer user_data)
+{
+    return respond(context, STAGE_CONNECT);
+}
+
+static MilterStatus
+cb_helo (MilterClientContext *context, const gchar *fqdn, gpointer user_data)
+{
+    return respond(context, STAGE_HELO);
+}
+
+static MilterStatus
+cb_envelope_from (MilterClientContext *context, const gchar *from,
+                  gpointer user_data)
+{
+    return respond(context, STAGE_ENVELOPE_FROM);
+}
+
+static MilterStatus
+cb_envelope_recipient (MilterClientContext *context, const gchar *to,
+                       gpointer user_data)
+{
+    return respond(context, STAGE_ENVELOPE_RECIPIENT);
+}
+
+static MilterStatus
+cb_data (MilterClientContext *context, gpointer user_data)
+{
+    return respond(context, STAGE_DATA);
+}
+
+static MilterStatus
+cb_unknown (MilterClientContext *context, const gchar *command,
+            gpointer user_data)
+{
+    return respond(context, STAGE_UNKNOWN);
+}
+
+static MilterStatus
+cb_header (MilterClientContext *context, const gchar *name, const gchar *value,
+           gpointer user_data)
+{
+    return respond(context, STAGE_HEADER);
+}
+
+static MilterStatus
+cb_end_of_header (MilterClientContext *context, gpointer user_data)
+{
+    return respond(context, STAGE_END_OF_HEADER);
+}
+
+static MilterStatus
+cb_body (MilterClientContext *context, const gchar *chunk, gsize length,
+         gpointer user_data)
+{
+    return respond(context, STAGE_BODY);
+}
+
+static MilterStatus
+cb_end_of_message (MilterClientContext *context,
+                   const gchar *chunk, gsize length,
+                   gpointer user_data)
+{
+    return respond(context, STAGE_END_OF_MESSAGE);
+}
+
+static MilterStatus
+cb_abort (MilterClientContext *context, MilterClientContextState state,
+          gpointer user_data)
+{
+    cancel_reply(milter_client_context_get_private_data(context));
+    return MILTER_STATUS_CONTINUE;
+}
+
+static void
+cb_finished (MilterFinishedEmittable *emittable)
+{
+    MilterClientContext *context = MILTER_CLIENT_CONTEXT(emittable);
+
+    cancel_reply(milter_client_context_get_private_data(context));
+    n_sessions++;
+}
+
+static void
+setup_context_signals (MilterClientContext *context)
+{
+#define CONNECT(name)                                                   \
+    g_signal_connect(context, #name, G_CALLBACK(cb_ ## name), NULL)
+
+    CONNECT(negotiate);
+    CONNECT(connect);
+    CONNECT(helo);
+    CONNECT(envelope_from);
+    CONNECT(envelope_recipient);
+    CONNECT(data);
+    CONNECT(unknown);
+    CONNECT(header);
+    CONNECT(end_of_header);
+    CONNECT(body);
+    CONNECT(end_of_message);
+    CONNECT(abort);
+
+    CONNECT(finished);
+
+#undef CONNECT
+}
+
+static void
+cb_connection_established (MilterClient *client, MilterClientContext *context,
+                           gpointer user_data)
+{
+    StubContext *stub;
+
+    stub = g_new0(StubContext, 1);
+    stub->context = context;
+    stub->loop = milter_agent_get_event_loop(MILTER_AGENT(context));
+    stub->reply_id = 0;
+    milter_client_context_set_private_data(context, stub, stub_context_free);
+
+    setup_context_signals(context);
+}
+
+static void
+cb_error (MilterErrorEmittable *emittable, GError *error,
+          gpointer user_data)
+{
+    g_print("ERROR: %s\n", error->message);
+}
+
+static void
+cb_signal_shutdown_client (int signum)
+{
+    if (client)
+        milter_client_shutdown(client);
+
+    signal(signum, SIG_DFL);
+}
+
+static void
+free_option_values (void)
+{
+    gint i;
+
+    for (i = 0; i < N_STAGES; i++) {
+        g_free(latencies[i]);
+        latencies[i] = NULL;
+    }
+    if (added_headers)
+        g_object_unref(added_headers);
+    if (changed_headers)
+        g_object_unref(changed_headers);
+    g_strfreev(added_recipients);
+}
+
+int
+main (int argc, char *argv[])
+{
+    gboolean success = TRUE;
+    GError *error = NULL;
+    GOptionContext *option_context;
+    GOptionGroup *milter_group;
+
+#ifdef HAVE_LOCALE_H
+    setlocale(LC_ALL, "");
+#endif
+
+    milter_init();
+    milter_client_init();
+
+    added_headers = milter_headers_new();
+    changed_headers = milter_headers_new();
+
+    option_context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(option_context, option_entries, NULL);
+
+    client = milter_client_new();
+    milter_group = milter_client_get_option_group(client);
+    g_option_context_add_group(option_context, milter_group);
+
+    if (!g_option_context_parse(option_context, &argc, &argv, &error)) {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(option_context);
+        g_object_unref(client);
+        free_option_values();
+        exit(EXIT_FAILURE);
+    }
+
+    if (seed == 0)
+        random_generator = g_rand_new();
+    else
+        random_generator = g_rand_new_with_seed(seed);
+
+    success = milter_client_listen(client, &error);
+    if (success)
+        success = milter_client_drop_privilege(client, &error);
+    if (success) {
+        void (*sigint_handler) (int signum);
+        void (*sigterm_handler) (int signum);
+
+        g_signal_connect(client, "connection-established",
+                         G_CALLBACK(cb_connection_established), NULL);
+        g_signal_connect(client, "error", G_CALLBACK(cb_error), NULL);
+        sigint_handler = signal(SIGINT, cb_signal_shutdown_client);
+        sigterm_handler = signal(SIGTERM, cb_signal_shutdown_client);
+        success = milter_client_run(client, &error);
+        if (!success) {
+            g_print("%s\n", error->message);
+            g_error_free(error);
+        }
+        signal(SIGTERM, sigterm_handler);
+        signal(SIGINT, sigint_handler);
+    } else {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(client);
+
+    if (report) {
+        g_print("sessions: %u\n", n_sessions);
+        g_print("rejected: %u\n", n_rejected);
+        g_print("temporary-failed: %u\n", n_temporary_failed);
+        g_print("modified: %u\n", n_modified);
+    }
+
+    g_option_context_free(option_context);
+    g_rand_free(random_generator);
+    free_option_values();
+
+    milter_client_quit();
+    milter_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/
@@ -0,0 +1,1330 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ *  Copyright (C) 2013  Kouhei Sutou <kou@clear-code.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "../config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_LOCALE_H
+#  include <locale.h>
+#endif
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <milter/server.h>
+#include <milter/core.h>
+
+#include "milter-bench-distribution.h"
+
+#define DEFAULT_NEGOTIATE_VERSION 6
+#define DEFAULT_N_SESSIONS 100
+#define DEFAULT_CONCURRENCY 10
+
+static gboolean verbose = FALSE;
+static gchar *spec = NULL;
+static gint n_sessions = DEFAULT_N_SESSIONS;
+static gint concurrency = DEFAULT_CONCURRENCY;
+static gdouble rate = 0.0;
+static gchar **mail_files = NULL;
+static gchar *helo_host = NULL;
+static gchar *envelope_from = NULL;
+static MilterBenchDistribution body_size_distribution = {
+    MILTER_BENCH_DISTRIBUTION_FIXED, 4096, 0
+};
+static MilterBenchDistribution n_recipients_distribution = {
+    MILTER_BENCH_DISTRIBUTION_FIXED, 1, 0
+};
+static gint seed = 0;
+static gchar *output_path = NULL;
+static gdouble connection_timeout = MILTER_SERVER_CONTEXT_DEFAULT_CONNECTION_TIMEOUT;
+static gdouble writing_timeout = MILTER_SERVER_CONTEXT_DEFAULT_WRITING_TIMEOUT;
+static gdouble reading_timeout = MILTER_SERVER_CONTEXT_DEFAULT_READING_TIMEOUT;
+static gdouble end_of_message_timeout = MILTER_SERVER_CONTEXT_DEFAULT_END_OF_MESSAGE_TIMEOUT;
+
+typedef struct _Mail
+{
+    gchar *envelope_from;
+    gchar **recipients;
+    MilterHeaders *headers;
+    gchar **body_chunks;
+} Mail;
+
+typedef struct _Bench
+{
+    MilterEventLoop *loop;
+    GTimer *timer;
+    GRand *rand;
+    GPtrArray *mails;
+    guint timer_id;
+    gint n_started;
+    gint n_finished;
+    gint n_failed;
+    gint n_running;
+    gint max_running;
+    GArray *session_latencies;
+    GHashTable *stage_latencies;
+    GHashTable *status_counts;
+} Bench;
+
+typedef struct _Session
+{
+    Bench *bench;
+    MilterServerContext *context;
+    Mail *mail;
+    gboolean own_mail;
+    MilterOption *option;
+    gdouble scheduled_time;
+    gdouble stage_start_time;
+    gint current_recipient;
+    guint current_header;
+    gint current_body_chunk;
+    gboolean ready;
+    gboolean failed;
+    gboolean finished;
+} Session;
+
+static void
+mail_free (Mail *mail)
+{
+    g_free(mail->envelope_from);
+    g_strfreev(mail->recipients);
+    if (mail->headers)
+        g_object_unref(mail->headers);
+    g_strfreev(mail->body_chunks);
+    g_free(mail);
+}
+
+static gchar **
+split_body (const gchar *body, gsize body_size)
+{
+    GPtrArray *chunks;
+    gsize offset;
+
+    chunks = g_ptr_array_new();
+    for (offset = 0; offset < body_size; offset += MILTER_CHUNK_SIZE) {
+        gsize chunk_size;
+
+        chunk_size = MIN(MILTER_CHUNK_SIZE, body_size - offset);
+        g_ptr_array_add(chunks, g_strndup(body + offset, chunk_size));
+    }
+    g_ptr_array_add(chunks, NULL);
+
+    return (gchar **)g_ptr_array_free(chunks, FALSE);
+}
+
+static gchar *
+extract_path (const gchar *address)
+{
+    const gchar *start, *end;
+    gchar *stripped, *path;
+
+    start = strchr(address, '<');
+    if (start) {
+        end = strchr(start, '>');
+        if (end)
+            return g_strndup(start, end + 1 - start);
+    }
+
+    stripped = g_strstrip(g_strdup(address));
+    path = g_strdup_printf("<%s>", stripped);
+    g_free(stripped);
+
+    return path;
+}
+
+static Mail *
+mail_parse (const gchar *contents)
+{
+    Mail *mail;
+    gchar **lines, **line;
+    GPtrArray *recipients;
+    GString *body;
+
+    mail = g_new0(Mail, 1);
+    mail->headers = milter_headers_new();
+    recipients = g_ptr_array_new();
+
+    lines = g_strsplit(contents, "\n", -1);
+    line = lines;
+    /* Ignore mbox separation 'From ' mark. */
+    if (*line && g_str_has_prefix(*line, "From "))
+        line++;
+    for (; *line; line++) {
+        gchar *current = *line;
+        gsize length;
+
+        length = strlen(current);
+        if (length > 0 && current[length - 1] == '\r')
+            current[length - 1] = '\0';
+        if (current[0] == '\0') {
+            line++;
+            break;
+        }
+
+        if (g_ascii_isspace(current[0])) {
+            guint n_headers;
+            MilterHeader *last_header;
+            gchar *old_value;
+
+            n_headers = milter_headers_length(mail->headers);
+            if (n_headers == 0)
+                continue;
+            last_header = milter_headers_get_nth_header(mail->headers,
+                                                        n_headers);
+            old_value = last_header->value;
+            last_header->value = g_strdup_printf("%s\n%s", old_value, current);
+            g_free(old_value);
+        } else {
+            gchar **name_and_value;
+
+            name_and_value = g_strsplit(current, ":", 2);
+            if (name_and_value[0] && name_and_value[1]) {
+                const gchar *name = name_and_value[0];
+                const gchar *value = g_strchug(name_and_value[1]);
+
+                milter_headers_append_header(mail->headers, name, value);
+                if (!mail->envelope_from && g_str_equal(name, "From"))
+                    mail->envelope_from = extract_path(value);
+                else if (g_str_equal(name, "To"))
+                    g_ptr_array_add(recipients, extract_path(value));
+            }
+            g_strfreev(name_and_value);
+        }
+    }
+
+    body = g_string_new(NULL);
+    for (; *line; line++) {
+        g_string_append(body, *line);
+        g_string_append(body, "\r\n");
+    }
+    mail->body_chunks = split_body(body->str, body->len);
+    g_string_free(body, TRUE);
+    g_strfreev(lines);
+
+    if (!mail->envelope_from)
+        mail->envelope_from = g_strdup(envelope_from);
+    if (recipients->len == 0)
+        g_ptr_array_add(recipients, g_strdup("<receiver@example.com>"));
+    g_ptr_array_add(recipients, NULL);
+    mail->recipients = (gchar **)g_ptr_array_free(recipients, FALSE);
+
+    return mail;
+}
+
+static Mail *
+mail_generate (Bench *bench)
+{
+    Mail *mail;
+    gint i, n_recipients;
+    gsize j, body_size;
+    gchar *body;
+    gchar *message_id;
+
+    mail = g_new0(Mail, 1);
+    mail->envelope_from = g_strdup(envelope_from);
+
+    n_recipients =
+        (gint)milter_bench_distribution_sample(&n_recipients_distribution,
+                                               bench->rand);
+    n_recipients = MAX(n_recipients, 1);
+    mail->recipients = g_new0(gchar *, n_recipients + 1);
+    for (i = 0; i < n_recipients; i++) {
+        mail->recipients[i] = g_strdup_printf("<receiver%d@example.com>", i);
+    }
+
+    mail->headers = milter_headers_new();
+    milter_headers_append_header(mail->headers, "From", mail->envelope_from);
+    milter_headers_append_header(mail->headers, "To", mail->recipients[0]);
+    milter_headers_append_header(mail->headers, "Subject", "milter-bench");
+    message_id = g_strdup_printf("<%d.%u@milter-bench>",
+                                 bench->n_started, g_rand_int(bench->rand));
+    milter_headers_append_header(mail->headers, "Message-ID", message_id);
+    g_free(message_id);
+
+    body_size =
+        (gsize)milter_bench_distribution_sample(&body_size_distribution,
+                                                bench->rand);
+    body = g_malloc(body_size + 1);
+    for (j = 0; j < body_size; j++) {
+        if (j % 78 == 76)
+            body[j] = '\r';
+        else if (j % 78 == 77)
+            body[j] = '\n';
+        else
+            body[j] = 'a' + (j % 26);
+    }
+    body[body_size] = '\0';
+    mail->body_chunks = split_body(body, body_size);
+    g_free(body);
+
+    return mail;
+}
+
+static gboolean
+load_mail_files (Bench *bench, GError **error)
+{
+    gint i;
+
+    if (!mail_files)
+        return TRUE;
+
+    for (i = 0; mail_files[i]; i++) {
+        gchar *contents = NULL;
+
+        if (!g_file_get_contents(mail_files[i], &contents, NULL, error))
+            return FALSE;
+        g_ptr_array_add(bench->mails, mail_parse(contents));
+        g_free(contents);
+    }
+
+    return TRUE;
+}
+
+static void
+record_latency (GHashTable *latencies, const gchar *name, gdouble latency)
+{
+    GArray *values;
+
+    values = g_hash_table_lookup(latencies, name);
+    if (!values) {
+        values = g_array_new(FALSE, FALSE, sizeof(gdouble));
+        g_hash_table_insert(latencies, g_strdup(name), values);
+    }
+    g_array_append_val(values, latency);
+}
+
+static void
+record_stage_latency (Session *session, MilterServerContextState state)
+{
+    Bench *bench = session->bench;
+    gchar *state_name;
+
+    state_name =
+        milter_utils_get_enum_nick_name(MILTER_TYPE_SERVER_CONTEXT_STATE,
+                                        state);
+    record_latency(bench->stage_latencies, state_name,
+                   g_timer_elapsed(bench->timer, NULL) -
+                   session->stage_start_time);
+    g_free(state_name);
+}
+
+static void
+count_status (Session *session, MilterStatus status)
+{
+    Bench *bench = session->bench;
+    gchar *status_name;
+    gpointer count;
+
+    status_name = milter_utils_get_enum_nick_name(MILTER_TYPE_STATUS, status);
+    count = g_hash_table_lookup(bench->status_counts, status_name);
+    g_hash_table_insert(bench->status_counts,
+                        status_name,
+                        GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+}
+
+static void
+mark_stage_start (Session *session)
+{
+    session->stage_start_time = g_timer_elapsed(session->bench->timer, NULL);
+}
+
+static void
+send_quit (Session *session)
+{
+    milter_server_context_quit(session->context);
+    milter_agent_shutdown(MILTER_AGENT(session->context));
+}
+
+static void
+send_abort (Session *session)
+{
+    milter_server_context_abort(session->context);
+    send_quit(session);
+}
+
+static MilterStepFlags
+session_step (Session *session)
+{
+    if (!session->option)
+        return MILTER_STEP_NONE;
+    return milter_option_get_step(session->option);
+}
+
+static gboolean
+send_connect (Session *session)
+{
+    struct sockaddr_in address;
+
+    if (session_step(session) & MILTER_STEP_NO_CONNECT)
+        return FALSE;
+
+    address.sin_family = AF_INET;
+    address.sin_port = g_htons(50443);
+    inet_pton(AF_INET, "192.168.123.123", &(address.sin_addr));
+    mark_stage_start(session);
+    milter_server_context_connect(session->context,
+                                  "mx.example.net",
+                                  (struct sockaddr *)(&address),
+                                  sizeof(address));
+    return TRUE;
+}
+
+static gboolean
+send_helo (Session *session)
+{
+    if (session_step(session) & MILTER_STEP_NO_HELO)
+        return FALSE;
+
+    mark_stage_start(session);
+    milter_server_context_helo(session->context, helo_host);
+    return TRUE;
+}
+
+static gboolean
+send_envelope_from (Session *session)
+{
+    milter_server_context_reset_message_related_data(session->context);
+    if (session_step(session) & MILTER_STEP_NO_ENVELOPE_FROM)
+        return FALSE;
+
+    mark_stage_start(session);
+    milter_server_context_envelope_from(session->context,
+                                        session->mail->envelope_from);
+    return TRUE;
+}
+
+static gboolean
+send_envelope_recipient (Session *session)
+{
+    const gchar *recipient;
+
+    if (session_step(session) & MILTER_STEP_NO_ENVELOPE_RECIPIENT)
+        return FALSE;
+
+    recipient = session->mail->recipients[session->current_recipient];
+    if (!recipient)
+        return FALSE;
+
+    milter_protocol_agent_set_macros(MILTER_PROTOCOL_AGENT(session->context),
+                                     MILTER_COMMAND_ENVELOPE_RECIPIENT,
+                                     "{rcpt_addr}", recipient,
+                                     NULL);
+    mark_stage_start(session);
+    milter_server_context_envelope_recipient(session->context, recipient);
+    session->current_recipient++;
+    return TRUE;
+}
+
+static gboolean
+send_data (Session *session)
+{
+    if (session_step(session) & MILTER_STEP_NO_DATA)
+        return FALSE;
+    if (milter_option_get_version(session->option) < 4)
+        return FALSE;
+
+    mark_stage_start(session);
+    milter_server_context_data(session->context);
+    return TRUE;
+}
+
+static gboolean
+send_header (Session *session)
+{
+    MilterHeader *header;
+
+    if (session_step(session) & MILTER_STEP_NO_HEADERS)
+        return FALSE;
+    if (session->current_header >=
+        milter_headers_length(session->mail->headers))
+        return FALSE;
+
+    session->current_header++;
+    header = milter_headers_get_nth_header(session->mail->headers,
+                                           session->current_header);
+    mark_stage_start(session);
+    milter_server_context_header(session->context, header->name, header->value);
+    return TRUE;
+}
+
+static gboolean
+send_end_of_header (Session *session)
+{
+    if (session_step(session) & MILTER_STEP_NO_END_OF_HEADER)
+        return FALSE;
+
+    mark_stage_start(session);
+    milter_server_context_end_of_header(session->context);
+    return TRUE;
+}
+
+static gboolean
+send_body (Session *session)
+{
+    const gchar *chunk;
+
+    if (session_step(session) & MILTER_STEP_NO_BODY)
+        return FALSE;
+
+    chunk = session->mail->body_chunks[session->current_body_chunk];
+    if (!chunk)
+        return FALSE;
+
+    mark_stage_start(session);
+    milter_server_context_body(session->context, chunk, strlen(chunk));
+    session->current_body_chunk++;
+    return TRUE;
+}
+
+static gboolean
+send_end_of_message (Session *session)
+{
+    mark_stage_start(session);
+    milter_server_context_end_of_message(session->context, NULL, 0);
+    return TRUE;
+}
+
+static void
+send_next (Session *session, MilterServerContextState state)
+{
+    switch (state) {
+    case MILTER_SERVER_CONTEXT_STATE_NEGOTIATE:
+        if (send_connect(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_CONNECT:
+        if (send_helo(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_HELO:
+        if (send_envelope_from(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
+        if (send_envelope_recipient(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_UNKNOWN:
+        if (send_data(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_DATA:
+    case MILTER_SERVER_CONTEXT_STATE_HEADER:
+        if (send_header(session))
+            break;
+        if (send_end_of_header(session))
+            break;
+    case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
+    case MILTER_SERVER_CONTEXT_STATE_BODY:
+        if (send_body(session))
+            break;
+        send_end_of_message(session);
+        break;
+    case MILTER_SERVER_CONTEXT_STATE_END_OF_MESSAGE:
+        send_quit(session);
+        break;
+    default:
+        send_abort(session);
+        break;
+    }
+}
+
+static void
+reply (Session *session, MilterStatus status)
+{
+    MilterServerContextState state;
+
+    state = milter_server_context_get_state(session->context);
+    record_stage_latency(session, state);
+    count_status(session, status);
+
+    switch (status) {
+    case MILTER_STATUS_CONTINUE:
+    case MILTER_STATUS_SKIP:
+        send_next(session, state);
+        break;
+    case MILTER_STATUS_REJECT:
+    case MILTER_STATUS_TEMPORARY_FAILURE:
+        if (state == MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT) {
+            send_next(session, state);
+        } else {
+            send_quit(session);
+        }
+        break;
+    default:
+        send_quit(session);
+        break;
+    }
+}
+
+static void
+cb_negotiate_reply (MilterServerContext *context, MilterOption *option,
+                    MilterMacrosRequests *macros_requests, gpointer user_data)
+{
+    Session *session = user_data;
+
+    record_stage_latency(session, MILTER_SERVER_CONTEXT_STATE_NEGOTIATE);
+    session->option = g_object_ref(option);
+    send_next(session, MILTER_SERVER_CONTEXT_STATE_NEGOTIATE);
+}
+
+static void
+cb_continue (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_CONTINUE);
+}
+
+static void
+cb_reply_code (MilterServerContext *context,
+               guint code,
+               const gchar *extended_code,
+               const gchar *message,
+               gpointer user_data)
+{
+    if (code / 100 == 4)
+        reply(user_data, MILTER_STATUS_TEMPORARY_FAILURE);
+    else
+        reply(user_data, MILTER_STATUS_REJECT);
+}
+
+static void
+cb_temporary_failure (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_TEMPORARY_FAILURE);
+}
+
+static void
+cb_reject (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_REJECT);
+}
+
+static void
+cb_accept (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_ACCEPT);
+}
+
+static void
+cb_discard (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_DISCARD);
+}
+
+static void
+cb_skip (MilterServerContext *context, gpointer user_data)
+{
+    reply(user_data, MILTER_STATUS_SKIP);
+}
+
+static void
+cb_state_transited (MilterServerContext *context,
+                    MilterServerContextState state,
+                    gpointer user_data)
+{
+    Session *session = user_data;
+
+    switch (state) {
+    case MILTER_SERVER_CONTEXT_STATE_CONNECT:
+    case MILTER_SERVER_CONTEXT_STATE_HELO:
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_FROM:
+    case MILTER_SERVER_CONTEXT_STATE_ENVELOPE_RECIPIENT:
+    case MILTER_SERVER_CONTEXT_STATE_UNKNOWN:
+    case MILTER_SERVER_CONTEXT_STATE_DATA:
+    case MILTER_SERVER_CONTEXT_STATE_HEADER:
+    case MILTER_SERVER_CONTEXT_STATE_END_OF_HEADER:
+    case MILTER_SERVER_CONTEXT_STATE_BODY:
+        if (!milter_server_context_need_reply(context, state))
+            send_next(session, state);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+fail (Session *session, const gchar *reason)
+{
+    if (!session->failed) {
+        session->failed = TRUE;
+        if (verbose)
+            g_printerr("session failed: %s\n", reason);
+    }
+}
+
+static void finish_session (Session *session);
+
+/*
+ * A connected session is finished by its "finished"
+ * signal after it is shut down. A session that isn't
+ * connected yet doesn't emit it.
+ */
+static void
+abort_session (Session *session, const gchar *reason)
+{
+    fail(session, reason);
+    if (session->ready)
+        milter_agent_shutdown(MILTER_AGENT(session->context));
+    else
+        finish_session(session);
+}
+
+static void
+cb_connection_timeout (MilterServerContext *context, gpointer user_data)
+{
+    abort_session(user_data, "connection timeout");
+}
+
+static void
+cb_writing_timeout (MilterServerContext *context, gpointer user_data)
+{
+    abort_session(user_data, "writing timeout");
+}
+
+static void
+cb_reading_timeout (MilterServerContext *context, gpointer user_data)
+{
+    fail(user_data, "reading timeout");
+    send_abort(user_data);
+}
+
+static void
+cb_end_of_message_timeout (MilterServerContext *context, gpointer user_data)
+{
+    fail(user_data, "end-of-message timeout");
+    send_abort(user_data);
+}
+
+static void start_session (Bench *bench, gdouble scheduled_time);
+
+static void
+bench_check_done (Bench *bench)
+{
+    if (bench->n_finished < n_sessions)
+        return;
+    milter_event_loop_quit(bench->loop);
+}
+
+static gboolean
+cb_free_session (gpointer user_data)
+{
+    Session *session = user_data;
+
+    g_object_unref(session->context);
+    if (session->option)
+        g_object_unref(session->option);
+    if (session->own_mail)
+        mail_free(session->mail);
+    g_free(session);
+
+    return FALSE;
+}
+
+static gboolean
+cb_start_next_session (gpointer user_data)
+{
+    Bench *bench = user_data;
+
+    if (bench->n_started < n_sessions)
+        start_session(bench, g_timer_elapsed(bench->timer, NULL));
+
+    return FALSE;
+}
+
+static void
+finish_session (Session *session)
+{
+    Bench *bench = session->bench;
+    gdouble latency;
+
+    if (session->finished)
+        return;
+    session->finished = TRUE;
+
+    latency = g_timer_elapsed(bench->timer, NULL) - session->scheduled_time;
+    if (session->failed) {
+        bench->n_failed++;
+    } else {
+        g_array_append_val(bench->session_latencies, latency);
+    }
+    bench->n_finished++;
+    bench->n_running--;
+
+    milter_event_loop_add_idle(bench->loop, cb_free_session, session);
+
+    /* Closed loop: the next session is started in the next
+     * iteration. Starting it here recurses when sessions
+     * fail synchronously. */
+    if (rate <= 0.0 && bench->n_started < n_sessions)
+        milter_event_loop_add_idle(bench->loop, cb_start_next_session, bench);
+    bench_check_done(bench);
+}
+
+static void
+cb_finished (MilterFinishedEmittable *emittable, gpointer user_data)
+{
+    finish_session(user_data);
+}
+
+static void
+setup_session_signals (Session *session)
+{
+#define CONNECT(name)                                                   \
+    g_signal_connect(session->context, #name,                           \
+                     G_CALLBACK(cb_ ## name), session)
+
+    CONNECT(negotiate_reply);
+    CONNECT(continue);
+    CONNECT(reply_code);
+    CONNECT(temporary_failure);
+    CONNECT(reject);
+    CONNECT(accept);
+    CONNECT(discard);
+    CONNECT(skip);
+    CONNECT(finished);
+
+    CONNECT(writing_timeout);
+    CONNECT(reading_timeout);
+    CONNECT(end_of_message_timeout);
+
+    CONNECT(state_transited);
+
+#undef CONNECT
+}
+
+static void
+negotiate (Session *session)
+{
+    MilterOption *option;
+
+    option = milter_option_new(DEFAULT_NEGOTIATE_VERSION,
+                               MILTER_ACTION_ADD_HEADERS |
+                               MILTER_ACTION_CHANGE_BODY |
+                               MILTER_ACTION_ADD_ENVELOPE_RECIPIENT |
+                               MILTER_ACTION_DELETE_ENVELOPE_RECIPIENT |
+                               MILTER_ACTION_CHANGE_HEADERS |
+                               MILTER_ACTION_QUARANTINE |
+                               MILTER_ACTION_CHANGE_ENVELOPE_FROM |
+                               MILTER_ACTION_ADD_ENVELOPE_RECIPIENT_WITH_PARAMETERS |
+                               MILTER_ACTION_SET_SYMBOL_LIST,
+                               MILTER_STEP_NO_CONNECT |
+                               MILTER_STEP_NO_HELO |
+                               MILTER_STEP_NO_ENVELOPE_FROM |
+                               MILTER_STEP_NO_ENVELOPE_RECIPIENT |
+                               MILTER_STEP_NO_BODY |
+                               MILTER_STEP_NO_HEADERS |
+                               MILTER_STEP_NO_END_OF_HEADER |
+                               MILTER_STEP_NO_REPLY_HEADER |
+                               MILTER_STEP_NO_UNKNOWN |
+                               MILTER_STEP_NO_DATA |
+                               MILTER_STEP_SKIP |
+                               MILTER_STEP_ENVELOPE_RECIPIENT_REJECTED |
+                               MILTER_STEP_NO_REPLY_CONNECT |
+                               MILTER_STEP_NO_REPLY_HELO |
+                               MILTER_STEP_NO_REPLY_ENVELOPE_FROM |
+                               MILTER_STEP_NO_REPLY_ENVELOPE_RECIPIENT |
+                               MILTER_STEP_NO_REPLY_DATA |
+                               MILTER_STEP_NO_REPLY_UNKNOWN |
+                               MILTER_STEP_NO_REPLY_END_OF_HEADER |
+                               MILTER_STEP_NO_REPLY_BODY |
+                               MILTER_STEP_HEADER_VALUE_WITH_LEADING_SPACE);
+    mark_stage_start(session);
+    milter_server_context_negotiate(session->context, option);
+    g_object_unref(option);
+}
+
+static void
+cb_ready (MilterServerContext *context, gpointer user_data)
+{
+    Session *session = user_data;
+
+    session->ready = TRUE;
+    record_stage_latency(session, MILTER_SERVER_CONTEXT_STATE_START);
+    setup_session_signals(session);
+    negotiate(session);
+}
+
+static void
+cb_error (MilterErrorEmittable *emittable, GError *error, gpointer user_data)
+{
+    abort_session(user_data, error->message);
+}
+
+static void
+start_session (Bench *bench, gdouble scheduled_time)
+{
+    Session *session;
+    GError *error = NULL;
+
+    session = g_new0(Session, 1);
+    session->bench = bench;
+    session->scheduled_time = scheduled_time;
+    if (bench->mails->len > 0) {
+        session->mail = g_ptr_array_index(bench->mails,
+                                          bench->n_started % bench->mails->len);
+        session->own_mail = FALSE;
+    } else {
+        session->mail = mail_generate(bench);
+        session->own_mail = TRUE;
+    }
+
+    bench->n_started++;
+    bench->n_running++;
+    bench->max_running = MAX(bench->max_running, bench->n_running);
+
+    session->context = milter_server_context_new();
+    milter_agent_set_event_loop(MILTER_AGENT(session->context), bench->loop);
+    milter_server_context_set_name(session->context, g_get_prgname());
+    milter_server_context_set_connection_timeout(session->context,
+                                                 connection_timeout);
+    milter_server_context_set_reading_timeout(session->context,
+                                              reading_timeout);
+    milter_server_context_set_writing_timeout(session->context,
+                                              writing_timeout);
+    milter_server_context_set_end_of_message_timeout(session->context,
+                                                     end_of_message_timeout);
+    g_signal_connect(session->context, "ready",
+                     G_CALLBACK(cb_ready), session);
+    g_signal_connect(session->context, "error",
+                     G_CALLBACK(cb_error), session);
+    g_signal_connect(session->context, "connection-timeout",
+                     G_CALLBACK(cb_connection_timeout), session);
+
+    mark_stage_start(session);
+    if (!milter_server_context_set_connection_spec(session->context,
+                                                   spec, &error) ||
+        !milter_server_context_establish_connection(session->context,
+                                                    &error)) {
+        fail(session, error->message);
+        g_error_free(error);
+        finish_session(session);
+    }
+}
+
+static gboolean
+cb_arrival (gpointer user_data)
+{
+    Bench *bench = user_data;
+    gdouble now;
+    gint n_due;
+
+    /* Open loop: sessions are scheduled at a fixed rate
+     * regardless of how many are still running. Latencies are
+     * measured from the scheduled time to avoid coordinated
+     * omission. */
+    now = g_timer_elapsed(bench->timer, NULL);
+    n_due = MIN((gint)(now * rate) + 1, n_sessions);
+    while (bench->n_started < n_due) {
+        start_session(bench, bench->n_started / rate);
+    }
+
+    if (bench->n_started < n_sessions)
+        return TRUE;
+
+    bench->timer_id = 0;
+    return FALSE;
+}
+
+static void
+start_bench (Bench *bench)
+{
+    g_timer_start(bench->timer);
+    if (rate > 0.0) {
+        cb_arrival(bench);
+        if (bench->n_started < n_sessions)
+            bench->timer_id = milter_event_loop_add_timeout(bench->loop,
+                                                            1.0 / rate,
+                                                            cb_arrival,
+                                                            bench);
+    } else {
+        gint i;
+
+        for (i = 0; i < concurrency && bench->n_started < n_sessions; i++) {
+            start_session(bench, g_timer_elapsed(bench->timer, NULL));
+        }
+    }
+}
+
+static gint
+compare_double (gconstpointer a, gconstpointer b)
+{
+    gdouble value_a = *(const gdouble *)a;
+    gdouble value_b = *(const gdouble *)b;
+
+    if (value_a < value_b)
+        return -1;
+    if (value_a > value_b)
+        return 1;
+    return 0;
+}
+
+static gdouble
+percentile (GArray *sorted_values, gdouble ratio)
+{
+    guint index;
+
+    if (sorted_values->len == 0)
+        return 0.0;
+
+    index = (guint)ceil(ratio * sorted_values->len);
+    if (index > 0)
+        index--;
+    index = MIN(index, sorted_values->len - 1);
+    return g_array_index(sorted_values, gdouble, index);
+}
+
+static void
+append_latency_summary (GString *json, const gchar *name, GArray *values)
+{
+    gdouble sum = 0.0;
+    guint i;
+
+    g_array_sort(values, compare_double);
+    for (i = 0; i < values->len; i++) {
+        sum += g_array_index(values, gdouble, i);
+    }
+
+    g_string_append_printf(json,
+                           "    \"%s\": {"
+                           "\"count\": %u, "
+                           "\"mean\": %.9f, "
+                           "\"p50\": %.9f, "
+                           "\"p99\": %.9f, "
+                           "\"p999\": %.9f, "
+                           "\"max\": %.9f}",
+                           name,
+                           values->len,
+                           values->len > 0 ? sum / values->len : 0.0,
+                           percentile(values, 0.50),
+                           percentile(values, 0.99),
+                           percentile(values, 0.999),
+                           percentile(values, 1.0));
+}
+
+static gchar *
+bench_to_json (Bench *bench, gdouble elapsed)
+{
+    GString *json;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean first;
+    gchar *inspected;
+
+    json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"mode\": \"%s\",\n",
+                           rate > 0.0 ? "open" : "closed");
+    if (rate > 0.0)
+        g_string_append_printf(json, "  \"rate\": %g,\n", rate);
+    else
+        g_string_append_printf(json, "  \"concurrency\": %d,\n", concurrency);
+    if (bench->mails->len > 0) {
+        g_string_append_printf(json, "  \"mails\": %u,\n", bench->mails->len);
+    } else {
+        inspected = milter_bench_distribution_inspect(&body_size_distribution);
+        g_string_append_printf(json, "  \"body_size\": \"%s\",\n", inspected);
+        g_free(inspected);
+        inspected =
+            milter_bench_distribution_inspect(&n_recipients_distribution);
+        g_string_append_printf(json, "  \"n_recipients\": \"%s\",\n",
+                               inspected);
+        g_free(inspected);
+    }
+    g_string_append_printf(json,
+                           "  \"sessions\": {"
+                           "\"started\": %d, "
+                           "\"finished\": %d, "
+                           "\"failed\": %d, "
+                           "\"max_concurrent\": %d},\n",
+                           bench->n_started,
+                           bench->n_finished,
+                           bench->n_failed,
+                           bench->max_running);
+    g_string_append_printf(json, "  \"elapsed\": %.9f,\n", elapsed);
+    g_string_append_printf(json, "  \"throughput\": %.3f,\n",
+                           elapsed > 0.0 ? bench->n_finished / elapsed : 0.0);
+
+    g_string_append(json, "  \"statuses\": {");
+    first = TRUE;
+    g_hash_table_iter_init(&iter, bench->status_counts);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        g_string_append_printf(json, "%s\"%s\": %u",
+                               first ? "" : ", ",
+                               (const gchar *)key,
+                               GPOINTER_TO_UINT(value));
+        first = FALSE;
+    }
+    g_string_append(json, "},\n");
+
+    g_string_append(json, "  \"latency\": {\n");
+    append_latency_summary(json, "session", bench->session_latencies);
+    g_hash_table_iter_init(&iter, bench->stage_latencies);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        g_string_append(json, ",\n");
+        append_latency_summary(json, key, value);
+    }
+    g_string_append(json, "\n  }\n}\n");
+
+    return g_string_free(json, FALSE);
+}
+
+static void
+free_latencies (gpointer data)
+{
+    g_array_free(data, TRUE);
+}
+
+static void
+bench_init (Bench *bench)
+{
+    bench->loop = milter_libev_event_loop_new();
+    bench->timer = g_timer_new();
+    if (seed == 0)
+        bench->rand = g_rand_new();
+    else
+        bench->rand = g_rand_new_with_seed(seed);
+    bench->mails = g_ptr_array_new();
+    bench->timer_id = 0;
+    bench->n_started = 0;
+    bench->n_finished = 0;
+    bench->n_failed = 0;
+    bench->n_running = 0;
+    bench->max_running = 0;
+    bench->session_latencies = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    bench->stage_latencies = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   g_free, free_latencies);
+    bench->status_counts = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 g_free, NULL);
+}
+
+static void
+bench_fin (Bench *bench)
+{
+    if (bench->timer_id > 0)
+        milter_event_loop_remove(bench->loop, bench->timer_id);
+    /* Run pending idle callbacks to free sessions. */
+    while (milter_event_loop_iterate(bench->loop, FALSE))
+        ;
+    g_object_unref(bench->loop);
+    g_timer_destroy(bench->timer);
+    g_rand_free(bench->rand);
+    g_ptr_array_foreach(bench->mails, (GFunc)mail_free, NULL);
+    g_ptr_array_free(bench->mails, TRUE);
+    g_array_free(bench->session_latencies, TRUE);
+    g_hash_table_unref(bench->stage_latencies);
+    g_hash_table_unref(bench->status_counts);
+}
+
+static gboolean
+parse_spec_arg (const gchar *option_name,
+                const gchar *value,
+                gpointer data,
+                GError **error)
+{
+    GError *spec_error = NULL;
+    gboolean success;
+
+    success = milter_connection_parse_spec(value, NULL, NULL, NULL, &spec_error);
+    if (success) {
+        g_free(spec);
+        spec = g_strdup(value);
+    } else {
+        g_set_error(error,
+                    G_OPTION_ERROR,
+                    G_OPTION_ERROR_BAD_VALUE,
+                    _("%s"), spec_error->message);
+        g_error_free(spec_error);
+    }
+
+    return success;
+}
+
+static gboolean
+parse_body_size_arg (const gchar *option_name,
+                     const gchar *value,
+                     gpointer data,
+                     GError **error)
+{
+    return milter_bench_distribution_parse(&body_size_distribution,
+                                           value, error);
+}
+
+static gboolean
+parse_n_recipients_arg (const gchar *option_name,
+                        const gchar *value,
+                        gpointer data,
+                        GError **error)
+{
+    return milter_bench_distribution_parse(&n_recipients_distribution,
+                                           value, error);
+}
+
+static gboolean
+print_version (const gchar *option_name,
+               const gchar *value,
+               gpointer data,
+               GError **error)
+{
+    g_print("%s %s\n", PACKAGE, VERSION);
+    exit(EXIT_SUCCESS);
+    return TRUE;
+}
+
+static const GOptionEntry option_entries[] =
+{
+    {"connection-spec", 's', 0, G_OPTION_ARG_CALLBACK, parse_spec_arg,
+     N_("The spec of client socket. "
+        "(unix:PATH|inet:PORT[@HOST]|inet6:PORT[@HOST])"),
+     "SPEC"},
+    {"sessions", 'n', 0, G_OPTION_ARG_INT, &n_sessions,
+     N_("Run N sessions. "
+        "(" G_STRINGIFY(DEFAULT_N_SESSIONS) ")"),
+     "N"},
+    {"concurrency", 'c', 0, G_OPTION_ARG_INT, &concurrency,
+     N_("Keep N sessions running in closed loop mode. "
+        "(" G_STRINGIFY(DEFAULT_CONCURRENCY) ")"),
+     "N"},
+    {"rate", 'r', 0, G_OPTION_ARG_DOUBLE, &rate,
+     N_("Start RATE sessions per second in open loop mode. "
+        "Closed loop mode is used when RATE isn't specified."),
+     "RATE"},
+    {"mail-file", 'm', 0, G_OPTION_ARG_FILENAME_ARRAY, &mail_files,
+     N_("Replay mail placed at PATH. "
+        "To replay N mails, use --mail-file option N times."),
+     "PATH"},
+    {"body-size", 0, 0, G_OPTION_ARG_CALLBACK, parse_body_size_arg,
+     N_("Use DISTRIBUTION for body size of synthetic mails. (fixed:4096)"),
+     "DISTRIBUTION"},
+    {"n-recipients", 0, 0, G_OPTION_ARG_CALLBACK, parse_n_recipients_arg,
+     N_("Use DISTRIBUTION for the number of recipients of synthetic mails. "
+        "(fixed:1)"),
+     "DISTRIBUTION"},
+    {"helo-fqdn", 0, 0, G_OPTION_ARG_STRING, &helo_host,
+     N_("Use FQDN for HELO/EHLO command"), "FQDN"},
+    {"envelope-from", 'f', 0, G_OPTION_ARG_STRING, &envelope_from,
+     N_("Use FROM as a sender address of synthetic mails"), "FROM"},
+    {"seed", 0, 0, G_OPTION_ARG_INT, &seed,
+     N_("Use SEED as random seed for synthetic mails"), "SEED"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+     N_("Write JSON result to PATH instead of standard output"), "PATH"},
+    {"connection-timeout", 0, 0, G_OPTION_ARG_DOUBLE, &connection_timeout,
+     N_("Timeout after SECONDS seconds on connecting to a milter."), "SECONDS"},
+    {"reading-timeout", 0, 0, G_OPTION_ARG_DOUBLE, &reading_timeout,
+     N_("Timeout after SECONDS seconds on reading a command."), "SECONDS"},
+    {"writing-timeout", 0, 0, G_OPTION_ARG_DOUBLE, &writing_timeout,
+     N_("Timeout after SECONDS seconds on writing a command."), "SECONDS"},
+    {"end-of-message-timeout", 0, 0, G_OPTION_ARG_DOUBLE,
+     &end_of_message_timeout,
+     N_("Timeout after SECONDS seconds on end-of-message command."), "SECONDS"},
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
+     N_("Be verbose"), NULL},
+    {"version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, print_version,
+     N_("Show version"), NULL},
+    {NULL}
+};
+
+static void
+free_option_values (void)
+{
+    g_free(spec);
+    g_strfreev(mail_files);
+    g_free(helo_host);
+    g_free(envelope_from);
+    g_free(output_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+    gboolean success = TRUE;
+    GError *error = NULL;
+    GOptionContext *option_context;
+    Bench bench;
+    gchar *json;
+
+#ifdef HAVE_LOCALE_H
+    setlocale(LC_ALL, "");
+#endif
+
+    milter_init();
+    milter_server_init();
+
+    option_context = g_option_context_new(NULL);
+    g_option_context_add_main_entries(option_context, option_entries, NULL);
+    if (!g_option_context_parse(option_context, &argc, &argv, &error)) {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(option_context);
+        free_option_values();
+        exit(EXIT_FAILURE);
+    }
+    g_option_context_free(option_context);
+
+    if (verbose)
+        g_setenv("MILTER_LOG_LEVEL", "all", FALSE);
+    if (!spec)
+        spec = g_strdup("inet:10025@localhost");
+    if (!helo_host)
+        helo_host = g_strdup("delian");
+    if (!envelope_from)
+        envelope_from = g_strdup("<sender@example.com>");
+    n_sessions = MAX(n_sessions, 1);
+    concurrency = MAX(concurrency, 1);
+
+    bench_init(&bench);
+    if (!load_mail_files(&bench, &error)) {
+        g_print("%s\n", error->message);
+        g_error_free(error);
+        bench_fin(&bench);
+        free_option_values();
+        exit(EXIT_FAILURE);
+    }
+
+    start_bench(&bench);
+    if (bench.n_finished < n_sessions)
+        milter_event_loop_run(bench.loop);
+    g_timer_stop(bench.timer);
+
+    json = bench_to_json(&bench, g_timer_elapsed(bench.timer, NULL));
+    if (output_path) {
+        if (!g_file_set_contents(output_path, json, -1, &error)) {
+            g_print("%s\n", error->message);
+            g_error_free(error);
+            success = FALSE;
+        }
+    } else {
+        g_print("%s", json);
+    }
+    g_free(json);
+    success = success && bench.n_failed == 0;
+
+    bench_fin(&bench);
+    free_option_values();
+
+    milter_server_quit();
+    milter_quit();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+vi:ts=4:nowrap:ai:expandtab:sw=4
+*/